@@ -2,7 +2,6 @@ workspace "Renderer"
 	configurations { "Debug", "Release" }
 	location "build"
 	toolset "clang"
-	system "windows"
 	platforms { "x86_64" }
 	architecture "x86_64"
 
@@ -59,34 +58,50 @@ project "RendererProject"
 		"lib/%{cfg.buildcfg}",
 	}
 
-	links {
-		"glfw3",
-		"Jolt",
-		"assimp-vc143-mt",
-		"freetype",
-		"harfbuzz",
-		"user32",
-		"gdi32",
-		"shell32",
-	}
-
 	defines {
-		"_CRT_SECURE_NO_WARNINGS",
 		"JPH_OBJECT_STREAM"
 	}
 
+	filter "system:windows"
+		links {
+			"glfw3",
+			"Jolt",
+			"assimp-vc143-mt",
+			"freetype",
+			"harfbuzz",
+			"user32",
+			"gdi32",
+			"shell32",
+		}
+		-- the minimum windows version is windows 10
+		defines {
+			"_CRT_SECURE_NO_WARNINGS",
+			"_WIN32_WINNT=_WIN32_WINNT_WIN10",
+		}
+		buildoptions { "-gcodeview" }
+
+	-- the headless mode (--headless) renders through EGL, without a window
+	filter "system:linux"
+		links {
+			"glfw",
+			"Jolt",
+			"assimp",
+			"freetype",
+			"harfbuzz",
+			"EGL",
+			"pthread",
+			"dl",
+		}
+
 	filter "configurations:Debug"
 		kind "ConsoleApp"
 		runtime "Debug"
-		links { "msvcrtd" }
-		-- the minimum windows version is windows 10
 		defines {
 			"ZR_DEBUG",
 			"TRACY_ENABLE",
 			"JPH_PROFILE_ENABLED",
 			"JPH_DEBUG_RENDERER",
 			"_DEBUG",
-			"_WIN32_WINNT=_WIN32_WINNT_WIN10",
 			"_LIBCPP_DEBUG=1",
 			"_ITERATOR_DEBUG_LEVEL=2",
 		}
@@ -95,7 +110,6 @@ project "RendererProject"
 		-- TODO: -Wall, -Werror, -Wvarargs
 		buildoptions {
 			"-g",
-			"-gcodeview",
 			-- "-fsanitize=undefined",
 			-- "-fsanitize-trap=all",
 		}
@@ -115,8 +129,6 @@ project "RendererProject"
 	filter "configurations:Release"
 		kind "ConsoleApp"
 		runtime "Release"
-		links { "msvcrt" }
-		-- the minimum windows version is windows 10
 		defines {
 			"ZR_RELEASE",
 			"TRACY_ENABLE",
@@ -124,11 +136,9 @@ project "RendererProject"
 			"JPH_DEBUG_RENDERER",
 			"NDEBUG",
 			"_ITERATOR_DEBUG_LEVEL=0",
-			"_WIN32_WINNT=_WIN32_WINNT_WIN10",
 		}
 		buildoptions {
 			"-g",
-			"-gcodeview",
 		}
 		linkoptions {
 			"-fuse-ld=lld",
@@ -137,5 +147,11 @@ project "RendererProject"
 		optimize "Full"
 		symbols "On"
 
+	filter { "system:windows", "configurations:Debug" }
+		links { "msvcrtd" }
+
+	filter { "system:windows", "configurations:Release" }
+		links { "msvcrt" }
+
 	-- TODO: distribution config
 	--		 D:\JoltPhysics\Build\VS2022_Clang\Distribution
@@ -14,6 +14,7 @@ void main()
 {
 	float x = uFilterRadius;
 	float y = uFilterRadius;
+	vec2 texelSize = 1.0 / vec2(textureSize(uScreenTexture, 0));
 
 	/** Take 9 samples around current texel:
 	 * a - b - c
@@ -24,17 +25,17 @@ void main()
 	 
 	// TODO: IMPORTANT: dont sample pixel if UV out of the screen. SSAO.frag has a example
 
-	vec3 a = texture(uScreenTexture, Saturate(vec2(UV.x - x,	UV.y + y))).rgb;
-	vec3 b = texture(uScreenTexture, Saturate(vec2(UV.x,		UV.y + y))).rgb;
-	vec3 c = texture(uScreenTexture, Saturate(vec2(UV.x + x,	UV.y + y))).rgb;
+	vec3 a = texture(uScreenTexture, RenderUV(vec2(UV.x - x,	UV.y + y), texelSize)).rgb;
+	vec3 b = texture(uScreenTexture, RenderUV(vec2(UV.x,		UV.y + y), texelSize)).rgb;
+	vec3 c = texture(uScreenTexture, RenderUV(vec2(UV.x + x,	UV.y + y), texelSize)).rgb;
 
-	vec3 d = texture(uScreenTexture, Saturate(vec2(UV.x - x,	UV.y))).rgb;
-	vec3 e = texture(uScreenTexture, Saturate(vec2(UV.x,		UV.y))).rgb;
-	vec3 f = texture(uScreenTexture, Saturate(vec2(UV.x + x,	UV.y))).rgb;
+	vec3 d = texture(uScreenTexture, RenderUV(vec2(UV.x - x,	UV.y), texelSize)).rgb;
+	vec3 e = texture(uScreenTexture, RenderUV(vec2(UV.x,		UV.y), texelSize)).rgb;
+	vec3 f = texture(uScreenTexture, RenderUV(vec2(UV.x + x,	UV.y), texelSize)).rgb;
 
-	vec3 g = texture(uScreenTexture, Saturate(vec2(UV.x - x,	UV.y - y))).rgb;
-	vec3 h = texture(uScreenTexture, Saturate(vec2(UV.x,		UV.y - y))).rgb;
-	vec3 i = texture(uScreenTexture, Saturate(vec2(UV.x + x,	UV.y - y))).rgb;
+	vec3 g = texture(uScreenTexture, RenderUV(vec2(UV.x - x,	UV.y - y), texelSize)).rgb;
+	vec3 h = texture(uScreenTexture, RenderUV(vec2(UV.x,		UV.y - y), texelSize)).rgb;
+	vec3 i = texture(uScreenTexture, RenderUV(vec2(UV.x + x,	UV.y - y), texelSize)).rgb;
 
 	/** Apply weighted distribution, by using a 3x3 tent filter:
 	 *  1   | 1 2 1 |
@@ -1,14 +1,29 @@
 #version 460 core
 
+#include "Utils.glsl"
+
+// permutations: PACKED_GBUFFER
+
+#ifdef PACKED_GBUFFER
+// the position is reconstructed from the depth buffer
+layout (location = 0) out vec4 gAlbedoSpecular;
+layout (location = 1) out vec2 gNormal;
+// the screen UV this frame minus the screen UV last frame, only attached with TAA
+layout (location = 2) out vec2 gVelocity;
+#else
 layout (location = 0) out vec4 gAlbedo;
 layout (location = 1) out vec4 gSpecular;
 layout (location = 2) out vec4 gNormal;
 layout (location = 3) out vec4 gPosition;
+layout (location = 4) out vec2 gVelocity;
+#endif
 
 in vec2 UV;
 in vec3 FragPos;
 in vec3 Normal;
 in mat3 TBN;
+in vec4 CurrentClip;
+in vec4 PrevClip;
 
 layout (binding = 0) uniform sampler2D uTextureDiffuse;
 layout (binding = 1) uniform sampler2D uTextureSpecular;
@@ -17,12 +32,20 @@ layout (binding = 3) uniform sampler2D uTextureNormal;
 
 void main()
 {
+	vec3 texNormal	= texture(uTextureNormal, UV).xyz;
+	texNormal		= texNormal * 2.0 - 1.0; // [0,1] to [-1,1]
+	vec3 normal		= normalize(TBN * texNormal);
+
+#ifdef PACKED_GBUFFER
+	gAlbedoSpecular	= vec4(texture(uTextureDiffuse, UV).rgb, texture(uTextureSpecular, UV).r);
+	gNormal			= EncodeOctahedral(normal);
+#else
 	gAlbedo.rgb	= texture(uTextureDiffuse, UV).rgb;
 	gSpecular	= vec4(texture(uTextureSpecular, UV).rgb, 1.0);
 	// depth values are in gPosition.a
 	gPosition	= vec4(FragPos, gl_FragCoord.z);
+	gNormal		= vec4(normal, 1.0);
+#endif
 
-	vec3 texNormal	= texture(uTextureNormal, UV).xyz;
-	texNormal		= texNormal * 2.0 - 1.0; // [0,1] to [-1,1]
-	gNormal			= vec4(normalize(TBN * texNormal), 1.0);
+	gVelocity = (CurrentClip.xy / CurrentClip.w - PrevClip.xy / PrevClip.w) * 0.5;
 }
@@ -5,15 +5,26 @@ layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aUV;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in vec3 aBitangent;
+// per instance, Geom::Mesh::mInstanceTransforms
+layout (location = 5) in mat4 aModel;
 
 out vec3 Normal;
 out vec2 UV;
 out vec3 FragPos;
 out mat3 TBN;
+// without the jitter, for the velocity
+out vec4 CurrentClip;
+out vec4 PrevClip;
+
+// the depth must match DepthPrepass.vert for the GL_EQUAL depth test
+invariant gl_Position;
 
-uniform mat4 uModel;
 uniform mat4 uView;
+/// @brief Jittered by the temporal anti-aliasing.
 uniform mat4 uProjection;
+/// @brief The view projection of this and the previous frame, without the jitter.
+uniform mat4 uViewProjection;
+uniform mat4 uPrevViewProjection;
 
 void main()
 {
@@ -23,13 +34,18 @@ void main()
 	Normal = (uView * vec4(aNormal, 0.0)).xyz;
 	UV = aUV;
 
-	vec3 T = normalize(vec3(uModel * vec4(aTangent, 0.0)));
-	vec3 B = normalize(vec3(uModel * vec4(aBitangent, 0.0)));
-	vec3 N = normalize(vec3(uModel * vec4(Normal, 0.0)));
+	vec3 T = normalize(vec3(aModel * vec4(aTangent, 0.0)));
+	vec3 B = normalize(vec3(aModel * vec4(aBitangent, 0.0)));
+	vec3 N = normalize(vec3(aModel * vec4(Normal, 0.0)));
 	TBN = mat3(T, B, N);
 
-	vec4 viewPos = uView * uModel * vec4(aPos, 1.0);
+	vec4 viewPos = uView * aModel * vec4(aPos, 1.0);
 	FragPos = viewPos.xyz;
 
 	gl_Position = uProjection * viewPos;
+
+	// meshes don't move, only the camera does
+	vec4 worldPos = aModel * vec4(aPos, 1.0);
+	CurrentClip	= uViewProjection * worldPos;
+	PrevClip	= uPrevViewProjection * worldPos;
 }
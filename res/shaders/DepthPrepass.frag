@@ -0,0 +1,7 @@
+#version 460 core
+
+// only the depth is written
+
+void main()
+{
+}
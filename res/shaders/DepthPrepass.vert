@@ -0,0 +1,22 @@
+#version 460 core
+
+/**
+ * the depth prepass of the G-buffer. only the position is read, and gl_Position is computed
+ * exactly like Deferred.vert so the G-buffer pass can test its depth with GL_EQUAL.
+ */
+
+layout (location = 0) in vec3 aPos;
+// per instance, Geom::Mesh::mInstanceTransforms
+layout (location = 5) in mat4 aModel;
+
+invariant gl_Position;
+
+uniform mat4 uView;
+/// @brief Jittered by the temporal anti-aliasing, like in Deferred.vert.
+uniform mat4 uProjection;
+
+void main()
+{
+	vec4 viewPos = uView * aModel * vec4(aPos, 1.0);
+	gl_Position = uProjection * viewPos;
+}
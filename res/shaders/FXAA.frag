@@ -12,7 +12,6 @@ out vec4 FragColor;
 in vec2 UV;
 
 layout (binding = 0) uniform sampler2D	uScreenTexture;
-uniform bool							uEnableFxaa;
 
 vec3 FxaaTextureOffset(vec2 pos, ivec2 offset);
 
@@ -28,22 +27,20 @@ vec3 FxaaTextureOffset(vec2 pos, ivec2 offset);
 #define FXAA_SEARCH_THRESHOLD (1.0 / 4.0)
 
 vec2 gTexelSize;
+// the input may be rendered to a part of the texture, see RenderUV()
+vec2 gMaxUV;
 
 void main()
 {
-	if (!uEnableFxaa)
-	{
-		FragColor = vec4(texture(uScreenTexture, UV).rgb, 1.0);
-		return;
-	}
-
 	gTexelSize = 1.0 / textureSize(uScreenTexture, 0);
+	gMaxUV = uRenderScale - 0.5 * gTexelSize;
+	vec2 uv = UV * uRenderScale;
 
-	vec3 rgbM = texture(uScreenTexture, UV).rgb;
-	vec3 rgbN = FxaaTextureOffset(UV, ivec2( 0, -1));
-	vec3 rgbW = FxaaTextureOffset(UV, ivec2(-1,  0));
-	vec3 rgbS = FxaaTextureOffset(UV, ivec2( 0,  1));
-	vec3 rgbE = FxaaTextureOffset(UV, ivec2( 1,  0));
+	vec3 rgbM = texture(uScreenTexture, uv).rgb;
+	vec3 rgbN = FxaaTextureOffset(uv, ivec2( 0, -1));
+	vec3 rgbW = FxaaTextureOffset(uv, ivec2(-1,  0));
+	vec3 rgbS = FxaaTextureOffset(uv, ivec2( 0,  1));
+	vec3 rgbE = FxaaTextureOffset(uv, ivec2( 1,  0));
 
 	float lumM = Luminance(rgbM);
 	float lumN = Luminance(rgbN);
@@ -66,10 +63,10 @@ void main()
 	blendL = min(FXAA_SUBPIX_CAP, blendL);
 
 	vec3 rgbL = rgbN + rgbW + rgbM + rgbE + rgbS;
-	vec3 rgbNW = FxaaTextureOffset(UV, ivec2(-1, -1));
-	vec3 rgbNE = FxaaTextureOffset(UV, ivec2( 1, -1));
-	vec3 rgbSW = FxaaTextureOffset(UV, ivec2(-1,  1));
-	vec3 rgbSE = FxaaTextureOffset(UV, ivec2( 1,  1));
+	vec3 rgbNW = FxaaTextureOffset(uv, ivec2(-1, -1));
+	vec3 rgbNE = FxaaTextureOffset(uv, ivec2( 1, -1));
+	vec3 rgbSW = FxaaTextureOffset(uv, ivec2(-1,  1));
+	vec3 rgbSE = FxaaTextureOffset(uv, ivec2( 1,  1));
 	float lumNW = Luminance(rgbNW);
 	float lumNE = Luminance(rgbNE);
 	float lumSW = Luminance(rgbSW);
@@ -128,8 +125,8 @@ void main()
 	}
 
 	vec2 posN;
-	posN.x = UV.x + (horzSpan ? 0.0 : lengthSign / 2.0);
-	posN.y = UV.y + (horzSpan ? lengthSign / 2.0 : 0.0);
+	posN.x = uv.x + (horzSpan ? 0.0 : lengthSign / 2.0);
+	posN.y = uv.y + (horzSpan ? lengthSign / 2.0 : 0.0);
 
 	gradN *= FXAA_SEARCH_THRESHOLD;
 
@@ -147,8 +144,8 @@ void main()
 
 	for (uint i = 0; i < FXAA_SEARCH_STEPS; i++)
 	{
-		if (!doneN) lumEndN = Luminance(textureGrad(uScreenTexture, posN, offsetNP, offsetNP).rgb);
-		if (!doneP) lumEndP = Luminance(textureGrad(uScreenTexture, posP, offsetNP, offsetNP).rgb);
+		if (!doneN) lumEndN = Luminance(textureGrad(uScreenTexture, min(posN, gMaxUV), offsetNP, offsetNP).rgb);
+		if (!doneP) lumEndP = Luminance(textureGrad(uScreenTexture, min(posP, gMaxUV), offsetNP, offsetNP).rgb);
 
 		doneN = doneN || (abs(lumEndN - lumN) >= gradN);
 		doneP = doneP || (abs(lumEndP - lumN) >= gradN);
@@ -159,8 +156,8 @@ void main()
 		if (!doneP) posP += offsetNP;
 	}
 
-	float distN = horzSpan ? (UV.x - posN.x) : (UV.y - posN.y);
-	float distP = horzSpan ? (posP.x - UV.x) : (posP.y - UV.y);
+	float distN = horzSpan ? (uv.x - posN.x) : (uv.y - posN.y);
+	float distP = horzSpan ? (posP.x - uv.x) : (posP.y - uv.y);
 
 	bool directionN = distN < distP;
 
@@ -174,8 +171,8 @@ void main()
 	float subPixelOffset = (0.5 + (distN * (-1.0 / spanLength))) * lengthSign;
 
 	vec2 sampleFrom;
-	sampleFrom.x = UV.x + (horzSpan ? 0.0 : subPixelOffset);
-	sampleFrom.y = UV.y + (horzSpan ? subPixelOffset : 0.0);
+	sampleFrom.x = uv.x + (horzSpan ? 0.0 : subPixelOffset);
+	sampleFrom.y = uv.y + (horzSpan ? subPixelOffset : 0.0);
 
 	vec3 rgbF = texture(uScreenTexture, sampleFrom).xyz;
 
@@ -184,5 +181,5 @@ void main()
 
 vec3 FxaaTextureOffset(vec2 pos, ivec2 offset)
 {
-	return texture(uScreenTexture, clamp(pos + offset * gTexelSize, 0.0, 1.0)).rgb;
+	return texture(uScreenTexture, clamp(pos + offset * gTexelSize, 0.5 * gTexelSize, gMaxUV)).rgb;
 }
@@ -1,52 +1,53 @@
 #version 460 core
 
-out vec4 FragColor;
+#include "Utils.glsl"
+#include "Lights.glsl"
 
-in vec2 UV;
+// permutations: ENABLE_SSAO, CSM_DEBUG, PACKED_GBUFFER
 
-struct PointLight
-{
-	vec3	mPosition;
-	vec3	mColor;
-	float	mLinear;
-	float	mQuadratic;
-};
-
-struct DirLight
-{
-	vec3 mDirection;
-	vec3 mColor;
-};
+out vec4 FragColor;
 
-#define MAX_POINT_LIGHTS 42
+in vec2 UV;
 
+#ifdef PACKED_GBUFFER
+layout (binding = 0) uniform sampler2D		uAlbedoSpecularTexture;
+layout (binding = 2) uniform sampler2D		uNormalTexture;
+layout (binding = 3) uniform sampler2D		uDepthTexture;
+#else
 layout (binding = 0) uniform sampler2D		uAlbedoTexture;
 layout (binding = 1) uniform sampler2D		uSpecularTexture;
 layout (binding = 2) uniform sampler2D		uNormalTexture;
 layout (binding = 3) uniform sampler2D		uPositionTexture;
+#endif
 layout (binding = 4) uniform sampler2D		uOcclusionTexture;
 layout (binding = 5) uniform sampler2DArray	uCascades;
 
 uniform vec3							uViewPos;
-uniform uint							uNumPointLights;
-uniform PointLight[MAX_POINT_LIGHTS]	uPointLights;
-uniform DirLight						uDirLight;
-uniform bool							uEnableSSAO;
-uniform bool							uCsmDebug;
 uniform mat4							uView;
-// TODO: when i unhardcode the number of frusta and cascades, plz unhardcode in Transparent.frag also
-uniform mat4							uCascadeMatrices[4];
-uniform float							uShadowCascadeLevels[3];
+uniform mat4							uInvProjection;
 
 float CalculateShadow(vec4 pos, vec3 normal, vec3 lightDir, int cascadeIdx);
 
 void main()
 {
-	vec3 albedo		= texture(uAlbedoTexture, UV).rgb;
-	float specular	= texture(uSpecularTexture, UV).r;
-	vec3 normal		= texture(uNormalTexture, UV).rgb;
-	vec3 pos		= texture(uPositionTexture, UV).rgb;
-	float occlusion	= texture(uOcclusionTexture, UV).r;
+	// the pixel centers of the rendered part
+	vec2 uv = UV * uRenderScale;
+
+#ifdef PACKED_GBUFFER
+	vec4 albedoSpecular	= texture(uAlbedoSpecularTexture, uv);
+	vec3 albedo		= albedoSpecular.rgb;
+	float specular	= albedoSpecular.a;
+	vec3 normal		= DecodeOctahedral(texture(uNormalTexture, uv).rg);
+	vec3 pos		= ReconstructViewPos(UV, texture(uDepthTexture, uv).r, uInvProjection);
+#else
+	vec3 albedo		= texture(uAlbedoTexture, uv).rgb;
+	float specular	= texture(uSpecularTexture, uv).r;
+	vec3 normal		= texture(uNormalTexture, uv).rgb;
+	vec3 pos		= texture(uPositionTexture, uv).rgb;
+#endif
+#ifdef ENABLE_SSAO
+	float occlusion	= texture(uOcclusionTexture, uv).r;
+#endif
 
 	vec3 viewDir = normalize(uViewPos - pos);
 
@@ -55,41 +56,28 @@ void main()
 	{ // dir light
 		const float kAmbientFactor = 0.05;
 		vec3 ambient = uDirLight.mColor * kAmbientFactor * albedo;
-		if (uEnableSSAO)
-			ambient *= occlusion;
+#ifdef ENABLE_SSAO
+		ambient *= occlusion;
+#endif
 
 		vec3 lightDir	= normalize((uView * vec4(uDirLight.mDirection, 0.0)).xyz);
 		vec3 halfwayDir	= normalize(lightDir + viewDir);
 
-		float depth = abs(pos.z);
-		int cascadeIdx = -1;
-		for (int i = 0; i < 3; i++)
-		{
-			if (depth < uShadowCascadeLevels[i])
-			{
-				cascadeIdx = i;
-				break;
-			}
-		}
-		if (cascadeIdx == -1)
-		{
-			cascadeIdx = 3;
-		}
+		int cascadeIdx = SelectCascade(abs(pos.z));
+
+#ifdef CSM_DEBUG
+		float levelColor = float(cascadeIdx) / 255.0;
+		levelColor *= 255.0 / float(max(uCascadeCount - 1, 1)); // the maximum cascade idx
+
+		FragColor = vec4(levelColor, 0.0, 0.0, 1.0);
+		return;
+#endif
 
 		vec4 posWorldSpace = inverse(uView) * vec4(pos, 1.0);
 		vec4 posLightSpace = uCascadeMatrices[cascadeIdx] * posWorldSpace;
 
 		float shadow = CalculateShadow(posLightSpace, normal, lightDir, cascadeIdx);
 
-		float levelColor = float(cascadeIdx) / 255.0;
-		levelColor *= 255.0 / 3.0; // 3 is the maximum cascade idx
-
-		if (uCsmDebug)
-		{
-			FragColor = vec4(levelColor, 0.0, 0.0, 1.0);
-			return;
-		}
-
 		float diff = max(dot(normal, lightDir), 0.0);
 		// TODO: this 1.0 should be shininess
 		float spec = pow(max(dot(normal, halfwayDir), 0.0), 1.0);
@@ -122,8 +110,9 @@ void main()
 								   + uPointLights[i].mQuadratic * (distance * distance));
 
 		vec3 ambient = uPointLights[i].mColor * albedo;
-		if (uEnableSSAO)
-			ambient *= occlusion;
+#ifdef ENABLE_SSAO
+		ambient *= occlusion;
+#endif
 
 		vec3 diffuse		= uPointLights[i].mColor * diff * albedo;
 		vec3 lightSpecular	= spec * vec3(specular);
@@ -156,10 +145,7 @@ float CalculateShadow(vec4 pos, vec3 normal, vec3 lightDir, int cascadeIdx)
 	float currentDepth = projCoords.z;
 
 	float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
-	if (cascadeIdx == 3)
-		bias *= 1.0 / (1000.0 * 0.5);
-	else
-		bias *= 1.0 / (uShadowCascadeLevels[cascadeIdx] * 0.5);
+	bias *= 1.0 / (uShadowCascadeLevels[cascadeIdx] * 0.5);
 
 	float shadow = 0.0;
 	vec2 texelSize = 1.0 / vec2(textureSize(uCascades, 0));
@@ -0,0 +1,44 @@
+#define MAX_POINT_LIGHTS 42
+// Renderer::kCascadeCount
+#define MAX_CASCADES 4
+
+struct PointLight
+{
+	vec3	mPosition;	// world space
+	float	mLinear;
+	vec3	mColor;
+	float	mQuadratic;
+};
+
+struct DirLight
+{
+	vec3	mDirection;	// world space, towards the light
+	float	Pad0;
+	vec3	mColor;
+	float	Pad1;
+};
+
+/**
+ * the lights and cascades of a frame, FrameLightsUniforms on the CPU. they are uploaded once
+ * per frame and shared by every program which shades, the renderer keeps the block bound.
+ */
+layout (std140, binding = 1) uniform FrameLights {
+	PointLight	uPointLights[MAX_POINT_LIGHTS];
+	DirLight	uDirLight;
+	mat4		uCascadeMatrices[MAX_CASCADES];
+	/// @brief The far view space depth of every cascade, the last one covers the rest of the view.
+	vec4		uShadowCascadeLevels;
+	uint		uNumPointLights;
+	int			uCascadeCount;
+};
+
+// the cascade of a positive view space depth
+int SelectCascade(float depth)
+{
+	for (int i = 0; i < uCascadeCount - 1; i++)
+	{
+		if (depth < uShadowCascadeLevels[i])
+			return i;
+	}
+	return uCascadeCount - 1;
+}
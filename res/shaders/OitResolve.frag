@@ -0,0 +1,111 @@
+#version 460 core
+
+// permutations: LINKED_LIST
+
+/**
+ * composites the order independent transparency over the lit scene. the output is the
+ * premultiplied color of the transparent layers and their transmittance, blended with
+ * (ONE, SRC_ALPHA) so the scene is scaled by how much light the layers let through.
+ */
+
+out vec4 FragColor;
+
+in vec2 UV;
+
+#ifdef LINKED_LIST
+// the nearest fragments of a pixel are sorted, the farther ones are blended unsorted behind them
+#define MAX_FRAGMENTS 16
+
+layout (binding = 0, r32ui) uniform readonly uimage2D	uHeads;
+layout (binding = 0, std430) readonly buffer			Nodes {
+	uint	NodeCount;
+	uint	Pad[3];
+	uvec4	Node[];
+};
+#else
+layout (binding = 0) uniform sampler2D	uAccumulation;
+layout (binding = 1) uniform sampler2D	uRevealage;
+#endif
+
+void main()
+{
+	ivec2 coord = ivec2(gl_FragCoord.xy);
+
+#ifdef LINKED_LIST
+	// kept sorted near to far while the list is walked, a nearer fragment pushes out the farthest
+	uvec4 fragments[MAX_FRAGMENTS];
+	int count = 0;
+	// the pushed out fragments, weighted by their alpha like the weighted blended mode
+	vec3 tailColor = vec3(0.0);
+	float tailAlpha = 0.0;
+	float tailTransmittance = 1.0;
+
+	uint index = imageLoad(uHeads, coord).r;
+	while (index != 0xFFFFFFFFu)
+	{
+		uvec4 fragment = Node[index];
+		index = fragment.w;
+		float depth = uintBitsToFloat(fragment.z);
+
+		if (count == MAX_FRAGMENTS)
+		{
+			// the farthest of the kept fragments or this one goes to the tail
+			bool nearer = uintBitsToFloat(fragments[MAX_FRAGMENTS - 1].z) > depth;
+			uvec4 farthest = nearer ? fragments[MAX_FRAGMENTS - 1] : fragment;
+
+			vec2 rg = unpackHalf2x16(farthest.x);
+			vec2 ba = unpackHalf2x16(farthest.y);
+			tailColor += ba.y * vec3(rg, ba.x);
+			tailAlpha += ba.y;
+			tailTransmittance *= 1.0 - ba.y;
+			if (!nearer)
+				continue;
+			count--;
+		}
+
+		// insertion, near to far
+		int j = count - 1;
+		while (j >= 0 && uintBitsToFloat(fragments[j].z) > depth)
+		{
+			fragments[j + 1] = fragments[j];
+			j--;
+		}
+		fragments[j + 1] = fragment;
+		count++;
+	}
+
+	if (count == 0)
+		discard;
+
+	vec3 color = vec3(0.0);
+	float transmittance = 1.0;
+	for (int i = 0; i < count; i++)
+	{
+		vec2 rg = unpackHalf2x16(fragments[i].x);
+		vec2 ba = unpackHalf2x16(fragments[i].y);
+		color += transmittance * ba.y * vec3(rg, ba.x);
+		transmittance *= 1.0 - ba.y;
+	}
+
+	if (tailAlpha > 0.0)
+	{
+		color += transmittance * (1.0 - tailTransmittance) * tailColor / tailAlpha;
+		transmittance *= tailTransmittance;
+	}
+
+	FragColor = vec4(color, transmittance);
+#else
+	float revealage = texelFetch(uRevealage, coord, 0).r;
+	// no transparent layer covers the pixel
+	if (revealage == 1.0)
+		discard;
+
+	vec4 accumulation = texelFetch(uAccumulation, coord, 0);
+	// the half float sum overflows under many heavily weighted layers
+	if (isinf(max(max(abs(accumulation.r), abs(accumulation.g)), abs(accumulation.b))))
+		accumulation.rgb = vec3(accumulation.a);
+
+	vec3 average = accumulation.rgb / max(accumulation.a, 1e-5);
+	FragColor = vec4(average * (1.0 - revealage), revealage);
+#endif
+}
@@ -1,32 +1,73 @@
 #version 460 core
 
+#include "Utils.glsl"
+
+// permutations: PACKED_GBUFFER, LOW_RES
+
 out float FragColor;
 
 in vec2 UV;
 
-#define SAMPLE_COUNT (32)
+#define MAX_SAMPLE_COUNT (64)
 
+#if defined(LOW_RES)
+// the downsampled G-buffer, view space normal in xyz and z in w
+layout (binding = 0) uniform sampler2D uDepthNormalTexture;
+#elif defined(PACKED_GBUFFER)
+layout (binding = 0) uniform sampler2D uDepthTexture;
+layout (binding = 1) uniform sampler2D uNormalTexture;
+#else
 layout (binding = 0) uniform sampler2D uPositionTexture;
 layout (binding = 1) uniform sampler2D uNormalTexture;
+#endif
 layout (binding = 2) uniform sampler2D uNoiseTexture;
 
-uniform vec3 uSamples[SAMPLE_COUNT];
+uniform vec3 uSamples[MAX_SAMPLE_COUNT];
+uniform uint uSampleCount;
+uniform float uRadius;
 uniform mat4 uProjection;
+uniform mat4 uInvProjection;
+
+// uv is a screen UV, the targets are sampled in their rendered part
+vec3 ViewPos(vec2 uv)
+{
+#if defined(LOW_RES)
+	return ViewPosFromViewZ(uv, texture(uDepthNormalTexture, uv * uRenderScale).w, uProjection);
+#elif defined(PACKED_GBUFFER)
+	return ReconstructViewPos(uv, texture(uDepthTexture, uv * uRenderScale).r, uInvProjection);
+#else
+	return texture(uPositionTexture, uv * uRenderScale).rgb;
+#endif
+}
+
+vec3 ViewNormal(vec2 uv)
+{
+#if defined(LOW_RES)
+	return texture(uDepthNormalTexture, uv * uRenderScale).xyz;
+#elif defined(PACKED_GBUFFER)
+	return DecodeOctahedral(texture(uNormalTexture, uv * uRenderScale).rg);
+#else
+	return texture(uNormalTexture, uv * uRenderScale).rgb;
+#endif
+}
 
 vec2 gNoiseScale;
 
-const float kRadius = 3.1;
 const float kBias = 0.025;
 
 void main()
 {
 	float noiseSize = textureSize(uNoiseTexture, 0).x;
-	vec2 screenSize = textureSize(uPositionTexture, 0).xy;
+#ifdef LOW_RES
+	vec2 screenSize = vec2(textureSize(uDepthNormalTexture, 0).xy) * uRenderScale;
+#else
+	vec2 screenSize = vec2(textureSize(uNormalTexture, 0).xy) * uRenderScale;
+#endif
 
 	gNoiseScale = vec2(screenSize.x / noiseSize, screenSize.y / noiseSize);
 
-	vec3 pos		= texture(uPositionTexture, UV).rgb;
-	vec3 normal		= texture(uNormalTexture, UV).rgb;
+	vec3 pos		= ViewPos(UV);
+	vec3 normal		= ViewNormal(UV);
 	vec3 randomVec	= texture(uNoiseTexture, UV * gNoiseScale).rgb;
 
 	vec3 tangent	= normalize(randomVec - normal * dot(randomVec, normal));
@@ -34,10 +75,10 @@ void main()
 	mat3 TBN		= mat3(tangent, bitangent, normal);
 
 	float occlusion = 0.0;
-	for (uint i = 0; i < SAMPLE_COUNT; i++)
+	for (uint i = 0; i < uSampleCount; i++)
 	{
 		vec3 samplePos = TBN * uSamples[i];
-		samplePos = pos + samplePos * kRadius;
+		samplePos = pos + samplePos * uRadius;
 
 		vec4 offset = vec4(samplePos, 1.0);
 		offset = uProjection * offset;
@@ -47,12 +88,12 @@ void main()
 		if (offset.x < 0.0 || offset.x > 1.0 || offset.y < 0.0 || offset.y > 1.0)
 			continue;
 
-		float sampleDepth = texture(uPositionTexture, offset.xy).z;
+		float sampleDepth = ViewPos(offset.xy).z;
 
-		float rangeCheck = smoothstep(0.0, 1.0, kRadius / abs(pos.z - sampleDepth));
+		float rangeCheck = smoothstep(0.0, 1.0, uRadius / abs(pos.z - sampleDepth));
 		occlusion += (sampleDepth >= samplePos.z + kBias ? 1.0 : 0.0) * rangeCheck;
 	}
 
-	occlusion = 1.0 - (occlusion / float(SAMPLE_COUNT));
+	occlusion = 1.0 - (occlusion / float(uSampleCount));
 	FragColor = occlusion;
 }
@@ -1,10 +1,10 @@
 #version 460 core
 
 layout (location = 0) in vec3 aPos;
-
-uniform mat4 uModel;
+// per instance, Geom::Mesh::mInstanceTransforms
+layout (location = 5) in mat4 aModel;
 
 void main()
 {
-	gl_Position = uModel * vec4(aPos, 1.0);
+	gl_Position = aModel * vec4(aPos, 1.0);
 }
@@ -5,8 +5,8 @@ out vec4 FragColor;
 in vec3 UVW;
 
 layout (binding = 0, std430) buffer	Luma {
-	uint	TotalLuma;			// not used by this shader
-	float	DesiredExposure;	// not used by this shader
+	uint	Histogram[256];		// not used by this shader
+	float	AverageLogLuma;		// not used by this shader
 	float	Exposure;			// the current exposure
 };
 
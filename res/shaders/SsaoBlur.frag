@@ -1,5 +1,7 @@
 #version 460 core
 
+#include "Utils.glsl"
+
 out float FragColor;
 
 in vec2 UV;
@@ -9,13 +11,16 @@ layout (binding = 0) uniform sampler2D uOcclusionTexture;
 void main()
 {
 	vec2 texelSize = 1.0 / vec2(textureSize(uOcclusionTexture, 0));
+	vec2 uv = UV * uRenderScale;
+	// taps past the rendered part would read a stale frame
+	vec2 maxUV = uRenderScale - 0.5 * texelSize;
 	float result = 0.0;
 	for (int x = -2; x < 2; ++x) 
 	{
 		for (int y = -2; y < 2; ++y) 
 		{
 			vec2 offset = vec2(float(x), float(y)) * texelSize;
-			result += texture(uOcclusionTexture, UV + offset).r;
+			result += texture(uOcclusionTexture, min(uv + offset, maxUV)).r;
 		}
 	}
 	FragColor = result / (4.0 * 4.0);
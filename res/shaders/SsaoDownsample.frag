@@ -0,0 +1,66 @@
+#version 460 core
+
+#include "Utils.glsl"
+
+// permutations: PACKED_GBUFFER
+
+/**
+ * writes the view space normal (xyz) and z (w) of the G-buffer at the SSAO
+ * resolution. of the corner texels of the block a texel covers, the closest
+ * to the camera is kept, so thin foreground objects survive the downsample.
+ */
+
+out vec4 FragColor;
+
+in vec2 UV;
+
+#ifdef PACKED_GBUFFER
+layout (binding = 0) uniform sampler2D uDepthTexture;
+#else
+layout (binding = 0) uniform sampler2D uPositionTexture;
+#endif
+layout (binding = 1) uniform sampler2D uNormalTexture;
+
+uniform int		uScale;
+uniform mat4	uInvProjection;
+
+void main()
+{
+	// the rendered part of the G-buffer
+	ivec2 fullSize = uRenderSize;
+	ivec2 origin = ivec2(gl_FragCoord.xy) * uScale;
+
+	ivec2 corners[4] = ivec2[](
+		ivec2(0, 0), ivec2(uScale - 1, 0),
+		ivec2(0, uScale - 1), ivec2(uScale - 1, uScale - 1)
+	);
+
+	float closestZ = -1e30;
+	ivec2 closest = origin;
+	for (int i = 0; i < 4; i++)
+	{
+		ivec2 coord = min(origin + corners[i], fullSize - 1);
+
+#ifdef PACKED_GBUFFER
+		vec2 uv = (vec2(coord) + 0.5) / vec2(fullSize);
+		float z = ReconstructViewPos(uv, texelFetch(uDepthTexture, coord, 0).r, uInvProjection).z;
+#else
+		float z = texelFetch(uPositionTexture, coord, 0).z;
+#endif
+
+		// view space z is negative, the largest is the closest
+		if (z > closestZ)
+		{
+			closestZ = z;
+			closest = coord;
+		}
+	}
+
+#ifdef PACKED_GBUFFER
+	vec3 normal = DecodeOctahedral(texelFetch(uNormalTexture, closest, 0).rg);
+#else
+	vec3 normal = texelFetch(uNormalTexture, closest, 0).rgb;
+#endif
+
+	FragColor = vec4(normal, closestZ);
+}
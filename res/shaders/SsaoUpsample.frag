@@ -0,0 +1,73 @@
+#version 460 core
+
+#include "Utils.glsl"
+
+// permutations: PACKED_GBUFFER
+
+/**
+ * depth aware bilateral upsample of the low resolution occlusion. the bilinear
+ * weights of the 4 closest low resolution texels are scaled by how similar their
+ * depth and normal are to the full resolution pixel, so occlusion doesn't bleed
+ * across edges.
+ */
+
+out float FragColor;
+
+in vec2 UV;
+
+layout (binding = 0) uniform sampler2D uOcclusionTexture;
+layout (binding = 1) uniform sampler2D uDepthNormalTexture;
+#ifdef PACKED_GBUFFER
+layout (binding = 2) uniform sampler2D uDepthTexture;
+#else
+layout (binding = 2) uniform sampler2D uPositionTexture;
+#endif
+layout (binding = 3) uniform sampler2D uNormalTexture;
+
+uniform mat4 uInvProjection;
+
+const float kDepthEpsilon = 0.01;
+const float kNormalPower = 8.0;
+
+void main()
+{
+	vec2 uv = UV * uRenderScale;
+#ifdef PACKED_GBUFFER
+	float z		= ReconstructViewPos(UV, texture(uDepthTexture, uv).r, uInvProjection).z;
+	vec3 normal	= DecodeOctahedral(texture(uNormalTexture, uv).rg);
+#else
+	float z		= texture(uPositionTexture, uv).z;
+	vec3 normal	= texture(uNormalTexture, uv).rgb;
+#endif
+
+	// the rendered part of the low resolution targets
+	vec2 lowRenderSize = floor(vec2(textureSize(uOcclusionTexture, 0)) * uRenderScale + 0.5);
+	ivec2 lowSize = max(ivec2(lowRenderSize), ivec2(1));
+	vec2 texel = UV * lowRenderSize - 0.5;
+	ivec2 base = ivec2(floor(texel));
+	vec2 f = texel - floor(texel);
+
+	float bilinear[4] = float[](
+		(1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y),
+		(1.0 - f.x) * f.y,         f.x * f.y
+	);
+	ivec2 offsets[4] = ivec2[](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1), ivec2(1, 1));
+
+	float result = 0.0;
+	float totalWeight = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		ivec2 coord = clamp(base + offsets[i], ivec2(0), lowSize - 1);
+		vec4 depthNormal = texelFetch(uDepthNormalTexture, coord, 0);
+
+		float depthWeight = 1.0 / (kDepthEpsilon + abs(z - depthNormal.w));
+		float normalWeight = pow(max(dot(normal, depthNormal.xyz), 0.0), kNormalPower);
+		float weight = bilinear[i] * depthWeight * normalWeight;
+
+		result += texelFetch(uOcclusionTexture, coord, 0).r * weight;
+		totalWeight += weight;
+	}
+
+	// no texel is similar, a plain bilinear sample is the best guess
+	FragColor = totalWeight > 1e-4 ? result / totalWeight : texture(uOcclusionTexture, uv).r;
+}
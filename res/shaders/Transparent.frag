@@ -1,26 +1,34 @@
 #version 460 core
 
+#include "Lights.glsl"
+
+// permutations: WEIGHTED_BLENDED, LINKED_LIST, see Renderer::ETransparency
+
+#if defined(WEIGHTED_BLENDED)
+// summed over the layers, the weighted premultiplied color and the weighted opacity
+layout (location = 0) out vec4 Accumulation;
+// multiplied over the layers, the transmittance
+layout (location = 1) out float Revealage;
+#elif defined(LINKED_LIST)
+// the fragments hidden by the G-buffer depth are never stored
+layout (early_fragment_tests) in;
+
+layout (binding = 0, r32ui) uniform coherent uimage2D	uHeads;
+/// @brief A node is its half color and opacity, its depth and the next node of its pixel.
+layout (binding = 0, std430) buffer						Nodes {
+	uint	NodeCount;
+	uint	Pad[3];
+	uvec4	Node[];
+};
+uniform uint											uNodeCapacity;
+#else
 out vec4 FragColor;
+#endif
 
 in vec2 UV;
 in vec3 Normal;
 in vec3 FragPos;
-
-struct PointLight
-{
-	vec3	mPosition;
-	vec3	mColor;
-	float	mLinear;
-	float	mQuadratic;
-};
-
-struct DirLight
-{
-	vec3 mDirection;
-	vec3 mColor;
-};
-
-#define MAX_POINT_LIGHTS 42
+in float ViewDepth;
 
 layout (binding = 0) uniform sampler2D		uAlbedoTexture;
 layout (binding = 1) uniform sampler2D		uSpecularTexture;
@@ -29,12 +37,6 @@ layout (binding = 3) uniform sampler2DArray	uCascades;
 
 uniform bool							uUseTransparencyTex;
 uniform vec3							uViewPos;
-uniform uint							uNumPointLights;
-uniform PointLight[MAX_POINT_LIGHTS]	uPointLights;
-uniform DirLight						uDirLight;
-uniform mat4							uLightSpaceMatrix;
-uniform mat4							uCascadeMatrices[4];
-uniform float							uShadowCascadeLevels[3];
 
 float CalculateShadow(vec4 pos, vec3 normal, vec3 lightDir, int cascadeIdx);
 
@@ -53,23 +55,10 @@ void main()
 		const float kAmbientFactor = 0.05;
 		vec3 ambient = uDirLight.mColor * kAmbientFactor * albedo;
 
-		vec3 lightDir	= normalize(-uDirLight.mDirection);
+		vec3 lightDir	= normalize(uDirLight.mDirection);
 		vec3 halfwayDir	= normalize(lightDir + viewDir);
 
-		float depth = abs(gl_FragDepth);
-		int cascadeIdx = -1;
-		for (int i = 0; i < 3; i++)
-		{
-			if (depth < uShadowCascadeLevels[i])
-			{
-				cascadeIdx = i;
-				break;
-			}
-		}
-		if (cascadeIdx == -1)
-		{
-			cascadeIdx = 3;
-		}
+		int cascadeIdx = SelectCascade(ViewDepth);
 
 		vec4 posLightSpace = uCascadeMatrices[cascadeIdx] * vec4(FragPos, 1.0);
 		float shadow = CalculateShadow(posLightSpace, normal, lightDir, cascadeIdx);
@@ -122,7 +111,27 @@ void main()
 	else
 		opacity = color.a;
 
+#if defined(WEIGHTED_BLENDED)
+	// McGuire and Bavoil's depth weight, the near layers dominate the average
+	float weight = clamp(10.0 / (1e-5 + pow(ViewDepth / 5.0, 2.0) + pow(ViewDepth / 200.0, 6.0)), 1e-2, 3e3);
+	Accumulation = vec4(result * opacity, opacity) * weight;
+	Revealage = opacity;
+#elif defined(LINKED_LIST)
+	uint index = atomicAdd(NodeCount, 1u);
+	// the fragments past the capacity are dropped, the resolve shows what fit
+	if (index < uNodeCapacity)
+	{
+		uint next = imageAtomicExchange(uHeads, ivec2(gl_FragCoord.xy), index);
+		Node[index] = uvec4(
+			packHalf2x16(result.rg),
+			packHalf2x16(vec2(result.b, opacity)),
+			floatBitsToUint(gl_FragCoord.z),
+			next
+		);
+	}
+#else
 	FragColor = vec4(result, opacity);
+#endif
 }
 
 float CalculateShadow(vec4 pos, vec3 normal, vec3 lightDir, int cascadeIdx)
@@ -141,10 +150,7 @@ float CalculateShadow(vec4 pos, vec3 normal, vec3 lightDir, int cascadeIdx)
 	float currentDepth = projCoords.z;
 
 	float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
-	if (cascadeIdx == 3)
-		bias *= 1.0 / (1000.0 * 0.5);
-	else
-		bias *= 1.0 / (uShadowCascadeLevels[cascadeIdx] * 0.5);
+	bias *= 1.0 / (uShadowCascadeLevels[cascadeIdx] * 0.5);
 
 	float shadow = 0.0;
 	vec2 texelSize = 1.0 / vec2(textureSize(uCascades, 0));
@@ -3,12 +3,14 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aUV;
+// per instance, Geom::Mesh::mInstanceTransforms
+layout (location = 5) in mat4 aModel;
 
 out vec3 Normal;
 out vec2 UV;
 out vec3 FragPos;
+out float ViewDepth;
 
-uniform mat4 uModel;
 uniform mat4 uView;
 uniform mat4 uProjection;
 
@@ -17,8 +19,11 @@ void main()
 	Normal = aNormal;
 	UV = aUV;
 
-	vec4 worldPos = uModel * vec4(aPos, 1.0);
+	vec4 worldPos = aModel * vec4(aPos, 1.0);
 	FragPos = worldPos.xyz;
 
-	gl_Position = uProjection * uView * worldPos;
+	vec4 viewPos = uView * worldPos;
+	ViewDepth = -viewPos.z;
+
+	gl_Position = uProjection * viewPos;
 }
@@ -0,0 +1,42 @@
+#version 460 core
+
+#include "Utils.glsl"
+
+/**
+ * scales the rendered part of the anti-aliased frame up to the window and sharpens it back.
+ * the sharpening follows AMD's contrast adaptive sharpening: the weight of the cross
+ * around a pixel is lowered where the neighborhood already has contrast, so edges don't ring.
+ * https://gpuopen.com/fidelityfx-cas/
+ */
+
+out vec4 FragColor;
+
+in vec2 UV;
+
+layout (binding = 0) uniform sampler2D	uScreenTexture;
+
+/// @brief 0 to 1.
+uniform float	uSharpness;
+
+void main()
+{
+	vec2 texelSize = 1.0 / vec2(textureSize(uScreenTexture, 0));
+	vec2 uv = RenderUV(UV, texelSize);
+	vec2 maxUV = uRenderScale - 0.5 * texelSize;
+
+	vec3 c = texture(uScreenTexture, uv).rgb;
+	vec3 n = texture(uScreenTexture, min(uv + vec2(0.0, texelSize.y), maxUV)).rgb;
+	vec3 s = texture(uScreenTexture, max(uv - vec2(0.0, texelSize.y), 0.5 * texelSize)).rgb;
+	vec3 e = texture(uScreenTexture, min(uv + vec2(texelSize.x, 0.0), maxUV)).rgb;
+	vec3 w = texture(uScreenTexture, max(uv - vec2(texelSize.x, 0.0), 0.5 * texelSize)).rgb;
+
+	vec3 minRGB = min(c, min(min(n, s), min(e, w)));
+	vec3 maxRGB = max(c, max(max(n, s), max(e, w)));
+
+	// how far the neighborhood is from clipping at either end, relative to its brightest
+	vec3 amp = sqrt(Saturate(min(minRGB, 1.0 - maxRGB) / max(maxRGB, vec3(0.0001))));
+	vec3 weight = amp * (-1.0 / mix(8.0, 5.0, uSharpness));
+
+	vec3 result = (c + (n + s + e + w) * weight) / (1.0 + 4.0 * weight);
+	FragColor = vec4(Saturate(result), 1.0);
+}
@@ -36,3 +36,62 @@ float LinearizeDepth(float depth, float near, float far)
 	float z = depth * 2.0 - 1.0;
 	return (2.0 * near * far) / (far + near - z * (far - near)) / far;
 }
+
+/**
+ * octahedral normal encoding, the normal is projected on an octahedron which
+ * is unfolded into a square. see "A Survey of Efficient Representations for
+ * Independent Unit Vectors" (Cigolle et al. 2014)
+ */
+vec2 OctWrap(vec2 v)
+{
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// returns [0,1] so it can be stored in a unorm texture
+vec2 EncodeOctahedral(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+	return n.xy * 0.5 + 0.5;
+}
+
+vec3 DecodeOctahedral(vec2 f)
+{
+	f = f * 2.0 - 1.0;
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+// view space position from a [0,1] depth buffer value
+vec3 ReconstructViewPos(vec2 uv, float depth, mat4 invProjection)
+{
+	vec4 ndc = vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+	vec4 viewPos = invProjection * ndc;
+	return viewPos.xyz / viewPos.w;
+}
+
+// view space position from a view space z, for a symmetric perspective projection
+vec3 ViewPosFromViewZ(vec2 uv, float viewZ, mat4 projection)
+{
+	vec2 ndc = uv * 2.0 - 1.0;
+	return vec3(ndc.x * -viewZ / projection[0][0], ndc.y * -viewZ / projection[1][1], viewZ);
+}
+
+/**
+ * with dynamic resolution the frame renders to the bottom left part of the internal
+ * targets, which are allocated at the window size. screen UVs are multiplied by
+ * uRenderScale to sample them. the renderer keeps the block bound for every program.
+ */
+layout (std140, binding = 0) uniform RenderScale {
+	vec2	uRenderScale;
+	ivec2	uRenderSize;	// the rendered part of the window sized targets, in pixels
+};
+
+// the UV of an internal target at a screen UV, kept half a texel inside the rendered part
+vec2 RenderUV(vec2 screenUV, vec2 texelSize)
+{
+	return clamp(screenUV * uRenderScale, 0.5 * texelSize, uRenderScale - 0.5 * texelSize);
+}
@@ -0,0 +1,448 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace Benchmark
+{
+	static struct
+	{
+		FILE*	mFile = nullptr;
+		f32		mTime = 0.0f;
+	} gRecording;
+
+	/// @brief The first character which isn't a space, null for a blank line or a comment.
+	static const char* skipBlank(const char* inLine)
+	{
+		const char* start = inLine + strspn(inLine, " \t");
+		if (*start == '#' || *start == '\n' || *start == '\r' || *start == '\0')
+			return nullptr;
+		return start;
+	}
+
+	bool LoadManifest(const char* inPath, Manifest* outManifest)
+	{
+		FILE* file = fopen(inPath, "r");
+		if (!file)
+		{
+			printf("ERROR(Benchmark): Failed to open the manifest \"%s\".\n", inPath);
+			return false;
+		}
+
+		outManifest->mName = fs::path(inPath).stem().string();
+
+		char line[512];
+		u32 lineNumber = 0;
+		bool succeeded = true;
+		while (fgets(line, sizeof(line), file))
+		{
+			lineNumber++;
+			const char* start = skipBlank(line);
+			if (!start)
+				continue;
+
+			char key[32] = {'\0'};
+			i32 valueStart = 0;
+			if (sscanf(start, "%31s %n", key, &valueStart) != 1)
+				continue;
+
+			std::string value = start + valueStart;
+			value.erase(value.find_last_not_of(" \t\r\n") + 1);
+
+			if (value.empty())
+			{
+				printf("ERROR(Benchmark): \"%s\":%u has no value for \"%s\".\n", inPath, lineNumber, key);
+				succeeded = false;
+				continue;
+			}
+
+			bool valid = true;
+			if (strcmp(key, "name") == 0)
+				outManifest->mName = value;
+			else if (strcmp(key, "model") == 0)
+				outManifest->mModelPath = value;
+			else if (strcmp(key, "track") == 0)
+				outManifest->mTrackPath = value;
+			else if (strcmp(key, "size") == 0)
+				valid = sscanf(value.c_str(), "%ux%u", &outManifest->mWidth, &outManifest->mHeight) == 2 && outManifest->mWidth > 0 && outManifest->mHeight > 0;
+			else if (strcmp(key, "frames") == 0)
+				valid = sscanf(value.c_str(), "%u", &outManifest->mFrames) == 1;
+			else if (strcmp(key, "warmup") == 0)
+				valid = sscanf(value.c_str(), "%u", &outManifest->mWarmUpFrames) == 1;
+			else if (strcmp(key, "delta") == 0)
+				valid = sscanf(value.c_str(), "%f", &outManifest->mDeltaTime) == 1 && outManifest->mDeltaTime > 0.0f;
+			else if (strcmp(key, "physics") == 0)
+				outManifest->mEnablePhysics = value != "0";
+			else
+			{
+				printf("ERROR(Benchmark): \"%s\":%u has the unknown key \"%s\".\n", inPath, lineNumber, key);
+				succeeded = false;
+				continue;
+			}
+
+			if (!valid)
+			{
+				printf("ERROR(Benchmark): \"%s\":%u has an invalid value for \"%s\".\n", inPath, lineNumber, key);
+				succeeded = false;
+			}
+		}
+		fclose(file);
+
+		if (succeeded && outManifest->mTrackPath.empty())
+		{
+			printf("ERROR(Benchmark): The manifest \"%s\" has no track.\n", inPath);
+			succeeded = false;
+		}
+		return succeeded;
+	}
+
+	bool LoadTrack(const char* inPath, std::vector<TrackFrame>* outTrack)
+	{
+		FILE* file = fopen(inPath, "r");
+		if (!file)
+		{
+			printf("ERROR(Benchmark): Failed to open the track \"%s\".\n", inPath);
+			return false;
+		}
+
+		char line[256];
+		u32 lineNumber = 0;
+		bool succeeded = true;
+		while (fgets(line, sizeof(line), file))
+		{
+			lineNumber++;
+			const char* start = skipBlank(line);
+			if (!start)
+				continue;
+
+			TrackFrame frame{};
+			const i32 count = sscanf(start, "%f %f %f %f %f %f %f %f %f",
+				&frame.mTime, &frame.mPos.x, &frame.mPos.y, &frame.mPos.z, &frame.mYaw, &frame.mPitch,
+				&frame.mMovement.x, &frame.mMovement.y, &frame.mMovement.z
+			);
+			if (count != 6 && count != 9)
+			{
+				printf("ERROR(Benchmark): \"%s\":%u is not `<seconds> <x> <y> <z> <yaw> <pitch> [<move x> <move y> <move z>]`.\n", inPath, lineNumber);
+				succeeded = false;
+				break;
+			}
+			if (!outTrack->empty() && frame.mTime < outTrack->back().mTime)
+			{
+				printf("ERROR(Benchmark): \"%s\":%u goes back in time, the frames must be in order.\n", inPath, lineNumber);
+				succeeded = false;
+				break;
+			}
+			outTrack->push_back(frame);
+		}
+		fclose(file);
+
+		if (succeeded && outTrack->empty())
+		{
+			printf("ERROR(Benchmark): The track \"%s\" has no frames.\n", inPath);
+			succeeded = false;
+		}
+		return succeeded;
+	}
+
+	TrackFrame SampleTrack(const std::vector<TrackFrame>& inTrack, f32 inTime)
+	{
+		ZR_ASSERT(!inTrack.empty(), "Sampling an empty track.%s", "");
+
+		if (inTime <= inTrack.front().mTime)
+			return inTrack.front();
+		if (inTime >= inTrack.back().mTime)
+			return inTrack.back();
+
+		// the time is between the first and last frames, so there is a next frame
+		auto next = std::upper_bound(inTrack.begin(), inTrack.end(), inTime, [](f32 inT, const TrackFrame& inFrame) {
+			return inT < inFrame.mTime;
+		});
+		const TrackFrame& a = *(next - 1);
+		const TrackFrame& b = *next;
+		const f32 t = b.mTime > a.mTime ? (inTime - a.mTime) / (b.mTime - a.mTime) : 1.0f;
+
+		TrackFrame frame{};
+		frame.mTime		= inTime;
+		frame.mPos		= glm::mix(a.mPos, b.mPos, t);
+		frame.mYaw		= glm::mix(a.mYaw, b.mYaw, t);
+		frame.mPitch	= glm::mix(a.mPitch, b.mPitch, t);
+		frame.mMovement	= glm::mix(a.mMovement, b.mMovement, t);
+		return frame;
+	}
+
+	bool BeginRecording(const char* inPath)
+	{
+		EndRecording();
+
+		const fs::path directory = fs::path(inPath).parent_path();
+		std::error_code error;
+		if (!directory.empty())
+			fs::create_directories(directory, error);
+
+		gRecording.mFile = fopen(inPath, "w");
+		if (!gRecording.mFile)
+		{
+			printf("ERROR(Benchmark): Failed to open \"%s\" for recording.\n", inPath);
+			return false;
+		}
+		gRecording.mTime = 0.0f;
+		fputs("# <seconds> <x> <y> <z> <yaw> <pitch> <move x> <move y> <move z>\n", gRecording.mFile);
+		printf("Benchmark: Recording the track \"%s\".\n", inPath);
+		return true;
+	}
+
+	void RecordFrame(f32 inDeltaTime, const Camera& inCamera, const glm::vec3& inMovement)
+	{
+		if (!gRecording.mFile)
+			return;
+
+		fprintf(gRecording.mFile, "%.5f %.4f %.4f %.4f %.3f %.3f %.4f %.4f %.4f\n", gRecording.mTime,
+			inCamera.mPos.x, inCamera.mPos.y, inCamera.mPos.z, inCamera.mYaw, inCamera.mPitch,
+			inMovement.x, inMovement.y, inMovement.z
+		);
+		gRecording.mTime += inDeltaTime;
+	}
+
+	void EndRecording()
+	{
+		if (!gRecording.mFile)
+			return;
+
+		fclose(gRecording.mFile);
+		gRecording.mFile = nullptr;
+		printf("Benchmark: Recorded %.2f seconds.\n", gRecording.mTime);
+	}
+
+	bool IsRecording()
+	{
+		return gRecording.mFile != nullptr;
+	}
+
+	Summary Summarize(const std::vector<f32>& inSamples)
+	{
+		Summary summary;
+		if (inSamples.empty())
+			return summary;
+
+		std::vector<f32> sorted = inSamples;
+		std::sort(sorted.begin(), sorted.end());
+
+		auto percentile = [&sorted](f32 inPercent) {
+			const usize rank = std::min((usize)std::ceil(inPercent / 100.0f * (f32)sorted.size()), sorted.size());
+			return sorted[rank > 0 ? rank - 1 : 0];
+		};
+
+		f64 total = 0.0;
+		for (f32 sample : sorted)
+			total += sample;
+
+		summary.mMean	= (f32)(total / (f64)sorted.size());
+		summary.mMin	= sorted.front();
+		summary.mP50	= percentile(50.0f);
+		summary.mP95	= percentile(95.0f);
+		summary.mP99	= percentile(99.0f);
+		summary.mMax	= sorted.back();
+		return summary;
+	}
+
+	void AddSample(Report* ioReport, const char* inSeries, f32 inMs)
+	{
+		for (Series& series : ioReport->mSeries)
+		{
+			if (series.mName == inSeries)
+			{
+				series.mSamples.push_back(inMs);
+				return;
+			}
+		}
+		ioReport->mSeries.push_back({ inSeries, { inMs } });
+	}
+
+	/// @brief The names are zone names and GL strings, only quotes and backslashes are escaped.
+	static std::string escapeJson(const std::string& inString)
+	{
+		std::string escaped;
+		for (char c : inString)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	}
+
+	bool WriteReport(const Report& inReport, const char* inPath)
+	{
+		FILE* file = fopen(inPath, "w");
+		if (!file)
+		{
+			printf("ERROR(Benchmark): Failed to open \"%s\" for the report.\n", inPath);
+			return false;
+		}
+
+		const usize length = strlen(inPath);
+		const bool csv = length >= 4 && strcmp(inPath + length - 4, ".csv") == 0;
+		if (csv)
+		{
+			fputs("series,mean,min,p50,p95,p99,max\n", file);
+			for (const Series& series : inReport.mSeries)
+			{
+				const Summary summary = Summarize(series.mSamples);
+				fprintf(file, "\"%s\",%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n", series.mName.c_str(),
+					summary.mMean, summary.mMin, summary.mP50, summary.mP95, summary.mP99, summary.mMax);
+			}
+		} else
+		{
+			// a series per line, Compare() reads them back line by line
+			fputs("{\n", file);
+			fprintf(file, "\t\"name\": \"%s\",\n", escapeJson(inReport.mName).c_str());
+			fprintf(file, "\t\"renderer\": \"%s\",\n", escapeJson(inReport.mRenderer).c_str());
+			fprintf(file, "\t\"width\": %u,\n\t\"height\": %u,\n", inReport.mWidth, inReport.mHeight);
+			fprintf(file, "\t\"frames\": %u,\n\t\"deltaTime\": %.6f,\n", inReport.mFrames, inReport.mDeltaTime);
+			fputs("\t\"series\": [\n", file);
+			for (usize i = 0; i < inReport.mSeries.size(); i++)
+			{
+				const Series& series = inReport.mSeries[i];
+				const Summary summary = Summarize(series.mSamples);
+				fprintf(file, "\t\t{ \"name\": \"%s\", \"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+					escapeJson(series.mName).c_str(), summary.mMean, summary.mMin, summary.mP50, summary.mP95, summary.mP99, summary.mMax,
+					i + 1 < inReport.mSeries.size() ? "," : "");
+			}
+			fputs("\t]\n}\n", file);
+		}
+
+		fclose(file);
+		printf("Benchmark: Wrote the report \"%s\".\n", inPath);
+		return true;
+	}
+
+	/// @brief The number after `"<key>": ` in a JSON line, 0 if it's missing.
+	static f32 jsonNumber(const char* inLine, const char* inKey)
+	{
+		const std::string pattern = std::string("\"") + inKey + "\": ";
+		const char* value = strstr(inLine, pattern.c_str());
+		return value ? strtof(value + pattern.size(), nullptr) : 0.0f;
+	}
+
+	/// @brief The string after `"<key>": "` in a JSON line, unescaped.
+	static bool jsonString(const char* inLine, const char* inKey, std::string* outValue)
+	{
+		const std::string pattern = std::string("\"") + inKey + "\": \"";
+		const char* value = strstr(inLine, pattern.c_str());
+		if (!value)
+			return false;
+
+		outValue->clear();
+		for (const char* c = value + pattern.size(); *c != '\0' && *c != '"'; c++)
+		{
+			if (*c == '\\' && c[1] != '\0')
+				c++;
+			*outValue += *c;
+		}
+		return true;
+	}
+
+	/// @brief The series of a JSON or CSV report written by WriteReport().
+	static bool readBaseline(const char* inPath, std::vector<std::pair<std::string, Summary>>* outSeries, std::string* outRenderer)
+	{
+		FILE* file = fopen(inPath, "r");
+		if (!file)
+		{
+			printf("ERROR(Benchmark): Failed to open the baseline \"%s\".\n", inPath);
+			return false;
+		}
+
+		char line[1024];
+		while (fgets(line, sizeof(line), file))
+		{
+			std::string name;
+			Summary summary;
+			if (strstr(line, "\"p50\": ") && jsonString(line, "name", &name))
+			{
+				summary.mMean	= jsonNumber(line, "mean");
+				summary.mMin	= jsonNumber(line, "min");
+				summary.mP50	= jsonNumber(line, "p50");
+				summary.mP95	= jsonNumber(line, "p95");
+				summary.mP99	= jsonNumber(line, "p99");
+				summary.mMax	= jsonNumber(line, "max");
+			} else if (line[0] == '"')
+			{
+				const char* nameEnd = strchr(line + 1, '"');
+				if (!nameEnd || sscanf(nameEnd + 1, ",%f,%f,%f,%f,%f,%f", &summary.mMean, &summary.mMin,
+					&summary.mP50, &summary.mP95, &summary.mP99, &summary.mMax) != 6)
+					continue;
+				name.assign(line + 1, nameEnd - line - 1);
+			} else
+			{
+				jsonString(line, "renderer", outRenderer);
+				continue;
+			}
+			outSeries->push_back({ name, summary });
+		}
+		fclose(file);
+		return true;
+	}
+
+	i32 Compare(const Report& inReport, const char* inBaselinePath, f32 inThresholdPercent)
+	{
+		std::vector<std::pair<std::string, Summary>> baseline;
+		std::string baselineRenderer;
+		if (!readBaseline(inBaselinePath, &baseline, &baselineRenderer))
+			return -1;
+
+		printf("Benchmark: Comparing with \"%s\", a regression is %.1f%% and %.2fms slower.\n",
+			inBaselinePath, inThresholdPercent, kMinRegressionMs);
+		if (!baselineRenderer.empty() && baselineRenderer != inReport.mRenderer)
+			printf("[WARN]: The baseline was rendered by \"%s\", the timings may not be comparable.\n", baselineRenderer.c_str());
+
+		i32 regressions = 0;
+		for (const Series& series : inReport.mSeries)
+		{
+			auto found = std::find_if(baseline.begin(), baseline.end(), [&series](const std::pair<std::string, Summary>& inEntry) {
+				return inEntry.first == series.mName;
+			});
+			if (found == baseline.end())
+			{
+				printf("  new         %s\n", series.mName.c_str());
+				continue;
+			}
+
+			const Summary current = Summarize(series.mSamples);
+			const Summary& base = found->second;
+			const struct { const char* mName; f32 mCurrent; f32 mBase; } percentiles[] = {
+				{ "p50", current.mP50, base.mP50 },
+				{ "p95", current.mP95, base.mP95 },
+			};
+			for (const auto& percentile : percentiles)
+			{
+				const f32 difference = percentile.mCurrent - percentile.mBase;
+				const f32 percent = percentile.mBase > 0.0f ? 100.0f * difference / percentile.mBase : 0.0f;
+				if (std::fabs(difference) < kMinRegressionMs || std::fabs(percent) < inThresholdPercent)
+					continue;
+
+				const bool regressed = difference > 0.0f;
+				regressions += regressed ? 1 : 0;
+				printf("  %-11s %s %s: %.3fms -> %.3fms (%+.1f%%)\n", regressed ? "REGRESSION" : "improved",
+					series.mName.c_str(), percentile.mName, percentile.mBase, percentile.mCurrent, percent);
+			}
+		}
+
+		for (const auto& entry : baseline)
+		{
+			const bool kept = std::any_of(inReport.mSeries.begin(), inReport.mSeries.end(), [&entry](const Series& inSeries) {
+				return inSeries.mName == entry.first;
+			});
+			if (!kept)
+				printf("  missing     %s\n", entry.first.c_str());
+		}
+
+		printf("Benchmark: %d regression%s.\n", regressions, regressions == 1 ? "" : "s");
+		return regressions;
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Renderer.h"
+#include "defines.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Repeatable performance runs. A manifest names the scene, the size and the time step, and
+ * a track recorded from the app replays the camera and the character input of a flight through
+ * it. The replay runs in the headless mode with a fixed time step, so every run renders the same
+ * frames. The CPU and GPU time of the frame and of every GL zone is kept per frame, the report
+ * has their percentiles and can be compared against a baseline report.
+ */
+namespace Benchmark
+{
+	/// @brief A frame of a track.
+	struct TrackFrame
+	{
+		/// @brief Seconds since the track started.
+		f32			mTime = 0.0f;
+		glm::vec3	mPos = glm::vec3(0.0f);
+		f32			mYaw = -90.0f;
+		f32			mPitch = 0.0f;
+		/// @brief The character movement input, with the speed baked in like Physics::UpdateCharacter().
+		glm::vec3	mMovement = glm::vec3(0.0f);
+	};
+
+	/**
+	 * @brief A file of `<key> <value>` lines, `#` starts a comment:
+	 * - `name` The name of the report, the file name by default.
+	 * - `model` The scene to load.
+	 * - `track` The track to replay, see LoadTrack().
+	 * - `size` The render size, `<width>x<height>`.
+	 * - `frames` The frames to time, by default as many as the track lasts.
+	 * - `warmup` The frames rendered before the timings are kept.
+	 * - `delta` The time step of every frame in seconds.
+	 * - `physics` Whether the physics is stepped with the movement of the track (1 or 0).
+	 */
+	struct Manifest
+	{
+		std::string	mName;
+		std::string	mModelPath = "res/models/sponza2/sponza2.gltf";
+		std::string	mTrackPath;
+		u32			mWidth = 1280;
+		u32			mHeight = 720;
+		/// @brief 0 times as many frames as the track lasts.
+		u32			mFrames = 0;
+		u32			mWarmUpFrames = 16;
+		f32			mDeltaTime = 1.0f / 60.0f;
+		bool		mEnablePhysics = true;
+	};
+
+	bool		LoadManifest(const char* inPath, Manifest* outManifest);
+
+	/**
+	 * @brief A frame per line, `<seconds> <x> <y> <z> <yaw> <pitch> [<move x> <move y> <move z>]`
+	 * (`#` starts a comment). The times must not go back.
+	 */
+	bool		LoadTrack(const char* inPath, std::vector<TrackFrame>* outTrack);
+	/// @brief The frame at inTime, interpolated linearly between the frames around it.
+	TrackFrame	SampleTrack(const std::vector<TrackFrame>& inTrack, f32 inTime);
+
+	/// @brief Write the camera and the movement of every frame until EndRecording().
+	bool		BeginRecording(const char* inPath);
+	void		RecordFrame(f32 inDeltaTime, const Camera& inCamera, const glm::vec3& inMovement);
+	void		EndRecording();
+	bool		IsRecording();
+
+	/// @brief The samples of a measurement, a sample per timed frame.
+	struct Series
+	{
+		std::string			mName;
+		std::vector<f32>	mSamples;
+	};
+
+	struct Summary
+	{
+		f32	mMean = 0.0f;
+		f32	mMin = 0.0f;
+		f32	mP50 = 0.0f;
+		f32	mP95 = 0.0f;
+		f32	mP99 = 0.0f;
+		f32	mMax = 0.0f;
+	};
+
+	struct Report
+	{
+		std::string			mName;
+		/// @brief GL_RENDERER, the reports of different GPUs aren't comparable.
+		std::string			mRenderer;
+		u32					mWidth = 0;
+		u32					mHeight = 0;
+		u32					mFrames = 0;
+		f32					mDeltaTime = 0.0f;
+		std::vector<Series>	mSeries;
+	};
+
+	/// @brief Percentiles are nearest rank.
+	Summary		Summarize(const std::vector<f32>& inSamples);
+	/// @param inSeries The series is created at its first sample.
+	void		AddSample(Report* ioReport, const char* inSeries, f32 inMs);
+
+	/// @brief A CSV report if the path ends with `.csv`, JSON otherwise. Every series is a row of its summary.
+	bool		WriteReport(const Report& inReport, const char* inPath);
+	/**
+	 * @brief Compare the p50 and p95 of every series with a report written by WriteReport().
+	 * A series regressed if it's slower by more than inThresholdPercent and kMinRegressionMs.
+	 * @return The number of regressions, or -1 if the baseline can't be read.
+	 */
+	i32			Compare(const Report& inReport, const char* inBaselinePath, f32 inThresholdPercent);
+
+	/// @brief Below this difference a series didn't regress, however large the percentage is.
+	constexpr f32 kMinRegressionMs = 0.05f;
+}
@@ -1,5 +1,6 @@
 #include "DebugDraw.h"
 
+#include "GLState.h"
 #include "Memory.h"
 #include "Utils.h"
 #include <glm/gtc/constants.hpp>
@@ -26,7 +27,7 @@ bool DebugDraw::StartUp()
 void DebugDraw::ShutDown()
 {
 	glDeleteBuffers(1, &mVBO);
-	glDeleteVertexArrays(1, &mVAO);
+	GLState::DeleteVertexArrays(1, &mVAO);
 	mVBO = 0;
 	mVAO = 0;
 	mDrawables.clear();
@@ -135,16 +136,16 @@ void DebugDraw::AddCoordinateSystem(const glm::mat4& inTransform)
 
 void DebugDraw::DrawFrame(const Camera& inCamera)
 {
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::Enable(GL_BLEND);
+	GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	mShader.Use();
 	mShader.SetMat4("uView", inCamera.mView);
 	mShader.SetMat4("uProjection", inCamera.mProjection);
 	mShader.SetMat4("uModel", glm::mat4(1.0f));
 
-	glBindVertexArray(mVAO);
+	GLState::BindVertexArray(mVAO);
 	for (i32 i = mDrawables.size() - 1; i >= 0; i--)
 	{
 		Drawable* d = &mDrawables[i];
@@ -1,5 +1,6 @@
 #include "Environment.h"
 
+#include "GLState.h"
 #include <glad/glad.h>
 #include <stb_image.h>
 #include <glm/gtc/matrix_transform.hpp>
@@ -53,6 +54,10 @@ bool Skybox::StartUpSystem()
 	if (!sSkyboxShader.Load("res/shaders/Skybox.vert", "res/shaders/Skybox.frag"))
 		return false;
 
+	sSkyboxShader.SetUniformSetup([](const Shader& inShader) {
+		inShader.SetMat4("uProjection", sProjection);
+	});
+
 	glCreateVertexArrays(1, &sVAO);
 	glCreateBuffers(1, &sVBO);
 
@@ -69,12 +74,13 @@ bool Skybox::StartUpSystem()
 void Skybox::ShutDownSystem()
 {
 	glDeleteBuffers(1, &sVBO);
-	glDeleteVertexArrays(1, &sVAO);
+	GLState::DeleteVertexArrays(1, &sVAO);
 	sSkyboxShader.Unload();
 }
 
 void Skybox::UpdateProjection(const glm::mat4& inProjection)
 {
+	sProjection = inProjection;
 	sSkyboxShader.Use();
 	sSkyboxShader.SetMat4("uProjection", inProjection);
 }
@@ -150,21 +156,21 @@ bool Skybox::Load(const char* inBasePath, const char* inExtension)
 
 void Skybox::Unload()
 {
-	glDeleteTextures(1, &mID);
+	GLState::DeleteTextures(1, &mID);
 	mID = UINT32_MAX;
 }
 
 void Skybox::Draw(const glm::mat4& inView) const
 {
-	glDepthFunc(GL_LEQUAL);
+	GLState::DepthFunc(GL_LEQUAL);
 	
 	sSkyboxShader.Use();
 	
 	glm::mat4 view = glm::mat4(glm::mat3(inView));
 	sSkyboxShader.SetMat4("uView", view);
 
-	glBindVertexArray(sVAO);
-	glBindTextureUnit(1, mID);
+	GLState::BindVertexArray(sVAO);
+	GLState::BindTextureUnit(1, mID);
 	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glDepthFunc(GL_LESS);
+	GLState::DepthFunc(GL_LESS);
 }
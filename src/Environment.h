@@ -29,4 +29,6 @@ struct Skybox final
 	sinline Shader	sSkyboxShader{};
 	sinline u32		sVAO = UINT32_MAX;
 	sinline u32		sVBO = UINT32_MAX;
+	/// @brief Kept to restore the uniform when the shader is hot reloaded.
+	sinline glm::mat4	sProjection = glm::mat4(1.0f);
 };
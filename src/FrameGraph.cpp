@@ -0,0 +1,369 @@
+#include "FrameGraph.h"
+
+#include <algorithm>
+#include <cstdio>
+// only the format enums, nothing here calls GL, see FrameGraphGL.cpp
+#include <glad/glad.h>
+#include <tracy/Tracy.hpp>
+
+void FrameGraph::Reset()
+{
+	mResources.clear();
+	mPasses.clear();
+	mAllocations.clear();
+}
+
+FGResource FrameGraph::CreateTexture(const char* inName, const FGTextureDesc& inDesc)
+{
+	ZR_ASSERT(inDesc.mWidth > 0 && inDesc.mHeight > 0, "A frame graph texture can't be empty.");
+
+	Resource resource{};
+	resource.mName = inName;
+	resource.mDesc = inDesc;
+	mResources.push_back(resource);
+	return FGResource{ (u32)mResources.size() - 1 };
+}
+
+FGResource FrameGraph::Import(const char* inName, u32 inID)
+{
+	Resource resource{};
+	resource.mName		= inName;
+	resource.mImported	= true;
+	resource.mID		= inID;
+	mResources.push_back(resource);
+	return FGResource{ (u32)mResources.size() - 1 };
+}
+
+void FrameGraph::MarkOutput(FGResource inResource)
+{
+	ZR_ASSERT(inResource.mIndex < mResources.size(), "Invalid frame graph resource.");
+	mResources[inResource.mIndex].mOutput = true;
+}
+
+u32 FrameGraph::AddPass(const char* inName, std::function<void()> inExecute)
+{
+	Pass pass{};
+	pass.mName		= inName;
+	pass.mExecute	= std::move(inExecute);
+	mPasses.push_back(std::move(pass));
+	return (u32)mPasses.size() - 1;
+}
+
+void FrameGraph::Read(u32 inPass, FGResource inResource)
+{
+	ZR_ASSERT(inPass < mPasses.size() && inResource.mIndex < mResources.size(), "Invalid frame graph pass or resource.");
+	mPasses[inPass].mReads.push_back(inResource.mIndex);
+}
+
+void FrameGraph::Write(u32 inPass, FGResource inResource)
+{
+	ZR_ASSERT(inPass < mPasses.size() && inResource.mIndex < mResources.size(), "Invalid frame graph pass or resource.");
+	mPasses[inPass].mWrites.push_back(inResource.mIndex);
+}
+
+bool FrameGraph::Compile()
+{
+	ZoneScopedN("Compile Frame Graph");
+
+	// walk back from the outputs, a pass is live if it writes something a later live pass reads
+	std::vector<bool> needed(mResources.size(), false);
+	for (u32 i = 0; i < mResources.size(); i++)
+		needed[i] = mResources[i].mOutput;
+
+	for (u32 i = (u32)mPasses.size(); i-- > 0;)
+	{
+		Pass& pass = mPasses[i];
+		pass.mCulled = std::none_of(pass.mWrites.begin(), pass.mWrites.end(), [&](u32 inResource) {
+			return needed[inResource];
+		});
+		if (pass.mCulled)
+			continue;
+
+		for (u32 resource : pass.mReads)
+			needed[resource] = true;
+	}
+
+	// the lifetimes of the resources, in live passes
+	for (Resource& resource : mResources)
+	{
+		resource.mFirstPass		= UINT32_MAX;
+		resource.mLastPass		= UINT32_MAX;
+		resource.mAllocation	= UINT32_MAX;
+	}
+
+	auto use = [this](u32 inResource, u32 inPass) {
+		Resource& resource = mResources[inResource];
+		if (resource.mFirstPass == UINT32_MAX)
+			resource.mFirstPass = inPass;
+		resource.mLastPass = inPass;
+	};
+
+	std::vector<bool> written(mResources.size(), false);
+	for (u32 i = 0; i < mPasses.size(); i++)
+	{
+		const Pass& pass = mPasses[i];
+		if (pass.mCulled)
+			continue;
+
+		for (u32 resource : pass.mReads)
+		{
+			if (!mResources[resource].mImported && !written[resource])
+			{
+				printf("ERROR(FrameGraph): Pass \"%s\" reads \"%s\" before any pass wrote it.\n", pass.mName.c_str(), mResources[resource].mName.c_str());
+				return false;
+			}
+			use(resource, i);
+		}
+
+		for (u32 resource : pass.mWrites)
+		{
+			written[resource] = true;
+			use(resource, i);
+		}
+	}
+
+	// place the transients in the order they start, in the first allocation that is free by then
+	std::vector<u32> transients;
+	for (u32 i = 0; i < mResources.size(); i++)
+	{
+		if (!mResources[i].mImported && mResources[i].mFirstPass != UINT32_MAX)
+			transients.push_back(i);
+	}
+	std::stable_sort(transients.begin(), transients.end(), [this](u32 inA, u32 inB) {
+		return mResources[inA].mFirstPass < mResources[inB].mFirstPass;
+	});
+
+	mAllocations.clear();
+	for (u32 index : transients)
+	{
+		Resource& resource = mResources[index];
+
+		u32 allocation = 0;
+		while (allocation < mAllocations.size() && !canShare(mAllocations[allocation], resource))
+			allocation++;
+
+		if (allocation == mAllocations.size())
+		{
+			Allocation newAllocation{};
+			newAllocation.mWidth	= resource.mDesc.mWidth;
+			newAllocation.mHeight	= resource.mDesc.mHeight;
+			newAllocation.mFormat	= resource.mDesc.mFormat;
+			u32 bytesPerTexel = 0;
+			GetFormatInfo(resource.mDesc.mFormat, &newAllocation.mViewClass, &bytesPerTexel);
+			mAllocations.push_back(newAllocation);
+		}
+
+		mAllocations[allocation].mLastPass = resource.mLastPass;
+		resource.mAllocation = allocation;
+	}
+
+	return true;
+}
+
+void FrameGraph::Execute() const
+{
+	for (const Pass& pass : mPasses)
+	{
+		if (!pass.mCulled)
+			pass.mExecute();
+	}
+}
+
+u32 FrameGraph::GetID(FGResource inResource) const
+{
+	ZR_ASSERT(inResource.mIndex < mResources.size(), "Invalid frame graph resource.");
+	return mResources[inResource.mIndex].mID;
+}
+
+u32 FrameGraph::GetTransientCount() const
+{
+	return (u32)std::count_if(mResources.begin(), mResources.end(), [](const Resource& inResource) {
+		return inResource.mAllocation != UINT32_MAX;
+	});
+}
+
+u32 FrameGraph::GetAllocation(FGResource inResource) const
+{
+	ZR_ASSERT(inResource.mIndex < mResources.size(), "Invalid frame graph resource.");
+	return mResources[inResource.mIndex].mAllocation;
+}
+
+void FrameGraph::GetFormatInfo(u32 inFormat, u32* outViewClass, u32* outBytesPerTexel)
+{
+	switch (inFormat)
+	{
+	case GL_RGBA32F: case GL_RGBA32UI: case GL_RGBA32I:
+		*outViewClass = 128;
+		break;
+	case GL_RGB32F: case GL_RGB32UI: case GL_RGB32I:
+		*outViewClass = 96;
+		break;
+	case GL_RGBA16F: case GL_RG32F: case GL_RGBA16UI: case GL_RG32UI: case GL_RGBA16I:
+	case GL_RG32I: case GL_RGBA16: case GL_RGBA16_SNORM:
+		*outViewClass = 64;
+		break;
+	case GL_RGB16F: case GL_RGB16UI: case GL_RGB16I: case GL_RGB16: case GL_RGB16_SNORM:
+		*outViewClass = 48;
+		break;
+	case GL_RG16F: case GL_R11F_G11F_B10F: case GL_R32F: case GL_RGB10_A2UI: case GL_RGBA8UI:
+	case GL_RG16UI: case GL_R32UI: case GL_RGBA8I: case GL_RG16I: case GL_R32I: case GL_RGB10_A2:
+	case GL_RGBA8: case GL_RG16: case GL_RGBA8_SNORM: case GL_RG16_SNORM: case GL_SRGB8_ALPHA8:
+	case GL_RGB9_E5:
+		*outViewClass = 32;
+		break;
+	case GL_RGB8: case GL_RGB8_SNORM: case GL_SRGB8: case GL_RGB8UI: case GL_RGB8I:
+		*outViewClass = 24;
+		break;
+	case GL_R16F: case GL_RG8UI: case GL_R16UI: case GL_RG8I: case GL_R16I: case GL_RG8:
+	case GL_R16: case GL_RG8_SNORM: case GL_R16_SNORM:
+		*outViewClass = 16;
+		break;
+	case GL_R8UI: case GL_R8I: case GL_R8: case GL_R8_SNORM:
+		*outViewClass = 8;
+		break;
+	// depth and stencil formats are only view compatible with themselves
+	case GL_DEPTH_COMPONENT16:
+		*outViewClass = 0;
+		*outBytesPerTexel = 2;
+		return;
+	case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32F: case GL_DEPTH24_STENCIL8:
+		*outViewClass = 0;
+		*outBytesPerTexel = 4;
+		return;
+	case GL_DEPTH32F_STENCIL8:
+		*outViewClass = 0;
+		*outBytesPerTexel = 8;
+		return;
+	default:
+		ZR_ASSERT(false, "Unsupported frame graph texture format.");
+		*outViewClass = 0;
+		*outBytesPerTexel = 0;
+		return;
+	}
+
+	*outBytesPerTexel = *outViewClass / 8;
+}
+
+bool FrameGraph::canShare(const Allocation& inAllocation, const Resource& inResource) const
+{
+	if (inAllocation.mLastPass >= inResource.mFirstPass)
+		return false;
+	if (inAllocation.mWidth != inResource.mDesc.mWidth || inAllocation.mHeight != inResource.mDesc.mHeight)
+		return false;
+
+	u32 viewClass = 0;
+	u32 bytesPerTexel = 0;
+	GetFormatInfo(inResource.mDesc.mFormat, &viewClass, &bytesPerTexel);
+	if (viewClass == 0 || inAllocation.mViewClass == 0)
+		return inAllocation.mFormat == inResource.mDesc.mFormat;
+	return inAllocation.mViewClass == viewClass;
+}
+
+bool FrameGraph::SelfTest()
+{
+	u32 failures = 0;
+	auto check = [&failures](bool inPassed, const char* inWhat) {
+		if (inPassed)
+			return;
+		printf("ERROR(FrameGraph): Self test failed, %s.\n", inWhat);
+		failures++;
+	};
+	auto noop = []() {};
+
+	const FGTextureDesc color	= { 64, 64, GL_RGBA8, GL_NEAREST };
+	const FGTextureDesc srgb	= { 64, 64, GL_SRGB8_ALPHA8, GL_NEAREST };
+	const FGTextureDesc large	= { 128, 128, GL_RGBA8, GL_NEAREST };
+	const FGTextureDesc depth	= { 64, 64, GL_DEPTH_COMPONENT32F, GL_NEAREST };
+	const FGTextureDesc single	= { 64, 64, GL_R32F, GL_NEAREST };
+
+	// a chain of passes into the back buffer, and a pass nothing reads
+	{
+		FrameGraph graph;
+		const FGResource a		= graph.CreateTexture("A", color);
+		const FGResource b		= graph.CreateTexture("B", color);
+		const FGResource c		= graph.CreateTexture("C", srgb);
+		const FGResource unused	= graph.CreateTexture("Unused", color);
+		const FGResource output	= graph.Import("Back Buffer", 0);
+		graph.MarkOutput(output);
+
+		const u32 writeA = graph.AddPass("Write A", noop);
+		graph.Write(writeA, a);
+		const u32 writeUnused = graph.AddPass("Write Unused", noop);
+		graph.Read(writeUnused, a);
+		graph.Write(writeUnused, unused);
+		const u32 writeB = graph.AddPass("A to B", noop);
+		graph.Read(writeB, a);
+		graph.Write(writeB, b);
+		const u32 writeC = graph.AddPass("B to C", noop);
+		graph.Read(writeC, b);
+		graph.Write(writeC, c);
+		const u32 present = graph.AddPass("Present", noop);
+		graph.Read(present, c);
+		graph.Write(present, output);
+
+		check(graph.Compile(), "the chain doesn't compile");
+		check(!graph.IsCulled(writeA) && !graph.IsCulled(writeB) && !graph.IsCulled(writeC) && !graph.IsCulled(present),
+			"a pass of the chain was culled");
+		check(graph.IsCulled(writeUnused), "a pass which writes what nothing reads wasn't culled");
+
+		const Resource& lifetimeA = graph.mResources[a.mIndex];
+		const Resource& lifetimeC = graph.mResources[c.mIndex];
+		check(lifetimeA.mFirstPass == writeA && lifetimeA.mLastPass == writeB, "the lifetime of A isn't from its write to its last read");
+		check(lifetimeC.mFirstPass == writeC && lifetimeC.mLastPass == present, "the lifetime of C isn't from its write to its last read");
+		check(graph.GetAllocation(unused) == UINT32_MAX, "the texture of a culled pass was allocated");
+
+		// A is dead before C is written and both are 32 bit, B overlaps both
+		check(graph.GetAllocation(a) == graph.GetAllocation(c), "A and C don't share their memory");
+		check(graph.GetAllocation(a) != graph.GetAllocation(b), "A and B share memory while both are alive");
+		check(graph.GetAllocationCount() == 2, "the chain doesn't fit in two allocations");
+		check(graph.GetTransientCount() == 3, "the chain doesn't have three live transients");
+	}
+
+	// textures of another size, or outside the view classes, don't share
+	{
+		FrameGraph graph;
+		const FGResource a		= graph.CreateTexture("A", color);
+		const FGResource b		= graph.CreateTexture("Large", large);
+		const FGResource c		= graph.CreateTexture("Depth", depth);
+		const FGResource d		= graph.CreateTexture("Single", single);
+		const FGResource output	= graph.Import("Back Buffer", 0);
+		graph.MarkOutput(output);
+
+		FGResource previous = a;
+		const u32 first = graph.AddPass("Write A", noop);
+		graph.Write(first, a);
+		for (FGResource next : { b, c, d })
+		{
+			const u32 pass = graph.AddPass("Copy", noop);
+			graph.Read(pass, previous);
+			graph.Write(pass, next);
+			previous = next;
+		}
+		const u32 present = graph.AddPass("Present", noop);
+		graph.Read(present, previous);
+		graph.Write(present, output);
+
+		check(graph.Compile(), "the copies don't compile");
+		check(graph.GetAllocation(a) != graph.GetAllocation(b), "textures of different sizes share memory");
+		check(graph.GetAllocation(a) != graph.GetAllocation(c), "a depth texture shares the memory of a color texture");
+		check(graph.GetAllocation(a) == graph.GetAllocation(d), "R32F doesn't share the memory of RGBA8");
+	}
+
+	// a live pass reads a texture nothing wrote
+	{
+		FrameGraph graph;
+		const FGResource a		= graph.CreateTexture("Never Written", color);
+		const FGResource output	= graph.Import("Back Buffer", 0);
+		graph.MarkOutput(output);
+
+		const u32 present = graph.AddPass("Present", noop);
+		graph.Read(present, a);
+		graph.Write(present, output);
+
+		puts("FrameGraph: the next error is expected.");
+		check(!graph.Compile(), "a read of a texture nothing wrote compiles");
+	}
+
+	printf("FrameGraph: self test %s (%u failed checks).\n", failures == 0 ? "passed" : "failed", failures);
+	return failures == 0;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "defines.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+/// @brief A texture or buffer of a FrameGraph.
+struct FGResource
+{
+	bool	IsValid() const { return mIndex != UINT32_MAX; }
+
+	u32		mIndex = UINT32_MAX;
+};
+
+struct FGTextureDesc
+{
+	u32		mWidth	= 0;
+	u32		mHeight	= 0;
+	u32		mFormat	= 0; ///< A sized internal format, e.g. GL_RGBA16F.
+	u32		mFilter	= 0; ///< GL_NEAREST or GL_LINEAR.
+};
+
+/**
+ * @brief The passes of a frame and the resources they read and write. Passes run in the
+ * order they were added.
+ *
+ * Compile() culls the passes that don't contribute to an output, finds the first and last
+ * pass which uses every transient texture and lets transients whose lifetimes don't overlap
+ * share memory. Building and compiling a graph doesn't touch GL, so it can be tested without a
+ * context (see SelfTest()), only Realize() and Release() in FrameGraphGL.cpp call GL. Realize()
+ * creates the memory and a view of it for every transient.
+ *
+ * A graph is built once and executed every frame until it is built again, per frame state
+ * reaches the passes through what they capture.
+ */
+class FrameGraph final
+{
+public:
+				FrameGraph() = default;
+				~FrameGraph() = default;
+
+	/// @brief Forget the passes and resources. The memory is kept for the next Realize().
+	void		Reset();
+	/// @brief Delete the memory of the transients.
+	void		Release();
+
+	/// @brief A texture owned by the graph. Its content doesn't live past the passes which use it.
+	FGResource	CreateTexture(const char* inName, const FGTextureDesc& inDesc);
+	/// @brief A resource owned by the caller, e.g. a history texture or the back buffer (0).
+	FGResource	Import(const char* inName, u32 inID);
+	/// @brief Passes which write an output, or a resource read by such a pass, are never culled.
+	void		MarkOutput(FGResource inResource);
+
+	/// @return The index of the pass.
+	u32			AddPass(const char* inName, std::function<void()> inExecute);
+	void		Read(u32 inPass, FGResource inResource);
+	void		Write(u32 inPass, FGResource inResource);
+
+	/// @return false if a live pass reads a transient no earlier pass wrote.
+	bool		Compile();
+	/// @brief Create the memory of the compiled graph, reusing the memory of the last build where it fits.
+	void		Realize();
+	void		Execute() const;
+
+	/// @return The GL name of the resource, 0 for a transient no live pass uses.
+	u32			GetID(FGResource inResource) const;
+
+	u32			GetPassCount() const { return (u32)mPasses.size(); }
+	const char*	GetPassName(u32 inPass) const { return mPasses[inPass].mName.c_str(); }
+	bool		IsCulled(u32 inPass) const { return mPasses[inPass].mCulled; }
+	/// @brief The transients used by a live pass.
+	u32			GetTransientCount() const;
+	/// @brief The distinct allocations the transients were packed into.
+	u32			GetAllocationCount() const { return (u32)mAllocations.size(); }
+	/// @return The index of the allocation of a live transient, UINT32_MAX otherwise.
+	u32			GetAllocation(FGResource inResource) const;
+
+	/**
+	 * @brief Textures can share memory if their views are compatible (see the texture view
+	 * table of the GL spec). Formats outside that table only share with the same format.
+	 * @param outViewClass The bits per texel of the class, 0 if the format has no class.
+	 */
+	static void	GetFormatInfo(u32 inFormat, u32* outViewClass, u32* outBytesPerTexel);
+
+	/**
+	 * @brief Compile small graphs and check the culled passes, the lifetimes and the shared
+	 * allocations, the failures are printed. It needs no GL context, see `--test-frame-graph`.
+	 * @return Whether every check passed.
+	 */
+	static bool	SelfTest();
+
+private:
+	struct Resource
+	{
+		std::string				mName;
+		FGTextureDesc			mDesc;
+		bool					mImported = false;
+		bool					mOutput = false;
+		u32						mID = 0;
+		/// @brief The live passes which use the resource, UINT32_MAX if none.
+		u32						mFirstPass = UINT32_MAX;
+		u32						mLastPass = UINT32_MAX;
+		u32						mAllocation = UINT32_MAX;
+	};
+
+	struct Pass
+	{
+		std::string				mName;
+		std::function<void()>	mExecute;
+		std::vector<u32>		mReads;
+		std::vector<u32>		mWrites;
+		bool					mCulled = false;
+	};
+
+	/// @brief The memory of the transients assigned to it, created in the format of the first.
+	struct Allocation
+	{
+		u32						mWidth = 0;
+		u32						mHeight = 0;
+		u32						mFormat = 0;
+		u32						mViewClass = 0;
+		u32						mLastPass = 0;
+		u32						mID = 0;
+	};
+
+	bool						canShare(const Allocation& inAllocation, const Resource& inResource) const;
+
+	std::vector<Resource>		mResources;
+	std::vector<Pass>			mPasses;
+	std::vector<Allocation>		mAllocations;
+	/// @brief Realized memory, kept across builds.
+	std::vector<Allocation>		mMemory;
+	/// @brief The views of the transients of the last Realize().
+	std::vector<u32>			mViews;
+	/// @brief The memory the transients would take without sharing minus the memory they take.
+	usize						mSavedBytes = 0;
+};
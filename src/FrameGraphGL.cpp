@@ -0,0 +1,117 @@
+#include "FrameGraph.h"
+
+#include "Memory.h"
+#include "GLState.h"
+#include <algorithm>
+#include <glad/glad.h>
+#include <tracy/Tracy.hpp>
+
+/**
+ * GL has no heaps to place resources in, so the shared memory is a texture and every
+ * transient is a texture view of it. A view has its own format and sampler state, so any
+ * transients of the same size and view class can share, e.g. an RGBA8 output can live in
+ * the memory of an sRGB albedo target once the albedo was read for the last time.
+ *
+ * Aliased transients don't keep their content, the first pass which writes one must
+ * overwrite all of it.
+ */
+
+static usize textureBytes(u32 inWidth, u32 inHeight, u32 inFormat)
+{
+	u32 viewClass = 0;
+	u32 bytesPerTexel = 0;
+	FrameGraph::GetFormatInfo(inFormat, &viewClass, &bytesPerTexel);
+	return (usize)inWidth * inHeight * bytesPerTexel;
+}
+
+void FrameGraph::Release()
+{
+	GLState::DeleteTextures((i32)mViews.size(), mViews.data());
+	mViews.clear();
+
+	for (const Allocation& memory : mMemory)
+	{
+		GLState::DeleteTextures(1, &memory.mID);
+		Mem::ReportFree(textureBytes(memory.mWidth, memory.mHeight, memory.mFormat), EMemSource::RendererVRAM);
+	}
+	mMemory.clear();
+
+	Mem::ReportDedupFree(mSavedBytes, EMemSource::RendererVRAM);
+	mSavedBytes = 0;
+
+	Reset();
+}
+
+void FrameGraph::Realize()
+{
+	ZoneScopedN("Realize Frame Graph");
+
+	GLState::DeleteTextures((i32)mViews.size(), mViews.data());
+	mViews.clear();
+	Mem::ReportDedupFree(mSavedBytes, EMemSource::RendererVRAM);
+	mSavedBytes = 0;
+
+	// memory of the last build with the same size and format is taken over
+	std::vector<Allocation> previous = std::move(mMemory);
+	mMemory.clear();
+	for (Allocation& allocation : mAllocations)
+	{
+		auto match = std::find_if(previous.begin(), previous.end(), [&](const Allocation& inMemory) {
+			return inMemory.mWidth == allocation.mWidth && inMemory.mHeight == allocation.mHeight && inMemory.mFormat == allocation.mFormat;
+		});
+
+		if (match != previous.end())
+		{
+			allocation.mID = match->mID;
+			previous.erase(match);
+		} else
+		{
+			glCreateTextures(GL_TEXTURE_2D, 1, &allocation.mID);
+			glTextureStorage2D(allocation.mID, 1, allocation.mFormat, allocation.mWidth, allocation.mHeight);
+#ifndef ZR_DISTRIBUTION
+			glObjectLabel(GL_TEXTURE, allocation.mID, -1, "Frame Graph Memory");
+#endif
+			Mem::ReportAlloc(textureBytes(allocation.mWidth, allocation.mHeight, allocation.mFormat), EMemSource::RendererVRAM);
+		}
+
+		mMemory.push_back(allocation);
+	}
+
+	for (const Allocation& memory : previous)
+	{
+		GLState::DeleteTextures(1, &memory.mID);
+		Mem::ReportFree(textureBytes(memory.mWidth, memory.mHeight, memory.mFormat), EMemSource::RendererVRAM);
+	}
+
+	usize transientBytes = 0;
+	for (Resource& resource : mResources)
+	{
+		if (resource.mImported)
+			continue;
+
+		resource.mID = 0;
+		if (resource.mAllocation == UINT32_MAX)
+			continue;
+
+		const FGTextureDesc& desc = resource.mDesc;
+		glGenTextures(1, &resource.mID);
+		glTextureView(resource.mID, GL_TEXTURE_2D, mAllocations[resource.mAllocation].mID, desc.mFormat, 0, 1, 0, 1);
+#ifndef ZR_DISTRIBUTION
+		glObjectLabel(GL_TEXTURE, resource.mID, -1, resource.mName.c_str());
+#endif
+		glTextureParameteri(resource.mID, GL_TEXTURE_MIN_FILTER, desc.mFilter);
+		glTextureParameteri(resource.mID, GL_TEXTURE_MAG_FILTER, desc.mFilter);
+		glTextureParameteri(resource.mID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(resource.mID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		mViews.push_back(resource.mID);
+
+		transientBytes += textureBytes(desc.mWidth, desc.mHeight, desc.mFormat);
+	}
+
+	usize memoryBytes = 0;
+	for (const Allocation& allocation : mAllocations)
+		memoryBytes += textureBytes(allocation.mWidth, allocation.mHeight, allocation.mFormat);
+
+	mSavedBytes = transientBytes - memoryBytes;
+	Mem::ReportDedup(mSavedBytes, EMemSource::RendererVRAM);
+}
@@ -0,0 +1,414 @@
+#include "GLState.h"
+
+#include <cstring>
+#include <glad/glad.h>
+#include <imgui.h>
+
+namespace GLState
+{
+	/// @brief The texture units which are shadowed, the ones above are passed through.
+	sconst u32 kMaxTextureUnits = 32;
+	/// @brief An unknown binding or enum, no GL name or enum has it.
+	sconst u32 kUnknown = UINT32_MAX;
+
+	enum ECall : u32
+	{
+		Call_Capability,
+		Call_BlendFunc,
+		Call_DepthFunc,
+		Call_DepthMask,
+		Call_CullFace,
+		Call_Viewport,
+		Call_UseProgram,
+		Call_BindVertexArray,
+		Call_BindFramebuffer,
+		Call_BindTextureUnit,
+		Call_Count,
+	};
+
+	static const char* kCallNames[Call_Count] =
+	{
+		"glEnable/glDisable",
+		"glBlendFunc",
+		"glDepthFunc",
+		"glDepthMask",
+		"glCullFace",
+		"glViewport",
+		"glUseProgram",
+		"glBindVertexArray",
+		"glBindFramebuffer",
+		"glBindTextureUnit",
+	};
+
+	sconst u32 kCaps[] =
+	{
+		GL_BLEND,
+		GL_CULL_FACE,
+		GL_DEPTH_TEST,
+		GL_DEPTH_CLAMP,
+		GL_FRAMEBUFFER_SRGB,
+		GL_SCISSOR_TEST,
+		GL_STENCIL_TEST,
+	};
+	sconst u32 kCapCount = sizeof(kCaps) / sizeof(kCaps[0]);
+
+	struct Counts
+	{
+		u32	mCalls[Call_Count];
+		u32	mRedundant[Call_Count];
+	};
+
+	struct State
+	{
+		/// @brief 0 disabled, 1 enabled, -1 unknown.
+		i8		mCaps[kCapCount];
+		u32		mBlendSrc;
+		u32		mBlendDst;
+		u32		mDepthFunc;
+		/// @brief 0 off, 1 on, -1 unknown.
+		i8		mDepthMask;
+		u32		mCullFace;
+		bool	mViewportKnown;
+		i32		mViewport[4];
+		u32		mProgram;
+		u32		mVAO;
+		u32		mDrawFBO;
+		u32		mReadFBO;
+		u32		mTextures[kMaxTextureUnits];
+	};
+
+	/// @brief Every state unknown, so the next call of every kind reaches GL.
+	static State unknownState()
+	{
+		State state;
+		memset(state.mCaps, -1, sizeof(state.mCaps));
+		state.mBlendSrc			= kUnknown;
+		state.mBlendDst			= kUnknown;
+		state.mDepthFunc		= kUnknown;
+		state.mDepthMask		= -1;
+		state.mCullFace			= kUnknown;
+		state.mViewportKnown	= false;
+		state.mProgram			= kUnknown;
+		state.mVAO				= kUnknown;
+		state.mDrawFBO			= kUnknown;
+		state.mReadFBO			= kUnknown;
+		for (u32& texture : state.mTextures)
+			texture = kUnknown;
+		return state;
+	}
+
+	State	gState = unknownState();
+	bool	gFiltering = true;
+	bool	gInstrumented = false;
+	Counts	gFrameCounts = {};
+	Counts	gLastCounts = {};
+	/// @brief Every frame since the instrumentation was turned on, for PrintReport().
+	u64		gTotalCalls[Call_Count] = {};
+	u64		gTotalRedundant[Call_Count] = {};
+	u32		gTotalFrames = 0;
+
+	/// @return Whether the call must reach GL.
+	static bool count(ECall inCall, bool inRedundant)
+	{
+		if (gInstrumented)
+		{
+			gFrameCounts.mCalls[inCall]++;
+			if (inRedundant)
+				gFrameCounts.mRedundant[inCall]++;
+		}
+		return !inRedundant || !gFiltering;
+	}
+
+	static i8* findCap(u32 inCap)
+	{
+		for (u32 index = 0; index < kCapCount; index++)
+		{
+			if (kCaps[index] == inCap)
+				return &gState.mCaps[index];
+		}
+		return nullptr;
+	}
+
+	void Enable(u32 inCap)
+	{
+		i8* cap = findCap(inCap);
+		if (!count(Call_Capability, cap && *cap == 1))
+			return;
+		if (cap)
+			*cap = 1;
+		glEnable(inCap);
+	}
+
+	void Disable(u32 inCap)
+	{
+		i8* cap = findCap(inCap);
+		if (!count(Call_Capability, cap && *cap == 0))
+			return;
+		if (cap)
+			*cap = 0;
+		glDisable(inCap);
+	}
+
+	void BlendFunc(u32 inSrc, u32 inDst)
+	{
+		if (!count(Call_BlendFunc, gState.mBlendSrc == inSrc && gState.mBlendDst == inDst))
+			return;
+		gState.mBlendSrc = inSrc;
+		gState.mBlendDst = inDst;
+		glBlendFunc(inSrc, inDst);
+	}
+
+	void BlendFunci(u32 inBuffer, u32 inSrc, u32 inDst)
+	{
+		count(Call_BlendFunc, false);
+		gState.mBlendSrc = kUnknown;
+		gState.mBlendDst = kUnknown;
+		glBlendFunci(inBuffer, inSrc, inDst);
+	}
+
+	void DepthFunc(u32 inFunc)
+	{
+		if (!count(Call_DepthFunc, gState.mDepthFunc == inFunc))
+			return;
+		gState.mDepthFunc = inFunc;
+		glDepthFunc(inFunc);
+	}
+
+	void DepthMask(bool inWrite)
+	{
+		if (!count(Call_DepthMask, gState.mDepthMask == (i8)inWrite))
+			return;
+		gState.mDepthMask = (i8)inWrite;
+		glDepthMask(inWrite ? GL_TRUE : GL_FALSE);
+	}
+
+	void CullFace(u32 inMode)
+	{
+		if (!count(Call_CullFace, gState.mCullFace == inMode))
+			return;
+		gState.mCullFace = inMode;
+		glCullFace(inMode);
+	}
+
+	void Viewport(i32 inX, i32 inY, i32 inWidth, i32 inHeight)
+	{
+		const i32 viewport[4] = { inX, inY, inWidth, inHeight };
+		const bool redundant = gState.mViewportKnown && memcmp(gState.mViewport, viewport, sizeof(viewport)) == 0;
+		if (!count(Call_Viewport, redundant))
+			return;
+		gState.mViewportKnown = true;
+		memcpy(gState.mViewport, viewport, sizeof(viewport));
+		glViewport(inX, inY, inWidth, inHeight);
+	}
+
+	void UseProgram(u32 inProgram)
+	{
+		if (!count(Call_UseProgram, gState.mProgram == inProgram))
+			return;
+		gState.mProgram = inProgram;
+		glUseProgram(inProgram);
+	}
+
+	void BindVertexArray(u32 inVAO)
+	{
+		if (!count(Call_BindVertexArray, gState.mVAO == inVAO))
+			return;
+		gState.mVAO = inVAO;
+		glBindVertexArray(inVAO);
+	}
+
+	void BindFramebuffer(u32 inTarget, u32 inFBO)
+	{
+		bool redundant;
+		if (inTarget == GL_DRAW_FRAMEBUFFER)
+			redundant = gState.mDrawFBO == inFBO;
+		else if (inTarget == GL_READ_FRAMEBUFFER)
+			redundant = gState.mReadFBO == inFBO;
+		else
+			redundant = gState.mDrawFBO == inFBO && gState.mReadFBO == inFBO;
+
+		if (!count(Call_BindFramebuffer, redundant))
+			return;
+		if (inTarget != GL_READ_FRAMEBUFFER)
+			gState.mDrawFBO = inFBO;
+		if (inTarget != GL_DRAW_FRAMEBUFFER)
+			gState.mReadFBO = inFBO;
+		glBindFramebuffer(inTarget, inFBO);
+	}
+
+	void BindTextureUnit(u32 inUnit, u32 inTexture)
+	{
+		const bool shadowed = inUnit < kMaxTextureUnits;
+		if (!count(Call_BindTextureUnit, shadowed && gState.mTextures[inUnit] == inTexture))
+			return;
+		if (shadowed)
+			gState.mTextures[inUnit] = inTexture;
+		glBindTextureUnit(inUnit, inTexture);
+	}
+
+	void DeleteTextures(i32 inCount, const u32* inTextures)
+	{
+		for (i32 index = 0; index < inCount; index++)
+		{
+			for (u32& texture : gState.mTextures)
+			{
+				if (texture == inTextures[index])
+					texture = kUnknown;
+			}
+		}
+		glDeleteTextures(inCount, inTextures);
+	}
+
+	void DeleteProgram(u32 inProgram)
+	{
+		if (gState.mProgram == inProgram)
+			gState.mProgram = kUnknown;
+		glDeleteProgram(inProgram);
+	}
+
+	void DeleteVertexArrays(i32 inCount, const u32* inVAOs)
+	{
+		for (i32 index = 0; index < inCount; index++)
+		{
+			if (gState.mVAO == inVAOs[index])
+				gState.mVAO = kUnknown;
+		}
+		glDeleteVertexArrays(inCount, inVAOs);
+	}
+
+	void DeleteFramebuffers(i32 inCount, const u32* inFBOs)
+	{
+		for (i32 index = 0; index < inCount; index++)
+		{
+			if (gState.mDrawFBO == inFBOs[index])
+				gState.mDrawFBO = kUnknown;
+			if (gState.mReadFBO == inFBOs[index])
+				gState.mReadFBO = kUnknown;
+		}
+		glDeleteFramebuffers(inCount, inFBOs);
+	}
+
+	void Invalidate()
+	{
+		gState = unknownState();
+	}
+
+	void NewFrame()
+	{
+		if (!gInstrumented)
+			return;
+
+		for (u32 call = 0; call < Call_Count; call++)
+		{
+			gTotalCalls[call]		+= gFrameCounts.mCalls[call];
+			gTotalRedundant[call]	+= gFrameCounts.mRedundant[call];
+		}
+		gTotalFrames++;
+		gLastCounts = gFrameCounts;
+		gFrameCounts = {};
+	}
+
+	void SetFiltering(bool inFilter)
+	{
+		gFiltering = inFilter;
+	}
+
+	bool IsFiltering()
+	{
+		return gFiltering;
+	}
+
+	void SetInstrumented(bool inInstrumented)
+	{
+		if (inInstrumented && !gInstrumented)
+		{
+			gFrameCounts = {};
+			gLastCounts = {};
+			memset(gTotalCalls, 0, sizeof(gTotalCalls));
+			memset(gTotalRedundant, 0, sizeof(gTotalRedundant));
+			gTotalFrames = 0;
+		}
+		gInstrumented = inInstrumented;
+	}
+
+	bool IsInstrumented()
+	{
+		return gInstrumented;
+	}
+
+	void DrawUI()
+	{
+		bool filtering = gFiltering;
+		if (ImGui::Checkbox("Drop Redundant Calls", &filtering))
+			SetFiltering(filtering);
+		bool instrumented = gInstrumented;
+		if (ImGui::Checkbox("Count Calls", &instrumented))
+			SetInstrumented(instrumented);
+
+		if (!gInstrumented)
+			return;
+		if (gTotalFrames == 0)
+		{
+			ImGui::TextDisabled("No frame was counted yet.");
+			return;
+		}
+
+		u32 calls = 0;
+		u32 redundant = 0;
+		const ImGuiTableFlags flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders;
+		if (ImGui::BeginTable("GL State Calls", 4, flags))
+		{
+			ImGui::TableSetupColumn("Call");
+			ImGui::TableSetupColumn("Calls");
+			ImGui::TableSetupColumn("Redundant");
+			ImGui::TableSetupColumn("Average Redundant");
+			ImGui::TableHeadersRow();
+			for (u32 call = 0; call < Call_Count; call++)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(kCallNames[call]);
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", gLastCounts.mCalls[call]);
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", gLastCounts.mRedundant[call]);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f", (f64)gTotalRedundant[call] / gTotalFrames);
+
+				calls		+= gLastCounts.mCalls[call];
+				redundant	+= gLastCounts.mRedundant[call];
+			}
+			ImGui::EndTable();
+		}
+
+		ImGui::Text("Last frame: %u of %u calls redundant (%.1f%%), %s", redundant, calls,
+			calls > 0 ? 100.0f * redundant / calls : 0.0f, gFiltering ? "dropped" : "made");
+	}
+
+	void PrintReport(FILE* ioFile)
+	{
+		if (gTotalFrames == 0)
+		{
+			fputs("GL state: no frame was counted.\n", ioFile);
+			return;
+		}
+
+		fprintf(ioFile, "GL state calls per frame over %u frames, redundant calls %s:\n", gTotalFrames,
+			gFiltering ? "dropped" : "made");
+		fprintf(ioFile, "%-24s %12s %12s %8s\n", "Call", "Calls", "Redundant", "%");
+
+		u64 calls = 0;
+		u64 redundant = 0;
+		for (u32 call = 0; call < Call_Count; call++)
+		{
+			const f64 callsPerFrame = (f64)gTotalCalls[call] / gTotalFrames;
+			const f64 redundantPerFrame = (f64)gTotalRedundant[call] / gTotalFrames;
+			fprintf(ioFile, "%-24s %12.1f %12.1f %7.1f%%\n", kCallNames[call], callsPerFrame, redundantPerFrame,
+				gTotalCalls[call] > 0 ? 100.0 * gTotalRedundant[call] / gTotalCalls[call] : 0.0);
+			calls		+= gTotalCalls[call];
+			redundant	+= gTotalRedundant[call];
+		}
+		fprintf(ioFile, "%-24s %12.1f %12.1f %7.1f%%\n", "Total", (f64)calls / gTotalFrames, (f64)redundant / gTotalFrames,
+			calls > 0 ? 100.0 * redundant / calls : 0.0);
+	}
+}
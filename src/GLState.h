@@ -0,0 +1,58 @@
+#pragma once
+
+#include "defines.h"
+#include <cstdio>
+
+/**
+ * @brief A shadow of the GL state which is set every draw: the capabilities, the blend, depth and
+ * cull state, the viewport and the program, vertex array, framebuffer and texture unit bindings.
+ * A call which sets what is already set is dropped. The state starts unknown, so the first call
+ * of every kind always reaches GL.
+ *
+ * Everything which changes this state must go through here, or call Invalidate() after. The
+ * deletes forget the bindings of the deleted names, which GL reuses.
+ *
+ * The instrumented mode counts the calls and the redundant ones every frame. With the filter off
+ * the redundant calls still reach GL, so the two can be timed against each other.
+ */
+namespace GLState
+{
+	/// @brief The capabilities which aren't shadowed are passed through.
+	void	Enable(u32 inCap);
+	void	Disable(u32 inCap);
+	void	BlendFunc(u32 inSrc, u32 inDst);
+	/// @brief Not shadowed, it makes the blend function of every buffer unknown.
+	void	BlendFunci(u32 inBuffer, u32 inSrc, u32 inDst);
+	void	DepthFunc(u32 inFunc);
+	void	DepthMask(bool inWrite);
+	void	CullFace(u32 inMode);
+	void	Viewport(i32 inX, i32 inY, i32 inWidth, i32 inHeight);
+	void	UseProgram(u32 inProgram);
+	void	BindVertexArray(u32 inVAO);
+	/// @param inTarget GL_FRAMEBUFFER binds the draw and read framebuffers.
+	void	BindFramebuffer(u32 inTarget, u32 inFBO);
+	void	BindTextureUnit(u32 inUnit, u32 inTexture);
+
+	void	DeleteTextures(i32 inCount, const u32* inTextures);
+	void	DeleteProgram(u32 inProgram);
+	void	DeleteVertexArrays(i32 inCount, const u32* inVAOs);
+	void	DeleteFramebuffers(i32 inCount, const u32* inFBOs);
+
+	/// @brief Forget the shadowed state, after code which sets it directly (e.g. the ImGui backend).
+	void	Invalidate();
+
+	/// @brief Call once per frame, after the buffers are swapped. The counts of the frame are kept.
+	void	NewFrame();
+
+	/// @brief On by default.
+	void	SetFiltering(bool inFilter);
+	bool	IsFiltering();
+	/// @brief Off by default, turning it on resets the totals of PrintReport().
+	void	SetInstrumented(bool inInstrumented);
+	bool	IsInstrumented();
+
+	/// @brief The filter and instrumentation toggles and the counts of the last frame.
+	void	DrawUI();
+	/// @brief The calls and redundant calls per frame, averaged since the instrumentation was turned on.
+	void	PrintReport(FILE* ioFile);
+}
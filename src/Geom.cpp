@@ -1,10 +1,13 @@
 #include "Geom.h"
 
+#include "GLState.h"
 #include "ResourceManager.h"
+#include "Memory.h"
 #include "Utils.h"
 #include <glad/glad.h>
 #include <unordered_map>
 #include <functional>
+#include <cfloat>
 #include <string>
 #include <filesystem>
 #include <assimp/Importer.hpp>
@@ -54,6 +57,8 @@ static struct
 	};
 
 	u32 mVAO = UINT32_MAX;
+	/// @brief Reads only the position of the interleaved vertices.
+	u32 mPositionVAO = UINT32_MAX;
 } gState;
 
 static glm::mat4 AssimpToGlm(const aiMatrix4x4& inMat4)
@@ -66,10 +71,30 @@ static glm::mat4 AssimpToGlm(const aiMatrix4x4& inMat4)
 	return out;
 }
 
+/// @brief The per instance mat4 at attributes 5 to 8, a column each, from binding 1.
+static void setupInstanceAttribs(u32 inVAO)
+{
+	for (u32 i = 0; i < 4; i++)
+	{
+		glEnableVertexArrayAttrib(inVAO, 5 + i);
+		glVertexArrayAttribFormat(inVAO, 5 + i, 4, GL_FLOAT, GL_FALSE, i * sizeof(glm::vec4));
+		glVertexArrayAttribBinding(inVAO, 5 + i, 1);
+	}
+	glVertexArrayBindingDivisor(inVAO, 1, 1);
+}
+
 bool Geom::StartUp()
 {
 	glCreateVertexArrays(1, &gState.mVAO);
 
+	glCreateVertexArrays(1, &gState.mPositionVAO);
+	glEnableVertexArrayAttrib(gState.mPositionVAO, 0);
+	glVertexArrayAttribFormat(gState.mPositionVAO, 0, 3, GL_FLOAT, GL_FALSE, OFFSETOF(Vertex, mPosition));
+	glVertexArrayAttribBinding(gState.mPositionVAO, 0, 0);
+
+	setupInstanceAttribs(gState.mVAO);
+	setupInstanceAttribs(gState.mPositionVAO);
+
 	{
 		u8 redPixel = 255;
 		glCreateTextures(GL_TEXTURE_2D, 1, &gState.mOpacityMapFallback);
@@ -155,24 +180,34 @@ bool Geom::StartUp()
 
 void Geom::ShutDown()
 {
-	glDeleteVertexArrays(1, &gState.mVAO);
+	GLState::DeleteVertexArrays(1, &gState.mVAO);
+	GLState::DeleteVertexArrays(1, &gState.mPositionVAO);
 
-	glDeleteTextures(1, &gState.mDiffuseMapFallback);
-	glDeleteTextures(1, &gState.mNormalMapFallback);
-	glDeleteTextures(1, &gState.mOpacityMapFallback);
-	glDeleteTextures(1, &gState.mSpecularMapFallback);
+	GLState::DeleteTextures(1, &gState.mDiffuseMapFallback);
+	GLState::DeleteTextures(1, &gState.mNormalMapFallback);
+	GLState::DeleteTextures(1, &gState.mOpacityMapFallback);
+	GLState::DeleteTextures(1, &gState.mSpecularMapFallback);
 }
 
-void Model::parseNodeRecursive(const char* inModelDir, const aiScene* inScene, const aiNode* inNode)
+void Model::parseNodeRecursive(const char* inModelDir, const aiScene* inScene, const aiNode* inNode, std::vector<u32>* ioMeshIndices)
 {
 	for (u32 i = 0; i < inNode->mNumMeshes; i++)
 	{
+		// a mesh used by many nodes is loaded once, with a transform per node
+		u32& meshIndex = (*ioMeshIndices)[inNode->mMeshes[i]];
+		if (meshIndex != UINT32_MAX)
+		{
+			mMeshes[meshIndex].mInstanceTransforms.push_back(AssimpToGlm(inNode->mTransformation));
+			continue;
+		}
+
 		aiMesh* assimpMesh = inScene->mMeshes[inNode->mMeshes[i]];
 
+		meshIndex = (u32)mMeshes.size();
 		mMeshes.emplace_back();
 		Mesh& mesh = mMeshes.back();
 		mesh.Init();
-		mesh.mTransform = AssimpToGlm(inNode->mTransformation);
+		mesh.mInstanceTransforms.push_back(AssimpToGlm(inNode->mTransformation));
 
 		// here assume each face has 3 indices cuz assimp
 		// triangulates the meshes in Model::Load();
@@ -277,12 +312,10 @@ void Model::parseNodeRecursive(const char* inModelDir, const aiScene* inScene, c
 		{
 			SBREAK();
 		}
-
-		mesh.UploadDataGPU();
 	}
 
 	for (u32 i = 0; i < inNode->mNumChildren; i++)
-		parseNodeRecursive(inModelDir, inScene, inNode->mChildren[i]);
+		parseNodeRecursive(inModelDir, inScene, inNode->mChildren[i], ioMeshIndices);
 }
 
 bool Model::Load(const char* inFilePath)
@@ -314,7 +347,17 @@ bool Model::Load(const char* inFilePath)
 
 	std::string modelDir = filePath.substr(0, filePath.find_last_of('/'));
 	modelDir += '/';
-	parseNodeRecursive(modelDir.c_str(), scene, scene->mRootNode);
+	std::vector<u32> meshIndices(scene->mNumMeshes, UINT32_MAX);
+	parseNodeRecursive(modelDir.c_str(), scene, scene->mRootNode, &meshIndices);
+
+	// after every node is parsed, the instances are known
+	usize instanceCount = 0;
+	for (Mesh& mesh : mMeshes)
+	{
+		mesh.UploadDataGPU();
+		instanceCount += mesh.mInstanceTransforms.size();
+	}
+	printf("%zu meshes, %zu instances\n", mMeshes.size(), instanceCount);
 
 	printf("aiLight count %u\n", scene->mNumLights);
 	for (u32 i = 0; i < scene->mNumLights; i++)
@@ -422,11 +465,7 @@ void Mesh::Init()
 		return;
 	}
 
-	glCreateBuffers(1, &mVBO);
-	glCreateBuffers(1, &mEBO);
-
-	glVertexArrayVertexBuffer(gState.mVAO, 0, mVBO, 0, sizeof(Vertex));
-	glVertexArrayElementBuffer(gState.mVAO, mEBO);
+	mContentHash = 0;
 }
 
 void Mesh::Destroy()
@@ -455,27 +494,58 @@ void Mesh::Destroy()
 	mOpacityTexture = nullptr;
 	mNormalTexture = nullptr;
 
-	glDeleteBuffers(1, &mVBO);
-	glDeleteBuffers(1, &mEBO);
+	// the buffers may still be used by other meshes with the same data
+	if (ResMgr::ReleaseMeshBuffers(mContentHash))
+	{
+		glDeleteBuffers(1, &mVBO);
+		glDeleteBuffers(1, &mEBO);
+	}
 	mVBO = UINT32_MAX;
 	mEBO = UINT32_MAX;
+	mContentHash = 0;
+
+	glDeleteBuffers(1, &mInstanceVBO);
+	mInstanceVBO = UINT32_MAX;
+	mInstanceTransforms.clear();
 }
 
 void Mesh::UploadDataGPU()
 {
-	if (mVBO == UINT32_MAX || mEBO == UINT32_MAX || mVertices.size() == 0)
+	if (mVBO != UINT32_MAX || mEBO != UINT32_MAX || mVertices.size() == 0)
 	{
-		puts("ERROR(Mesh): Mesh is not initialized.");
+		puts("ERROR(Mesh): Mesh is already uploaded or has no vertices.");
 		FATAL();
 		return;
 	}
 
+	mBoundsMin = mVertices[0].mPosition;
+	mBoundsMax = mVertices[0].mPosition;
+	for (const Vertex& vertex : mVertices)
+	{
+		mBoundsMin = glm::min(mBoundsMin, vertex.mPosition);
+		mBoundsMax = glm::max(mBoundsMax, vertex.mPosition);
+	}
+
+	const usize verticesSize = mVertices.size() * sizeof(Vertex);
+	const usize indicesSize = mIndices.size() * sizeof(u32);
+	mContentHash = Utils::Hash64(mIndices.data(), indicesSize, Utils::Hash64(mVertices.data(), verticesSize));
+
+	if (!ResMgr::AcquireMeshBuffers(&mContentHash, verticesSize + indicesSize, &mVBO, &mEBO))
+	{
+		glCreateBuffers(1, &mVBO);
+		glCreateBuffers(1, &mEBO);
+
+		glNamedBufferData(mVBO, verticesSize, mVertices.data(), GL_STATIC_DRAW);
+		glNamedBufferData(mEBO, indicesSize, mIndices.data(), GL_STATIC_DRAW);
+
+		ResMgr::AddMeshBuffers(mContentHash, mVBO, mEBO, verticesSize + indicesSize);
+	}
+
+	UploadInstances();
+
 	glVertexArrayVertexBuffer(gState.mVAO, 0, mVBO, 0, sizeof(Vertex));
 	glVertexArrayElementBuffer(gState.mVAO, mEBO);
 
-	glNamedBufferData(mVBO, mVertices.size() * sizeof(Vertex), mVertices.data(), GL_STATIC_DRAW);
-	glNamedBufferData(mEBO, mIndices.size() * sizeof(u32), mIndices.data(), GL_STATIC_DRAW);
-
 	glEnableVertexArrayAttrib(gState.mVAO, 0);
 	glEnableVertexArrayAttrib(gState.mVAO, 1);
 	glEnableVertexArrayAttrib(gState.mVAO, 2);
@@ -495,48 +565,180 @@ void Mesh::UploadDataGPU()
 	glVertexArrayAttribBinding(gState.mVAO, 4, 0);
 }
 
+void Mesh::UploadInstances()
+{
+	ZR_ASSERT(!mInstanceTransforms.empty(), "A mesh has at least one instance.");
+
+	const usize size = mInstanceTransforms.size() * sizeof(glm::mat4);
+	if (mInstanceVBO != UINT32_MAX)
+	{
+		i32 oldSize = 0;
+		glGetNamedBufferParameteriv(mInstanceVBO, GL_BUFFER_SIZE, &oldSize);
+		if ((usize)oldSize == size)
+		{
+			glNamedBufferSubData(mInstanceVBO, 0, size, mInstanceTransforms.data());
+			return;
+		}
+		glDeleteBuffers(1, &mInstanceVBO);
+	}
+
+	glCreateBuffers(1, &mInstanceVBO);
+	glNamedBufferStorage(mInstanceVBO, size, mInstanceTransforms.data(), GL_DYNAMIC_STORAGE_BIT);
+}
+
 void Mesh::Draw() const
 {
 	ZoneScopedN("Draw Mesh");
 
+	bind();
+
+	{
+		ZoneScopedN("DrawElementsInstanced");
+		glDrawElementsInstanced(GL_TRIANGLES, static_cast<u32>(mIndices.size()), GL_UNSIGNED_INT, 0, static_cast<u32>(mInstanceTransforms.size()));
+	}
+}
+
+void Mesh::DrawIndirect(usize inOffset, u32 inDrawCount) const
+{
+	ZoneScopedN("Draw Mesh Indirect");
+
+	bind();
+
+	{
+		ZoneScopedN("MultiDrawElementsIndirect");
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(inOffset), inDrawCount, 0);
+	}
+}
+
+void Mesh::DrawDepth() const
+{
+	ZoneScopedN("Draw Mesh Depth");
+
+	bindPositions();
+	glDrawElementsInstanced(GL_TRIANGLES, static_cast<u32>(mIndices.size()), GL_UNSIGNED_INT, 0, static_cast<u32>(mInstanceTransforms.size()));
+}
+
+void Mesh::DrawDepthIndirect(usize inOffset, u32 inDrawCount) const
+{
+	ZoneScopedN("Draw Mesh Depth Indirect");
+
+	bindPositions();
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(inOffset), inDrawCount, 0);
+}
+
+void Mesh::GetWorldBounds(glm::vec3* outMin, glm::vec3* outMax) const
+{
+	*outMin = glm::vec3(FLT_MAX);
+	*outMax = glm::vec3(-FLT_MAX);
+	for (u32 i = 0; i < mInstanceTransforms.size(); i++)
+	{
+		glm::vec3 instanceMin;
+		glm::vec3 instanceMax;
+		GetInstanceBounds(i, &instanceMin, &instanceMax);
+		*outMin = glm::min(*outMin, instanceMin);
+		*outMax = glm::max(*outMax, instanceMax);
+	}
+}
+
+void Mesh::GetInstanceBounds(u32 inInstance, glm::vec3* outMin, glm::vec3* outMax) const
+{
+	*outMin = glm::vec3(FLT_MAX);
+	*outMax = glm::vec3(-FLT_MAX);
+	for (u32 i = 0; i < 8; i++)
+	{
+		const glm::vec3 corner(
+			(i & 1) ? mBoundsMax.x : mBoundsMin.x,
+			(i & 2) ? mBoundsMax.y : mBoundsMin.y,
+			(i & 4) ? mBoundsMax.z : mBoundsMin.z
+		);
+		const glm::vec3 world = glm::vec3(mInstanceTransforms[inInstance] * glm::vec4(corner, 1.0f));
+		*outMin = glm::min(*outMin, world);
+		*outMax = glm::max(*outMax, world);
+	}
+}
+
+void Mesh::bind() const
+{
 	{
 		ZoneScopedN("Bind Texture Units");
 		if (mDiffuseTexture)
-			glBindTextureUnit(0, mDiffuseTexture->mID);
+			GLState::BindTextureUnit(0, mDiffuseTexture->mID);
 		else
-			glBindTextureUnit(0, gState.mDiffuseMapFallback);
+			GLState::BindTextureUnit(0, gState.mDiffuseMapFallback);
 
 		if (mSpecularTexture)
-			glBindTextureUnit(1, mSpecularTexture->mID);
+			GLState::BindTextureUnit(1, mSpecularTexture->mID);
 		else
-			glBindTextureUnit(1, gState.mSpecularMapFallback);
+			GLState::BindTextureUnit(1, gState.mSpecularMapFallback);
 
 		if (mOpacityTexture)
-			glBindTextureUnit(2, mOpacityTexture->mID);
+			GLState::BindTextureUnit(2, mOpacityTexture->mID);
 		else
-			glBindTextureUnit(2, gState.mOpacityMapFallback);
+			GLState::BindTextureUnit(2, gState.mOpacityMapFallback);
 
 		if (mNormalTexture)
-			glBindTextureUnit(3, mNormalTexture->mID);
+			GLState::BindTextureUnit(3, mNormalTexture->mID);
 		else
-			glBindTextureUnit(3, gState.mNormalMapFallback);
+			GLState::BindTextureUnit(3, gState.mNormalMapFallback);
 	}
 
 	{
 		ZoneScopedN("Bind VAO");
-		glBindVertexArray(gState.mVAO);
+		GLState::BindVertexArray(gState.mVAO);
 	}
 
 	glVertexArrayVertexBuffer(gState.mVAO, 0, mVBO, 0, sizeof(Vertex));
+	glVertexArrayVertexBuffer(gState.mVAO, 1, mInstanceVBO, 0, sizeof(glm::mat4));
 	glVertexArrayElementBuffer(gState.mVAO, mEBO);
+}
 
+void Mesh::bindPositions() const
+{
+	GLState::BindVertexArray(gState.mPositionVAO);
+	glVertexArrayVertexBuffer(gState.mPositionVAO, 0, mVBO, 0, sizeof(Vertex));
+	glVertexArrayVertexBuffer(gState.mPositionVAO, 1, mInstanceVBO, 0, sizeof(glm::mat4));
+	glVertexArrayElementBuffer(gState.mPositionVAO, mEBO);
+}
+
+bool Texture::Decode(const char* inFilePath, ETextureType inType, TextureData* outData)
+{
+	u8* pixels = stbi_load(inFilePath, &outData->mWidth, &outData->mHeight, &outData->mChannelCount, 0);
+	if (!pixels)
 	{
-		ZoneScopedN("DrawElements");
-		glDrawElements(GL_TRIANGLES, static_cast<u32>(mIndices.size()), GL_UNSIGNED_INT, 0);
+		fprintf(stderr, "ERROR: Failed to load texture '%s'.\n", inFilePath);
+		return false;
 	}
+
+	outData->mPixels = pixels;
+
+	// the dimensions and type are in the seed so the same bytes with a
+	// different layout or color space dont share a texture
+	const u64 header[4] = { (u64)outData->mWidth, (u64)outData->mHeight, (u64)outData->mChannelCount, (u64)inType };
+	const usize pixelsSize = (usize)outData->mWidth * (usize)outData->mHeight * (usize)outData->mChannelCount;
+	outData->mContentHash = Utils::Hash64(pixels, pixelsSize, Utils::Hash64(header, sizeof(header)));
+
+	return true;
+}
+
+void Texture::FreeData(TextureData* ioData)
+{
+	if (ioData->mPixels)
+		stbi_image_free(ioData->mPixels);
+	ioData->mPixels = nullptr;
 }
 
 bool Texture::Load(const char* inFilePath, ETextureType inType)
+{
+	TextureData data{};
+	if (!Decode(inFilePath, inType, &data))
+		return false;
+
+	bool res = Upload(data, inType);
+	FreeData(&data);
+	return res;
+}
+
+bool Texture::Upload(const TextureData& inData, ETextureType inType)
 {
 	auto GetInternalTextureFormat = [](i32 inChannelCount) -> u32 {
 		if (inChannelCount == 1)
@@ -586,17 +788,18 @@ bool Texture::Load(const char* inFilePath, ETextureType inType)
 		return UINT32_MAX;
 	};
 
-	i32 width, height, channelCount;
-	u8* data = stbi_load(inFilePath, &width, &height, &channelCount, 0);
-	if (!data)
-	{
-		fprintf(stderr, "ERROR: Failed to load texture '%s'.\n", inFilePath);
-		return false;
-	}
+	const i32 width = inData.mWidth;
+	const i32 height = inData.mHeight;
+	const i32 channelCount = inData.mChannelCount;
+	const u8* data = inData.mPixels;
 
 	u32 mipLevels = 1 + glm::floor(glm::log2(glm::max(width, height)));
 
+	// a full mip chain is 4/3 the size of the base level
+	mSizeBytes = ((usize)width * (usize)height * (usize)channelCount * 4) / 3;
+
 	mID = UINT32_MAX;
+	mType = inType;
 
 	glCreateTextures(GL_TEXTURE_2D, 1, &mID);
 	glTextureParameteri(mID, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -634,7 +837,8 @@ bool Texture::Load(const char* inFilePath, ETextureType inType)
 			if (!rgbData)
 			{
 				printf("ERROR(Texture): Failed to allocate memory for specular texture replication.\n");
-				stbi_image_free(data);
+				GLState::DeleteTextures(1, &mID);
+				mID = UINT32_MAX;
 				return false;
 			}
 
@@ -646,7 +850,8 @@ bool Texture::Load(const char* inFilePath, ETextureType inType)
 			}
 
 			glTextureStorage2D(mID, mipLevels, GL_RGB8, width, height);
-			glTextureSubImage2D(mID, 0, 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, data);
+			glTextureSubImage2D(mID, 0, 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rgbData);
+			mSizeBytes *= 3;
 
 			free(rgbData);
 
@@ -670,12 +875,15 @@ bool Texture::Load(const char* inFilePath, ETextureType inType)
 mip_and_free:
 	glGenerateTextureMipmap(mID);
 
-	stbi_image_free(data);
+	Mem::ReportAlloc(mSizeBytes, EMemSource::TextureVRAM);
 	return true;
 }
 
 void Texture::Unload()
 {
-	glDeleteTextures(1, &mID);
+	Mem::ReportFree(mSizeBytes, EMemSource::TextureVRAM);
+	mSizeBytes = 0;
+
+	GLState::DeleteTextures(1, &mID);
 	mID = UINT32_MAX;
 }
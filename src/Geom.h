@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Shader.h"
+#include "Handle.h"
 #include "defines.h"
 #include <vector>
 #include <glm/glm.hpp>
@@ -29,20 +30,41 @@ namespace Geom
 		Unknown,
 	};
 
+	/// @brief Decoded pixels of a texture file which are not uploaded yet.
+	struct TextureData
+	{
+		u8*				mPixels = nullptr;
+		i32				mWidth = 0;
+		i32				mHeight = 0;
+		i32				mChannelCount = 0;
+		/// @brief Hash of the pixels, dimensions and texture type.
+		u64				mContentHash = 0;
+	};
+
 	struct Texture
 	{
 						Texture() = default;
 						~Texture() = default;
 
+		/// @brief Same as calling Decode(), Upload() and FreeData().
 		bool			Load(const char* inFilePath, ETextureType inType);
 		void			Unload();
 
+		static bool		Decode(const char* inFilePath, ETextureType inType, TextureData* outData);
+		static void		FreeData(TextureData* ioData);
+		bool			Upload(const TextureData& inData, ETextureType inType);
+
 		/**
 		 * @brief It is not sufficient to check Mesh::mOpacityTexture is available,
 		 * because opacity may be baked in the alpha channel of mDiffuseTexture.
 		 */
 		bool			mHasTransparency = false;
 		u32				mID = UINT32_MAX;
+		ETextureType	mType = ETextureType::Unknown;
+		/// @brief Approximate VRAM size including mips.
+		usize			mSizeBytes = 0;
+		/// @brief Set by ResMgr so the texture can be released without a lookup.
+		Handle<Texture>	mHandle;
 	};
 
 	struct Mesh
@@ -50,9 +72,28 @@ namespace Geom
 		void						Init();
 		void						Destroy();
 		void						UploadDataGPU();
+		/// @brief Upload mInstanceTransforms again after they changed.
+		void						UploadInstances();
+		/// @brief Draw every instance.
 		void						Draw() const;
+		/**
+		 * @brief Draw with inDrawCount commands from inOffset bytes into the bound GL_DRAW_INDIRECT_BUFFER.
+		 * The base instance of a command selects its transform.
+		 */
+		void						DrawIndirect(usize inOffset, u32 inDrawCount = 1) const;
+		/// @brief Draw() with only the positions and no textures, for the depth prepass.
+		void						DrawDepth() const;
+		void						DrawDepthIndirect(usize inOffset, u32 inDrawCount = 1) const;
+		/// @brief The world space box around every instance.
+		void						GetWorldBounds(glm::vec3* outMin, glm::vec3* outMax) const;
+		/// @brief The world space box around mBoundsMin and mBoundsMax transformed by an instance.
+		void						GetInstanceBounds(u32 inInstance, glm::vec3* outMin, glm::vec3* outMax) const;
 
-		glm::mat4					mTransform;
+		/**
+		 * @brief The transform of every node which uses the mesh, so a mesh repeated in the scene
+		 * is loaded and drawn once. There is at least one.
+		 */
+		std::vector<glm::mat4>		mInstanceTransforms;
 
 		const Texture*				mDiffuseTexture	= nullptr;
 		const Texture*				mSpecularTexture = nullptr;
@@ -61,8 +102,22 @@ namespace Geom
 
 		std::vector<Vertex>			mVertices;
 		std::vector<u32>			mIndices;
+		/**
+		 * @brief The buffers are owned by ResMgr and shared with every mesh
+		 * that has identical vertex and index data.
+		 */
 		u32							mVBO = UINT32_MAX;
 		u32							mEBO = UINT32_MAX;
+		u64							mContentHash = 0;
+		/// @brief mInstanceTransforms, read by the per instance aModel attribute of the shaders.
+		u32							mInstanceVBO = UINT32_MAX;
+		/// @brief The bounding box of mVertices, before the instance transforms. Set by UploadDataGPU().
+		glm::vec3					mBoundsMin = glm::vec3(0.0f);
+		glm::vec3					mBoundsMax = glm::vec3(0.0f);
+
+	private:
+		void						bind() const;
+		void						bindPositions() const;
 	};
 
 	struct PointLight
@@ -84,9 +139,17 @@ namespace Geom
 
 		std::vector<Mesh>			mMeshes;
 		std::vector<PointLight>		mPointLights;
+		/// @brief Set by ResMgr so the model can be released without a lookup.
+		Handle<Model>				mHandle;
 
 	private:
-		void						parseNodeRecursive(const char* inModelDir, const aiScene* inScene, const aiNode* inNode);
+		/// @param ioMeshIndices The index in mMeshes of every aiMesh already loaded, or UINT32_MAX.
+		void						parseNodeRecursive(
+										const char* inModelDir,
+										const aiScene* inScene,
+										const aiNode* inNode,
+										std::vector<u32>* ioMeshIndices
+									);
 	};
 
 	bool StartUp();
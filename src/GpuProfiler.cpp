@@ -0,0 +1,409 @@
+#include "GpuProfiler.h"
+
+#include "Renderer.h"
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <glad/glad.h>
+#include <imgui.h>
+#include <tracy/Tracy.hpp>
+#include <tracy/TracyOpenGL.hpp>
+
+using Clock = std::chrono::steady_clock;
+
+namespace GpuProfiler
+{
+	/// @brief The deepest nesting of zones.
+	sconst u32 kMaxDepth = 16;
+	/// @brief The frames of the rolling average.
+	sconst u32 kHistoryLength = 64;
+
+	/// @brief A zone of a frame, its timestamps are mQuery and mQuery + 1 of the pool.
+	struct Zone
+	{
+		const char*			mName;
+		u32					mQuery;
+		/// @brief The index of the enclosing zone in the frame, UINT32_MAX at the top.
+		u32					mParent;
+		Clock::time_point	mCpuStart;
+		/// @brief The CPU time between GL_ZONE() and GL_ZONE_END(), recording the commands.
+		f32					mCpuMs;
+	};
+
+	struct FramePool
+	{
+		/// @brief Grows to the most zones a frame had, twice as many queries.
+		std::vector<u32>	mQueries;
+		std::vector<Zone>	mZones;
+	};
+
+	/// @brief The timings of a zone name under its parent, zones with the same key in a frame are summed.
+	struct ZoneStats
+	{
+		std::string	mName;
+		/// @brief The names of the enclosing zones and this one, separated by '/'.
+		std::string	mPath;
+		/// @brief The index of the parent stats, UINT32_MAX at the top.
+		u32			mParent;
+		u32			mDepth;
+		f32			mFrameMs;
+		f32			mCpuFrameMs;
+		f32			mHistory[kHistoryLength];
+		u32			mHistoryCount;
+		/// @brief The pool frame whose timings mFrameMs holds.
+		u32			mLastFrame;
+		/// @brief Every frame read since the totals were reset, for PrintReport().
+		f64			mTotalMs;
+		f32			mMinMs;
+		f32			mMaxMs;
+		u32			mTotalFrames;
+	};
+
+	/// @brief A top level zone of the last frame read, for GetSpanMs().
+	struct ReadZone
+	{
+		u32	mStats;
+		u64	mBegin;
+		u64	mEnd;
+	};
+
+	FramePool				gPools[kGpuTimerLatency];
+	u32						gFrame = 0;
+	/// @brief The zones of the current frame which haven't ended.
+	std::vector<u32>		gStack;
+	std::vector<ZoneStats>	gStats;
+	/// @brief The last frame read, UINT32_MAX before the first.
+	u32						gReadFrame = UINT32_MAX;
+	std::vector<ReadZone>	gReadZones;
+	/// @brief The frames whose queries weren't done when their pool was needed again.
+	u32						gDroppedFrames = 0;
+	FrameFn					gFrameCallback;
+
+#ifdef TRACY_ENABLE
+	// the Tracy GPU zones are scoped, they are constructed and destroyed in place by the zones
+	alignas(tracy::GpuCtxScope) u8 gTracyScopes[kMaxDepth][sizeof(tracy::GpuCtxScope)];
+#endif
+
+	void StartUp()
+	{
+		TracyGpuContext;
+		for (FramePool& pool : gPools)
+		{
+			pool.mQueries.clear();
+			pool.mZones.clear();
+		}
+		gFrame = 0;
+		gReadFrame = UINT32_MAX;
+		gReadZones.clear();
+		gDroppedFrames = 0;
+		gStats.clear();
+		gStack.clear();
+	}
+
+	void ShutDown()
+	{
+		for (FramePool& pool : gPools)
+		{
+			glDeleteQueries((i32)pool.mQueries.size(), pool.mQueries.data());
+			pool.mQueries.clear();
+			pool.mZones.clear();
+		}
+		gStats.clear();
+		gReadZones.clear();
+	}
+
+	static u32 findStats(const char* inName, u32 inParent)
+	{
+		for (u32 i = 0; i < gStats.size(); i++)
+		{
+			if (gStats[i].mParent == inParent && gStats[i].mName == inName)
+				return i;
+		}
+
+		ZoneStats stats{};
+		stats.mName			= inName;
+		stats.mPath			= inParent == UINT32_MAX ? inName : gStats[inParent].mPath + '/' + inName;
+		stats.mParent		= inParent;
+		stats.mDepth		= inParent == UINT32_MAX ? 0 : gStats[inParent].mDepth + 1;
+		stats.mLastFrame	= UINT32_MAX;
+		gStats.push_back(stats);
+		return (u32)gStats.size() - 1;
+	}
+
+	/// @brief Add the timings of a pool to the stats, the zone stats are found in the order of the zones.
+	static void readPool(const FramePool& inPool, u32 inFrame)
+	{
+		gReadZones.clear();
+		std::vector<u32> zoneStats(inPool.mZones.size());
+		for (u32 i = 0; i < inPool.mZones.size(); i++)
+		{
+			const Zone& zone = inPool.mZones[i];
+			u64 begin = 0;
+			u64 end = 0;
+			glGetQueryObjectui64v(inPool.mQueries[zone.mQuery], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(inPool.mQueries[zone.mQuery + 1], GL_QUERY_RESULT, &end);
+
+			// a parent is always before its children
+			const u32 parent = zone.mParent == UINT32_MAX ? UINT32_MAX : zoneStats[zone.mParent];
+			zoneStats[i] = findStats(zone.mName, parent);
+
+			if (zone.mParent == UINT32_MAX)
+				gReadZones.push_back({ zoneStats[i], begin, end });
+
+			ZoneStats& stats = gStats[zoneStats[i]];
+			if (stats.mLastFrame != inFrame)
+			{
+				stats.mLastFrame	= inFrame;
+				stats.mFrameMs		= 0.0f;
+				stats.mCpuFrameMs	= 0.0f;
+			}
+			stats.mFrameMs += (f32)(end - begin) / 1000000.0f;
+			stats.mCpuFrameMs += zone.mCpuMs;
+		}
+
+		std::vector<FrameZone> frameZones;
+		for (ZoneStats& stats : gStats)
+		{
+			if (stats.mLastFrame != inFrame)
+				continue;
+
+			stats.mHistory[stats.mHistoryCount++ % kHistoryLength] = stats.mFrameMs;
+			stats.mMinMs = stats.mTotalFrames == 0 || stats.mFrameMs < stats.mMinMs ? stats.mFrameMs : stats.mMinMs;
+			stats.mMaxMs = stats.mFrameMs > stats.mMaxMs ? stats.mFrameMs : stats.mMaxMs;
+			stats.mTotalMs += stats.mFrameMs;
+			stats.mTotalFrames++;
+
+			if (gFrameCallback)
+				frameZones.push_back({ stats.mPath.c_str(), stats.mFrameMs, stats.mCpuFrameMs });
+		}
+
+		if (gFrameCallback)
+			gFrameCallback(frameZones);
+		gReadFrame = inFrame;
+	}
+
+	void NewFrame()
+	{
+		ZR_ASSERT(gStack.empty(), "GL_ZONE(\"%s\") isn't ended.", gStack.empty() ? "" : gPools[gFrame % kGpuTimerLatency].mZones[gStack.back()].mName);
+		TracyGpuCollect;
+
+		gFrame++;
+		FramePool& pool = gPools[gFrame % kGpuTimerLatency];
+		if (pool.mZones.empty())
+			return;
+
+		// the end of every zone, a parent ends after the zones it encloses so no single query is the last
+		i32 available = 1;
+		for (u32 i = 0; i < pool.mZones.size() && available; i++)
+			glGetQueryObjectiv(pool.mQueries[pool.mZones[i].mQuery + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+			readPool(pool, gFrame - kGpuTimerLatency);
+		else
+			gDroppedFrames++;
+
+		pool.mZones.clear();
+	}
+
+	u32 GetFrame()
+	{
+		return gFrame;
+	}
+
+	void Flush()
+	{
+		glFinish();
+		// every pool left is read as its frame comes around
+		for (u32 i = 1; i < kGpuTimerLatency; i++)
+			NewFrame();
+	}
+
+	void BeginZone(const char* inName, const char* inFile, u32 inLine)
+	{
+		ZR_ASSERT(gStack.size() < kMaxDepth, "GL_ZONE(\"%s\") is nested more than %u deep.", inName, kMaxDepth);
+
+		FramePool& pool = gPools[gFrame % kGpuTimerLatency];
+		const u32 query = 2 * (u32)pool.mZones.size();
+		if (query + 2 > pool.mQueries.size())
+		{
+			pool.mQueries.resize(query + 2);
+			glCreateQueries(GL_TIMESTAMP, 2, &pool.mQueries[query]);
+		}
+
+		pool.mZones.push_back({ inName, query, gStack.empty() ? UINT32_MAX : gStack.back(), Clock::now(), 0.0f });
+		gStack.push_back((u32)pool.mZones.size() - 1);
+		glQueryCounter(pool.mQueries[query], GL_TIMESTAMP);
+
+#ifdef TRACY_ENABLE
+		new (gTracyScopes[gStack.size() - 1]) tracy::GpuCtxScope(
+			inLine, inFile, strlen(inFile), inName, strlen(inName), inName, strlen(inName), true
+		);
+#else
+		(void)inFile;
+		(void)inLine;
+#endif
+	}
+
+	void EndZone()
+	{
+		ZR_ASSERT(!gStack.empty(), "GL_ZONE_END() without a GL_ZONE().%s", "");
+
+#ifdef TRACY_ENABLE
+		((tracy::GpuCtxScope*)gTracyScopes[gStack.size() - 1])->~GpuCtxScope();
+#endif
+
+		FramePool& pool = gPools[gFrame % kGpuTimerLatency];
+		Zone& zone = pool.mZones[gStack.back()];
+		glQueryCounter(pool.mQueries[zone.mQuery + 1], GL_TIMESTAMP);
+		zone.mCpuMs = std::chrono::duration<f32, std::milli>(Clock::now() - zone.mCpuStart).count();
+		gStack.pop_back();
+	}
+
+	bool GetSpanMs(const char* inFirst, const char* inLast, f32* outMs, u32* outFrame)
+	{
+		u64 begin = 0;
+		u64 end = 0;
+		bool foundFirst = false;
+		bool foundLast = false;
+		for (const ReadZone& zone : gReadZones)
+		{
+			const std::string& name = gStats[zone.mStats].mName;
+			if (!foundFirst && name == inFirst)
+			{
+				begin = zone.mBegin;
+				foundFirst = true;
+			}
+			// the last one after the first
+			if (foundFirst && name == inLast)
+			{
+				end = zone.mEnd;
+				foundLast = true;
+			}
+		}
+
+		if (!foundLast)
+			return false;
+
+		*outMs = (f32)(end - begin) / 1000000.0f;
+		*outFrame = gReadFrame;
+		return true;
+	}
+
+	/// @brief A row of the stats and its children, the new zones are appended wherever their parent is.
+	static void drawRows(u32 inParent, f32* ioTotalMs, f32* ioTotalAverageMs)
+	{
+		for (u32 index = 0; index < gStats.size(); index++)
+		{
+			const ZoneStats& stats = gStats[index];
+			if (stats.mParent != inParent || stats.mLastFrame != gReadFrame)
+				continue;
+
+			const u32 count = stats.mHistoryCount < kHistoryLength ? stats.mHistoryCount : kHistoryLength;
+			f32 averageMs = 0.0f;
+			f32 maxMs = 0.0f;
+			for (u32 i = 0; i < count; i++)
+			{
+				averageMs += stats.mHistory[i];
+				maxMs = stats.mHistory[i] > maxMs ? stats.mHistory[i] : maxMs;
+			}
+			averageMs /= (f32)(count > 0 ? count : 1);
+
+			if (stats.mDepth == 0)
+			{
+				*ioTotalMs += stats.mFrameMs;
+				*ioTotalAverageMs += averageMs;
+			}
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%*s%s", (i32)(2 * stats.mDepth), "", stats.mName.c_str());
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stats.mFrameMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", averageMs);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", maxMs);
+
+			drawRows(index, ioTotalMs, ioTotalAverageMs);
+		}
+	}
+
+	void DrawUI()
+	{
+		if (gReadFrame == UINT32_MAX)
+		{
+			ImGui::TextDisabled("No frame was read yet.");
+			return;
+		}
+
+		f32 totalMs = 0.0f;
+		f32 totalAverageMs = 0.0f;
+
+		const ImGuiTableFlags flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders;
+		if (ImGui::BeginTable("GPU Zones", 4, flags))
+		{
+			ImGui::TableSetupColumn("Zone");
+			ImGui::TableSetupColumn("Last (ms)");
+			ImGui::TableSetupColumn("Average (ms)");
+			ImGui::TableSetupColumn("Max (ms)");
+			ImGui::TableHeadersRow();
+			drawRows(UINT32_MAX, &totalMs, &totalAverageMs);
+			ImGui::EndTable();
+		}
+
+		// the top level zones don't overlap, the time between them isn't counted
+		ImGui::Text("Zones: %.3f ms (%.3f ms average over %u frames)", totalMs, totalAverageMs, kHistoryLength);
+		if (gDroppedFrames > 0)
+			ImGui::Text("Frames dropped, the GPU was behind: %u", gDroppedFrames);
+	}
+
+	void SetFrameCallback(FrameFn inCallback)
+	{
+		gFrameCallback = std::move(inCallback);
+	}
+
+	void ResetTotals()
+	{
+		for (ZoneStats& stats : gStats)
+		{
+			stats.mTotalMs		= 0.0;
+			stats.mMinMs		= 0.0f;
+			stats.mMaxMs		= 0.0f;
+			stats.mTotalFrames	= 0;
+		}
+		gDroppedFrames = 0;
+	}
+
+	static void printRows(FILE* ioFile, u32 inParent, f64* ioTotalAverageMs)
+	{
+		for (u32 index = 0; index < gStats.size(); index++)
+		{
+			const ZoneStats& stats = gStats[index];
+			if (stats.mParent != inParent || stats.mTotalFrames == 0)
+				continue;
+
+			const f64 averageMs = stats.mTotalMs / stats.mTotalFrames;
+			if (stats.mDepth == 0)
+				*ioTotalAverageMs += averageMs;
+
+			fprintf(ioFile, "%*s%-*s %10.3f %10.3f %10.3f %8u\n", (i32)(2 * stats.mDepth), "",
+				(i32)(40 - 2 * stats.mDepth), stats.mName.c_str(), averageMs, stats.mMinMs, stats.mMaxMs, stats.mTotalFrames);
+
+			printRows(ioFile, index, ioTotalAverageMs);
+		}
+	}
+
+	void PrintReport(FILE* ioFile)
+	{
+		fprintf(ioFile, "%-40s %10s %10s %10s %8s\n", "Zone", "Avg (ms)", "Min (ms)", "Max (ms)", "Frames");
+
+		f64 totalAverageMs = 0.0;
+		printRows(ioFile, UINT32_MAX, &totalAverageMs);
+
+		fprintf(ioFile, "%-40s %10.3f\n", "Zones", totalAverageMs);
+		if (gDroppedFrames > 0)
+			fprintf(ioFile, "Frames dropped, the GPU was behind: %u\n", gDroppedFrames);
+	}
+}
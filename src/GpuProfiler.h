@@ -0,0 +1,67 @@
+#pragma once
+
+#include "defines.h"
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief GPU time of the GL_ZONE() scopes. Every zone writes a GL_TIMESTAMP query at its start and
+ * end into the query pool of the frame, there is a pool per frame of the last kGpuTimerLatency
+ * frames. A pool is read when its frame comes around again, so the CPU never waits on the GPU.
+ *
+ * The zones are also sent to Tracy as GPU zones when it's enabled. The timings are kept per zone
+ * name with a rolling average and shown by DrawUI(). The CPU time of every zone is measured too,
+ * it's the time spent recording its commands.
+ */
+namespace GpuProfiler
+{
+	/// @brief The timings of a zone in a frame, the zones with the same path are summed.
+	struct FrameZone
+	{
+		/// @brief The names of the enclosing zones and the zone, separated by '/'. Valid until the callback returns.
+		const char*	mPath;
+		f32			mGpuMs;
+		f32			mCpuMs;
+	};
+
+	/// @brief Receives the zones of every frame read, parents before their children.
+	using FrameFn = std::function<void(const std::vector<FrameZone>& inZones)>;
+
+	/// @brief Needs the GL context.
+	void	StartUp();
+	void	ShutDown();
+
+	/// @brief Call after the buffers are swapped, the frame whose pool comes next is read.
+	void	NewFrame();
+	/// @brief The frame the zones are recorded in, counted by NewFrame().
+	u32		GetFrame();
+	/// @brief Wait on the GPU and read every frame still in flight, e.g. before PrintReport().
+	void	Flush();
+
+	/**
+	 * @brief Use GL_ZONE() and GL_ZONE_END(), which also push the debug groups.
+	 * @param inName Must outlive the frame, the zones keep the pointer until they're read.
+	 */
+	void	BeginZone(const char* inName, const char* inFile, u32 inLine);
+	void	EndZone();
+
+	/**
+	 * @brief The GPU time from the start of a top level zone to the end of another in the last frame read,
+	 * e.g. of a run of passes. The same zone twice is its own time.
+	 * @param outFrame The frame the zones were recorded in, see GetFrame().
+	 * @return false if no frame was read yet or it doesn't have the zones.
+	 */
+	bool	GetSpanMs(const char* inFirst, const char* inLast, f32* outMs, u32* outFrame);
+
+	/// @brief A table of the zones of the last frame read, nested zones are indented.
+	void	DrawUI();
+
+	/// @brief An empty callback stops the calls.
+	void	SetFrameCallback(FrameFn inCallback);
+
+	/// @brief Forget the totals of PrintReport(), e.g. after warming up.
+	void	ResetTotals();
+	/// @brief The average, min and max time of every zone over the frames read since ResetTotals().
+	void	PrintReport(FILE* ioFile);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * @brief A typed reference to a slot of a resource table. The generation is
+ * compared with the slot's generation on every access so a handle to a released
+ * resource is detected instead of silently aliasing the slot's new resource.
+ */
+template <typename T>
+struct Handle
+{
+	bool	IsValid() const { return mGeneration != 0; }
+
+	bool	operator==(const Handle& inOther) const { return mIndex == inOther.mIndex && mGeneration == inOther.mGeneration; }
+	bool	operator!=(const Handle& inOther) const { return !(*this == inOther); }
+
+	u32		mIndex		= UINT32_MAX;
+	u32		mGeneration	= 0; ///< Live slots never have a generation of 0.
+};
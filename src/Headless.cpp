@@ -0,0 +1,679 @@
+#include "Headless.h"
+
+#include "Benchmark.h"
+#include "DebugDraw.h"
+#include "Geom.h"
+#include "GLState.h"
+#include "GpuProfiler.h"
+#include "Memory.h"
+#include "Physics.h"
+#include "Renderer.h"
+#include "ResourceManager.h"
+#include "Shader.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <glad/glad.h>
+#ifdef __linux__
+	#include <EGL/egl.h>
+	#include <EGL/eglext.h>
+#else
+	#define GLFW_INCLUDE_NONE
+	#include <GLFW/glfw3.h>
+#endif
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <tracy/Tracy.hpp>
+
+using Clock = std::chrono::steady_clock;
+
+namespace Headless
+{
+	sconst f32 kOrbitRadius = 8.0f;
+	sconst f32 kOrbitHeight = 3.0f;
+	/// @brief The circle the dynamic model moves on around where it was loaded, and the seconds per turn.
+	sconst f32 kDynamicRadius = 2.0f;
+	sconst f32 kDynamicPeriod = 4.0f;
+
+	struct Context
+	{
+#ifdef __linux__
+		EGLDisplay	mDisplay = EGL_NO_DISPLAY;
+		EGLContext	mContext = EGL_NO_CONTEXT;
+#else
+		GLFWwindow*	mWindow = nullptr;
+#endif
+	};
+
+	static bool parseU32(const char* inArg, u32* outValue)
+	{
+		char* end = nullptr;
+		const unsigned long value = strtoul(inArg, &end, 10);
+		if (end == inArg || *end != '\0')
+			return false;
+		*outValue = (u32)value;
+		return true;
+	}
+
+	bool ParseArgs(i32 inArgc, char** inArgv, Options* outOptions)
+	{
+		bool headless = false;
+		for (i32 i = 1; i < inArgc; i++)
+		{
+			const char* arg = inArgv[i];
+			// every option but the flags takes a value
+			const char* value = i + 1 < inArgc ? inArgv[i + 1] : nullptr;
+
+			if (strcmp(arg, "--headless") == 0)
+			{
+				headless = true;
+				continue;
+			}
+			if (strcmp(arg, "--physics") == 0)
+			{
+				outOptions->mEnablePhysics = true;
+				continue;
+			}
+			if (strcmp(arg, "--state-stats") == 0)
+			{
+				outOptions->mCountStateCalls = true;
+				continue;
+			}
+			if (strcmp(arg, "--no-state-filter") == 0)
+			{
+				outOptions->mFilterState = false;
+				continue;
+			}
+
+			if (!value)
+			{
+				printf("ERROR(Headless): \"%s\" needs a value.\n", arg);
+				continue;
+			}
+
+			bool valid = true;
+			if (strcmp(arg, "--frames") == 0)
+				valid = parseU32(value, &outOptions->mFrames) && outOptions->mFrames > 0;
+			else if (strcmp(arg, "--warmup") == 0)
+				valid = parseU32(value, &outOptions->mWarmUpFrames);
+			else if (strcmp(arg, "--size") == 0)
+				valid = sscanf(value, "%ux%u", &outOptions->mWidth, &outOptions->mHeight) == 2 && outOptions->mWidth > 0 && outOptions->mHeight > 0;
+			else if (strcmp(arg, "--model") == 0)
+				outOptions->mModelPath = value;
+			else if (strcmp(arg, "--dynamic-model") == 0)
+				outOptions->mDynamicModelPath = value;
+			else if (strcmp(arg, "--camera") == 0)
+				outOptions->mCameraPath = value;
+			else if (strcmp(arg, "--png") == 0)
+				outOptions->mPngPrefix = value;
+			else if (strcmp(arg, "--png-interval") == 0)
+				valid = parseU32(value, &outOptions->mPngInterval);
+			else if (strcmp(arg, "--benchmark") == 0)
+			{
+				outOptions->mManifestPath = value;
+				headless = true;
+			}
+			else if (strcmp(arg, "--report") == 0)
+				outOptions->mReportPath = value;
+			else if (strcmp(arg, "--baseline") == 0)
+				outOptions->mBaselinePath = value;
+			else if (strcmp(arg, "--threshold") == 0)
+				valid = sscanf(value, "%f", &outOptions->mRegressionThreshold) == 1 && outOptions->mRegressionThreshold >= 0.0f;
+			else
+			{
+				printf("ERROR(Headless): Unknown argument \"%s\".\n", arg);
+				continue;
+			}
+
+			if (!valid)
+				printf("ERROR(Headless): Invalid value \"%s\" for \"%s\".\n", value, arg);
+			i++;
+		}
+		return headless;
+	}
+
+	/// @brief A full orbit of the origin over inDuration, the path without a track.
+	static Benchmark::TrackFrame orbitFrame(f32 inTime, f32 inDuration)
+	{
+		const f32 angle = glm::two_pi<f32>() * inTime / inDuration;
+		Benchmark::TrackFrame frame{};
+		frame.mTime		= inTime;
+		frame.mPos		= glm::vec3(cos(angle) * kOrbitRadius, kOrbitHeight, sin(angle) * kOrbitRadius);
+		// facing the origin
+		frame.mYaw		= glm::degrees(angle) + 180.0f;
+		frame.mPitch	= 0.0f;
+		return frame;
+	}
+
+	/// @param inLoadedTransforms The instance transforms of every mesh as the model was loaded.
+	static void moveDynamicModel(Geom::Model* ioModel, const std::vector<std::vector<glm::mat4>>& inLoadedTransforms, f32 inTime)
+	{
+		const f32 angle = glm::two_pi<f32>() * inTime / kDynamicPeriod;
+		const glm::mat4 offset = glm::translate(glm::mat4(1.0f), glm::vec3(cos(angle), 0.0f, sin(angle)) * kDynamicRadius);
+		for (u32 i = 0; i < ioModel->mMeshes.size(); i++)
+		{
+			Geom::Mesh& mesh = ioModel->mMeshes[i];
+			for (u32 j = 0; j < mesh.mInstanceTransforms.size(); j++)
+				mesh.mInstanceTransforms[j] = offset * inLoadedTransforms[i][j];
+			mesh.UploadInstances();
+		}
+	}
+
+	static void applyTrackFrame(const Benchmark::TrackFrame& inFrame, Camera* ioCamera)
+	{
+		ioCamera->mPos		= inFrame.mPos;
+		ioCamera->mYaw		= inFrame.mYaw;
+		ioCamera->mPitch	= glm::clamp(inFrame.mPitch, -89.0f, 89.0f);
+
+		glm::vec3 front{};
+		front.x = cos(glm::radians(ioCamera->mYaw)) * cos(glm::radians(ioCamera->mPitch));
+		front.y = sin(glm::radians(ioCamera->mPitch));
+		front.z = sin(glm::radians(ioCamera->mYaw)) * cos(glm::radians(ioCamera->mPitch));
+		ioCamera->mFront = glm::normalize(front);
+		ioCamera->mView = glm::lookAt(ioCamera->mPos, ioCamera->mPos + ioCamera->mFront, ioCamera->mUp);
+	}
+
+#ifdef __linux__
+	static bool createContext(u32 inWidth, u32 inHeight, Context* outContext)
+	{
+		(void)inWidth;
+		(void)inHeight;
+
+		// surfaceless needs no display server, the default display is the fallback
+		auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay)
+			outContext->mDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (outContext->mDisplay == EGL_NO_DISPLAY)
+			outContext->mDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+		EGLint major = 0;
+		EGLint minor = 0;
+		if (outContext->mDisplay == EGL_NO_DISPLAY || !eglInitialize(outContext->mDisplay, &major, &minor))
+		{
+			puts("ERROR(Headless): Failed to initialize EGL.");
+			return false;
+		}
+
+		if (!eglBindAPI(EGL_OPENGL_API))
+		{
+			puts("ERROR(Headless): EGL doesn't support desktop OpenGL.");
+			return false;
+		}
+
+		const EGLint configAttribs[] = {
+			EGL_RENDERABLE_TYPE,	EGL_OPENGL_BIT,
+			EGL_NONE,
+		};
+		EGLConfig config = nullptr;
+		EGLint configCount = 0;
+		if (!eglChooseConfig(outContext->mDisplay, configAttribs, &config, 1, &configCount) || configCount == 0)
+		{
+			puts("ERROR(Headless): No EGL config supports OpenGL.");
+			return false;
+		}
+
+		// software GL (e.g. llvmpipe) may stop at 4.5, the shaders are lowered to the context's version
+		for (EGLint version : { 6, 5 })
+		{
+			const EGLint contextAttribs[] = {
+				EGL_CONTEXT_MAJOR_VERSION,			4,
+				EGL_CONTEXT_MINOR_VERSION,			version,
+				EGL_CONTEXT_OPENGL_PROFILE_MASK,	EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+				EGL_NONE,
+			};
+			outContext->mContext = eglCreateContext(outContext->mDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+			if (outContext->mContext != EGL_NO_CONTEXT)
+				break;
+		}
+		if (outContext->mContext == EGL_NO_CONTEXT)
+		{
+			puts("ERROR(Headless): Failed to create an OpenGL 4.5 core context.");
+			return false;
+		}
+
+		if (!eglMakeCurrent(outContext->mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, outContext->mContext))
+		{
+			puts("ERROR(Headless): Failed to make the context current, EGL_KHR_surfaceless_context is required.");
+			return false;
+		}
+
+		if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+		{
+			puts("ERROR(Headless): Failed to initialize GLAD.");
+			return false;
+		}
+		ShaderProgram::SetProcLoader((void* (*)(const char*))eglGetProcAddress);
+		return true;
+	}
+
+	static void destroyContext(Context* ioContext)
+	{
+		if (ioContext->mDisplay == EGL_NO_DISPLAY)
+			return;
+
+		eglMakeCurrent(ioContext->mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (ioContext->mContext != EGL_NO_CONTEXT)
+			eglDestroyContext(ioContext->mDisplay, ioContext->mContext);
+		eglTerminate(ioContext->mDisplay);
+		*ioContext = {};
+	}
+#else
+	static bool createContext(u32 inWidth, u32 inHeight, Context* outContext)
+	{
+		if (!glfwInit())
+		{
+			puts("ERROR(Headless): Failed to initialize GLFW.");
+			return false;
+		}
+
+		// a window is needed for the context, it's never shown
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		outContext->mWindow = glfwCreateWindow(inWidth, inHeight, "Renderer (Headless)", nullptr, nullptr);
+		if (!outContext->mWindow)
+		{
+			puts("ERROR(Headless): Failed to create the hidden GLFW window.");
+			return false;
+		}
+		glfwMakeContextCurrent(outContext->mWindow);
+
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		{
+			puts("ERROR(Headless): Failed to initialize GLAD.");
+			return false;
+		}
+		return true;
+	}
+
+	static void destroyContext(Context* ioContext)
+	{
+		if (ioContext->mWindow)
+			glfwDestroyWindow(ioContext->mWindow);
+		glfwTerminate();
+		*ioContext = {};
+	}
+#endif
+
+	static u32 crc32(const u8* inData, usize inSize, u32 inCrc)
+	{
+		static u32 table[256] = {};
+		if (table[1] == 0)
+		{
+			for (u32 i = 0; i < 256; i++)
+			{
+				u32 c = i;
+				for (u32 k = 0; k < 8; k++)
+					c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				table[i] = c;
+			}
+		}
+
+		u32 crc = ~inCrc;
+		for (usize i = 0; i < inSize; i++)
+			crc = table[(crc ^ inData[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	static void appendU32(std::vector<u8>* ioBytes, u32 inValue)
+	{
+		ioBytes->push_back((u8)(inValue >> 24));
+		ioBytes->push_back((u8)(inValue >> 16));
+		ioBytes->push_back((u8)(inValue >> 8));
+		ioBytes->push_back((u8)inValue);
+	}
+
+	static void appendChunk(std::vector<u8>* ioBytes, const char* inType, const std::vector<u8>& inData)
+	{
+		appendU32(ioBytes, (u32)inData.size());
+		const usize start = ioBytes->size();
+		ioBytes->insert(ioBytes->end(), inType, inType + 4);
+		ioBytes->insert(ioBytes->end(), inData.begin(), inData.end());
+		appendU32(ioBytes, crc32(ioBytes->data() + start, ioBytes->size() - start, 0));
+	}
+
+	/**
+	 * @brief An RGBA8 PNG with stored (uncompressed) deflate blocks, so no image library is
+	 * needed. inPixels are bottom up like glReadPixels() returns them.
+	 */
+	static bool writePng(const char* inPath, const u8* inPixels, u32 inWidth, u32 inHeight)
+	{
+		const usize rowSize = (usize)inWidth * 4;
+
+		// every row starts with its filter type, 0 is none
+		std::vector<u8> raw;
+		raw.reserve((rowSize + 1) * inHeight);
+		for (u32 y = 0; y < inHeight; y++)
+		{
+			const u8* row = inPixels + (inHeight - 1 - y) * rowSize;
+			raw.push_back(0);
+			raw.insert(raw.end(), row, row + rowSize);
+		}
+
+		std::vector<u8> idat = { 0x78, 0x01 };
+		u32 adlerA = 1;
+		u32 adlerB = 0;
+		for (usize offset = 0; offset < raw.size(); offset += 0xFFFF)
+		{
+			const u16 size = (u16)(raw.size() - offset < 0xFFFF ? raw.size() - offset : 0xFFFF);
+			idat.push_back(offset + size == raw.size() ? 1 : 0);
+			idat.push_back((u8)size);
+			idat.push_back((u8)(size >> 8));
+			idat.push_back((u8)~size);
+			idat.push_back((u8)(~size >> 8));
+			idat.insert(idat.end(), raw.begin() + offset, raw.begin() + offset + size);
+
+			for (usize i = offset; i < offset + size; i++)
+			{
+				adlerA = (adlerA + raw[i]) % 65521;
+				adlerB = (adlerB + adlerA) % 65521;
+			}
+		}
+		appendU32(&idat, (adlerB << 16) | adlerA);
+
+		std::vector<u8> ihdr;
+		appendU32(&ihdr, inWidth);
+		appendU32(&ihdr, inHeight);
+		// 8 bits per channel, RGBA, deflate, adaptive filters, not interlaced
+		ihdr.insert(ihdr.end(), { 8, 6, 0, 0, 0 });
+
+		std::vector<u8> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		appendChunk(&png, "IHDR", ihdr);
+		appendChunk(&png, "IDAT", idat);
+		appendChunk(&png, "IEND", {});
+
+		FILE* file = fopen(inPath, "wb");
+		if (!file)
+		{
+			printf("ERROR(Headless): Failed to open \"%s\" for writing.\n", inPath);
+			return false;
+		}
+		const bool written = fwrite(png.data(), 1, png.size(), file) == png.size();
+		fclose(file);
+		return written;
+	}
+
+	static void saveFrame(u32 inFBO, u32 inWidth, u32 inHeight, const char* inPrefix, u32 inFrame)
+	{
+		std::vector<u8> pixels((usize)inWidth * inHeight * 4);
+		GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, inFBO);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, inWidth, inHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+		// the alpha of the frame isn't coverage, keep the image opaque
+		for (usize i = 3; i < pixels.size(); i += 4)
+			pixels[i] = 255;
+
+		char path[512] = {'\0'};
+		snprintf(path, sizeof(path), "%s_%04u.png", inPrefix, inFrame);
+		if (writePng(path, pixels.data(), inWidth, inHeight))
+			printf("Headless: Wrote \"%s\".\n", path);
+	}
+
+	/**
+	 * @brief Render the warm up and the timed frames, the timings of the timed frames go to the report.
+	 * The physics is only stepped with inPhysics, the camera always follows the track.
+	 */
+	static void renderFrames(const Options& inOptions, const std::vector<Benchmark::TrackFrame>& inTrack, Renderer* ioRenderer,
+		Physics* ioPhysics, Geom::Model* ioDynamicModel, u32 inOutputFBO, Benchmark::Report* ioReport)
+	{
+		// the GPU timings are read kGpuTimerLatency frames late, the warm up is flushed before timing
+		bool timing = false;
+		GpuProfiler::SetFrameCallback([ioReport, &timing](const std::vector<GpuProfiler::FrameZone>& inZones) {
+			if (!timing)
+				return;
+
+			// the top level zones don't overlap
+			f32 gpuMs = 0.0f;
+			for (const GpuProfiler::FrameZone& zone : inZones)
+				gpuMs += strchr(zone.mPath, '/') ? 0.0f : zone.mGpuMs;
+			Benchmark::AddSample(ioReport, "frame:gpu", gpuMs);
+
+			for (const GpuProfiler::FrameZone& zone : inZones)
+			{
+				Benchmark::AddSample(ioReport, (std::string("gpu:") + zone.mPath).c_str(), zone.mGpuMs);
+				Benchmark::AddSample(ioReport, (std::string("cpu:") + zone.mPath).c_str(), zone.mCpuMs);
+			}
+		});
+
+		Camera camera;
+		camera.UpdateProjection(inOptions.mWidth, inOptions.mHeight);
+
+		std::vector<std::vector<glm::mat4>> loadedTransforms;
+		if (ioDynamicModel)
+		{
+			for (const Geom::Mesh& mesh : ioDynamicModel->mMeshes)
+				loadedTransforms.push_back(mesh.mInstanceTransforms);
+		}
+
+		const u32 frameCount = inOptions.mWarmUpFrames + inOptions.mFrames;
+		const f32 duration = inOptions.mFrames * inOptions.mDeltaTime;
+		Clock::time_point timedStart = Clock::now();
+		for (u32 frame = 0; frame < frameCount; frame++)
+		{
+			if (frame == inOptions.mWarmUpFrames)
+			{
+				GpuProfiler::Flush();
+				GpuProfiler::ResetTotals();
+				GLState::SetInstrumented(inOptions.mCountStateCalls);
+				timing = true;
+				timedStart = Clock::now();
+			}
+
+			// the frames are a fixed step apart, the camera holds its first pose while warming up
+			const u32 timedFrame = frame < inOptions.mWarmUpFrames ? 0 : frame - inOptions.mWarmUpFrames;
+			const f32 trackTime = timedFrame * inOptions.mDeltaTime;
+			const Benchmark::TrackFrame trackFrame = inTrack.empty() ? orbitFrame(trackTime, duration) : Benchmark::SampleTrack(inTrack, trackTime);
+			applyTrackFrame(trackFrame, &camera);
+
+			const Clock::time_point frameStart = Clock::now();
+			if (inOptions.mEnablePhysics)
+			{
+				ZoneScopedN("Physics");
+				ioPhysics->UpdateCharacter(inOptions.mDeltaTime, trackFrame.mMovement);
+				ioPhysics->Update(inOptions.mDeltaTime);
+			}
+			const Clock::time_point renderStart = Clock::now();
+			// moves every frame, the warm up included, so the static cascade cache is built with it moving
+			if (ioDynamicModel)
+				moveDynamicModel(ioDynamicModel, loadedTransforms, frame * inOptions.mDeltaTime);
+			ioRenderer->SetCamera(camera);
+			ioRenderer->Render(inOptions.mDeltaTime, frame * inOptions.mDeltaTime);
+			GpuProfiler::NewFrame();
+			GLState::NewFrame();
+			FrameMark;
+			const Clock::time_point frameEnd = Clock::now();
+
+			if (frame < inOptions.mWarmUpFrames)
+				continue;
+
+			Benchmark::AddSample(ioReport, "frame:cpu", std::chrono::duration<f32, std::milli>(frameEnd - frameStart).count());
+			if (inOptions.mEnablePhysics)
+				Benchmark::AddSample(ioReport, "cpu:Physics", std::chrono::duration<f32, std::milli>(renderStart - frameStart).count());
+
+			const bool lastFrame = timedFrame + 1 == inOptions.mFrames;
+			const bool interval = inOptions.mPngInterval > 0 && timedFrame % inOptions.mPngInterval == 0;
+			if (inOptions.mPngPrefix && (lastFrame || interval))
+				saveFrame(inOutputFBO, inOptions.mWidth, inOptions.mHeight, inOptions.mPngPrefix, timedFrame);
+		}
+
+		GpuProfiler::Flush();
+		GpuProfiler::SetFrameCallback(nullptr);
+		const f64 wallSeconds = std::chrono::duration<f64>(Clock::now() - timedStart).count();
+
+		printf("\nHeadless: %u frames at %ux%u (%u warm up frames), %.3f s (%.2f frames per second).\n",
+			inOptions.mFrames, inOptions.mWidth, inOptions.mHeight, inOptions.mWarmUpFrames, wallSeconds, inOptions.mFrames / wallSeconds);
+		GpuProfiler::PrintReport(stdout);
+		if (inOptions.mCountStateCalls)
+		{
+			GLState::PrintReport(stdout);
+			GLState::SetInstrumented(false);
+		}
+		for (const char* name : { "frame:cpu", "frame:gpu" })
+		{
+			for (const Benchmark::Series& series : ioReport->mSeries)
+			{
+				if (series.mName != name)
+					continue;
+				const Benchmark::Summary summary = Benchmark::Summarize(series.mSamples);
+				printf("%s (ms): %.3f p50, %.3f p95, %.3f p99, %.3f max\n", name, summary.mP50, summary.mP95, summary.mP99, summary.mMax);
+			}
+		}
+	}
+
+	i32 Run(const Options& inOptions)
+	{
+		Options options = inOptions;
+		Benchmark::Manifest manifest;
+		if (options.mManifestPath)
+		{
+			if (!Benchmark::LoadManifest(options.mManifestPath, &manifest))
+				return 1;
+			options.mModelPath		= manifest.mModelPath.c_str();
+			options.mCameraPath		= manifest.mTrackPath.c_str();
+			options.mWidth			= manifest.mWidth;
+			options.mHeight			= manifest.mHeight;
+			options.mWarmUpFrames	= manifest.mWarmUpFrames;
+			options.mDeltaTime		= manifest.mDeltaTime;
+			options.mEnablePhysics	= manifest.mEnablePhysics;
+		}
+
+		std::vector<Benchmark::TrackFrame> track;
+		if (options.mCameraPath && !Benchmark::LoadTrack(options.mCameraPath, &track))
+			return 1;
+		// a manifest times the whole track unless it says otherwise
+		if (options.mManifestPath)
+			options.mFrames = manifest.mFrames > 0 ? manifest.mFrames : (u32)(track.back().mTime / options.mDeltaTime) + 1;
+
+		Context context;
+		if (!createContext(options.mWidth, options.mHeight, &context))
+		{
+			destroyContext(&context);
+			return 1;
+		}
+		printf("Headless: %s, %s.\n", (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+
+		// the frame graph ends in this instead of the window
+		u32 outputFBO = 0;
+		u32 outputTextures[2] = {};
+		glCreateFramebuffers(1, &outputFBO);
+		glCreateTextures(GL_TEXTURE_2D, 2, outputTextures);
+		GL_LABEL(GL_TEXTURE, outputTextures[0], "Headless Color");
+		GL_LABEL(GL_TEXTURE, outputTextures[1], "Headless Depth");
+		glTextureStorage2D(outputTextures[0], 1, GL_RGBA8, options.mWidth, options.mHeight);
+		// the debug draw depth is copied from the G-buffer depth, the formats must match
+		glTextureStorage2D(outputTextures[1], 1, GL_DEPTH_COMPONENT24, options.mWidth, options.mHeight);
+		glNamedFramebufferTexture(outputFBO, GL_COLOR_ATTACHMENT0, outputTextures[0], 0);
+		glNamedFramebufferTexture(outputFBO, GL_DEPTH_ATTACHMENT, outputTextures[1], 0);
+		if (glCheckNamedFramebufferStatus(outputFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			puts("ERROR(Headless): Failed to create the output framebuffer.");
+			GLState::DeleteFramebuffers(1, &outputFBO);
+			GLState::DeleteTextures(2, outputTextures);
+			destroyContext(&context);
+			return 1;
+		}
+
+		// the physics class must be instanced after jolt default allocators
+		// are registered
+		Physics::Ready();
+		Physics* physics = Mem::AllocT<Physics>(EMemSource::Physics);
+		Renderer* renderer = Mem::AllocT<Renderer>(EMemSource::RendererRAM);
+
+		Camera camera;
+		camera.UpdateProjection(options.mWidth, options.mHeight);
+
+		GLState::SetFiltering(options.mFilterState);
+		renderer->mOutputFBO = outputFBO;
+		renderer->StartUp(options.mWidth, options.mHeight, nullptr);
+		renderer->SetCamera(camera);
+		gDebugDraw.StartUp();
+		Geom::StartUp();
+		physics->StartUp();
+		renderer->mJobSystem = physics->mJobSystem;
+
+		i32 exitCode = 0;
+		Geom::Model* model = ResMgr::GetModel(options.mModelPath);
+		if (!model)
+		{
+			printf("ERROR(Headless): Failed to load \"%s\".\n", options.mModelPath);
+			exitCode = 1;
+		} else if (model->mPointLights.size() > FrameLightsUniforms::kMaxPointLights)
+		{
+			printf("ERROR(Headless): \"%s\" has %zu point lights, at most %u are supported.\n",
+				options.mModelPath, model->mPointLights.size(), FrameLightsUniforms::kMaxPointLights);
+			exitCode = 1;
+		}
+
+		Geom::Model* dynamicModel = nullptr;
+		if (exitCode == 0 && options.mDynamicModelPath)
+		{
+			dynamicModel = ResMgr::GetModel(options.mDynamicModelPath);
+			if (!dynamicModel)
+			{
+				printf("ERROR(Headless): Failed to load \"%s\".\n", options.mDynamicModelPath);
+				exitCode = 1;
+			}
+		}
+
+		if (exitCode == 0)
+		{
+			for (Geom::Mesh& mesh : model->mMeshes)
+			{
+				renderer->mMeshes.push_back(&mesh);
+				if (SoftOcclusion::IsOccluderCandidate(mesh))
+					renderer->mOccluderMeshes.push_back(&mesh);
+			}
+			for (Geom::PointLight& light : model->mPointLights)
+				renderer->mPointLights.push_back(&light);
+			// only the static meshes are occluders
+			if (dynamicModel)
+			{
+				for (Geom::Mesh& mesh : dynamicModel->mMeshes)
+					renderer->mDynamicMeshes.push_back(&mesh);
+			}
+			if (options.mEnablePhysics)
+				physics->AddModel(*model);
+
+			Benchmark::Report report;
+			report.mName		= options.mManifestPath ? manifest.mName : "headless";
+			report.mRenderer	= (const char*)glGetString(GL_RENDERER);
+			report.mWidth		= options.mWidth;
+			report.mHeight		= options.mHeight;
+			report.mFrames		= options.mFrames;
+			report.mDeltaTime	= options.mDeltaTime;
+			renderFrames(options, track, renderer, physics, dynamicModel, outputFBO, &report);
+
+			if (options.mReportPath && !Benchmark::WriteReport(report, options.mReportPath))
+				exitCode = 1;
+			if (options.mBaselinePath)
+			{
+				const i32 regressions = Benchmark::Compare(report, options.mBaselinePath, options.mRegressionThreshold);
+				exitCode = regressions < 0 ? 1 : (regressions > 0 ? 2 : exitCode);
+			}
+		}
+
+		if (dynamicModel)
+			ResMgr::ReleaseModel(dynamicModel);
+		if (model)
+			ResMgr::ReleaseModel(model);
+
+		physics->ShutDown();
+		renderer->ShutDown();
+		Mem::FreeT<Physics>(physics, EMemSource::Physics);
+		Mem::FreeT<Renderer>(renderer, EMemSource::RendererRAM);
+
+		ResMgr::ShutDown();
+		Geom::ShutDown();
+		gDebugDraw.ShutDown();
+
+		GLState::DeleteFramebuffers(1, &outputFBO);
+		GLState::DeleteTextures(2, outputTextures);
+		destroyContext(&context);
+		return exitCode;
+	}
+}
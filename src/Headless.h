@@ -0,0 +1,64 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * @brief Rendering without a window, for benchmarks on machines without a display. On Linux
+ * the context is EGL surfaceless, which software GL (llvmpipe) supports, elsewhere a hidden
+ * GLFW window. A fixed number of frames is rendered along a scripted camera path into an
+ * offscreen framebuffer at the end of the frame graph, then the GPU time of every pass is printed.
+ * The timings can be written as a benchmark report and compared with a baseline, see Benchmark.
+ */
+namespace Headless
+{
+	struct Options
+	{
+		u32			mWidth = 1280;
+		u32			mHeight = 720;
+		/// @brief The frames that are timed, after the warm up.
+		u32			mFrames = 300;
+		/// @brief Frames rendered before the timings are kept, while the shaders and caches settle.
+		u32			mWarmUpFrames = 16;
+		/// @brief The time step of every frame in seconds, so the frames don't depend on how fast they render.
+		f32			mDeltaTime = 1.0f / 60.0f;
+		const char*	mModelPath = "res/models/sponza2/sponza2.gltf";
+		/// @brief A model moved on a circle every frame, its meshes are the Renderer's dynamic meshes.
+		const char*	mDynamicModelPath = nullptr;
+		/// @brief A track to replay, see Benchmark::LoadTrack(). Null orbits the origin.
+		const char*	mCameraPath = nullptr;
+		/// @brief Step the physics with the movement of the track, the camera follows the track either way.
+		bool		mEnablePhysics = false;
+		/// @brief Frames are written to `<prefix>_<frame>.png`, null writes none.
+		const char*	mPngPrefix = nullptr;
+		/// @brief Write every Nth timed frame, 0 only writes the last.
+		u32			mPngInterval = 0;
+		/// @brief Count the GL state calls of the timed frames and print how many were redundant, see GLState.
+		bool		mCountStateCalls = false;
+		/// @brief Whether the redundant GL state calls are dropped, off to time them.
+		bool		mFilterState = true;
+
+		/// @brief A benchmark manifest, it replaces the scene, track, size, time step and frame options.
+		const char*	mManifestPath = nullptr;
+		/// @brief Where the report is written, CSV if it ends with `.csv` and JSON otherwise.
+		const char*	mReportPath = nullptr;
+		/// @brief A report to compare with, the exit code is 2 if a series regressed.
+		const char*	mBaselinePath = nullptr;
+		/// @brief In percent, see Benchmark::Compare().
+		f32			mRegressionThreshold = 5.0f;
+	};
+
+	/**
+	 * @brief `--headless [--frames N] [--warmup N] [--size WxH] [--model path] [--dynamic-model path] [--camera path]
+	 * [--physics] [--png prefix] [--png-interval N] [--state-stats] [--no-state-filter] [--report path]
+	 * [--baseline path] [--threshold percent]`, or `--benchmark manifest` in place of --headless.
+	 * - `--dynamic-model` Add a model which moves, so the cached shadow cascades composite it over the static ones.
+	 * - `--state-stats` Count the GL state calls of the timed frames and print the redundant ones, see GLState.
+	 * - `--no-state-filter` Let the redundant GL state calls reach GL, to time them against a filtered run.
+	 *
+	 * `--test-frame-graph` is handled by main() before these, see FrameGraph::SelfTest().
+	 * @return Whether --headless or --benchmark is one of the arguments. The arguments it doesn't know are reported.
+	 */
+	bool	ParseArgs(i32 inArgc, char** inArgv, Options* outOptions);
+	/// @return The exit code of the application.
+	i32		Run(const Options& inOptions);
+}
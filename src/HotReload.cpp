@@ -0,0 +1,318 @@
+#include "HotReload.h"
+
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <tracy/Tracy.hpp>
+#ifdef __linux__
+	#include <sys/inotify.h>
+	#include <unistd.h>
+#endif
+
+/**
+ * On Linux the directories are watched with inotify. Other platforms fall back to
+ * comparing the last write time of every watched file a few times per second.
+ */
+
+using namespace HotReload;
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+/// @brief Editors often write a file more than once when saving, wait until it settles.
+sconst Clock::duration	kSettleTime		= std::chrono::milliseconds(100);
+sconst Clock::duration	kWakeUpInterval	= std::chrono::milliseconds(50);
+#ifndef __linux__
+sconst Clock::duration	kScanInterval	= std::chrono::milliseconds(250);
+#endif
+
+struct AsyncJob
+{
+	std::function<void()>	mWork;
+	std::function<void()>	mDone;
+};
+
+static struct
+{
+	std::thread										mThread;
+	std::mutex										mMutex;
+	std::condition_variable							mWakeUp;
+	bool											mRunning = false;
+
+	// guarded by mMutex
+	std::vector<AsyncJob>							mPendingJobs;
+	std::vector<std::function<void()>>				mFinishedJobs;
+	std::vector<std::string>						mChangedFiles;
+
+	// main thread only
+	std::vector<ChangeFn>							mSubscribers;
+
+	// background thread only
+	std::unordered_map<std::string, Clock::time_point>	mUnsettledFiles;
+
+#ifdef __linux__
+	i32												mInotifyFD = -1;
+	/// @brief Guarded by mMutex.
+	std::unordered_map<i32, std::string>			mWatchToDir;
+#else
+	/// @brief Guarded by mMutex.
+	std::vector<std::string>						mWatchedDirs;
+	std::unordered_set<std::string>					mScannedDirs;
+	std::unordered_map<std::string, fs::file_time_type>	mWriteTimes;
+	Clock::time_point								mLastScan;
+#endif
+} gState;
+
+#ifdef __linux__
+static void collectChanges()
+{
+	alignas(inotify_event) char buffer[4096];
+
+	for (;;)
+	{
+		// the descriptor is non-blocking, this fails with EAGAIN once the queue is empty
+		ssize_t len = read(gState.mInotifyFD, buffer, sizeof(buffer));
+		if (len <= 0)
+			break;
+
+		const Clock::time_point now = Clock::now();
+		std::lock_guard lock(gState.mMutex);
+		for (char* ptr = buffer; ptr < buffer + len;)
+		{
+			const inotify_event* event = (const inotify_event*)ptr;
+			ptr += sizeof(inotify_event) + event->len;
+
+			if (event->len == 0 || (event->mask & IN_ISDIR))
+				continue;
+
+			auto it = gState.mWatchToDir.find(event->wd);
+			if (it == gState.mWatchToDir.end())
+				continue;
+
+			gState.mUnsettledFiles[it->second + '/' + event->name] = now;
+		}
+	}
+}
+#else
+static void collectChanges()
+{
+	const Clock::time_point now = Clock::now();
+	if (now - gState.mLastScan < kScanInterval)
+		return;
+	gState.mLastScan = now;
+
+	std::vector<std::string> dirs;
+	{
+		std::lock_guard lock(gState.mMutex);
+		dirs = gState.mWatchedDirs;
+	}
+
+	for (const std::string& dir : dirs)
+	{
+		// the first scan of a directory only records the write times
+		const bool firstScan = gState.mScannedDirs.insert(dir).second;
+
+		std::error_code ec;
+		for (fs::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+		{
+			if (!it->is_regular_file(ec))
+				continue;
+
+			const fs::file_time_type writeTime = it->last_write_time(ec);
+			if (ec)
+				continue;
+
+			std::string path = Utils::NormalizePath(it->path().string().c_str());
+			auto [timeIt, inserted] = gState.mWriteTimes.try_emplace(path, writeTime);
+			if (!inserted && timeIt->second != writeTime)
+			{
+				timeIt->second = writeTime;
+				gState.mUnsettledFiles[path] = now;
+			} else if (inserted && !firstScan)
+			{
+				gState.mUnsettledFiles[path] = now;
+			}
+		}
+	}
+}
+#endif
+
+static void threadMain()
+{
+	tracy::SetThreadName("Hot Reload");
+
+	std::unique_lock lock(gState.mMutex);
+	while (gState.mRunning)
+	{
+		gState.mWakeUp.wait_for(lock, kWakeUpInterval, [] {
+			return !gState.mRunning || !gState.mPendingJobs.empty();
+		});
+		if (!gState.mRunning)
+			break;
+
+		std::vector<AsyncJob> jobs;
+		jobs.swap(gState.mPendingJobs);
+		lock.unlock();
+
+		for (AsyncJob& job : jobs)
+		{
+			ZoneScopedN("Hot Reload Job");
+			job.mWork();
+		}
+
+		collectChanges();
+
+		lock.lock();
+		for (AsyncJob& job : jobs)
+			gState.mFinishedJobs.push_back(std::move(job.mDone));
+
+		const Clock::time_point now = Clock::now();
+		for (auto it = gState.mUnsettledFiles.begin(); it != gState.mUnsettledFiles.end();)
+		{
+			if (now - it->second < kSettleTime)
+			{
+				it++;
+				continue;
+			}
+
+			gState.mChangedFiles.push_back(it->first);
+			it = gState.mUnsettledFiles.erase(it);
+		}
+	}
+}
+
+bool HotReload::StartUp()
+{
+#ifdef __linux__
+	gState.mInotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (gState.mInotifyFD < 0)
+	{
+		puts("ERROR(HotReload): Failed to initialize inotify.");
+		return false;
+	}
+#endif
+
+	gState.mRunning = true;
+	gState.mThread = std::thread(threadMain);
+	return true;
+}
+
+void HotReload::ShutDown()
+{
+	{
+		std::lock_guard lock(gState.mMutex);
+		gState.mRunning = false;
+	}
+	gState.mWakeUp.notify_one();
+
+	if (gState.mThread.joinable())
+		gState.mThread.join();
+
+	gState.mPendingJobs.clear();
+	gState.mFinishedJobs.clear();
+	gState.mChangedFiles.clear();
+	gState.mSubscribers.clear();
+
+#ifdef __linux__
+	if (gState.mInotifyFD >= 0)
+		close(gState.mInotifyFD);
+	gState.mInotifyFD = -1;
+	gState.mWatchToDir.clear();
+#else
+	gState.mWatchedDirs.clear();
+#endif
+}
+
+bool HotReload::WatchDirectory(const char* inDirPath)
+{
+	std::error_code ec;
+	if (!fs::is_directory(inDirPath, ec))
+	{
+		printf("ERROR(HotReload): \"%s\" is not a directory.\n", inDirPath);
+		return false;
+	}
+
+	const std::string dirPath = Utils::NormalizePath(inDirPath);
+
+#ifdef __linux__
+	// inotify is not recursive, every subdirectory needs its own watch
+	std::vector<std::string> dirs = { dirPath };
+	for (fs::recursive_directory_iterator it(dirPath, ec), end; !ec && it != end; it.increment(ec))
+	{
+		if (it->is_directory(ec))
+			dirs.push_back(Utils::NormalizePath(it->path().string().c_str()));
+	}
+
+	std::lock_guard lock(gState.mMutex);
+	for (const std::string& dir : dirs)
+	{
+		i32 wd = inotify_add_watch(gState.mInotifyFD, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (wd < 0)
+		{
+			printf("ERROR(HotReload): Failed to watch \"%s\".\n", dir.c_str());
+			continue;
+		}
+
+		gState.mWatchToDir[wd] = dir;
+	}
+#else
+	std::lock_guard lock(gState.mMutex);
+	gState.mWatchedDirs.push_back(dirPath);
+#endif
+
+	return true;
+}
+
+void HotReload::Subscribe(ChangeFn inFn)
+{
+	gState.mSubscribers.push_back(inFn);
+}
+
+void HotReload::Async(std::function<void()> inWork, std::function<void()> inDone)
+{
+	if (!gState.mRunning)
+	{
+		inWork();
+		inDone();
+		return;
+	}
+
+	{
+		std::lock_guard lock(gState.mMutex);
+		gState.mPendingJobs.push_back({ std::move(inWork), std::move(inDone) });
+	}
+	gState.mWakeUp.notify_one();
+}
+
+void HotReload::Update()
+{
+	ZoneScopedN("Hot Reload");
+
+	std::vector<std::string> changedFiles;
+	std::vector<std::function<void()>> finishedJobs;
+	{
+		std::lock_guard lock(gState.mMutex);
+		changedFiles.swap(gState.mChangedFiles);
+		finishedJobs.swap(gState.mFinishedJobs);
+	}
+
+	for (std::function<void()>& done : finishedJobs)
+		done();
+
+	if (changedFiles.empty())
+		return;
+
+	std::sort(changedFiles.begin(), changedFiles.end());
+	changedFiles.erase(std::unique(changedFiles.begin(), changedFiles.end()), changedFiles.end());
+
+	for (const std::string& path : changedFiles)
+		printf("HotReload: \"%s\" changed.\n", path.c_str());
+
+	for (ChangeFn fn : gState.mSubscribers)
+		fn(changedFiles);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "defines.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Watches asset directories and reloads changed files without restarting.
+ * A background thread detects file changes and runs the expensive part of a reload
+ * (reading, include expansion, image decoding). Everything that touches GL or the
+ * resource tables runs on the main thread inside Update(), so resources are only
+ * swapped between frames.
+ */
+namespace HotReload
+{
+	/// @brief Receives the absolute paths (with '/' separators) of the files that changed.
+	using ChangeFn = void (*)(const std::vector<std::string>& inPaths);
+
+	bool	StartUp();
+	void	ShutDown();
+
+	/// @brief Watch every file in the directory and its subdirectories.
+	bool	WatchDirectory(const char* inDirPath);
+	void	Subscribe(ChangeFn inFn);
+
+	/**
+	 * @brief Run inWork on the background thread, then inDone on the main thread
+	 * during the next Update() after inWork finished.
+	 */
+	void	Async(std::function<void()> inWork, std::function<void()> inDone);
+
+	/// @brief Must be called once per frame by the main thread before rendering.
+	void	Update();
+}
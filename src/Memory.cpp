@@ -12,10 +12,12 @@ std::unordered_map<uptr, usize> gPtrToSize;
 
 // TODO: is this thread safe?
 u64 gMemTotalAllocated[(u32)EMemSource::NumSources] = { 0 };
+u64 gMemDedupSaved[(u32)EMemSource::NumSources] = { 0 };
+u32 gMemGBufferBytesPerPixel = 0;
 
-const char* kAllocationSourceStr[(u32)EMemSource::NumSources] = {
+const char* Mem::kAllocationSourceStr[(u32)EMemSource::NumSources] = {
 	"Renderer (RAM)",		"Renderer (VRAM)",		"Physics",
-	"Debug Draw (RAM)",		"Debug Draw (VRAM)"		"Model (RAM)",
+	"Debug Draw (RAM)",		"Debug Draw (VRAM)",	"Model (RAM)",
 	"Model (VRAM)",			"Texture (RAM)",		"Texture (VRAM)",
 	"UI (RAM)",				"UI (VRAM)",			"Unknown",
 };
@@ -91,6 +93,40 @@ std::string Mem::GetUsageTable()
 	snprintf(memStr, sizeof(memStr), "%.3f", unknown);
 	table += "Unknown:             " + std::string(memStr) + unitStr(curUnit) + "\n";
 
+	if (gMemGBufferBytesPerPixel != 0)
+		table += "G-Buffer:            " + std::to_string(gMemGBufferBytesPerPixel) + "b/px\n";
+
+	// only list the sources that shared something
+	bool hasDedup = false;
+	for (u32 i = 0; i < (u32)EMemSource::NumSources; i++)
+	{
+		if (gMemDedupSaved[i] == 0)
+			continue;
+
+		if (!hasDedup)
+		{
+			table += "\nSaved by deduplication and aliasing:\n";
+			hasDedup = true;
+		}
+
+		f64 saved = (f64)gMemDedupSaved[i];
+		curUnit = EMemUnit::B;
+		if (saved >= 1_mb)
+		{
+			saved /= 1_mb;
+			curUnit = EMemUnit::MB;
+		} else if (saved >= 1_kb)
+		{
+			saved /= 1_kb;
+			curUnit = EMemUnit::KB;
+		}
+
+		char label[32] = {'\0'};
+		snprintf(label, sizeof(label), "%s:", kAllocationSourceStr[i]);
+		snprintf(memStr, sizeof(memStr), "%-21s%.3f", label, saved);
+		table += std::string(memStr) + unitStr(curUnit) + "\n";
+	}
+
 	return table;
 }
 
@@ -164,7 +200,12 @@ void* Mem::Alloc(usize inSize, EMemSource inSource)
 
 void* Mem::AlignedAlloc(usize inSize, usize inAlignment, EMemSource inSource)
 {
+#ifdef _WIN32
 	void* mem = _aligned_malloc(inSize, inAlignment);
+#else
+	// aligned_alloc wants the size to be a multiple of the alignment
+	void* mem = aligned_alloc(inAlignment, (inSize + inAlignment - 1) / inAlignment * inAlignment);
+#endif
 	if (mem)
 	{
 		ReportAlloc(inSize, inSource); // TODO: account for alignment
@@ -205,6 +246,23 @@ void Mem::ReportFree(usize inSize, EMemSource inSource)
 	gMemTotalAllocated[(u32)inSource] -= inSize;
 }
 
+void Mem::ReportDedup(usize inSize, EMemSource inSource)
+{
+	gMemDedupSaved[(u32)inSource] += inSize;
+}
+
+void Mem::ReportDedupFree(usize inSize, EMemSource inSource)
+{
+	if (inSize > gMemDedupSaved[(u32)inSource])
+	{
+		printf("ERROR(Memory): Source %u reported freeing more deduplicated memory than was saved. (request free: %zubytes, total: %llu)\n", (u32)inSource, inSize, gMemDedupSaved[(u32)inSource]);
+		SBREAK();
+		return;
+	}
+
+	gMemDedupSaved[(u32)inSource] -= inSize;
+}
+
 void Mem::Free(void* inBlock, EMemSource inSource)
 {
 	if (gPtrToSize.find((uptr)inBlock) == gPtrToSize.end())
@@ -231,6 +289,10 @@ void Mem::AlignedFree(void* inBlock, EMemSource inSource)
 	}
 	gPtrToSize.erase((uptr)inBlock);
 
+#ifdef _WIN32
 	_aligned_free(inBlock);
+#else
+	free(inBlock);
+#endif
 	ReportFree(gPtrToSize[(uptr)inBlock], inSource); // TODO: account for alignment
 }
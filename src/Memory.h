@@ -23,6 +23,10 @@ enum class EMemSource : u32
 enum class EMemUnit { B, KB, MB, GB };
 
 extern u64 gMemTotalAllocated[(u32)EMemSource::NumSources];
+/// @brief Memory that would have been allocated if identical resources weren't shared.
+extern u64 gMemDedupSaved[(u32)EMemSource::NumSources];
+/// @brief Set by the renderer when it creates the G-buffer, 0 if there is none.
+extern u32 gMemGBufferBytesPerPixel;
 
 namespace Mem
 {
@@ -71,6 +75,11 @@ namespace Mem
 	void			ReportAlloc(usize inSize, EMemSource inSource);
 	void			ReportFree(usize inSize, EMemSource inSource);
 
+	/// @brief Report memory that was not allocated because an identical resource or memory whose user is done is shared.
+	void			ReportDedup(usize inSize, EMemSource inSource);
+	/// @brief Report that a shared resource which saved memory was freed.
+	void			ReportDedupFree(usize inSize, EMemSource inSource);
+
 	void			Free(void* inBlock, EMemSource inSource);
 	void			AlignedFree(void* inBlock, EMemSource inSource);
 }
@@ -6,8 +6,12 @@
 #include "ResourceManager.h"
 #include "Utils.h"
 #include "Compute.h"
+#include "GLState.h"
 #include "PostFX.h"
+#include "Memory.h"
 #include <vector>
+#include <algorithm>
+#include <functional>
 #include <glad/glad.h>
 #include <imgui.h>
 #include <imgui/backends/imgui_impl_glfw.h>
@@ -16,12 +20,23 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <tracy/Tracy.hpp>
 
-constexpr f32 gShadowCascadeLevels[Renderer::kFrustumCount] = {
-	//kFarPlane / 50.0f,
-	kFarPlane / 25.0f,
-	kFarPlane / 10.0f,
-	kFarPlane / 2.0f
-};
+// permutation bits, in the order of the defines passed to Shader::Load()
+sconst u32 kLightingSSAO		= 1 << 0;
+sconst u32 kLightingCsmDebug	= 1 << 1;
+sconst u32 kLightingPackedGBuffer	= 1 << 2;
+sconst u32 kPostFxCLUT			= 1 << 0;
+sconst u32 kDeferredPackedGBuffer	= 1 << 0;
+sconst u32 kSsaoPackedGBuffer	= 1 << 0;
+sconst u32 kSsaoLowRes			= 1 << 1;
+sconst u32 kSsaoResamplePackedGBuffer	= 1 << 0;
+sconst u32 kTransparentWeightedBlended	= 1 << 0;
+sconst u32 kTransparentLinkedList	= 1 << 1;
+sconst u32 kOitResolveLinkedList	= 1 << 0;
+
+// the GPU profiler zones the stats and the dynamic resolution are read from
+static const char* kGBufferZone		= "Render G-Buffer";
+static const char* kTransparentZone	= "Transparent Meshes (Fwd Rendering)";
+static const char* kPostFxZone		= "Post FX";
 
 //glm::vec3 gSunPos(-18.0f, 100.0f, -89.3f); // city
 glm::vec3 gSunPos(2.0f, 85.0f, 0.0f); // sponza
@@ -32,6 +47,15 @@ static void openglDebugCb(
 	const GLchar* inMsg, const void* inUserParam);
 
 static void getFrustumCornersWorld(glm::vec4 ioCorners[8], const glm::mat4& inViewProj);
+/// @brief The light space rotation of the sun, its origin stays at the world origin.
+static glm::mat4 getSunRotation();
+/// @brief The float of a uint written by FloatToOrdered() in CascadeBounds.comp.
+static f32 orderedToFloat(u32 inValue);
+/// @brief The float of a uint written by floatBitsToUint() in GLSL.
+static f32 bitsToFloat(u32 inBits);
+/// @brief The frustum planes of a view projection, xyz points inside like `uFrustumPlanes` of `OcclusionCull.comp`.
+static void getFrustumPlanes(glm::vec4 outPlanes[6], const glm::mat4& inViewProj);
+static bool isInFrustum(const glm::vec4 inPlanes[6], const glm::vec3& inBoundsMin, const glm::vec3& inBoundsMax);
 
 bool Renderer::StartUp(u32 inWidth, u32 inHeight, GLFWwindow* ioWindow)
 {
@@ -39,26 +63,30 @@ bool Renderer::StartUp(u32 inWidth, u32 inHeight, GLFWwindow* ioWindow)
 	mWidth = inWidth;
 	mHeight = inHeight;
 
-	glViewport(0, 0, mWidth, mHeight);
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL);
+	GLState::Viewport(0, 0, mWidth, mHeight);
+	GLState::Enable(GL_DEPTH_TEST);
+	GLState::DepthFunc(GL_LEQUAL);
 
-	//glEnable(GL_CULL_FACE);
-	//glCullFace(GL_BACK);
+	//GLState::Enable(GL_CULL_FACE);
+	//GLState::CullFace(GL_BACK);
 	//glFrontFace(GL_CCW);
 
-	glEnable(GL_DEBUG_OUTPUT);
-	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	GLState::Enable(GL_DEBUG_OUTPUT);
+	GLState::Enable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 	glDebugMessageCallback(openglDebugCb, nullptr);
 
-	IMGUI_CHECKVERSION();
-	ImGui::CreateContext();
-	ImGuiIO& io = ImGui::GetIO();
-	io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
-	io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;
-	io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
-	ImGui_ImplGlfw_InitForOpenGL(ioWindow, true);
-	ImGui_ImplOpenGL3_Init();
+	mEnableUI = ioWindow != nullptr;
+	if (mEnableUI)
+	{
+		IMGUI_CHECKVERSION();
+		ImGui::CreateContext();
+		ImGuiIO& io = ImGui::GetIO();
+		io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
+		io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;
+		io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+		ImGui_ImplGlfw_InitForOpenGL(ioWindow, true);
+		ImGui_ImplOpenGL3_Init();
+	}
 
 	{ // full screen quad setup
 		const f32 quadVertices[] = {
@@ -87,62 +115,62 @@ bool Renderer::StartUp(u32 inWidth, u32 inHeight, GLFWwindow* ioWindow)
 		glVertexArrayAttribBinding(mFullScreenQuadVAO, 1, 0);
 	}
 
-	{
-		bloomSetup();
+	// the programs compile in parallel while the rest is set up, they are checked at EndBatch()
+	ShaderProgram::BeginBatch();
 
-		mBloomDownsampleShader.Load("res/shaders/FullScreen.vert", "res/shaders/BloomDownsample.frag");
-		mBloomDownsampleShader.Use();
+	{
+		glCreateFramebuffers(1, &mBloomFBO);
+		GL_LABEL(GL_FRAMEBUFFER, mBloomFBO, "Bloom FBO");
+		glCreateBuffers(1, &mBloomCounterSSBO);
+		GL_LABEL(GL_BUFFER, mBloomCounterSSBO, "Bloom Counters");
+		glNamedBufferStorage(mBloomCounterSSBO, (1 + kMaxBloomMips) * sizeof(u32), nullptr, GL_DYNAMIC_STORAGE_BIT);
 
+		mBloomDownsampleShader.Load("res/shaders/BloomDownsample.comp");
 		mBloomUpsampleShader.Load("res/shaders/FullScreen.vert", "res/shaders/BloomUpsample.frag");
-		mBloomUpsampleShader.Use();
 	}
 
 	{
 		mLensDirtTexture = ResMgr::GetTexture("res/textures/lens_dirt.jpg");
 
-		mPostFxShader.Load("res/shaders/FullScreen.vert", "res/shaders/PostFX.frag");
-		mPostFxShader.Use();
+		mPostFxShader.LoadCompute("res/shaders/PostFX.comp", { "ENABLE_CLUT" });
 
 		// glBindTexture(GL_TEXTURE_3D, 0);
 	}
 
-	mTransparentShader.Load("res/shaders/Transparent.vert", "res/shaders/Transparent.frag");
-	mTransparentShader.Use();
-	mTransparentShader.SetVec3("uDirLight.mDirection", kSunDirection);
-	mTransparentShader.SetVec3("uDirLight.mColor", glm::vec3(0.38f));
+	mTransparentShader.Load("res/shaders/Transparent.vert", "res/shaders/Transparent.frag", nullptr, { "WEIGHTED_BLENDED", "LINKED_LIST" });
+	mOitResolveShader.Load("res/shaders/FullScreen.vert", "res/shaders/OitResolve.frag", nullptr, { "LINKED_LIST" });
 
-	mLightingShader.Load("res/shaders/FullScreen.vert", "res/shaders/Lighting.frag");
-	mLightingShader.Use();
-	mLightingShader.SetVec3("uDirLight.mDirection", kSunDirection);
-	mLightingShader.SetVec3("uDirLight.mColor", glm::vec3(0.38f));
+	mLightingShader.Load("res/shaders/FullScreen.vert", "res/shaders/Lighting.frag", nullptr, { "ENABLE_SSAO", "CSM_DEBUG", "PACKED_GBUFFER" });
+	mLightingShader.SetUniformSetup([this](const Shader& inShader) {
+		inShader.SetMat4("uInvProjection", glm::inverse(mCamera.mProjection));
+	});
 
 	mFullScreenShader.Load("res/shaders/FullScreen.vert", "res/shaders/FullScreen.frag");
+	mUpscaleShader.Load("res/shaders/FullScreen.vert", "res/shaders/Upscale.frag");
 
 	mSsaoBlurShader.Load("res/shaders/FullScreen.vert", "res/shaders/SsaoBlur.frag");
-	mSsaoBlurShader.Use();
 
 	{
-		mSsaoShader.Load("res/shaders/FullScreen.vert", "res/shaders/SSAO.frag");
-		mSsaoShader.Use();
-		mSsaoShader.SetMat4("uProjection", mCamera.mProjection);
-
-		for (u32 i = 0; i < 32; i++)
-		{
-			glm::vec3 sample(
-				Utils::RandomBetween(-1.0f, 1.0f),
-				Utils::RandomBetween(-1.0f, 1.0f),
-				Utils::RandomBetween(0.0f, 1.0f)
-			);
-
-			sample = glm::normalize(sample);
-			sample *= Utils::RandomBetween(0.0f, 1.0f);
-
-			f32 scale = (f32)i / 64.0f;
-			scale = glm::mix(0.1f, 1.0f, scale * scale);
-			sample *= scale;
-
-			mSsaoShader.SetVec3("uSamples[" + std::to_string(i) + "]", sample);
-		}
+		mSsaoShader.Load("res/shaders/FullScreen.vert", "res/shaders/SSAO.frag", nullptr, { "PACKED_GBUFFER", "LOW_RES" });
+
+		// the kernel is a member so a reloaded shader gets the same samples
+		updateSsaoKernel();
+		mSsaoShader.SetUniformSetup([this](const Shader& inShader) {
+			inShader.SetMat4("uProjection", mCamera.mProjection);
+			inShader.SetMat4("uInvProjection", glm::inverse(mCamera.mProjection));
+			for (u32 i = 0; i < mSsaoKernel.size(); i++)
+				inShader.SetVec3("uSamples[" + std::to_string(i) + "]", mSsaoKernel[i]);
+		});
+
+		mSsaoDownsampleShader.Load("res/shaders/FullScreen.vert", "res/shaders/SsaoDownsample.frag", nullptr, { "PACKED_GBUFFER" });
+		mSsaoDownsampleShader.SetUniformSetup([this](const Shader& inShader) {
+			inShader.SetMat4("uInvProjection", glm::inverse(mCamera.mProjection));
+		});
+
+		mSsaoUpsampleShader.Load("res/shaders/FullScreen.vert", "res/shaders/SsaoUpsample.frag", nullptr, { "PACKED_GBUFFER" });
+		mSsaoUpsampleShader.SetUniformSetup([this](const Shader& inShader) {
+			inShader.SetMat4("uInvProjection", glm::inverse(mCamera.mProjection));
+		});
 
 		glm::vec3 ssaoNoise[16] = {};
 		for (u32 i = 0; i < 16; i++)
@@ -164,11 +192,13 @@ bool Renderer::StartUp(u32 inWidth, u32 inHeight, GLFWwindow* ioWindow)
 	}
 
 	mFxaaShader.Load("res/shaders/FullScreen.vert", "res/shaders/FXAA.frag");
-	mFxaaShader.Use();
 
-	mDeferredShader.Load("res/shaders/Deferred.vert", "res/shaders/Deferred.frag");
-	mDeferredShader.Use();
-	mDeferredShader.SetMat4("uProjection", mCamera.mProjection);
+	mDeferredShader.Load("res/shaders/Deferred.vert", "res/shaders/Deferred.frag", nullptr, { "PACKED_GBUFFER" });
+	mDeferredShader.SetUniformSetup([this](const Shader& inShader) {
+		inShader.SetMat4("uProjection", mCamera.mProjection);
+	});
+
+	mDepthPrepassShader.Load("res/shaders/DepthPrepass.vert", "res/shaders/DepthPrepass.frag");
 
 	mShadowMapShader.Load("res/shaders/ShadowMap.vert", "res/shaders/ShadowMap.frag", "res/shaders/ShadowMap.geom");
 
@@ -183,49 +213,8 @@ bool Renderer::StartUp(u32 inWidth, u32 inHeight, GLFWwindow* ioWindow)
 	#pragma endregion
 
 	#pragma region Setup framebuffers
-	glCreateTextures(GL_TEXTURE_2D, 1, &mAlbedoTex);
-	GL_LABEL(GL_TEXTURE, mAlbedoTex, "G Albedo");
-	glTextureParameteri(mAlbedoTex, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTextureParameteri(mAlbedoTex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTextureStorage2D(mAlbedoTex, 1, GL_RGBA16F, mWidth, mHeight);
-
-	glCreateTextures(GL_TEXTURE_2D, 1, &mSpecularTex);
-	GL_LABEL(GL_TEXTURE, mSpecularTex, "G Specular");
-	glTextureParameteri(mSpecularTex, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTextureParameteri(mSpecularTex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTextureStorage2D(mSpecularTex, 1, GL_RGBA16F, mWidth, mHeight);
-
-	glCreateTextures(GL_TEXTURE_2D, 1, &mNormalTex);
-	GL_LABEL(GL_TEXTURE, mNormalTex, "G Normal");
-	glTextureParameteri(mNormalTex, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTextureParameteri(mNormalTex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTextureStorage2D(mNormalTex, 1, GL_RGBA16F, mWidth, mHeight);
-
-	glCreateTextures(GL_TEXTURE_2D, 1, &mPositionTex);
-	GL_LABEL(GL_TEXTURE, mPositionTex, "G Position");
-	glTextureParameteri(mPositionTex, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTextureParameteri(mPositionTex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTextureStorage2D(mPositionTex, 1, GL_RGBA32F, mWidth, mHeight);
-
-	glCreateRenderbuffers(1, &mDepthRBO);
-	GL_LABEL(GL_RENDERBUFFER, mDepthRBO, "Depth RBO");
-	glNamedRenderbufferStorage(mDepthRBO, GL_DEPTH_COMPONENT24, mWidth, mHeight);
-
 	glCreateFramebuffers(1, &mDeferredFBO);
-	GL_LABEL(GL_TEXTURE, mDeferredFBO, "Deferred FBO");
-	glNamedFramebufferTexture(mDeferredFBO, GL_COLOR_ATTACHMENT0, mAlbedoTex, 0);
-	glNamedFramebufferTexture(mDeferredFBO, GL_COLOR_ATTACHMENT1, mSpecularTex, 0);
-	glNamedFramebufferTexture(mDeferredFBO, GL_COLOR_ATTACHMENT2, mNormalTex, 0);
-	glNamedFramebufferTexture(mDeferredFBO, GL_COLOR_ATTACHMENT3, mPositionTex, 0);
-	glNamedFramebufferRenderbuffer(mDeferredFBO, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepthRBO);
-	u32 colorAttachments4[4] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
-	glNamedFramebufferDrawBuffers(mDeferredFBO, 4, colorAttachments4);
-	if (glCheckNamedFramebufferStatus(mDeferredFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		puts("Error: Failed to create deferred framebuffer (G-Buffer).\n");
-		getchar();
-		return false;
-	}
+	GL_LABEL(GL_FRAMEBUFFER, mDeferredFBO, "Deferred FBO");
 
 	glCreateTextures(GL_TEXTURE_2D, 1, &mLightingTex);
 	GL_LABEL(GL_TEXTURE, mLightingTex, "Deferred Lighting");
@@ -235,78 +224,26 @@ bool Renderer::StartUp(u32 inWidth, u32 inHeight, GLFWwindow* ioWindow)
 	glCreateFramebuffers(1, &mLightingFBO);
 	GL_LABEL(GL_FRAMEBUFFER, mLightingFBO, "Lighting FBO");
 	glNamedFramebufferTexture(mLightingFBO, GL_COLOR_ATTACHMENT0, mLightingTex, 0);
-	// in modern opengl you can bind one render buffer to two frame buffers
-	glNamedFramebufferRenderbuffer(mLightingFBO, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepthRBO);
-	if (glCheckNamedFramebufferStatus(mLightingFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		puts("Error: Failed to create lighting framebuffer.\n");
-		getchar();
-		return false;
-	}
-
-	glCreateTextures(GL_TEXTURE_2D, 1, &mHdrTex);
-	GL_LABEL(GL_TEXTURE, mHdrTex, "HDR Texture");
-	glTextureParameteri(mHdrTex, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTextureParameteri(mHdrTex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTextureStorage2D(mHdrTex, 1, GL_RGBA8, mWidth, mHeight);
+	glCreateFramebuffers(1, &mOitFBO);
+	GL_LABEL(GL_FRAMEBUFFER, mOitFBO, "OIT FBO");
 
-	glCreateFramebuffers(1, &mHdrFBO);
-	GL_LABEL(GL_FRAMEBUFFER, mHdrFBO, "HDR FBO");
-	glNamedFramebufferTexture(mHdrFBO, GL_COLOR_ATTACHMENT0, mHdrTex, 0);
-	if (glCheckNamedFramebufferStatus(mHdrFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	// attaches the depth texture to the FBOs, the G-buffer and OIT targets are attached by the frame graph
+	if (!createDepthTarget())
 	{
-		puts("Error: Failed to create HDR tonemapping framebuffer.\n");
 		getchar();
 		return false;
 	}
 
-	glCreateTextures(GL_TEXTURE_2D, 1, &mSsaoTex);
-	GL_LABEL(GL_TEXTURE, mSsaoTex, "SSAO Texture");
-	glTextureParameteri(mSsaoTex, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTextureParameteri(mSsaoTex, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTextureStorage2D(mSsaoTex, 1, GL_RGBA16F, mWidth, mHeight);
-
 	glCreateFramebuffers(1, &mSsaoFBO);
 	GL_LABEL(GL_FRAMEBUFFER, mSsaoFBO, "SSAO FBO");
-	glNamedFramebufferTexture(mSsaoFBO, GL_COLOR_ATTACHMENT0, mSsaoTex, 0);
-	if (glCheckNamedFramebufferStatus(mSsaoFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		puts("Error: Failed to create SSAO framebuffer.\n");
-		getchar();
-		return false;
-	}
-
-	glCreateTextures(GL_TEXTURE_2D, 1, &mSsaoBlurTex);
-	GL_LABEL(GL_TEXTURE, mSsaoBlurTex, "SSAO Blur Texture");
-	glTextureParameteri(mSsaoBlurTex, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTextureParameteri(mSsaoBlurTex, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTextureStorage2D(mSsaoBlurTex, 1, GL_RGBA16F, mWidth, mHeight);
-
 	glCreateFramebuffers(1, &mSsaoBlurFBO);
 	GL_LABEL(GL_FRAMEBUFFER, mSsaoBlurFBO, "SSAO Blur FBO");
-	glNamedFramebufferTexture(mSsaoBlurFBO, GL_COLOR_ATTACHMENT0, mSsaoBlurTex, 0);
-	if (glCheckNamedFramebufferStatus(mSsaoBlurFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		puts("Error: Failed to create SSAO blur framebuffer.\n");
-		getchar();
-		return false;
-	}
-
-	glCreateTextures(GL_TEXTURE_2D, 1, &mFxaaTex);
-	GL_LABEL(GL_TEXTURE, mFxaaTex, "FXAA Texture");
-	glTextureParameteri(mFxaaTex, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTextureParameteri(mFxaaTex, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTextureStorage2D(mFxaaTex, 1, GL_RGBA8, mWidth, mHeight);
-
-	glCreateFramebuffers(1, &mFxaaFBO);
-	GL_LABEL(GL_FRAMEBUFFER, mFxaaFBO, "FXAA FBO");
-	glNamedFramebufferTexture(mFxaaFBO, GL_COLOR_ATTACHMENT0, mFxaaTex, 0);
-	if (glCheckNamedFramebufferStatus(mFxaaFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		puts("Error: Failed to create SSAO blur framebuffer.\n");
-		getchar();
-		return false;
-	}
+	glCreateFramebuffers(1, &mSsaoDepthNormalFBO);
+	GL_LABEL(GL_FRAMEBUFFER, mSsaoDepthNormalFBO, "SSAO Depth Normal FBO");
+	glCreateFramebuffers(1, &mSsaoUpsampleFBO);
+	GL_LABEL(GL_FRAMEBUFFER, mSsaoUpsampleFBO, "SSAO Upsample FBO");
+	glCreateFramebuffers(1, &mAntiAliasFBO);
+	GL_LABEL(GL_FRAMEBUFFER, mAntiAliasFBO, "Anti-Alias FBO");
 
 	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &mCascadeTexArray);
 	GL_LABEL(GL_TEXTURE, mCascadeTexArray, "CSM Tex Array");
@@ -329,10 +266,6 @@ bool Renderer::StartUp(u32 inWidth, u32 inHeight, GLFWwindow* ioWindow)
 		getchar();
 		return false;
 	}
-	#pragma endregion
-
-	mLumaShader.Load("res/shaders/Luma.comp");
-	mExposureShader.Load("res/shaders/Exposure.comp");
 
 	glCreateBuffers(1, &mLumaSSBO);
 	glNamedBufferStorage(
@@ -342,6 +275,63 @@ bool Renderer::StartUp(u32 inWidth, u32 inHeight, GLFWwindow* ioWindow)
 	LumaExposureComp initial{};
 	glNamedBufferSubData(mLumaSSBO, 0, sizeof(LumaExposureComp), &initial);
 
+	// every program which includes Utils.glsl reads the block, so it stays bound
+	glCreateBuffers(1, &mRenderScaleUBO);
+	GL_LABEL(GL_BUFFER, mRenderScaleUBO, "Render Scale");
+	glNamedBufferStorage(mRenderScaleUBO, sizeof(RenderScaleUniforms), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glBindBufferBase(GL_UNIFORM_BUFFER, kRenderScaleBinding, mRenderScaleUBO);
+	// and every program which includes Lights.glsl reads this one
+	glCreateBuffers(1, &mFrameLightsUBO);
+	GL_LABEL(GL_BUFFER, mFrameLightsUBO, "Frame Lights");
+	glNamedBufferStorage(mFrameLightsUBO, sizeof(FrameLightsUniforms), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glBindBufferBase(GL_UNIFORM_BUFFER, kFrameLightsBinding, mFrameLightsUBO);
+
+	glCreateBuffers(1, &mOitNodeCountBuffer);
+	GL_LABEL(GL_BUFFER, mOitNodeCountBuffer, "OIT Node Counts");
+	glNamedBufferStorage(mOitNodeCountBuffer, kGpuTimerLatency * sizeof(u32), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	glCreateQueries(GL_FRAGMENT_SHADER_INVOCATIONS, 2 * kGpuTimerLatency, mGBufferFragmentQueries);
+	GpuProfiler::StartUp();
+
+	for (DepthBoundsReadback& readback : mDepthBoundsReadbacks)
+	{
+		glCreateBuffers(1, &readback.mSSBO);
+		GL_LABEL(GL_BUFFER, readback.mSSBO, "Depth Bounds");
+		glNamedBufferStorage(readback.mSSBO, sizeof(DepthBoundsComp), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+	for (CullStatsReadback& readback : mCullStatsReadbacks)
+	{
+		glCreateBuffers(1, &readback.mSSBO);
+		GL_LABEL(GL_BUFFER, readback.mSSBO, "Cull Stats");
+		glNamedBufferStorage(readback.mSSBO, sizeof(CullStats), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+
+	// creates the transient targets, after everything the graph imports
+	if (!buildFrameGraph())
+	{
+		getchar();
+		return false;
+	}
+	#pragma endregion
+
+	mLumaShader.Load("res/shaders/Luma.comp");
+	mExposureShader.Load("res/shaders/Exposure.comp");
+	mGtaoShader.Load("res/shaders/GTAO.comp");
+	mTaaShader.Load("res/shaders/TAA.comp");
+	mDepthBoundsShader.Load("res/shaders/DepthBounds.comp");
+	mCascadeBoundsShader.Load("res/shaders/CascadeBounds.comp");
+	mHiZShader.Load("res/shaders/HiZ.comp");
+	mOcclusionCullShader.Load("res/shaders/OcclusionCull.comp");
+
+	// build the permutations of the default settings in the batch too
+	selectPermutations();
+
+	if (!ShaderProgram::EndBatch())
+	{
+		ZR_ASSERT(false, "Failed to build the shaders.");
+		return false;
+	}
+
 	PostFX::CLUT clut{};
 	if (!PostFX::LoadCLUT(&clut, "res/postfx/vibrant2.CUBE"))
 	{
@@ -364,10 +354,11 @@ bool Renderer::StartUp(u32 inWidth, u32 inHeight, GLFWwindow* ioWindow)
 void Renderer::ShutDown()
 {
 	mMeshes.clear();
+	mDynamicMeshes.clear();
 	mPointLights.clear();
 	mTransparentMeshes.clear();
 
-	glDeleteVertexArrays(1, &mFullScreenQuadVAO);
+	GLState::DeleteVertexArrays(1, &mFullScreenQuadVAO);
 	glDeleteBuffers(1, &mFullScreenQuadVBO);
 
 	ResMgr::ReleaseTexture(mLensDirtTexture);
@@ -376,52 +367,108 @@ void Renderer::ShutDown()
 	Skybox::ShutDownSystem();
 
 	mDeferredShader.Unload();
+	mDepthPrepassShader.Unload();
 	mPostFxShader.Unload();
 	mFxaaShader.Unload();
 	mLightingShader.Unload();
 	mSsaoShader.Unload();
 	mSsaoBlurShader.Unload();
+	mSsaoDownsampleShader.Unload();
+	mSsaoUpsampleShader.Unload();
 	mBloomUpsampleShader.Unload();
 	mBloomDownsampleShader.Unload();
 	mShadowMapShader.Unload();
 	mTransparentShader.Unload();
+	mOitResolveShader.Unload();
 	mFullScreenShader.Unload();
+	mUpscaleShader.Unload();
 	mLumaShader.Unload();
 	mExposureShader.Unload();
+	mGtaoShader.Unload();
+	mTaaShader.Unload();
+	mDepthBoundsShader.Unload();
+	mCascadeBoundsShader.Unload();
+	mHiZShader.Unload();
+	mOcclusionCullShader.Unload();
+
+	// the G-buffer color, SSAO, bloom and post FX targets
+	mFrameGraph.Release();
+	mBloomMipChain.clear();
 
-	glDeleteTextures(1, &mAlbedoTex);
-	glDeleteTextures(1, &mSpecularTex);
-	glDeleteTextures(1, &mNormalTex);
-	glDeleteTextures(1, &mPositionTex);
-	glDeleteTextures(1, &mLightingTex);
-	glDeleteTextures(1, &mHdrTex);
-	glDeleteTextures(1, &mSsaoTex);
-	glDeleteTextures(1, &mSsaoBlurTex);
-	glDeleteTextures(1, &mSsaoNoiseTex);
-	glDeleteTextures(1, &mFxaaTex);
-	glDeleteTextures(1, &mCascadeTexArray);
-	glDeleteTextures(1, &mClutTex);
-	glDeleteFramebuffers(1, &mShadowMapFBO);
-	glDeleteFramebuffers(1, &mDeferredFBO);
-	glDeleteFramebuffers(1, &mLightingFBO);
-	glDeleteFramebuffers(1, &mHdrFBO);
-	glDeleteFramebuffers(1, &mSsaoFBO);
-	glDeleteFramebuffers(1, &mSsaoBlurFBO);
-	glDeleteFramebuffers(1, &mFxaaFBO);
-	glDeleteFramebuffers(1, &mBloomFBO);
+	GLState::DeleteTextures(1, &mDepthTex);
+	Mem::ReportFree(mDepthSizeBytes, EMemSource::RendererVRAM);
+	mDepthSizeBytes = 0;
+	GLState::DeleteTextures(1, &mLightingTex);
+	GLState::DeleteTextures(1, &mSsaoNoiseTex);
+	GLState::DeleteTextures(2, mGtaoTex);
+	GLState::DeleteTextures(2, mGtaoViewZTex);
+	GLState::DeleteTextures(2, mTaaTex);
+	GLState::DeleteTextures(1, &mCascadeTexArray);
+	if (mStaticCascadeTexArray != 0)
+	{
+		GLState::DeleteTextures(1, &mStaticCascadeTexArray);
+		GLState::DeleteFramebuffers(1, &mStaticShadowMapFBO);
+		Mem::ReportFree((usize)2 * kShadowQuality * kShadowQuality * kCascadeCount, EMemSource::RendererVRAM);
+	}
+	GLState::DeleteTextures(1, &mClutTex);
+	GLState::DeleteFramebuffers(1, &mShadowMapFBO);
+	GLState::DeleteFramebuffers(1, &mDeferredFBO);
+	GLState::DeleteFramebuffers(1, &mLightingFBO);
+	GLState::DeleteFramebuffers(1, &mOitFBO);
+	GLState::DeleteFramebuffers(1, &mSsaoFBO);
+	GLState::DeleteFramebuffers(1, &mSsaoBlurFBO);
+	GLState::DeleteFramebuffers(1, &mSsaoDepthNormalFBO);
+	GLState::DeleteFramebuffers(1, &mSsaoUpsampleFBO);
+	GLState::DeleteFramebuffers(1, &mBloomFBO);
+	GLState::DeleteFramebuffers(1, &mAntiAliasFBO);
 
 	glDeleteBuffers(1, &mLumaSSBO);
-
-	for (u32 i = 0; i < mBloomMipChain.size(); i++)
+	glDeleteBuffers(1, &mBloomCounterSSBO);
+	glDeleteBuffers(1, &mRenderScaleUBO);
+	glDeleteBuffers(1, &mFrameLightsUBO);
+	glDeleteBuffers(1, &mOitNodeCountBuffer);
+	glDeleteBuffers(1, &mOitNodeSSBO);
+	Mem::ReportFree((usize)kOitNodeSize * mOitNodeCapacity, EMemSource::RendererVRAM);
+	mOitNodeSSBO = 0;
+	mOitNodeCapacity = 0;
+	glDeleteQueries(2 * kGpuTimerLatency, mGBufferFragmentQueries);
+	GpuProfiler::ShutDown();
+	for (DepthBoundsReadback& readback : mDepthBoundsReadbacks)
 	{
-		BloomMip* mip = &mBloomMipChain[i];
-		glDeleteTextures(1, &mip->mID);
+		glDeleteBuffers(1, &readback.mSSBO);
+		if (readback.mFence)
+			glDeleteSync(readback.mFence);
+		readback = DepthBoundsReadback{};
 	}
-	mBloomMipChain.clear();
+	mDepthBoundsCascadeCount = 0;
+	for (CullStatsReadback& readback : mCullStatsReadbacks)
+	{
+		glDeleteBuffers(1, &readback.mSSBO);
+		if (readback.mFence)
+			glDeleteSync(readback.mFence);
+		readback = CullStatsReadback{};
+	}
+	glDeleteBuffers(1, &mCullObjectSSBO);
+	glDeleteBuffers(2, mCullCommandBuffers);
+	glDeleteBuffers(1, &mCullVisibilitySSBO);
+	mCullCapacity = 0;
+	mCullMeshes.clear();
+	mCullObjects.clear();
+	for (IndirectDraws* draws : { &mVisibleDraws, &mTransparentDraws })
+	{
+		glDeleteBuffers(1, &draws->mBuffer);
+		*draws = IndirectDraws{};
+	}
+	GLState::DeleteTextures(1, &mHiZTex);
+	mHiZTex = 0;
+	mSoftOcclusion.ShutDown();
 
-	ImGui_ImplOpenGL3_Shutdown();
-	ImGui_ImplGlfw_Shutdown();
-	ImGui::DestroyContext();
+	if (mEnableUI)
+	{
+		ImGui_ImplOpenGL3_Shutdown();
+		ImGui_ImplGlfw_Shutdown();
+		ImGui::DestroyContext();
+	}
 }
 
 void Renderer::SetCamera(Camera inCamera)
@@ -431,6 +478,10 @@ void Renderer::SetCamera(Camera inCamera)
 	mDeferredShader.SetMat4("uProjection", mCamera.mProjection);
 	mSsaoShader.Use();
 	mSsaoShader.SetMat4("uProjection", mCamera.mProjection);
+	mSsaoShader.SetMat4("uInvProjection", glm::inverse(mCamera.mProjection));
+	mSsaoDownsampleShader.SetMat4("uInvProjection", glm::inverse(mCamera.mProjection));
+	mSsaoUpsampleShader.SetMat4("uInvProjection", glm::inverse(mCamera.mProjection));
+	mLightingShader.SetMat4("uInvProjection", glm::inverse(mCamera.mProjection));
 	Skybox::UpdateProjection(mCamera.mProjection);
 }
 
@@ -439,7 +490,7 @@ void Renderer::OnResize(u32 inWidth, u32 inHeight)
 	mWidth = inWidth;
 	mHeight = inHeight;
 
-	glViewport(0, 0, inWidth, inHeight);
+	GLState::Viewport(0, 0, inWidth, inHeight);
 
 	{
 		Skybox::UpdateProjection(mCamera.mProjection);
@@ -449,39 +500,19 @@ void Renderer::OnResize(u32 inWidth, u32 inHeight)
 
 		mSsaoShader.Use();
 		mSsaoShader.SetMat4("uProjection", mCamera.mProjection);
-	}
-
-	{
-		for (u32 i = 0; i < mBloomMipChain.size(); i++)
-			glDeleteTextures(1, &mBloomMipChain[i].mID);
+		mSsaoShader.SetMat4("uInvProjection", glm::inverse(mCamera.mProjection));
+		mSsaoDownsampleShader.SetMat4("uInvProjection", glm::inverse(mCamera.mProjection));
+		mSsaoUpsampleShader.SetMat4("uInvProjection", glm::inverse(mCamera.mProjection));
 
-		mBloomMipChain.clear();
-		glDeleteFramebuffers(1, &mBloomFBO);
-		bloomSetup();
-	}
-
-	{
-		glDeleteRenderbuffers(1, &mDepthRBO);
-		glCreateRenderbuffers(1, &mDepthRBO);
-		glNamedRenderbufferStorage(mDepthRBO, GL_DEPTH_COMPONENT24, mWidth, mHeight);
-	}
-
-	glNamedFramebufferRenderbuffer(mDeferredFBO, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepthRBO);
-	if (glCheckNamedFramebufferStatus(mDeferredFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		puts("Error: Failed to update depth renderbuffer size (for deferred FBO).\n");
-		exit(1);
+		mLightingShader.SetMat4("uInvProjection", glm::inverse(mCamera.mProjection));
 	}
 
-	glNamedFramebufferRenderbuffer(mLightingFBO, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepthRBO);
-	if (glCheckNamedFramebufferStatus(mLightingFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		puts("Error: Failed to update depth renderbuffer size (for lighting FBO).\n");
+	// the transient targets are recreated by the next Render(), the size is part of the graph key
+	if (!createDepthTarget())
 		exit(1);
-	}
 
 	auto resizeTexAndUpdateFBO = [&](u32* ioTexId, u32 inFBO, u32 inAttachment, u32 inInternalFormat) {
-		glDeleteTextures(1, ioTexId);
+		GLState::DeleteTextures(1, ioTexId);
 		glCreateTextures(GL_TEXTURE_2D, 1, ioTexId);
 		glTextureParameteri(*ioTexId, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTextureParameteri(*ioTexId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -495,18 +526,15 @@ void Renderer::OnResize(u32 inWidth, u32 inHeight)
 		}
 	};
 
-	resizeTexAndUpdateFBO(&mAlbedoTex, mDeferredFBO, GL_COLOR_ATTACHMENT0, GL_RGBA16F);
-	resizeTexAndUpdateFBO(&mSpecularTex, mDeferredFBO, GL_COLOR_ATTACHMENT1, GL_RGBA16F);
-	resizeTexAndUpdateFBO(&mNormalTex, mDeferredFBO, GL_COLOR_ATTACHMENT2, GL_RGBA16F);
-	resizeTexAndUpdateFBO(&mPositionTex, mDeferredFBO, GL_COLOR_ATTACHMENT3, GL_RGBA32F);
-	
 	resizeTexAndUpdateFBO(&mLightingTex, mLightingFBO, GL_COLOR_ATTACHMENT0, GL_RGBA16F);
-	resizeTexAndUpdateFBO(&mHdrTex, mHdrFBO, GL_COLOR_ATTACHMENT0, GL_RGBA8);
-
-	resizeTexAndUpdateFBO(&mSsaoTex, mSsaoFBO, GL_COLOR_ATTACHMENT0, GL_RGBA16F);
-	resizeTexAndUpdateFBO(&mSsaoBlurTex, mSsaoBlurFBO, GL_COLOR_ATTACHMENT0, GL_RGBA16F);
 
-	resizeTexAndUpdateFBO(&mFxaaTex, mFxaaFBO, GL_COLOR_ATTACHMENT0, GL_RGBA8);
+	// the horizon occlusion and temporal anti-aliasing targets are only created once they are selected
+	if (mGtaoTex[0] != 0)
+		createGtaoTargets();
+	if (mTaaTex[0] != 0)
+		createTaaTargets();
+	if (mHiZTex != 0)
+		createHiZTarget();
 }
 
 void Renderer::BeginUI()
@@ -516,451 +544,1716 @@ void Renderer::BeginUI()
 	ImGui::NewFrame();
 }
 
-void Renderer::Render(f32 inDeltaTime, f32 inCurrentTime)
+bool Renderer::createDepthTarget()
 {
-	glDisable(GL_BLEND);
+	GLState::DeleteTextures(1, &mDepthTex);
+	Mem::ReportFree(mDepthSizeBytes, EMemSource::RendererVRAM);
 
-	{ // render geometry data to g-buffer
-		GL_ZONE("Render G-Buffer");
-		ZoneScopedN("Render G-Buffer");
-		mDeferredShader.Use();
-		glBindFramebuffer(GL_FRAMEBUFFER, mDeferredFBO);
-		glEnable(GL_DEPTH_TEST);
+	// the packed layout samples the depth to reconstruct the position
+	glCreateTextures(GL_TEXTURE_2D, 1, &mDepthTex);
+	GL_LABEL(GL_TEXTURE, mDepthTex, "G Depth");
+	glTextureParameteri(mDepthTex, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(mDepthTex, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureStorage2D(mDepthTex, 1, GL_DEPTH_COMPONENT24, mWidth, mHeight);
 
-		glClearColor(0.1f, 0.14f, 0.21f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		mDeferredShader.SetMat4("uView", mCamera.mView);
-		renderMeshes(mDeferredShader);
+	mDepthSizeBytes = (usize)4 * mWidth * mHeight;
+	Mem::ReportAlloc(mDepthSizeBytes, EMemSource::RendererVRAM);
 
-		GL_ZONE_END();
+	glNamedFramebufferTexture(mDeferredFBO, GL_DEPTH_ATTACHMENT, mDepthTex, 0);
+
+	// the transparent meshes and the skybox are depth tested against the G-buffer depth
+	glNamedFramebufferTexture(mLightingFBO, GL_DEPTH_ATTACHMENT, mDepthTex, 0);
+	if (glCheckNamedFramebufferStatus(mLightingFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		puts("Error: Failed to create lighting framebuffer.\n");
+		return false;
 	}
+	glNamedFramebufferTexture(mOitFBO, GL_DEPTH_ATTACHMENT, mDepthTex, 0);
 
-	GL_ZONE("SSAO");
-	{ // calculate SSAO
-		GL_ZONE("Calculate Occlusion");
-		ZoneScopedN("Calculate SSAO");
+	return true;
+}
 
-		mSsaoShader.Use();
-		glBindFramebuffer(GL_FRAMEBUFFER, mSsaoFBO);
+void Renderer::createGtaoTargets()
+{
+	GLState::DeleteTextures(2, mGtaoTex);
+	GLState::DeleteTextures(2, mGtaoViewZTex);
+
+	auto createTarget = [this](u32* outTex, u32 inInternalFormat, u32 inFilter, const char* inName) {
+		glCreateTextures(GL_TEXTURE_2D, 1, outTex);
+		GL_LABEL(GL_TEXTURE, *outTex, inName);
+		glTextureParameteri(*outTex, GL_TEXTURE_MIN_FILTER, inFilter);
+		glTextureParameteri(*outTex, GL_TEXTURE_MAG_FILTER, inFilter);
+		glTextureParameteri(*outTex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(*outTex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTextureStorage2D(*outTex, 1, inInternalFormat, mWidth, mHeight);
+	};
 
-		glDisable(GL_DEPTH_TEST);
+	for (u32 i = 0; i < 2; i++)
+	{
+		// the history is reprojected at subpixel positions
+		createTarget(&mGtaoTex[i], GL_RGBA16F, GL_LINEAR, "GTAO Texture");
+		// a filtered z would blend both sides of an edge and never match
+		createTarget(&mGtaoViewZTex[i], GL_R32F, GL_NEAREST, "GTAO View Z");
+	}
 
-		glBindTextureUnit(0, mPositionTex);
-		glBindTextureUnit(1, mNormalTex);
-		glBindTextureUnit(2, mSsaoNoiseTex);
+	mGtaoHistoryValid = false;
+}
 
-		glBindVertexArray(mFullScreenQuadVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-		GL_ZONE_END();
+void Renderer::createTaaTargets()
+{
+	GLState::DeleteTextures(2, mTaaTex);
+
+	for (u32 i = 0; i < 2; i++)
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &mTaaTex[i]);
+		GL_LABEL(GL_TEXTURE, mTaaTex[i], "TAA Texture");
+		// the history is reprojected at subpixel positions
+		glTextureParameteri(mTaaTex[i], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(mTaaTex[i], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(mTaaTex[i], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(mTaaTex[i], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTextureStorage2D(mTaaTex[i], 1, GL_RGBA16F, mWidth, mHeight);
 	}
 
-	{ // blur SSAO output
-		GL_ZONE("Blur Occlusion");
-		ZoneScopedN("Blur SSAO");
+	mTaaHistoryValid = false;
+}
 
-		mSsaoBlurShader.Use();
-		glBindFramebuffer(GL_FRAMEBUFFER, mSsaoBlurFBO);
+void Renderer::updateSsaoKernel()
+{
+	const u32 sampleCount = glm::clamp(mSettings.mSsaoSampleCount, 1u, kMaxSsaoSamples);
 
-		glDisable(GL_DEPTH_TEST);
+	mSsaoKernel.resize(sampleCount);
+	for (u32 i = 0; i < sampleCount; i++)
+	{
+		glm::vec3 sample(
+			Utils::RandomBetween(-1.0f, 1.0f),
+			Utils::RandomBetween(-1.0f, 1.0f),
+			Utils::RandomBetween(0.0f, 1.0f)
+		);
 
-		glBindTextureUnit(0, mSsaoTex);
+		sample = glm::normalize(sample);
+		sample *= Utils::RandomBetween(0.0f, 1.0f);
 
-		glBindVertexArray(mFullScreenQuadVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-		GL_ZONE_END();
+		// more samples close to the pixel
+		f32 scale = (f32)i / (f32)sampleCount;
+		scale = glm::mix(0.1f, 1.0f, scale * scale);
+		sample *= scale;
+
+		mSsaoKernel[i] = sample;
 	}
-	GL_ZONE_END();
+}
 
-	glm::mat4 cascadeMatrices[kCascadeCount];
-	glm::vec4 viewCorners[8];
+void Renderer::selectPermutations()
+{
+	u32 lighting = 0;
+	if (mSettings.mEnableSSAO)
+		lighting |= kLightingSSAO;
+	if (mSettings.mCsmDebug)
+		lighting |= kLightingCsmDebug;
+	if (mGBufferPacked)
+		lighting |= kLightingPackedGBuffer;
+	mLightingShader.SetPermutation(lighting);
+
+	mPostFxShader.SetPermutation(mSettings.mEnableCLUT ? kPostFxCLUT : 0);
+	mDeferredShader.SetPermutation(mGBufferPacked ? kDeferredPackedGBuffer : 0);
+	// the low resolution SSAO reads the downsampled G-buffer, whatever its layout
+	if (mSsaoDivisor > 1)
+		mSsaoShader.SetPermutation(kSsaoLowRes);
+	else
+		mSsaoShader.SetPermutation(mGBufferPacked ? kSsaoPackedGBuffer : 0);
+	mSsaoDownsampleShader.SetPermutation(mGBufferPacked ? kSsaoResamplePackedGBuffer : 0);
+	mSsaoUpsampleShader.SetPermutation(mGBufferPacked ? kSsaoResamplePackedGBuffer : 0);
+
+	const ETransparency transparency = mSettings.mTransparency;
+	if (transparency == ETransparency::WeightedBlended)
+		mTransparentShader.SetPermutation(kTransparentWeightedBlended);
+	else if (transparency == ETransparency::LinkedList)
+		mTransparentShader.SetPermutation(kTransparentLinkedList);
+	else
+		mTransparentShader.SetPermutation(0);
+	mOitResolveShader.SetPermutation(transparency == ETransparency::LinkedList ? kOitResolveLinkedList : 0);
+}
 
-	//DebugDraw::AddLine({
-	//	.mFrom = gSunPos,
-	//	.mTo = glm::vec3(-10.0f, 0.0f, 0.0f),
-	//	.mStyle = DebugDraw::ELineStyle::Arrow,
-	//	.mColor = glm::vec3(1.0f, 0.0f, 0.0f),
-	//	.mLifetime = 1
-	//});
+void Renderer::updateRenderScale()
+{
+	ZoneScopedN("Update Render Scale");
+
+	// the scale of this frame goes in the slot of the frame the profiler just read
+	const u32 slot = GpuProfiler::GetFrame() % kGpuTimerLatency;
+	u32 frame = 0;
+	f32 ms = 0.0f;
+	// a frame read late, or not at all, has its slot already replaced
+	if (GpuProfiler::GetSpanMs(kGBufferZone, kPostFxZone, &ms, &frame) && frame + kGpuTimerLatency == GpuProfiler::GetFrame())
+	{
+		mGpuTimeMs = ms;
+		if (mSettings.mDynamicResolution && mGpuTimeMs > 0.0f)
+		{
+			// the cost of the scaled passes follows their pixel count, the square of the scale
+			const f32 scale = mGpuTimerScales[slot] * std::sqrt(mSettings.mTargetGpuTimeMs / mGpuTimeMs);
+			// only a part of the way, so a single slow frame doesn't change the resolution
+			mRenderScale = glm::mix(mRenderScale, scale, kRenderScaleRate);
+		}
+	}
 
+	mSettings.mMinRenderScale = glm::clamp(mSettings.mMinRenderScale, 0.25f, 1.0f);
+	if (mSettings.mDynamicResolution)
+		mRenderScale = glm::clamp(mRenderScale, mSettings.mMinRenderScale, 1.0f);
+	else
+		mRenderScale = 1.0f;
+	mGpuTimerScales[slot] = mRenderScale;
+
+	mRenderWidth		= std::max((u32)((f32)mWidth * mRenderScale + 0.5f), 1u);
+	mRenderHeight		= std::max((u32)((f32)mHeight * mRenderScale + 0.5f), 1u);
+	mRenderUVScale		= glm::vec2((f32)mRenderWidth / (f32)mWidth, (f32)mRenderHeight / (f32)mHeight);
+	// rounded like SsaoUpsample.frag
+	mSsaoRenderWidth	= std::max((u32)((f32)mSsaoWidth * mRenderUVScale.x + 0.5f), 1u);
+	mSsaoRenderHeight	= std::max((u32)((f32)mSsaoHeight * mRenderUVScale.y + 0.5f), 1u);
+
+	u32 width = mRenderWidth;
+	u32 height = mRenderHeight;
+	for (BloomMip& mip : mBloomMipChain)
 	{
-		GL_ZONE("Sun Shadow Map");
-		ZoneScopedN("Sun Shadow Map");
-
-		glBindFramebuffer(GL_FRAMEBUFFER, mShadowMapFBO);
-		glViewport(0, 0, kShadowQuality, kShadowQuality);
-		glClear(GL_DEPTH_BUFFER_BIT);
-
-		// city cfg
-		//constexpr f32 kNearPlane		= 0.0001f;
-		//constexpr f32 kFarPlane			= 200.0f;
-		//constexpr f32 kShadowMapSize	= 100.0f;
-
-		// sponza cfg
-		//constexpr f32 kNearPlane		= 0.1f;
-		//constexpr f32 kFarPlane			= 100.0f;
-		//constexpr f32 kShadowMapSize	= 50.0f;
-
-		//glm::mat4 lightProjection = glm::ortho(
-		//	-kShadowMapSize, kShadowMapSize,
-		//	-kShadowMapSize, kShadowMapSize,
-		//	kNearPlane, kFarPlane
-		//);
-
-		//glm::vec3 camPosXZ(mCamera.mPos.x, 0.0f, mCamera.mPos.z);
-
-		// city cfg
-		//glm::mat4 lightView = glm::lookAt(
-		//	gSunPos,
-		//	glm::vec3(60.0f, 0.0f, 60.0f),
-		//	glm::vec3(0.0f, 1.0f, 0.0f)
-		//);
-
-		// sponza cfg
-		//glm::mat4 lightView = glm::lookAt(
-		//	glm::vec3(3.6f, 97.0f, 7.1f),
-		//	glm::vec3(0.0f),
-		//	glm::vec3(0.0f, 1.0f, 0.0f)
-		//);
-
-		getLightSpaceMatrices(cascadeMatrices);
-
-		mLightingShader.Use();
-		mLightingShader.SetVec3("uDirLight.mDirection", glm::normalize(gSunPos));
-		for (u32 i = 0; i < kCascadeCount; i++)
-			mLightingShader.SetMat4("uCascadeMatrices[" + std::to_string(i) + "]", cascadeMatrices[i]);
-
-		mTransparentShader.Use();
-		for (u32 i = 0; i < kCascadeCount; i++)
-			mTransparentShader.SetMat4("uCascadeMatrices[" + std::to_string(i) + "]", cascadeMatrices[i]);
-
-		mShadowMapShader.Use();
-		for (u32 i = 0; i < kCascadeCount; i++)
-			mShadowMapShader.SetMat4("uCascadeMatrices[" + std::to_string(i) + "]", cascadeMatrices[i]);
-
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_DEPTH_CLAMP);
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_FRONT);
-		renderMeshes(mShadowMapShader);
-		glDisable(GL_DEPTH_CLAMP);
-		glCullFace(GL_BACK);
-		glDisable(GL_CULL_FACE);
-
-		// reset the viewport to normal size
-		glViewport(0, 0, mWidth, mHeight);
-		GL_ZONE_END();
+		width	= std::max(width / 2, 1u);
+		height	= std::max(height / 2, 1u);
+		mip.mRenderSize = glm::vec2((f32)width, (f32)height);
 	}
 
-	{ // apply lighting in screen space
-		GL_ZONE("Deferred Lighting");
-		ZoneScopedN("Deferred Lighting");
-
-		glBlitNamedFramebuffer(
-			mDeferredFBO, mLightingFBO,
-			0, 0, mWidth, mHeight,
-			0, 0, mWidth, mHeight,
-			GL_DEPTH_BUFFER_BIT, GL_NEAREST
-		);
+	const RenderScaleUniforms uniforms = { mRenderUVScale, glm::ivec2(mRenderWidth, mRenderHeight) };
+	glNamedBufferSubData(mRenderScaleUBO, 0, sizeof(RenderScaleUniforms), &uniforms);
+}
 
-		glBindFramebuffer(GL_FRAMEBUFFER, mLightingFBO);
+void Renderer::readOverdrawStats()
+{
+	u32 frame = 0;
+	f32 ms = 0.0f;
+	if (!GpuProfiler::GetSpanMs(kGBufferZone, kGBufferZone, &ms, &frame) || frame + kGpuTimerLatency != GpuProfiler::GetFrame())
+		return;
 
-		glDisable(GL_DEPTH_TEST);
-		mLightingShader.Use();
-		mLightingShader.SetVec3("uViewPos", mCamera.mPos);
-		mLightingShader.SetMat4("uView", mCamera.mView);
-		mLightingShader.SetInt("uEnableSSAO", (i32)mSettings.mEnableSSAO);
+	// the queries ended before the zone, they are done when it is
+	const u32 slot = frame % kGpuTimerLatency;
+	mOverdrawStats.mGBufferMs = ms;
 
-		// Optimize: sending these uniforms when they change only
-		mLightingShader.SetUint("uNumPointLights", mPointLights.size());
-		for (u32 i = 0; i < mPointLights.size(); i++)
-		{
-			mLightingShader.SetVec3("uPointLights[" + std::to_string(i) + "].mPosition", mPointLights[i]->mPosition);
-			mLightingShader.SetVec3("uPointLights[" + std::to_string(i) + "].mColor", mPointLights[i]->mColor);
-			mLightingShader.SetFloat("uPointLights[" + std::to_string(i) + "].mLinear", mPointLights[i]->mLinear);
-			mLightingShader.SetFloat("uPointLights[" + std::to_string(i) + "].mQuadratic", mPointLights[i]->mQuadratic);
-		}
+	mOverdrawStats.mFragments = 0;
+	for (u32 i = 0; i < mGBufferFragmentQueryCounts[slot]; i++)
+	{
+		u64 fragments = 0;
+		glGetQueryObjectui64v(mGBufferFragmentQueries[2 * slot + i], GL_QUERY_RESULT, &fragments);
+		mOverdrawStats.mFragments += fragments;
+	}
 
-		for (u32 i = 0; i < kFrustumCount; i++)
-		{
-			mLightingShader.SetFloat("uShadowCascadeLevels[" + std::to_string(i) + "]", gShadowCascadeLevels[i]);
-		}
+	// the pixels of the frame the queries were taken in
+	const f32 scale = mGpuTimerScales[slot];
+	const f32 pixels = std::max((f32)mWidth * scale, 1.0f) * std::max((f32)mHeight * scale, 1.0f);
+	mOverdrawStats.mOverdraw = (f32)mOverdrawStats.mFragments / pixels;
+}
 
-		glBindTextureUnit(0, mAlbedoTex);
-		glBindTextureUnit(1, mSpecularTex);
-		glBindTextureUnit(2, mNormalTex);
-		glBindTextureUnit(3, mPositionTex);
-		glBindTextureUnit(4, mSsaoBlurTex);
-		glBindTextureUnit(5, mCascadeTexArray);
+void Renderer::updateFrameLights(const glm::mat4 inCascadeMatrices[kCascadeCount], u32 inCascadeCount)
+{
+	static_assert(sizeof(FrameLightsUniforms::mCascadeMatrices) / sizeof(glm::mat4) == kCascadeCount, "MAX_CASCADES");
+	ZR_ASSERT(mPointLights.size() <= FrameLightsUniforms::kMaxPointLights, "Too many point lights.");
 
-		glBindVertexArray(mFullScreenQuadVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-		GL_ZONE_END();
+	FrameLightsUniforms uniforms{};
+	uniforms.mNumPointLights = (u32)mPointLights.size();
+	for (u32 i = 0; i < uniforms.mNumPointLights; i++)
+	{
+		const Geom::PointLight& light = *mPointLights[i];
+		uniforms.mPointLights[i] = { light.mPosition, light.mLinear, light.mColor, light.mQuadratic };
 	}
 
-	{ // render transparent meshes by forward rendering
-		GL_ZONE("Transparent Meshes (Fwd Rendering)");
-		ZoneScopedN("Transparent Meshes (Fwd Rendering)");
+	uniforms.mDirLightDirection	= glm::normalize(gSunPos);
+	uniforms.mDirLightColor		= kSunColor;
+	uniforms.mCascadeCount		= (i32)inCascadeCount;
+	for (u32 i = 0; i < inCascadeCount; i++)
+	{
+		uniforms.mCascadeMatrices[i]	= inCascadeMatrices[i];
+		uniforms.mCascadeLevels[i]		= mCascadeSplits[i];
+	}
+
+	glNamedBufferSubData(mFrameLightsUBO, 0, sizeof(FrameLightsUniforms), &uniforms);
+}
 
-		glBindFramebuffer(GL_FRAMEBUFFER, mLightingFBO);
+void Renderer::readTransparencyStats()
+{
+	u32 frame = 0;
+	f32 ms = 0.0f;
+	if (!GpuProfiler::GetSpanMs(kTransparentZone, kTransparentZone, &ms, &frame) || frame + kGpuTimerLatency != GpuProfiler::GetFrame())
+		return;
+
+	const u32 slot = frame % kGpuTimerLatency;
+	const ETransparency mode = mTransparentTimerModes[slot];
+	mTransparencyStats.mMs[(u32)mode] = ms;
+	// the counter was copied before the zone ended, so reading it doesn't wait
+	if (mode == ETransparency::LinkedList)
+		glGetNamedBufferSubData(mOitNodeCountBuffer, slot * sizeof(u32), sizeof(u32), &mTransparencyStats.mNodes);
+
+	auto& benchmark = mTransparencyBenchmark;
+	if (benchmark.mActive && (u32)mode == benchmark.mMode && benchmark.mSamples < kTransparencyBenchmarkFrames)
+	{
+		benchmark.mMsSum += ms;
+		benchmark.mSamples++;
+	}
+}
 
-		mTransparentShader.Use();
+void Renderer::BenchmarkTransparency()
+{
+	if (mTransparencyBenchmark.mActive)
+		return;
+
+	mTransparencyBenchmark			= {};
+	mTransparencyBenchmark.mActive	= true;
+	mTransparencyBenchmark.mPrevMode	= mSettings.mTransparency;
+	mSettings.mTransparency			= ETransparency::Sorted;
+	puts("Benchmarking the transparency modes, keep the camera still.");
+}
 
-		for (u32 i = 0; i < kFrustumCount; i++)
+void Renderer::updateTransparencyBenchmark()
+{
+	auto& benchmark = mTransparencyBenchmark;
+	// the transparent pass reads the lighting back once the mode has its samples
+	if (!benchmark.mActive || benchmark.mImage.empty())
+		return;
+
+	const u32 mode = benchmark.mMode;
+	benchmark.mMs[mode] = (f32)(benchmark.mMsSum / std::max(benchmark.mSamples, 1u));
+	if (mode == (u32)ETransparency::Sorted)
+	{
+		benchmark.mReference		= std::move(benchmark.mImage);
+		benchmark.mReferenceSize	= benchmark.mImageSize;
+		benchmark.mError[mode]		= 0.0f;
+	} else if (benchmark.mImageSize == benchmark.mReferenceSize)
+	{
+		f64 sum = 0.0;
+		for (usize i = 0; i < benchmark.mImage.size(); i++)
 		{
-			mTransparentShader.SetFloat("uShadowCascadeLevels[" + std::to_string(i) + "]", gShadowCascadeLevels[i]);
+			const glm::vec3 difference = glm::vec3(benchmark.mImage[i]) - glm::vec3(benchmark.mReference[i]);
+			sum += glm::dot(difference, difference) / 3.0f;
 		}
+		benchmark.mError[mode] = (f32)glm::sqrt(sum / std::max(benchmark.mImage.size(), (usize)1));
+	} else
+	{
+		// the render scale changed in between
+		benchmark.mError[mode] = -1.0f;
+	}
 
-		mTransparentShader.SetMat4("uView", mCamera.mView);
-		mTransparentShader.SetMat4("uProjection", mCamera.mProjection);
-		mTransparentShader.SetVec3("uViewPos", mCamera.mPos);
+	benchmark.mImage.clear();
+	benchmark.mMsSum	= 0.0;
+	benchmark.mSamples	= 0;
+	benchmark.mMode++;
+	if (benchmark.mMode < kTransparencyModeCount)
+	{
+		mSettings.mTransparency = (ETransparency)benchmark.mMode;
+		return;
+	}
 
-		// OPTIMIZE: sending these uniforms when they change only
-		mTransparentShader.SetUint("uNumPointLights", mPointLights.size());
-		for (u32 i = 0; i < mPointLights.size(); i++)
-		{
-			mTransparentShader.SetVec3("uPointLights[" + std::to_string(i) + "].mPosition", mPointLights[i]->mPosition);
-			mTransparentShader.SetVec3("uPointLights[" + std::to_string(i) + "].mColor", mPointLights[i]->mColor);
-			mTransparentShader.SetFloat("uPointLights[" + std::to_string(i) + "].mLinear", mPointLights[i]->mLinear);
-			mTransparentShader.SetFloat("uPointLights[" + std::to_string(i) + "].mQuadratic", mPointLights[i]->mQuadratic);
-		}
+	static const char* kModeNames[kTransparencyModeCount] = { "Sorted", "Weighted Blended", "Linked List" };
+	printf("Transparency benchmark, %u frames per mode at %ux%u:\n", kTransparencyBenchmarkFrames, benchmark.mReferenceSize.x, benchmark.mReferenceSize.y);
+	for (u32 i = 0; i < kTransparencyModeCount; i++)
+		printf("    %-16s %.3f ms, RMSE against sorted %.5f\n", kModeNames[i], benchmark.mMs[i], benchmark.mError[i]);
 
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glEnable(GL_DEPTH_TEST);
+	benchmark.mActive		= false;
+	benchmark.mDone			= true;
+	benchmark.mReference.clear();
+	mSettings.mTransparency	= benchmark.mPrevMode;
+}
 
-		glBindTextureUnit(3, mCascadeTexArray);
+void Renderer::createOitNodes()
+{
+	const u32 capacity = mWidth * mHeight * kOitNodesPerPixel;
+	if (mOitNodeCapacity >= capacity)
+		return;
+
+	glDeleteBuffers(1, &mOitNodeSSBO);
+	Mem::ReportFree((usize)kOitNodeSize * mOitNodeCapacity, EMemSource::RendererVRAM);
+
+	// the counter is padded to the size of a node, see `Transparent.frag`
+	glCreateBuffers(1, &mOitNodeSSBO);
+	GL_LABEL(GL_BUFFER, mOitNodeSSBO, "OIT Nodes");
+	glNamedBufferStorage(mOitNodeSSBO, (GLsizeiptr)kOitNodeSize * (capacity + 1), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	mOitNodeCapacity = capacity;
+	Mem::ReportAlloc((usize)kOitNodeSize * mOitNodeCapacity, EMemSource::RendererVRAM);
+}
 
-		for (u32 i = 0; i < mTransparentMeshes.size(); i++)
-		{
-			const Geom::Mesh* mesh = mTransparentMeshes[i];
+u64 Renderer::frameGraphKey() const
+{
+	// everything the passes or the transient targets depend on
+	const u32 key[] = {
+		mWidth,
+		mHeight,
+		mSettings.mPackedGBuffer,
+		mSettings.mEnableSSAO,
+		(u32)mSettings.mAmbientOcclusion,
+		mSettings.mSsaoResolutionDivisor,
+		mSettings.mBloomMipCount,
+		mSettings.mEnableAutoExposure,
+		mSettings.mDynamicResolution,
+		(u32)mSettings.mAntiAliasing,
+		mSettings.mSampleDistribution,
+		(u32)mSettings.mTransparency,
+	};
+	return Utils::Hash64(key, sizeof(key));
+}
 
-			if (mesh->mOpacityTexture)
-				mTransparentShader.SetInt("uUseTransparencyTex", true);
-			else if (mesh->mDiffuseTexture->mHasTransparency)
-				mTransparentShader.SetInt("uUseTransparencyTex", false);
-			else
-				ZR_ASSERT(false, "");
+bool Renderer::buildFrameGraph()
+{
+	ZoneScopedN("Build Frame Graph");
 
-			mTransparentShader.SetMat4("uModel", mesh->mTransform);
-			mesh->Draw();
-		}
+	mGBufferPacked = mSettings.mPackedGBuffer;
 
-		mTransparentMeshes.clear();
+	ZR_ASSERT(
+		mSettings.mSsaoResolutionDivisor == 1 || mSettings.mSsaoResolutionDivisor == 2 || mSettings.mSsaoResolutionDivisor == 4,
+		"The SSAO resolution divisor must be 1, 2 or 4."
+	);
+	mSsaoDivisor	= mSettings.mSsaoResolutionDivisor;
+	mSsaoWidth		= std::max(mWidth / mSsaoDivisor, 1u);
+	mSsaoHeight		= std::max(mHeight / mSsaoDivisor, 1u);
 
-		glDisable(GL_BLEND);
-		glDisable(GL_DEPTH_TEST);
+	mSettings.mBloomMipCount = glm::clamp(mSettings.mBloomMipCount, 1u, kMaxBloomMips);
+	mBloomMipChain.resize(mSettings.mBloomMipCount);
 
-		GL_ZONE_END();
+	const bool horizonOcclusion	= mSettings.mEnableSSAO && mSettings.mAmbientOcclusion == EAmbientOcclusion::Horizon;
+	const bool lowResSsao		= mSsaoDivisor > 1;
+	const bool temporal			= mSettings.mAntiAliasing == EAntiAliasing::Temporal;
+	const bool fxaa				= mSettings.mAntiAliasing == EAntiAliasing::FXAA;
+	const bool sampleDistribution	= mSettings.mSampleDistribution;
+
+	FrameGraph& graph = mFrameGraph;
+	graph.Reset();
+
+	auto target = [this](u32 inDivisor, u32 inInternalFormat, u32 inFilter) {
+		return FGTextureDesc{ std::max(mWidth / inDivisor, 1u), std::max(mHeight / inDivisor, 1u), inInternalFormat, inFilter };
+	};
+
+	const FGResource depth		= graph.Import("G Depth", mDepthTex);
+	const FGResource lighting	= graph.Import("Deferred Lighting", mLightingTex);
+	const FGResource cascades	= graph.Import("CSM Tex Array", mCascadeTexArray);
+	// the pass picks one of the two targets every frame
+	const FGResource gtao		= graph.Import("GTAO Texture", 0);
+	const FGResource taa		= graph.Import("TAA Texture", 0);
+	const FGResource exposure	= graph.Import("Exposure", mLumaSSBO);
+	// a buffer of the readback ring every frame
+	const FGResource depthBounds	= graph.Import("Depth Bounds", 0);
+	const FGResource backBuffer	= graph.Import("Back Buffer", 0);
+	graph.MarkOutput(backBuffer);
+
+	FGResource albedo;
+	FGResource specular;
+	FGResource normal;
+	FGResource position = depth;
+	if (mGBufferPacked)
+	{
+		// specular is in the alpha channel, which is always linear
+		albedo		= graph.CreateTexture("G Albedo Specular", target(1, GL_SRGB8_ALPHA8, GL_LINEAR));
+		normal		= graph.CreateTexture("G Normal (Octahedral)", target(1, GL_RG16, GL_NEAREST));
+		gMemGBufferBytesPerPixel = 4 + 4 + 4;
+	} else
+	{
+		albedo		= graph.CreateTexture("G Albedo", target(1, GL_RGBA16F, GL_LINEAR));
+		specular	= graph.CreateTexture("G Specular", target(1, GL_RGBA16F, GL_LINEAR));
+		normal		= graph.CreateTexture("G Normal", target(1, GL_RGBA16F, GL_LINEAR));
+		position	= graph.CreateTexture("G Position", target(1, GL_RGBA32F, GL_LINEAR));
+		gMemGBufferBytesPerPixel = 4 + 8 + 8 + 8 + 16;
 	}
 
-	// calculate lighting texture luma in compute shader
-	if (mSettings.mEnableAutoExposure)
+	FGResource velocity;
+	if (temporal)
 	{
-		GL_ZONE("Compute Scene Luma");
-		ZoneScopedN("Compute Luma");
+		velocity = graph.CreateTexture("G Velocity", target(1, GL_RG16F, GL_NEAREST));
+		gMemGBufferBytesPerPixel += 4;
+	}
+
+	{ // render geometry data to g-buffer
+		const u32 pass = graph.AddPass("G-Buffer", [this]() {
+			// the GPU time from here to the end of the post FX drives the render scale
+			GL_ZONE(kGBufferZone);
+			ZoneScopedN("Render G-Buffer");
+
+			const u32 slot = GpuProfiler::GetFrame() % kGpuTimerLatency;
+
+			mDeferredShader.Use();
+			GLState::BindFramebuffer(GL_FRAMEBUFFER, mDeferredFBO);
+			GLState::Viewport(0, 0, mRenderWidth, mRenderHeight);
+			GLState::Enable(GL_DEPTH_TEST);
+
+			// the packed albedo is sRGB, convert the linear output on write
+			if (mGBufferPacked)
+				GLState::Enable(GL_FRAMEBUFFER_SRGB);
+
+			glClearColor(0.1f, 0.14f, 0.21f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			mDeferredShader.SetMat4("uView", mCamera.mView);
+			mDeferredShader.SetMat4("uProjection", mJitteredProjection);
+			mDeferredShader.SetMat4("uViewProjection", mCamera.mProjection * mCamera.mView);
+			mDeferredShader.SetMat4("uPrevViewProjection", mPrevViewProjection);
+			mDepthPrepassShader.SetMat4("uView", mCamera.mView);
+			mDepthPrepassShader.SetMat4("uProjection", mJitteredProjection);
+
+			// every phase draws the same meshes twice with the prepass, the depth and then the shading
+			const bool prepass = mSettings.mDepthPrepass;
+			mGBufferFragmentQueryCounts[slot] = 0;
+			auto drawPhase = [this, prepass, slot](const std::function<void(bool)>& inDraw) {
+				if (prepass)
+				{
+					GL_ZONE("Depth Prepass");
+					glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+					GLState::DepthFunc(GL_LEQUAL);
+					GLState::DepthMask(GL_TRUE);
+					mDepthPrepassShader.Use();
+					inDraw(true);
+					glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+					GLState::DepthFunc(GL_EQUAL);
+					GLState::DepthMask(GL_FALSE);
+					GL_ZONE_END();
+				}
+
+				const u32 query = mGBufferFragmentQueries[2 * slot + mGBufferFragmentQueryCounts[slot]++];
+				glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, query);
+				mDeferredShader.Use();
+				inDraw(false);
+				glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+			};
+
+			if (mSettings.mOcclusionCulling)
+			{
+				if (mHiZTex == 0)
+					createHiZTarget();
+
+				updateCullObjects();
+
+				// the meshes visible last frame
+				dispatchOcclusionCull(1);
+				drawPhase([this](bool inDepthOnly) {
+					renderCulledMeshes(1, inDepthOnly);
+				});
+
+				// the meshes they don't hide
+				buildHiZ();
+				dispatchOcclusionCull(2);
+				drawPhase([this](bool inDepthOnly) {
+					renderCulledMeshes(2, inDepthOnly);
+				});
+			} else
+			{
+				SoftOcclusion* occlusion = nullptr;
+				if (mSettings.mSoftwareOcclusion)
+				{
+					mSoftOcclusion.Resize(
+						std::max(mWidth / kSoftOcclusionDivisor, 1u),
+						std::max(mHeight / kSoftOcclusionDivisor, 1u)
+					);
+					mSoftOcclusion.Rasterize(mOccluderMeshes, mCamera.mProjection * mCamera.mView, mJobSystem);
+					occlusion = &mSoftOcclusion;
+				}
+
+				glm::vec4 frustumPlanes[6];
+				getFrustumPlanes(frustumPlanes, mCamera.mProjection * mCamera.mView);
+
+				mVisibleDraws.mDraws.clear();
+				mVisibleDraws.mCommands.clear();
+				collectVisibleMeshes(mMeshes, frustumPlanes, occlusion);
+				collectVisibleMeshes(mDynamicMeshes, frustumPlanes, occlusion);
+				uploadIndirectDraws(&mVisibleDraws, "Visible Commands");
+				drawPhase([this](bool inDepthOnly) {
+					renderIndirectDraws(mVisibleDraws, inDepthOnly);
+				});
+			}
 
-		static const u32 zero = 0;
+			GLState::DepthFunc(GL_LEQUAL);
+			GLState::DepthMask(GL_TRUE);
+			GLState::Disable(GL_FRAMEBUFFER_SRGB);
 
+			GL_ZONE_END();
+		});
+		graph.Write(pass, albedo);
+		graph.Write(pass, normal);
+		graph.Write(pass, depth);
+		if (!mGBufferPacked)
 		{
-			ZoneScopedN("Dispatch Luma Comp");
-			glUseProgram(mLumaShader.mID);
-			glBindTextureUnit(0, mLightingTex);
-			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mLumaSSBO);
-			glDispatchCompute(mWidth, mHeight, 1);
-		}
-		{
-			ZoneScopedN("Barrier");
-			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			graph.Write(pass, specular);
+			graph.Write(pass, position);
 		}
+		if (temporal)
+			graph.Write(pass, velocity);
+	}
 
-		{
-			ZoneScopedN("Dispatch Exposure Comp");
-			glUseProgram(mExposureShader.mID);
-			glUniform1f(glGetUniformLocation(mExposureShader.mID, "uDeltaTime"), inDeltaTime);
-			glUniform2f(glGetUniformLocation(mExposureShader.mID, "uScreenSize"), mWidth, mHeight);
-			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mLumaSSBO);
-			glDispatchCompute(1, 1, 1);
-		}
-		{
-			ZoneScopedN("Barrier");
-			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-		}
+	// the hemisphere occlusion passes are culled when the lighting doesn't read their output
+	FGResource ssaoDepthNormal;
+	FGResource ssaoUpsampled;
+	if (lowResSsao)
+	{ // downsample the G-buffer depth and normals to the SSAO resolution
+		// view space z needs the full float precision
+		ssaoDepthNormal = graph.CreateTexture("SSAO Depth Normal", target(mSsaoDivisor, GL_RGBA32F, GL_NEAREST));
 
-		{
-			ZoneScopedN("Reset Total Luma");
-			glNamedBufferSubData(mLumaSSBO, OFFSETOF(LumaExposureComp, mTotalLuma), sizeof(u32), &zero);
-		}
+		const u32 pass = graph.AddPass("Downsample G-Buffer", [this]() {
+			GL_ZONE("Downsample G-Buffer");
+			ZoneScopedN("Downsample G-Buffer");
 
-		GL_ZONE_END();
-	}
+			GLState::Disable(GL_DEPTH_TEST);
+			GLState::BindVertexArray(mFullScreenQuadVAO);
+			GLState::Viewport(0, 0, mSsaoRenderWidth, mSsaoRenderHeight);
 
-	{ // draw the skybox using forward rendering and use deferred stage depth
-		GL_ZONE("Skybox");
-		ZoneScopedN("Render Skybox");
+			mSsaoDownsampleShader.Use();
+			mSsaoDownsampleShader.SetInt("uScale", (i32)mSsaoDivisor);
+			GLState::BindFramebuffer(GL_FRAMEBUFFER, mSsaoDepthNormalFBO);
 
-		// the lighting FBO is already bound for read and write
+			GLState::BindTextureUnit(0, mGBufferPacked ? mDepthTex : mPositionTex);
+			GLState::BindTextureUnit(1, mNormalTex);
 
-		glEnable(GL_DEPTH_TEST);
-		mSkybox.Draw(mCamera.mView);
-		GL_ZONE_END();
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+
+			GLState::Viewport(0, 0, mRenderWidth, mRenderHeight);
+			GL_ZONE_END();
+		});
+		graph.Read(pass, position);
+		graph.Read(pass, normal);
+		graph.Write(pass, ssaoDepthNormal);
 	}
 
-	{ // render bloom texture
-		GL_ZONE("Bloom");
-		ZoneScopedN("Render Bloom Texture");
+	// the occlusion is one channel
+	const FGResource ssao = graph.CreateTexture("SSAO Texture", target(mSsaoDivisor, GL_R16F, GL_NEAREST));
+	{ // calculate SSAO
+		const u32 pass = graph.AddPass("Calculate Occlusion", [this, lowResSsao]() {
+			GL_ZONE("Calculate Occlusion");
+			ZoneScopedN("Calculate SSAO");
 
-		glBindFramebuffer(GL_FRAMEBUFFER, mBloomFBO);
+			if (mSettings.mSsaoSampleCount != mSsaoKernel.size())
+			{
+				updateSsaoKernel();
+				for (u32 i = 0; i < mSsaoKernel.size(); i++)
+					mSsaoShader.SetVec3("uSamples[" + std::to_string(i) + "]", mSsaoKernel[i]);
+			}
 
-		{ // downsample
-			GL_ZONE("Downsample");
-			ZoneScopedN("Downsample Bloom");
+			GLState::Disable(GL_DEPTH_TEST);
+			GLState::BindVertexArray(mFullScreenQuadVAO);
+			GLState::Viewport(0, 0, mSsaoRenderWidth, mSsaoRenderHeight);
 
-			mBloomDownsampleShader.Use();
-			glBindTextureUnit(0, mLightingTex);
+			mSsaoShader.Use();
+			mSsaoShader.SetUint("uSampleCount", (u32)mSsaoKernel.size());
+			mSsaoShader.SetFloat("uRadius", mSettings.mSsaoRadius);
+			GLState::BindFramebuffer(GL_FRAMEBUFFER, mSsaoFBO);
 
-			// downscale and apply filter for each mip
-			for (u32 i = 0; i < mBloomMipChain.size(); i++)
+			if (lowResSsao)
 			{
-				const BloomMip& mip = mBloomMipChain[i];
-				glViewport(0, 0, mip.mSize.x, mip.mSize.y);
-				glNamedFramebufferTexture(mBloomFBO, GL_COLOR_ATTACHMENT0, mip.mID, 0);
+				GLState::BindTextureUnit(0, mSsaoDepthNormalTex);
+			} else
+			{
+				GLState::BindTextureUnit(0, mGBufferPacked ? mDepthTex : mPositionTex);
+				GLState::BindTextureUnit(1, mNormalTex);
+			}
+			GLState::BindTextureUnit(2, mSsaoNoiseTex);
 
-				glBindVertexArray(mFullScreenQuadVAO);
-				glDrawArrays(GL_TRIANGLES, 0, 6);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
 
-				glBindTextureUnit(0, mip.mID);
-			}
+			GLState::Viewport(0, 0, mRenderWidth, mRenderHeight);
 			GL_ZONE_END();
+		});
+		if (lowResSsao)
+		{
+			graph.Read(pass, ssaoDepthNormal);
+		} else
+		{
+			graph.Read(pass, position);
+			graph.Read(pass, normal);
 		}
+		graph.Write(pass, ssao);
+	}
 
-		{ // upsample
-			GL_ZONE("Upsample");
-			ZoneScopedN("Upsample Bloom");
-
-			mBloomUpsampleShader.Use();
-			mBloomUpsampleShader.SetFloat("uFilterRadius", 0.005f);
+	// linear so the upsample can fall back to a bilinear sample
+	const FGResource ssaoBlurred = graph.CreateTexture("SSAO Blur Texture", target(mSsaoDivisor, GL_R16F, GL_LINEAR));
+	{ // blur SSAO output
+		const u32 pass = graph.AddPass("Blur Occlusion", [this]() {
+			GL_ZONE("Blur Occlusion");
+			ZoneScopedN("Blur SSAO");
 
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_ONE, GL_ONE);
-			glBlendEquation(GL_FUNC_ADD);
+			GLState::Disable(GL_DEPTH_TEST);
+			GLState::BindVertexArray(mFullScreenQuadVAO);
+			GLState::Viewport(0, 0, mSsaoRenderWidth, mSsaoRenderHeight);
 
-			// reverse the downscale and apply filter for each mip
-			for (u32 i = mBloomMipChain.size() - 1; i > 0; i--)
-			{
-				const BloomMip& currentMip = mBloomMipChain[i];
-				const BloomMip& nextMip = mBloomMipChain[i - 1];
+			mSsaoBlurShader.Use();
+			GLState::BindFramebuffer(GL_FRAMEBUFFER, mSsaoBlurFBO);
 
-				glBindTextureUnit(0, currentMip.mID);
+			GLState::BindTextureUnit(0, mSsaoTex);
 
-				glViewport(0, 0, nextMip.mSize.x, nextMip.mSize.y);
-				glNamedFramebufferTexture(mBloomFBO, GL_COLOR_ATTACHMENT0, nextMip.mID, 0);
-				glBindVertexArray(mFullScreenQuadVAO);
-				glDrawArrays(GL_TRIANGLES, 0, 6);
-			}
+			glDrawArrays(GL_TRIANGLES, 0, 6);
 
-			glDisable(GL_BLEND);
+			GLState::Viewport(0, 0, mRenderWidth, mRenderHeight);
 			GL_ZONE_END();
-		}
-
-		glViewport(0, 0, mWidth, mHeight);
-		GL_ZONE_END();
+		});
+		graph.Read(pass, ssao);
+		graph.Write(pass, ssaoBlurred);
 	}
 
-	{ // render texture to full screen quad and apply post process
-		GL_ZONE("Post FX");
-		ZoneScopedN("Post FX");
+	if (lowResSsao)
+	{ // bring the blurred occlusion back to full resolution without bleeding over edges
+		ssaoUpsampled = graph.CreateTexture("SSAO Upsample Texture", target(1, GL_R16F, GL_NEAREST));
 
-		glBindFramebuffer(GL_FRAMEBUFFER, mHdrFBO);
+		const u32 pass = graph.AddPass("Upsample Occlusion", [this]() {
+			GL_ZONE("Upsample Occlusion");
+			ZoneScopedN("Upsample SSAO");
 
-		glDisable(GL_DEPTH_TEST);
+			GLState::Disable(GL_DEPTH_TEST);
+			GLState::BindVertexArray(mFullScreenQuadVAO);
 
-		mPostFxShader.Use();
-		mPostFxShader.SetInt("uEnableCLUT", (i32)mSettings.mEnableCLUT);
+			mSsaoUpsampleShader.Use();
+			GLState::BindFramebuffer(GL_FRAMEBUFFER, mSsaoUpsampleFBO);
 
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mLumaSSBO);
+			GLState::BindTextureUnit(0, mSsaoBlurTex);
+			GLState::BindTextureUnit(1, mSsaoDepthNormalTex);
+			GLState::BindTextureUnit(2, mGBufferPacked ? mDepthTex : mPositionTex);
+			GLState::BindTextureUnit(3, mNormalTex);
 
-		glBindTextureUnit(0, mLightingTex);
-		glBindTextureUnit(1, mBloomMipChain[0].mID);
-		glBindTextureUnit(2, mLensDirtTexture->mID);
-		glBindTextureUnit(3, mClutTex);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+			GL_ZONE_END();
+		});
+		graph.Read(pass, ssaoBlurred);
+		graph.Read(pass, ssaoDepthNormal);
+		graph.Read(pass, position);
+		graph.Read(pass, normal);
+		graph.Write(pass, ssaoUpsampled);
+	}
 
-		glBindVertexArray(mFullScreenQuadVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+	const u32 gtaoPass = graph.AddPass("GTAO", [this]() {
+		GL_ZONE("GTAO");
+		ZoneScopedN("GTAO");
+
+		if (mGtaoTex[0] == 0)
+			createGtaoTargets();
+
+		const u32 history = mGtaoCurrent;
+		const u32 current = history ^ 1;
+		const glm::mat4 currentToPrevView = mGtaoPrevView * glm::inverse(mCamera.mView);
+
+		GLState::UseProgram(mGtaoShader.mID);
+		glUniformMatrix4fv(glGetUniformLocation(mGtaoShader.mID, "uProjection"), 1, GL_FALSE, &mCamera.mProjection[0][0]);
+		glUniformMatrix4fv(glGetUniformLocation(mGtaoShader.mID, "uCurrentToPrevView"), 1, GL_FALSE, &currentToPrevView[0][0]);
+		glUniform1f(glGetUniformLocation(mGtaoShader.mID, "uRadius"), mSettings.mSsaoRadius);
+		glUniform1ui(glGetUniformLocation(mGtaoShader.mID, "uSliceCount"), std::max(mSettings.mGtaoSliceCount, 1u));
+		glUniform1ui(glGetUniformLocation(mGtaoShader.mID, "uStepCount"), std::max(mSettings.mGtaoStepCount, 1u));
+		glUniform1ui(glGetUniformLocation(mGtaoShader.mID, "uFrameIndex"), mFrameIndex);
+		glUniform1i(glGetUniformLocation(mGtaoShader.mID, "uHistoryValid"), mGtaoHistoryValid);
+		glUniform2fv(glGetUniformLocation(mGtaoShader.mID, "uHistoryScale"), 1, &mGtaoPrevRenderScale[0]);
+
+		GLState::BindTextureUnit(0, mDepthTex);
+		GLState::BindTextureUnit(1, mGtaoTex[history]);
+		GLState::BindTextureUnit(2, mGtaoViewZTex[history]);
+		glBindImageTexture(0, mGtaoTex[current], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		glBindImageTexture(1, mGtaoViewZTex[current], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		// 16x16 work groups, see GTAO.comp
+		glDispatchCompute((mRenderWidth + 15) / 16, (mRenderHeight + 15) / 16, 1);
+		// the lighting pass samples the output
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		mGtaoCurrent		= current;
+		mGtaoPrevView		= mCamera.mView;
+		mGtaoPrevRenderScale	= mRenderUVScale;
+		mGtaoHistoryValid	= true;
 		GL_ZONE_END();
+	});
+	graph.Read(gtaoPass, depth);
+	graph.Write(gtaoPass, gtao);
+
+	if (sampleDistribution)
+	{ // reduce the depth range and light space bounds the cascades are fitted to
+		const u32 pass = graph.AddPass("Depth Bounds", [this]() {
+			GL_ZONE("Depth Bounds");
+			ZoneScopedN("Depth Bounds");
+
+			reduceDepthBounds();
+
+			GL_ZONE_END();
+		});
+		graph.Read(pass, depth);
+		graph.Write(pass, depthBounds);
 	}
 
-	// fxaa cant anti alias lines :)
+	//DebugDraw::AddLine({
+	//	.mFrom = gSunPos,
+	//	.mTo = glm::vec3(-10.0f, 0.0f, 0.0f),
+	//	.mStyle = DebugDraw::ELineStyle::Arrow,
+	//	.mColor = glm::vec3(1.0f, 0.0f, 0.0f),
+	//	.mLifetime = 1
+	//});
 
-	// Note: always draw UI after FXAA
 	{
-		GL_ZONE("FXAA");
-		ZoneScopedN("Apply FXAA");
+		const u32 pass = graph.AddPass("Sun Shadow Map", [this, sampleDistribution]() {
+			GL_ZONE("Sun Shadow Map");
+			ZoneScopedN("Sun Shadow Map");
+
+			// city cfg
+			//constexpr f32 kNearPlane		= 0.0001f;
+			//constexpr f32 kFarPlane			= 200.0f;
+			//constexpr f32 kShadowMapSize	= 100.0f;
+
+			// sponza cfg
+			//constexpr f32 kNearPlane		= 0.1f;
+			//constexpr f32 kFarPlane			= 100.0f;
+			//constexpr f32 kShadowMapSize	= 50.0f;
+
+			//glm::mat4 lightProjection = glm::ortho(
+			//	-kShadowMapSize, kShadowMapSize,
+			//	-kShadowMapSize, kShadowMapSize,
+			//	kNearPlane, kFarPlane
+			//);
+
+			//glm::vec3 camPosXZ(mCamera.mPos.x, 0.0f, mCamera.mPos.z);
+
+			// city cfg
+			//glm::mat4 lightView = glm::lookAt(
+			//	gSunPos,
+			//	glm::vec3(60.0f, 0.0f, 60.0f),
+			//	glm::vec3(0.0f, 1.0f, 0.0f)
+			//);
+
+			// sponza cfg
+			//glm::mat4 lightView = glm::lookAt(
+			//	glm::vec3(3.6f, 97.0f, 7.1f),
+			//	glm::vec3(0.0f),
+			//	glm::vec3(0.0f, 1.0f, 0.0f)
+			//);
+
+			mSettings.mCascadeCount = glm::clamp(mSettings.mCascadeCount, 1u, kCascadeCount);
+			const u32 cascadeCount = mSettings.mCascadeCount;
+			updateCascadeSplits();
+
+			glm::mat4 cascadeMatrices[kCascadeCount];
+			getLightSpaceMatrices(cascadeMatrices);
+
+			const u32 usedCascades = (1u << cascadeCount) - 1;
+			// the layers rendered with every mesh, directly into the cascade array
+			u32 liveMask = usedCascades;
+			// the layers whose static meshes are rendered into the static cache
+			u32 staticMask = 0;
+			// the layers copied from the static cache with the dynamic meshes drawn over them
+			u32 compositeMask = 0;
+			if (mSettings.mCachedCascades && !sampleDistribution)
+			{
+				if (!mDynamicMeshes.empty() && mStaticCascadeTexArray == 0)
+				{
+					glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &mStaticCascadeTexArray);
+					GL_LABEL(GL_TEXTURE, mStaticCascadeTexArray, "Static CSM Tex Array");
+					glTextureStorage3D(mStaticCascadeTexArray, 1, GL_DEPTH_COMPONENT16, kShadowQuality, kShadowQuality, kCascadeCount);
+					Mem::ReportAlloc((usize)2 * kShadowQuality * kShadowQuality * kCascadeCount, EMemSource::RendererVRAM);
+
+					glCreateFramebuffers(1, &mStaticShadowMapFBO);
+					GL_LABEL(GL_FRAMEBUFFER, mStaticShadowMapFBO, "Static Shadow Map FBO");
+					glNamedFramebufferTexture(mStaticShadowMapFBO, GL_DEPTH_ATTACHMENT, mStaticCascadeTexArray, 0);
+					glNamedFramebufferDrawBuffer(mStaticShadowMapFBO, GL_NONE);
+					glNamedFramebufferReadBuffer(mStaticShadowMapFBO, GL_NONE);
+
+					// nothing is cached in the new array yet
+					for (u32 i = 1; i < kCascadeCount; i++)
+						mCascades[i].mValid = false;
+				}
+
+				const u32 invalidMask = updateCascadeCache(cascadeMatrices);
+				// the near cascade follows the camera every frame
+				liveMask = 1;
+
+				if (mDynamicMeshes.empty())
+				{
+					liveMask |= invalidMask;
+				} else
+				{
+					staticMask = invalidMask;
+					// the far cascades take turns, cascade i every 2^i frames and never two in a frame
+					for (u32 i = 1; i < cascadeCount; i++)
+					{
+						if (mFrameIndex % (1u << i) == (1u << (i - 1)))
+							compositeMask |= 1u << i;
+					}
+					compositeMask |= invalidMask;
+				}
+			} else
+			{
+				for (u32 i = 1; i < kCascadeCount; i++)
+					mCascades[i].mValid = false;
+			}
 
-		glBindFramebuffer(GL_FRAMEBUFFER, mFxaaFBO);
-		glDisable(GL_DEPTH_TEST);
-		mFxaaShader.Use();
-		mFxaaShader.SetInt("uEnableFxaa", (i32)mSettings.mEnableFXAA);
-		glBindTextureUnit(0, mHdrTex);
-		glBindVertexArray(mFullScreenQuadVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+			// the lighting and transparent passes read them from the shared block
+			updateFrameLights(cascadeMatrices, cascadeCount);
+
+			mShadowMapShader.Use();
+			for (u32 i = 0; i < cascadeCount; i++)
+				mShadowMapShader.SetMat4("uCascadeMatrices[" + std::to_string(i) + "]", cascadeMatrices[i]);
+
+			GLState::Viewport(0, 0, kShadowQuality, kShadowQuality);
+			GLState::Enable(GL_DEPTH_TEST);
+			GLState::Enable(GL_DEPTH_CLAMP);
+			GLState::Enable(GL_CULL_FACE);
+			GLState::CullFace(GL_FRONT);
+
+			auto clearLayers = [](u32 inTex, u32 inMask) {
+				const f32 farDepth = 1.0f;
+				for (u32 i = 0; i < kCascadeCount; i++)
+				{
+					if (inMask & (1u << i))
+						glClearTexSubImage(inTex, 0, 0, 0, i, kShadowQuality, kShadowQuality, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
+				}
+			};
+
+			if (staticMask != 0)
+			{
+				clearLayers(mStaticCascadeTexArray, staticMask);
+				GLState::BindFramebuffer(GL_FRAMEBUFFER, mStaticShadowMapFBO);
+				mShadowMapShader.SetUint("uCascadeMask", staticMask);
+				renderMeshes(mMeshes);
+			}
 
-		// draw FXAA output to back buffer to full screen quad
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		mFullScreenShader.Use();
-		glBindTextureUnit(0, mFxaaTex);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+			GLState::BindFramebuffer(GL_FRAMEBUFFER, mShadowMapFBO);
 
-		GL_ZONE_END();
+			if (compositeMask != 0)
+			{
+				for (u32 i = 0; i < kCascadeCount; i++)
+				{
+					if (compositeMask & (1u << i))
+					{
+						glCopyImageSubData(
+							mStaticCascadeTexArray, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i,
+							mCascadeTexArray, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i,
+							kShadowQuality, kShadowQuality, 1
+						);
+					}
+				}
+				mShadowMapShader.SetUint("uCascadeMask", compositeMask);
+				renderMeshes(mDynamicMeshes);
+			}
+
+			clearLayers(mCascadeTexArray, liveMask);
+			mShadowMapShader.SetUint("uCascadeMask", liveMask);
+			renderMeshes(mMeshes);
+			renderMeshes(mDynamicMeshes);
+
+			for (u32 i = 0; i < kCascadeCount; i++)
+			{
+				if ((liveMask | compositeMask) & (1u << i))
+					mCascades[i].mUpdateCount++;
+			}
+
+			GLState::Disable(GL_DEPTH_CLAMP);
+			GLState::CullFace(GL_BACK);
+			GLState::Disable(GL_CULL_FACE);
+
+			// reset the viewport to normal size
+			GLState::Viewport(0, 0, mRenderWidth, mRenderHeight);
+			GL_ZONE_END();
+		});
+		if (sampleDistribution)
+			graph.Read(pass, depthBounds);
+		graph.Write(pass, cascades);
 	}
 
-	// blit lighting FBO depth buffer to back buffer depth
-	glBlitNamedFramebuffer(
-		mLightingFBO, 0,
-		0, 0, mWidth, mHeight,
-		0, 0, mWidth, mHeight,
-		GL_DEPTH_BUFFER_BIT, GL_NEAREST
-	);
-	gDebugDraw.DrawFrame(mCamera);
+	{ // apply lighting in screen space
+		const u32 pass = graph.AddPass("Deferred Lighting", [this, horizonOcclusion]() {
+			GL_ZONE("Deferred Lighting");
+			ZoneScopedN("Deferred Lighting");
+
+			// the lighting FBO shares the depth texture with the G-buffer so there is nothing
+			// to copy. depth testing is off, so it can be sampled while it's attached
+			GLState::BindFramebuffer(GL_FRAMEBUFFER, mLightingFBO);
+
+			GLState::Disable(GL_DEPTH_TEST);
+			mLightingShader.Use();
+			mLightingShader.SetVec3("uViewPos", mCamera.mPos);
+			mLightingShader.SetMat4("uView", mCamera.mView);
+
+			GLState::BindTextureUnit(0, mAlbedoTex);
+			GLState::BindTextureUnit(1, mSpecularTex);
+			GLState::BindTextureUnit(2, mNormalTex);
+			GLState::BindTextureUnit(3, mGBufferPacked ? mDepthTex : mPositionTex);
+			if (horizonOcclusion)
+				GLState::BindTextureUnit(4, mGtaoTex[mGtaoCurrent]);
+			else
+				GLState::BindTextureUnit(4, mSsaoDivisor > 1 ? mSsaoUpsampleTex : mSsaoBlurTex);
+			GLState::BindTextureUnit(5, mCascadeTexArray);
 
-	{
-		GL_ZONE("ImGui");
-		ZoneScopedN("Render ImGui");
+			GLState::BindVertexArray(mFullScreenQuadVAO);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+			GL_ZONE_END();
+		});
+		graph.Read(pass, albedo);
+		graph.Read(pass, normal);
+		graph.Read(pass, position);
+		if (!mGBufferPacked)
+			graph.Read(pass, specular);
+		graph.Read(pass, cascades);
+		// the lighting permutation without SSAO doesn't read the occlusion texture
+		if (horizonOcclusion)
+			graph.Read(pass, gtao);
+		else if (mSettings.mEnableSSAO)
+			graph.Read(pass, lowResSsao ? ssaoUpsampled : ssaoBlurred);
+		graph.Write(pass, lighting);
+	}
+
+	{ // draw the skybox using forward rendering and use deferred stage depth
+		const u32 pass = graph.AddPass("Skybox", [this]() {
+			GL_ZONE("Skybox");
+			ZoneScopedN("Render Skybox");
+
+			// the lighting FBO is already bound by the lighting pass
+
+			// the sky is tonemapped with the exposure of the last frame
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mLumaSSBO);
+
+			GLState::Enable(GL_DEPTH_TEST);
+			mSkybox.Draw(mCamera.mView);
+			GL_ZONE_END();
+		});
+		graph.Read(pass, depth);
+		graph.Read(pass, exposure);
+		graph.Read(pass, lighting);
+		graph.Write(pass, lighting);
+	}
+
+	// after the skybox, so the transparent layers are composited over it without writing depth
+	FGResource oitAccumulation;
+	FGResource oitRevealage;
+	FGResource oitHeads;
+	{ // render transparent meshes by forward rendering
+		const ETransparency transparency = mSettings.mTransparency;
+		if (transparency == ETransparency::WeightedBlended)
+		{
+			oitAccumulation	= graph.CreateTexture("OIT Accumulation", target(1, GL_RGBA16F, GL_NEAREST));
+			oitRevealage	= graph.CreateTexture("OIT Revealage", target(1, GL_R16F, GL_NEAREST));
+		} else if (transparency == ETransparency::LinkedList)
+		{
+			oitHeads		= graph.CreateTexture("OIT Heads", target(1, GL_R32UI, GL_NEAREST));
+		}
+
+		const u32 pass = graph.AddPass("Transparent Meshes (Fwd Rendering)", [this, transparency]() {
+			GL_ZONE(kTransparentZone);
+			ZoneScopedN("Transparent Meshes (Fwd Rendering)");
+
+			const u32 slot = GpuProfiler::GetFrame() % kGpuTimerLatency;
 
-		u32 csmTexViews[kCascadeCount] = { 0 };
-		glGenTextures(kCascadeCount, csmTexViews);
-		for (u32 i = 0; i < kCascadeCount; i++)
+			const bool weightedBlended	= transparency == ETransparency::WeightedBlended;
+			const bool linkedList		= transparency == ETransparency::LinkedList;
+
+			// the order independent modes don't need the sort
+			collectTransparentDraws(transparency == ETransparency::Sorted);
+			uploadIndirectDraws(&mTransparentDraws, "Transparent Commands");
+
+			if (weightedBlended)
+			{
+				GLState::BindFramebuffer(GL_FRAMEBUFFER, mOitFBO);
+				const f32 noColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				const f32 fullyRevealed[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+				glClearNamedFramebufferfv(mOitFBO, GL_COLOR, 0, noColor);
+				glClearNamedFramebufferfv(mOitFBO, GL_COLOR, 1, fullyRevealed);
+			} else
+			{
+				GLState::BindFramebuffer(GL_FRAMEBUFFER, mLightingFBO);
+			}
+
+			if (linkedList)
+			{
+				createOitNodes();
+				const u32 listEnd = 0xFFFFFFFF;
+				const u32 noNodes = 0;
+				glClearTexImage(mOitHeadsTex, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &listEnd);
+				glClearNamedBufferSubData(mOitNodeSSBO, GL_R32UI, 0, sizeof(u32), GL_RED_INTEGER, GL_UNSIGNED_INT, &noNodes);
+				glBindImageTexture(0, mOitHeadsTex, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mOitNodeSSBO);
+				// the fragments only go to the lists
+				glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			}
+
+			mTransparentShader.Use();
+
+			mTransparentShader.SetMat4("uView", mCamera.mView);
+			mTransparentShader.SetMat4("uProjection", mJitteredProjection);
+			mTransparentShader.SetVec3("uViewPos", mCamera.mPos);
+			if (linkedList)
+				mTransparentShader.SetUint("uNodeCapacity", mOitNodeCapacity);
+
+			if (weightedBlended)
+			{
+				GLState::Enable(GL_BLEND);
+				GLState::BlendFunci(0, GL_ONE, GL_ONE);
+				GLState::BlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+			} else if (!linkedList)
+			{
+				GLState::Enable(GL_BLEND);
+				GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			}
+			// tested against the opaque depth only, every layer reaches the blend or the lists
+			GLState::Enable(GL_DEPTH_TEST);
+			GLState::DepthMask(GL_FALSE);
+
+			GLState::BindTextureUnit(3, mCascadeTexArray);
+
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mTransparentDraws.mBuffer);
+			for (const IndirectDraws::MeshDraw& draw : mTransparentDraws.mDraws)
+			{
+				const Geom::Mesh* mesh = draw.mMesh;
+
+				if (mesh->mOpacityTexture)
+					mTransparentShader.SetInt("uUseTransparencyTex", true);
+				else if (mesh->mDiffuseTexture->mHasTransparency)
+					mTransparentShader.SetInt("uUseTransparencyTex", false);
+				else
+					ZR_ASSERT(false, "");
+
+				mesh->DrawIndirect((usize)draw.mFirstCommand * sizeof(DrawCommand), draw.mCommandCount);
+			}
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+			mTransparentMeshes.clear();
+
+			GLState::DepthMask(GL_TRUE);
+			GLState::Disable(GL_DEPTH_TEST);
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+			if (weightedBlended || linkedList)
+			{
+				GL_ZONE("OIT Resolve");
+
+				// the color of the layers is premultiplied, the scene is scaled by their transmittance
+				GLState::BindFramebuffer(GL_FRAMEBUFFER, mLightingFBO);
+				GLState::Enable(GL_BLEND);
+				GLState::BlendFunc(GL_ONE, GL_SRC_ALPHA);
+
+				mOitResolveShader.Use();
+				if (weightedBlended)
+				{
+					GLState::BindTextureUnit(0, mOitAccumulationTex);
+					GLState::BindTextureUnit(1, mOitRevealageTex);
+				} else
+				{
+					glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+					glBindImageTexture(0, mOitHeadsTex, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32UI);
+				}
+
+				GLState::BindVertexArray(mFullScreenQuadVAO);
+				glDrawArrays(GL_TRIANGLES, 0, 6);
+				GL_ZONE_END();
+			}
+			GLState::Disable(GL_BLEND);
+
+			// before the zone ends, so the counter is read back without waiting
+			if (linkedList)
+				glCopyNamedBufferSubData(mOitNodeSSBO, mOitNodeCountBuffer, 0, slot * sizeof(u32), sizeof(u32));
+			mTransparentTimerModes[slot] = transparency;
+
+			// the benchmark compares the modes at the same jitter offset, the read back waits for the GPU
+			auto& benchmark = mTransparencyBenchmark;
+			if (benchmark.mActive && benchmark.mMode == (u32)transparency && benchmark.mSamples >= kTransparencyBenchmarkFrames
+				&& benchmark.mImage.empty() && mFrameIndex % kTaaJitterCount == 0)
+			{
+				benchmark.mImageSize = glm::uvec2(mRenderWidth, mRenderHeight);
+				benchmark.mImage.resize((usize)mRenderWidth * mRenderHeight);
+				glGetTextureSubImage(
+					mLightingTex, 0, 0, 0, 0, mRenderWidth, mRenderHeight, 1, GL_RGBA, GL_FLOAT,
+					(i32)(benchmark.mImage.size() * sizeof(glm::vec4)), benchmark.mImage.data()
+				);
+			}
+
+			GL_ZONE_END();
+		});
+		graph.Read(pass, cascades);
+		graph.Read(pass, depth);
+		graph.Read(pass, lighting);
+		if (oitAccumulation.IsValid())
+		{
+			graph.Write(pass, oitAccumulation);
+			graph.Write(pass, oitRevealage);
+		} else if (oitHeads.IsValid())
 		{
-			glTextureView(csmTexViews[i], GL_TEXTURE_2D, mCascadeTexArray, GL_DEPTH_COMPONENT16, 0, 1, i, 1);
+			graph.Write(pass, oitHeads);
 		}
+		graph.Write(pass, lighting);
+	}
+
+	// the post processing reads the resolved lighting with temporal anti-aliasing
+	FGResource sceneColor = lighting;
+	if (temporal)
+	{ // blend the jittered lighting with the reprojected history
+		const u32 pass = graph.AddPass("Temporal Anti-Aliasing", [this]() {
+			GL_ZONE("Temporal Anti-Aliasing");
+			ZoneScopedN("Temporal Anti-Aliasing");
+
+			if (mTaaTex[0] == 0)
+				createTaaTargets();
+
+			const u32 history = mTaaCurrent;
+			const u32 current = history ^ 1;
+			const glm::mat4 viewProjection = mCamera.mProjection * mCamera.mView;
+			const glm::mat4 currentToPrevClip = mPrevViewProjection * glm::inverse(viewProjection);
+
+			GLState::UseProgram(mTaaShader.mID);
+			glUniformMatrix4fv(glGetUniformLocation(mTaaShader.mID, "uCurrentToPrevClip"), 1, GL_FALSE, &currentToPrevClip[0][0]);
+			glUniform1i(glGetUniformLocation(mTaaShader.mID, "uHistoryValid"), mTaaHistoryValid);
+			glUniform2fv(glGetUniformLocation(mTaaShader.mID, "uHistoryScale"), 1, &mTaaPrevRenderScale[0]);
+			glUniform1f(glGetUniformLocation(mTaaShader.mID, "uBlend"), mSettings.mTaaBlend);
+
+			GLState::BindTextureUnit(0, mLightingTex);
+			GLState::BindTextureUnit(1, mTaaTex[history]);
+			GLState::BindTextureUnit(2, mVelocityTex);
+			GLState::BindTextureUnit(3, mDepthTex);
+			glBindImageTexture(0, mTaaTex[current], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+			// 8x8 work groups, see TAA.comp
+			glDispatchCompute((mRenderWidth + 7) / 8, (mRenderHeight + 7) / 8, 1);
+			// the bloom and the post FX sample the output
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+			mTaaCurrent			= current;
+			mTaaPrevRenderScale	= mRenderUVScale;
+			mTaaHistoryValid	= true;
+			GL_ZONE_END();
+		});
+		graph.Read(pass, lighting);
+		graph.Read(pass, velocity);
+		graph.Read(pass, depth);
+		graph.Write(pass, taa);
+		sceneColor = taa;
+	}
 
-		ImGui::Begin("Renderer");
+	FGResource bloomMips[kMaxBloomMips];
+	{ // render bloom texture
+		u32 width = mWidth;
+		u32 height = mHeight;
+		for (u32 i = 0; i < mBloomMipChain.size(); i++)
 		{
-			#define IMGUI_IMAGE(inID, inPos) ImGui::Image(inID, inPos, ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f))
+			width	= std::max(width / 2, 1u);
+			height	= std::max(height / 2, 1u);
+			mBloomMipChain[i].mSize = glm::vec2((f32)width, (f32)height);
+			bloomMips[i] = graph.CreateTexture("Bloom Mip", FGTextureDesc{ width, height, GL_R11F_G11F_B10F, GL_LINEAR });
+		}
+
+		const u32 downsamplePass = graph.AddPass("Downsample Bloom", [this, temporal]() {
+			GL_ZONE("Downsample Bloom");
+			ZoneScopedN("Downsample Bloom");
 
-			static f32 sunPos[3] = { gSunPos.x, gSunPos.y, gSunPos.z };
+			// 8x8 tiles of every mip, numbered level by level
+			const u32 mipCount = (u32)mBloomMipChain.size();
+			u32 tileCountX[kMaxBloomMips] = {};
+			u32 firstTile[kMaxBloomMips + 1] = {};
+			// only the rendered part of every level
+			glm::ivec2 renderSize[kMaxBloomMips + 1] = { glm::ivec2(mRenderWidth, mRenderHeight) };
+			for (u32 i = 0; i < mipCount; i++)
+			{
+				const BloomMip& mip = mBloomMipChain[i];
+				renderSize[i + 1]	= glm::ivec2(mip.mRenderSize);
+				tileCountX[i]		= ((u32)mip.mRenderSize.x + 7) / 8;
+				firstTile[i + 1]	= firstTile[i] + tileCountX[i] * (((u32)mip.mRenderSize.y + 7) / 8);
+
+				glBindImageTexture(i, mip.mID, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R11F_G11F_B10F);
+			}
 
-			if (ImGui::Button("save"))
-				getFrustumCornersWorld(viewCorners, mCamera.mProjection * mCamera.mView);
+			GLState::UseProgram(mBloomDownsampleShader.mID);
+			glUniform1ui(glGetUniformLocation(mBloomDownsampleShader.mID, "uMipCount"), mipCount);
+			glUniform1uiv(glGetUniformLocation(mBloomDownsampleShader.mID, "uTileCountX"), mipCount, tileCountX);
+			glUniform1uiv(glGetUniformLocation(mBloomDownsampleShader.mID, "uFirstTile"), mipCount + 1, firstTile);
+			glUniform2iv(glGetUniformLocation(mBloomDownsampleShader.mID, "uRenderSize"), mipCount + 1, &renderSize[0][0]);
 
-			ImGui::SliderFloat3("Sun", sunPos, -100.0f, 100.0f);
-			gSunPos.x = sunPos[0];
-			gSunPos.y = sunPos[1];
-			gSunPos.z = sunPos[2];
-			ImGui::Text("CSM");
+			GLState::BindTextureUnit(0, temporal ? mTaaTex[mTaaCurrent] : mLightingTex);
+			glClearNamedBufferData(mBloomCounterSSBO, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mBloomCounterSSBO);
+
+			// the work groups don't know their tile before they take a ticket, only the count matters
+			const u32 groupCount = firstTile[mipCount];
+			const u32 groupCountX = std::min(groupCount, 65535u);
+			glDispatchCompute(groupCountX, (groupCount + groupCountX - 1) / groupCountX, 1);
+
+			// the upsample samples the mips and blends into them as render targets
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+			GL_ZONE_END();
+		});
+		graph.Read(downsamplePass, sceneColor);
+
+		// meter the scene on the bloom chain, which is a filtered downsample of the lighting texture.
+		// it runs before the upsample, which adds every smaller mip into the mips it blends into
+		{
+			// the first mip at most kExposureMaxInputWidth wide, so the cost doesn't follow the resolution
+			u32 inputMip = (u32)mBloomMipChain.size() - 1;
+			for (u32 i = 0; i < mBloomMipChain.size(); i++)
+			{
+				if (mBloomMipChain[i].mSize.x <= (f32)kExposureMaxInputWidth)
+				{
+					inputMip = i;
+					break;
+				}
+			}
+
+			const u32 pass = graph.AddPass("Auto Exposure", [this, inputMip]() {
+				GL_ZONE("Auto Exposure");
+				ZoneScopedN("Auto Exposure");
+
+				const BloomMip& input = mBloomMipChain[inputMip];
+
+				{
+					ZoneScopedN("Dispatch Luma Comp");
+					GLState::UseProgram(mLumaShader.mID);
+					glUniform1f(glGetUniformLocation(mLumaShader.mID, "uMinLogLuma"), kExposureMinLogLuma);
+					glUniform1f(glGetUniformLocation(mLumaShader.mID, "uInvLogLumaRange"), 1.0f / kExposureLogLumaRange);
+					glUniform2i(glGetUniformLocation(mLumaShader.mID, "uSize"), (i32)input.mRenderSize.x, (i32)input.mRenderSize.y);
+					GLState::BindTextureUnit(0, input.mID);
+					glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mLumaSSBO);
+					// 16x16 work groups, see Luma.comp
+					glDispatchCompute(((u32)input.mRenderSize.x + 15) / 16, ((u32)input.mRenderSize.y + 15) / 16, 1);
+				}
+				{
+					ZoneScopedN("Barrier");
+					glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+				}
+
+				{
+					ZoneScopedN("Dispatch Exposure Comp");
+					GLState::UseProgram(mExposureShader.mID);
+					glUniform1f(glGetUniformLocation(mExposureShader.mID, "uDeltaTime"), mDeltaTime);
+					glUniform1f(glGetUniformLocation(mExposureShader.mID, "uMinLogLuma"), kExposureMinLogLuma);
+					glUniform1f(glGetUniformLocation(mExposureShader.mID, "uLogLumaRange"), kExposureLogLumaRange);
+					glUniform1f(glGetUniformLocation(mExposureShader.mID, "uLowPercentile"), mSettings.mExposureLowPercentile);
+					glUniform1f(glGetUniformLocation(mExposureShader.mID, "uHighPercentile"), mSettings.mExposureHighPercentile);
+					glUniform1f(glGetUniformLocation(mExposureShader.mID, "uAdaptationSpeed"), mSettings.mExposureAdaptationSpeed);
+					glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mLumaSSBO);
+					glDispatchCompute(1, 1, 1);
+				}
+				{
+					ZoneScopedN("Barrier");
+					glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+				}
+
+				GL_ZONE_END();
+			});
+			graph.Read(pass, bloomMips[inputMip]);
+			graph.Read(pass, exposure);
+			graph.Write(pass, exposure);
+		}
+
+		const u32 upsamplePass = graph.AddPass("Upsample Bloom", [this]() {
+			GL_ZONE("Upsample Bloom");
+			ZoneScopedN("Upsample Bloom");
+
+			GLState::BindFramebuffer(GL_FRAMEBUFFER, mBloomFBO);
+
+			mBloomUpsampleShader.Use();
+			mBloomUpsampleShader.SetFloat("uFilterRadius", mSettings.mBloomFilterRadius);
+
+			GLState::Enable(GL_BLEND);
+			GLState::BlendFunc(GL_ONE, GL_ONE);
+			glBlendEquation(GL_FUNC_ADD);
+
+			// reverse the downscale and apply filter for each mip
+			for (u32 i = mBloomMipChain.size() - 1; i > 0; i--)
+			{
+				const BloomMip& currentMip = mBloomMipChain[i];
+				const BloomMip& nextMip = mBloomMipChain[i - 1];
+
+				GLState::BindTextureUnit(0, currentMip.mID);
+
+				GLState::Viewport(0, 0, nextMip.mRenderSize.x, nextMip.mRenderSize.y);
+				glNamedFramebufferTexture(mBloomFBO, GL_COLOR_ATTACHMENT0, nextMip.mID, 0);
+				GLState::BindVertexArray(mFullScreenQuadVAO);
+				glDrawArrays(GL_TRIANGLES, 0, 6);
+			}
+
+			GLState::Disable(GL_BLEND);
+
+			GLState::Viewport(0, 0, mRenderWidth, mRenderHeight);
+			GL_ZONE_END();
+		});
+
+		for (u32 i = 0; i < mBloomMipChain.size(); i++)
+		{
+			graph.Write(downsamplePass, bloomMips[i]);
+			graph.Read(upsamplePass, bloomMips[i]);
+			graph.Write(upsamplePass, bloomMips[i]);
+		}
+	}
+
+	const FGResource postFxOutput = graph.CreateTexture("Post FX Output", target(1, GL_RGBA8, GL_LINEAR));
+	{ // tonemap, add bloom and lens dirt and apply the CLUT in one dispatch
+		const u32 pass = graph.AddPass("Post FX", [this, temporal]() {
+			GL_ZONE(kPostFxZone);
+			ZoneScopedN("Post FX");
+
+			mPostFxShader.Use();
+
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mLumaSSBO);
+
+			GLState::BindTextureUnit(0, temporal ? mTaaTex[mTaaCurrent] : mLightingTex);
+			GLState::BindTextureUnit(1, mBloomMipChain[0].mID);
+			GLState::BindTextureUnit(2, mLensDirtTexture->mID);
+			GLState::BindTextureUnit(3, mClutTex);
+			glBindImageTexture(0, mHdrTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+			// 8x8 work groups, see PostFX.comp
+			glDispatchCompute((mRenderWidth + 7) / 8, (mRenderHeight + 7) / 8, 1);
+			// the next G-buffer pass renders into the same memory when the output shares it with the albedo
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+
+			GL_ZONE_END();
+		});
+		graph.Read(pass, sceneColor);
+		graph.Read(pass, bloomMips[0]);
+		// without auto exposure the last exposure is kept
+		if (mSettings.mEnableAutoExposure)
+			graph.Read(pass, exposure);
+		graph.Write(pass, postFxOutput);
+	}
+
+	// fxaa cant anti alias lines :)
+
+	// Note: always draw UI after FXAA
+	FGResource antiAliased;
+	if (!mSettings.mDynamicResolution)
+	{
+		const u32 pass = graph.AddPass("FXAA", [this, fxaa]() {
+			GL_ZONE("FXAA");
+			ZoneScopedN("Apply FXAA");
+
+			GLState::Disable(GL_DEPTH_TEST);
+			GLState::BindVertexArray(mFullScreenQuadVAO);
+
+			// FXAA writes to the back buffer, without it the post fx output is copied there
+			GLState::BindFramebuffer(GL_FRAMEBUFFER, mOutputFBO);
+			if (fxaa)
+				mFxaaShader.Use();
+			else
+				mFullScreenShader.Use();
+			GLState::BindTextureUnit(0, mHdrTex);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+
+			GL_ZONE_END();
+		});
+		graph.Read(pass, postFxOutput);
+		graph.Write(pass, backBuffer);
+	} else
+	{
+		FGResource upscaleInput = postFxOutput;
+		if (fxaa)
+		{ // anti alias at the render size, before the upscale widens the edges
+			antiAliased = graph.CreateTexture("Anti-Aliased", target(1, GL_RGBA8, GL_LINEAR));
+
+			const u32 pass = graph.AddPass("FXAA", [this]() {
+				GL_ZONE("FXAA");
+				ZoneScopedN("Apply FXAA");
+
+				GLState::Disable(GL_DEPTH_TEST);
+				GLState::BindVertexArray(mFullScreenQuadVAO);
+				GLState::Viewport(0, 0, mRenderWidth, mRenderHeight);
+
+				GLState::BindFramebuffer(GL_FRAMEBUFFER, mAntiAliasFBO);
+				mFxaaShader.Use();
+				GLState::BindTextureUnit(0, mHdrTex);
+				glDrawArrays(GL_TRIANGLES, 0, 6);
+
+				GL_ZONE_END();
+			});
+			graph.Read(pass, postFxOutput);
+			graph.Write(pass, antiAliased);
+			upscaleInput = antiAliased;
+		}
+
+		const u32 pass = graph.AddPass("Upscale", [this, fxaa]() {
+			GL_ZONE("Upscale");
+			ZoneScopedN("Upscale");
+
+			GLState::Disable(GL_DEPTH_TEST);
+			GLState::BindVertexArray(mFullScreenQuadVAO);
+			GLState::Viewport(0, 0, mWidth, mHeight);
+
+			GLState::BindFramebuffer(GL_FRAMEBUFFER, mOutputFBO);
+			mUpscaleShader.Use();
+			mUpscaleShader.SetFloat("uSharpness", mSettings.mSharpness);
+			GLState::BindTextureUnit(0, fxaa ? mAntiAliasTex : mHdrTex);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+
+			GL_ZONE_END();
+		});
+		graph.Read(pass, upscaleInput);
+		graph.Write(pass, backBuffer);
+	}
+
+	{
+		const u32 pass = graph.AddPass("Debug Draw", [this]() {
+			// blit lighting FBO depth buffer to back buffer depth, scaled up to the window
+			glBlitNamedFramebuffer(
+				mLightingFBO, mOutputFBO,
+				0, 0, mRenderWidth, mRenderHeight,
+				0, 0, mWidth, mHeight,
+				GL_DEPTH_BUFFER_BIT, GL_NEAREST
+			);
+			GLState::Viewport(0, 0, mWidth, mHeight);
+			gDebugDraw.DrawFrame(mCamera);
+		});
+		graph.Read(pass, depth);
+		graph.Write(pass, backBuffer);
+	}
+
+	if (mEnableUI)
+	{
+		const u32 pass = graph.AddPass("ImGui", [this]() {
+			GL_ZONE("ImGui");
+			ZoneScopedN("Render ImGui");
+
+			u32 csmTexViews[kCascadeCount] = { 0 };
+			glGenTextures(kCascadeCount, csmTexViews);
 			for (u32 i = 0; i < kCascadeCount; i++)
 			{
-				IMGUI_IMAGE(csmTexViews[i], ImVec2(256.0f / f32(i + 1), 256.0f / f32(i + 1)));
+				glTextureView(csmTexViews[i], GL_TEXTURE_2D, mCascadeTexArray, GL_DEPTH_COMPONENT16, 0, 1, i, 1);
 			}
-			ImGui::Text("Normal Map");
-			IMGUI_IMAGE(mNormalTex, ImVec2((f32)mWidth / 6.0f, (f32)mHeight / 6.0f));
-		} ImGui::End();
 
-		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-		GL_ZONE_END();
+			ImGui::Begin("Renderer");
+			{
+				#define IMGUI_IMAGE(inID, inPos) ImGui::Image(inID, inPos, ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f))
+
+				static f32 sunPos[3] = { gSunPos.x, gSunPos.y, gSunPos.z };
+
+				glm::vec4 viewCorners[8];
+				if (ImGui::Button("save"))
+					getFrustumCornersWorld(viewCorners, mCamera.mProjection * mCamera.mView);
+
+				ImGui::SliderFloat3("Sun", sunPos, -100.0f, 100.0f);
+				gSunPos.x = sunPos[0];
+				gSunPos.y = sunPos[1];
+				gSunPos.z = sunPos[2];
+				ImGui::Text("CSM");
+				for (u32 i = 0; i < mSettings.mCascadeCount; i++)
+				{
+					ImGui::Text("Cascade %u: to %.1f, %u updates", i, mCascadeSplits[i], mCascades[i].mUpdateCount);
+				}
+				if (mSettings.mSampleDistribution)
+				{
+					if (hasDepthBounds())
+						ImGui::Text("Depth Bounds: %.2f to %.2f", bitsToFloat(mDepthBounds.mMinDepth), bitsToFloat(mDepthBounds.mMaxDepth));
+					else
+						ImGui::TextDisabled("Depth Bounds: waiting for the GPU");
+				}
+				for (u32 i = 0; i < kCascadeCount; i++)
+				{
+					IMGUI_IMAGE(csmTexViews[i], ImVec2(256.0f / f32(i + 1), 256.0f / f32(i + 1)));
+				}
+				ImGui::Text("Normal Map");
+				IMGUI_IMAGE(mNormalTex, ImVec2((f32)mWidth / 6.0f, (f32)mHeight / 6.0f));
+
+				if (mSettings.mOcclusionCulling && ImGui::TreeNode("Occlusion Culling"))
+				{
+					ImGui::Text("Meshes: %u", mCullStats.mObjectCount);
+					ImGui::Text("Frustum Culled: %u", mCullStats.mFrustumCulled);
+					ImGui::Text("Occlusion Culled: %u", mCullStats.mOcclusionCulled);
+					ImGui::Text("Drawn: %u + %u", mCullStats.mPhase1Drawn, mCullStats.mPhase2Drawn);
+					ImGui::TreePop();
+				}
+
+				if (ImGui::TreeNode("GPU Profiler"))
+				{
+					GpuProfiler::DrawUI();
+					ImGui::TreePop();
+				}
+
+				if (ImGui::TreeNode("GL State Cache"))
+				{
+					GLState::DrawUI();
+					ImGui::TreePop();
+				}
+
+				if (ImGui::TreeNode("Overdraw"))
+				{
+					ImGui::Text("G-Buffer: %.3f ms%s", mOverdrawStats.mGBufferMs, mSettings.mDepthPrepass ? " (with the prepass)" : "");
+					ImGui::Text("Shaded Fragments: %llu", (unsigned long long)mOverdrawStats.mFragments);
+					ImGui::Text("Shaded Per Pixel: %.2f", mOverdrawStats.mOverdraw);
+					ImGui::TreePop();
+				}
+
+				if (ImGui::TreeNode("Transparency"))
+				{
+					static const char* kModeNames[kTransparencyModeCount] = { "Sorted", "Weighted Blended", "Linked List" };
+					for (u32 i = 0; i < kTransparencyModeCount; i++)
+						ImGui::Text("%s: %.3f ms", kModeNames[i], mTransparencyStats.mMs[i]);
+					if (mOitNodeCapacity != 0)
+					{
+						ImGui::Text("Linked List Nodes: %u / %u%s", mTransparencyStats.mNodes, mOitNodeCapacity,
+							mTransparencyStats.mNodes > mOitNodeCapacity ? " (overflowed)" : "");
+					}
+
+					const auto& benchmark = mTransparencyBenchmark;
+					if (benchmark.mActive)
+					{
+						ImGui::Text("Benchmarking %s...", kModeNames[benchmark.mMode]);
+					} else if (benchmark.mDone)
+					{
+						ImGui::Separator();
+						ImGui::Text("Benchmark");
+						for (u32 i = 0; i < kTransparencyModeCount; i++)
+							ImGui::Text("%s: %.3f ms, RMSE %.5f", kModeNames[i], benchmark.mMs[i], benchmark.mError[i]);
+					}
+					ImGui::TreePop();
+				}
+
+				if (!mSettings.mOcclusionCulling && mSettings.mSoftwareOcclusion && ImGui::TreeNode("Software Occlusion"))
+				{
+					const auto& stats = mSoftOcclusion.mStats;
+					ImGui::Text("Occluders: %u", (u32)mOccluderMeshes.size());
+					ImGui::Text("Triangles: %u (%u rasterized)", stats.mOccluderTriangles, stats.mRasterizedTriangles);
+					ImGui::Text("Culled: %u / %u", stats.mCulledBoxes, stats.mTestedBoxes);
+					ImGui::Text("Rasterize: %.3f ms", stats.mRasterizeMs);
+					ImGui::TreePop();
+				}
+
+				if (ImGui::TreeNode("Frame Graph"))
+				{
+					ImGui::Text("%u transient targets in %u allocations", mFrameGraph.GetTransientCount(), mFrameGraph.GetAllocationCount());
+					for (u32 i = 0; i < mFrameGraph.GetPassCount(); i++)
+					{
+						if (mFrameGraph.IsCulled(i))
+							ImGui::TextDisabled("%s (culled)", mFrameGraph.GetPassName(i));
+						else
+							ImGui::Text("%s", mFrameGraph.GetPassName(i));
+					}
+					ImGui::TreePop();
+				}
+			} ImGui::End();
+
+			ImGui::Render();
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+			// the backend sets the GL state directly
+			GLState::Invalidate();
+			GL_ZONE_END();
+
+			GLState::DeleteTextures(kCascadeCount, csmTexViews);
+		});
+		graph.Read(pass, normal);
+		graph.Read(pass, cascades);
+		graph.Write(pass, backBuffer);
+	}
+
+	if (!graph.Compile())
+		return false;
+	graph.Realize();
+
+	// the passes use the GL names of the transients, which only change here
+	auto getID = [&](FGResource inResource) {
+		return inResource.IsValid() ? graph.GetID(inResource) : 0u;
+	};
+
+	mAlbedoTex			= getID(albedo);
+	mSpecularTex		= getID(specular);
+	mNormalTex			= getID(normal);
+	mPositionTex		= mGBufferPacked ? 0 : getID(position);
+	mVelocityTex		= getID(velocity);
+	mSsaoTex			= getID(ssao);
+	mSsaoBlurTex		= getID(ssaoBlurred);
+	mSsaoDepthNormalTex	= getID(ssaoDepthNormal);
+	mSsaoUpsampleTex	= getID(ssaoUpsampled);
+	mHdrTex				= getID(postFxOutput);
+	mAntiAliasTex		= getID(antiAliased);
+	mOitAccumulationTex	= getID(oitAccumulation);
+	mOitRevealageTex	= getID(oitRevealage);
+	mOitHeadsTex		= getID(oitHeads);
+	for (u32 i = 0; i < mBloomMipChain.size(); i++)
+		mBloomMipChain[i].mID = getID(bloomMips[i]);
+
+	if (mGBufferPacked)
+	{
+		glNamedFramebufferTexture(mDeferredFBO, GL_COLOR_ATTACHMENT0, mAlbedoTex, 0);
+		glNamedFramebufferTexture(mDeferredFBO, GL_COLOR_ATTACHMENT1, mNormalTex, 0);
+		glNamedFramebufferTexture(mDeferredFBO, GL_COLOR_ATTACHMENT2, mVelocityTex, 0);
+		glNamedFramebufferTexture(mDeferredFBO, GL_COLOR_ATTACHMENT3, 0, 0);
+		glNamedFramebufferTexture(mDeferredFBO, GL_COLOR_ATTACHMENT4, 0, 0);
+		// the velocity is location 2 of the packed layout
+		u32 colorAttachments3[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+		glNamedFramebufferDrawBuffers(mDeferredFBO, temporal ? 3 : 2, colorAttachments3);
+	} else
+	{
+		glNamedFramebufferTexture(mDeferredFBO, GL_COLOR_ATTACHMENT0, mAlbedoTex, 0);
+		glNamedFramebufferTexture(mDeferredFBO, GL_COLOR_ATTACHMENT1, mSpecularTex, 0);
+		glNamedFramebufferTexture(mDeferredFBO, GL_COLOR_ATTACHMENT2, mNormalTex, 0);
+		glNamedFramebufferTexture(mDeferredFBO, GL_COLOR_ATTACHMENT3, mPositionTex, 0);
+		glNamedFramebufferTexture(mDeferredFBO, GL_COLOR_ATTACHMENT4, mVelocityTex, 0);
+		u32 colorAttachments5[5] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3, GL_COLOR_ATTACHMENT4 };
+		glNamedFramebufferDrawBuffers(mDeferredFBO, temporal ? 5 : 4, colorAttachments5);
+	}
+
+	if (glCheckNamedFramebufferStatus(mDeferredFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		puts("Error: Failed to create deferred framebuffer (G-Buffer).\n");
+		return false;
+	}
+
+	// culled targets are 0, which detaches the last one
+	auto attach = [](u32 inFBO, u32 inTex, const char* inName) -> bool {
+		glNamedFramebufferTexture(inFBO, GL_COLOR_ATTACHMENT0, inTex, 0);
+		if (inTex != 0 && glCheckNamedFramebufferStatus(inFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			printf("Error: Failed to create the \"%s\" framebuffer.\n", inName);
+			return false;
+		}
+
+		return true;
+	};
+
+	if (!attach(mSsaoFBO, mSsaoTex, "SSAO Texture")
+		|| !attach(mSsaoBlurFBO, mSsaoBlurTex, "SSAO Blur Texture")
+		|| !attach(mSsaoDepthNormalFBO, mSsaoDepthNormalTex, "SSAO Depth Normal")
+		|| !attach(mSsaoUpsampleFBO, mSsaoUpsampleTex, "SSAO Upsample Texture")
+		|| !attach(mBloomFBO, mBloomMipChain[0].mID, "Bloom")
+		|| !attach(mAntiAliasFBO, mAntiAliasTex, "Anti-Aliased"))
+	{
+		return false;
+	}
+
+	glNamedFramebufferTexture(mOitFBO, GL_COLOR_ATTACHMENT0, mOitAccumulationTex, 0);
+	glNamedFramebufferTexture(mOitFBO, GL_COLOR_ATTACHMENT1, mOitRevealageTex, 0);
+	if (mOitAccumulationTex != 0)
+	{
+		u32 oitAttachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glNamedFramebufferDrawBuffers(mOitFBO, 2, oitAttachments);
+		if (glCheckNamedFramebufferStatus(mOitFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			puts("Error: Failed to create the OIT framebuffer.\n");
+			return false;
+		}
+	}
+
+	// the history is stale once the pass stops running
+	if (graph.IsCulled(gtaoPass))
+		mGtaoHistoryValid = false;
+	if (!temporal)
+		mTaaHistoryValid = false;
+
+	mFrameGraphKey = frameGraphKey();
+	return true;
+}
 
-		glDeleteTextures(kCascadeCount, csmTexViews);
+void Renderer::Render(f32 inDeltaTime, f32 inCurrentTime)
+{
+	GLState::Disable(GL_BLEND);
+
+	// may switch the transparency mode, which the graph depends on
+	readTransparencyStats();
+	updateTransparencyBenchmark();
+
+	// the compiled graph is kept until the size or a setting it depends on changes
+	if (frameGraphKey() != mFrameGraphKey && !buildFrameGraph())
+		exit(1);
+
+	// before the render scale of its slot is replaced
+	readOverdrawStats();
+	// after a build, which may change the bloom chain
+	updateRenderScale();
+
+	// a new subpixel offset every frame, which the temporal resolve turns into anti-aliasing
+	mJitteredProjection = mCamera.mProjection;
+	if (mSettings.mAntiAliasing == EAntiAliasing::Temporal)
+	{
+		// Halton element 0 is 0 in every base, start at 1
+		const u32 index = mFrameIndex % kTaaJitterCount + 1;
+		const glm::vec2 jitter(Utils::Halton(index, 2) - 0.5f, Utils::Halton(index, 3) - 0.5f);
+		// a translation of clip space by the jitter in render pixels
+		mJitteredProjection[2][0] += jitter.x * 2.0f / (f32)mRenderWidth;
+		mJitteredProjection[2][1] += jitter.y * 2.0f / (f32)mRenderHeight;
 	}
+
+	// before any uniform is set, every permutation has its own
+	selectPermutations();
+
+	mDeltaTime = inDeltaTime;
+	mFrameGraph.Execute();
+
+	mPrevViewProjection = mCamera.mProjection * mCamera.mView;
+	mFrameIndex++;
 }
 
 void openglDebugCb(
@@ -1020,55 +2313,163 @@ void openglDebugCb(
 	}
 }
 
-void Renderer::bloomSetup()
+void Renderer::renderMeshes(const std::vector<const Geom::Mesh*>& inMeshes, std::vector<const Geom::Mesh*>* outTransparentMeshes, bool inDepthOnly)
 {
-	glCreateFramebuffers(1, &mBloomFBO);
+	// Optimize: remove mMeshes. split into mOpaqueMeshes and mTransparentMeshes
 
-	glm::vec2 mipSize((f32)mWidth, (f32)mHeight);
-	for (u32 i = 0; i < 5; i++)
+	GL_ZONE("Render Opaque Meshes");
+	for (u32 i = 0; i < inMeshes.size(); i++)
 	{
-		BloomMip mip{};
-		mipSize /= 2.0f;
-		mip.mSize = mipSize;
-
-		glCreateTextures(GL_TEXTURE_2D, 1, &mip.mID);
-		glTextureStorage2D(mip.mID, 1, GL_R11F_G11F_B10F, (i32)mipSize.x, (i32)mipSize.y);
-		glTextureParameteri(mip.mID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTextureParameteri(mip.mID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTextureParameteri(mip.mID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTextureParameteri(mip.mID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-		mBloomMipChain.push_back(mip);
-	}
+		const Geom::Mesh* mesh = inMeshes[i];
+		if (mesh->mOpacityTexture || (mesh->mDiffuseTexture && mesh->mDiffuseTexture->mHasTransparency))
+		{
+			// Note: this is mean tto be cleared each frame, or we have
+			// a memory leak
+			if (outTransparentMeshes)
+				outTransparentMeshes->push_back(mesh);
+			continue;
+		}
 
-	glNamedFramebufferTexture(mBloomFBO, GL_COLOR_ATTACHMENT0, mBloomMipChain[0].mID, 0);
-	if (glCheckNamedFramebufferStatus(mBloomFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		puts("Error: Failed to create bloom framebuffer.\n");
-		getchar();
-		exit(1);
+		if (inDepthOnly)
+			mesh->DrawDepth();
+		else
+			mesh->Draw();
 	}
+	GL_ZONE_END();
 }
 
-void Renderer::renderMeshes(Shader inShader)
+void Renderer::collectVisibleMeshes(const std::vector<const Geom::Mesh*>& inMeshes, const glm::vec4 inFrustumPlanes[6], SoftOcclusion* ioOcclusion)
 {
-	// Optimize: remove mMeshes. split into mOpaqueMeshes and mTransparentMeshes
+	ZoneScopedN("Collect Visible Meshes");
 
-	GL_ZONE("Render Opaque Meshes");
-	for (u32 i = 0; i < mMeshes.size(); i++)
+	std::vector<DrawCommand>& commands = mVisibleDraws.mCommands;
+	for (const Geom::Mesh* mesh : inMeshes)
 	{
-		const Geom::Mesh* mesh = mMeshes[i];
+		// like renderMeshes()
 		if (mesh->mOpacityTexture || (mesh->mDiffuseTexture && mesh->mDiffuseTexture->mHasTransparency))
 		{
-			// Note: this is mean tto be cleared each frame, or we have
-			// a memory leak
 			mTransparentMeshes.push_back(mesh);
 			continue;
 		}
 
-		inShader.SetMat4("uModel", mesh->mTransform);
-		mesh->Draw();
+		// the visible instances are compacted like in OcclusionCull.comp, a run of them is one command
+		const u32 firstCommand = (u32)commands.size();
+		bool inRun = false;
+		for (u32 i = 0; i < mesh->mInstanceTransforms.size(); i++)
+		{
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			mesh->GetInstanceBounds(i, &boundsMin, &boundsMax);
+
+			const bool visible = isInFrustum(inFrustumPlanes, boundsMin, boundsMax) &&
+				(!ioOcclusion || ioOcclusion->IsVisible(boundsMin, boundsMax));
+			if (!visible)
+			{
+				inRun = false;
+				continue;
+			}
+
+			if (inRun)
+				commands.back().mInstanceCount++;
+			else
+				commands.push_back({ .mCount = (u32)mesh->mIndices.size(), .mInstanceCount = 1, .mBaseInstance = i });
+			inRun = true;
+		}
+
+		const u32 commandCount = (u32)commands.size() - firstCommand;
+		if (commandCount != 0)
+			mVisibleDraws.mDraws.push_back({ mesh, firstCommand, commandCount });
+	}
+}
+
+void Renderer::collectTransparentDraws(bool inSort)
+{
+	ZoneScopedN("Collect Transparent Draws");
+
+	mTransparentDraws.mDraws.clear();
+	mTransparentDraws.mCommands.clear();
+
+	glm::vec4 frustumPlanes[6];
+	getFrustumPlanes(frustumPlanes, mCamera.mProjection * mCamera.mView);
+
+	struct Instance
+	{
+		f32					mDistanceSq;
+		const Geom::Mesh*	mMesh;
+		u32					mInstance;
+	};
+
+	std::vector<Instance> instances;
+	for (const Geom::Mesh* mesh : mTransparentMeshes)
+	{
+		for (u32 i = 0; i < mesh->mInstanceTransforms.size(); i++)
+		{
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			mesh->GetInstanceBounds(i, &boundsMin, &boundsMax);
+			if (!isInFrustum(frustumPlanes, boundsMin, boundsMax))
+				continue;
+
+			const glm::vec3 toCenter = (boundsMin + boundsMax) * 0.5f - mCamera.mPos;
+			instances.push_back({ glm::dot(toCenter, toCenter), mesh, i });
+		}
+	}
+
+	// back to front by the center of the bounds of every instance
+	if (inSort)
+	{
+		std::sort(instances.begin(), instances.end(), [](const Instance& inA, const Instance& inB) {
+			return inA.mDistanceSq > inB.mDistanceSq;
+		});
+	}
+
+	for (const Instance& instance : instances)
+	{
+		// instances of the same mesh in a row share its uniforms
+		if (mTransparentDraws.mDraws.empty() || mTransparentDraws.mDraws.back().mMesh != instance.mMesh)
+			mTransparentDraws.mDraws.push_back({ instance.mMesh, (u32)mTransparentDraws.mCommands.size(), 0 });
+
+		mTransparentDraws.mDraws.back().mCommandCount++;
+		mTransparentDraws.mCommands.push_back({
+			.mCount			= (u32)instance.mMesh->mIndices.size(),
+			.mInstanceCount	= 1,
+			.mBaseInstance	= instance.mInstance,
+		});
+	}
+}
+
+void Renderer::uploadIndirectDraws(IndirectDraws* ioDraws, const char* inLabel)
+{
+	const u32 count = (u32)ioDraws->mCommands.size();
+	if (count > ioDraws->mCapacity)
+	{
+		glDeleteBuffers(1, &ioDraws->mBuffer);
+		ioDraws->mCapacity = std::max(count, ioDraws->mCapacity * 2);
+
+		glCreateBuffers(1, &ioDraws->mBuffer);
+		GL_LABEL(GL_BUFFER, ioDraws->mBuffer, inLabel);
+		glNamedBufferStorage(ioDraws->mBuffer, ioDraws->mCapacity * sizeof(DrawCommand), nullptr, GL_DYNAMIC_STORAGE_BIT);
 	}
+
+	if (count > 0)
+		glNamedBufferSubData(ioDraws->mBuffer, 0, count * sizeof(DrawCommand), ioDraws->mCommands.data());
+}
+
+void Renderer::renderIndirectDraws(const IndirectDraws& inDraws, bool inDepthOnly)
+{
+	GL_ZONE("Render Visible Meshes");
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, inDraws.mBuffer);
+	for (const IndirectDraws::MeshDraw& draw : inDraws.mDraws)
+	{
+		const usize offset = (usize)draw.mFirstCommand * sizeof(DrawCommand);
+		if (inDepthOnly)
+			draw.mMesh->DrawDepthIndirect(offset, draw.mCommandCount);
+		else
+			draw.mMesh->DrawIndirect(offset, draw.mCommandCount);
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
 	GL_ZONE_END();
 }
 
@@ -1180,15 +2581,432 @@ glm::mat4 Renderer::getLightSpaceMatrix(f32 inNear, f32 inFar) const
 	return res;
 }
 
+u32 Renderer::updateCascadeCache(glm::mat4 ioMats[kCascadeCount])
+{
+	// a moved sun invalidates every cascade
+	if (gSunPos != mCascadeSunPos)
+	{
+		for (u32 i = 1; i < kCascadeCount; i++)
+			mCascades[i].mValid = false;
+		mCascadeSunPos = gSunPos;
+	}
+
+	// the texel grid doesn't move with the camera
+	const glm::mat4 lightRotation = getSunRotation();
+
+	u32 invalidMask = 0;
+	for (u32 i = 1; i < mSettings.mCascadeCount; i++)
+	{
+		const f32 sliceNear	= mCascadeSplits[i - 1];
+		const f32 sliceFar	= mCascadeSplits[i];
+		const glm::mat4 proj = glm::perspective(glm::radians(mCamera.mFOV), f32(mWidth) / f32(mHeight), sliceNear, sliceFar);
+
+		glm::vec4 frustCorners[8];
+		getFrustumCornersWorld(frustCorners, proj * mCamera.mView);
+
+		glm::vec3 center(0.0f);
+		for (u32 j = 0; j < 8; j++)
+			center += glm::vec3(frustCorners[j]);
+		center /= 8.0f;
+
+		// a sphere doesn't change its size when the camera turns, unlike a box around the corners
+		f32 sliceRadius = 0.0f;
+		for (u32 j = 0; j < 8; j++)
+			sliceRadius = std::max(sliceRadius, glm::length(glm::vec3(frustCorners[j]) - center));
+
+		// rounded up so the float error of the corners doesn't change it every frame
+		const f32 radius	= std::ceil(sliceRadius * (1.0f + kCascadeCacheMargin));
+		const f32 texelSize	= 2.0f * radius / (f32)kShadowQuality;
+		// the slice stays inside the cascade while its center is within the margin, less the snapping
+		const f32 threshold	= radius - sliceRadius - 2.0f * texelSize;
+
+		CachedCascade& cascade = mCascades[i];
+		const glm::vec3 lightCenter = glm::vec3(lightRotation * glm::vec4(center, 1.0f));
+		const f32 moved = glm::length(glm::vec2(lightCenter.x - cascade.mCenter.x, lightCenter.y - cascade.mCenter.y));
+		if (!cascade.mValid || radius != cascade.mRadius || moved > threshold)
+		{
+			// whole texels, so static geometry rasterizes to the same texels wherever the cascade is
+			cascade.mCenter = glm::vec3(
+				std::floor(lightCenter.x / texelSize) * texelSize,
+				std::floor(lightCenter.y / texelSize) * texelSize,
+				lightCenter.z
+			);
+			cascade.mRadius = radius;
+			cascade.mValid	= true;
+
+			// like getLightSpaceMatrix(), casters out to twice the radius toward the sun are kept
+			const glm::mat4 lightProj = glm::ortho(-radius, radius, -radius, radius, -2.0f * radius, 2.0f * radius);
+			cascade.mMatrix = lightProj * glm::translate(glm::mat4(1.0f), -cascade.mCenter) * lightRotation;
+
+			invalidMask |= 1u << i;
+		}
+
+		ioMats[i] = cascade.mMatrix;
+	}
+
+	return invalidMask;
+}
+
 void Renderer::getLightSpaceMatrices(glm::mat4 ioMats[kCascadeCount]) const
 {
-	for (u32 i = 0; i < kCascadeCount; i++)
+	const bool sampleDistribution = mSettings.mSampleDistribution && hasDepthBounds();
+	const glm::mat4 lightRotation = getSunRotation();
+
+	for (u32 i = 0; i < mSettings.mCascadeCount; i++)
 	{
-		if (i == 0)
-			ioMats[i] = getLightSpaceMatrix(kNearPlane, gShadowCascadeLevels[i]);
-		else if (i < kFrustumCount)
-			ioMats[i] = getLightSpaceMatrix(gShadowCascadeLevels[i - 1], gShadowCascadeLevels[i]);
+		const f32 sliceNear = i == 0 ? (sampleDistribution ? bitsToFloat(mDepthBounds.mMinDepth) : kNearPlane) : mCascadeSplits[i - 1];
+		ioMats[i] = getLightSpaceMatrix(sliceNear, mCascadeSplits[i]);
+
+		// a cascade without pixels keeps the fit to its frustum slice
+		const u32* bounds = mDepthBounds.mBounds[i];
+		if (!sampleDistribution || bounds[0] > bounds[3] || bounds[1] > bounds[4] || bounds[2] > bounds[5])
+			continue;
+
+		const glm::vec3 minBounds(orderedToFloat(bounds[0]), orderedToFloat(bounds[1]), orderedToFloat(bounds[2]));
+		const glm::vec3 maxBounds(orderedToFloat(bounds[3]), orderedToFloat(bounds[4]), orderedToFloat(bounds[5]));
+
+		// square texels, and the size only changes in steps of an eighth of an octave so it doesn't
+		// shimmer with every small change of the bounds. a texel wider on both sides for the snapping
+		const f32 width		= std::max(std::max(maxBounds.x - minBounds.x, maxBounds.y - minBounds.y), 0.01f) * (1.0f + 2.0f / (f32)kShadowQuality);
+		const f32 extent	= std::exp2(std::ceil(std::log2(width) * 8.0f) / 8.0f);
+		const f32 texelSize	= extent / (f32)kShadowQuality;
+
+		// whole texels of the light space grid, which doesn't move with the camera
+		const f32 left		= std::floor((0.5f * (minBounds.x + maxBounds.x - extent)) / texelSize) * texelSize;
+		const f32 bottom	= std::floor((0.5f * (minBounds.y + maxBounds.y - extent)) / texelSize) * texelSize;
+
+		// light space looks down -z. casters between the near plane and the sun are kept by the depth clamp
+		const glm::mat4 lightProj = glm::ortho(
+			left, left + extent,
+			bottom, bottom + extent,
+			-maxBounds.z, -minBounds.z
+		);
+		ioMats[i] = lightProj * lightRotation;
+	}
+}
+
+bool Renderer::hasDepthBounds() const
+{
+	return mDepthBoundsCascadeCount == mSettings.mCascadeCount
+		&& mDepthBoundsSunPos == gSunPos
+		&& mDepthBounds.mMinDepth <= mDepthBounds.mMaxDepth;
+}
+
+void Renderer::updateCascadeSplits()
+{
+	const u32 cascadeCount = mSettings.mCascadeCount;
+
+	f32 nearDepth	= kNearPlane;
+	f32 farDepth	= kFarPlane;
+	if (mSettings.mSampleDistribution && hasDepthBounds())
+	{
+		nearDepth	= std::max(bitsToFloat(mDepthBounds.mMinDepth), kNearPlane);
+		farDepth	= std::max(bitsToFloat(mDepthBounds.mMaxDepth), nearDepth + kNearPlane);
+	}
+
+	// like CascadeSplit() in CascadeBounds.comp
+	for (u32 i = 0; i + 1 < cascadeCount; i++)
+	{
+		const f32 f = (f32)(i + 1) / (f32)cascadeCount;
+		const f32 uniformSplit	= nearDepth + (farDepth - nearDepth) * f;
+		const f32 logSplit		= nearDepth * std::pow(farDepth / nearDepth, f);
+		mCascadeSplits[i] = glm::mix(uniformSplit, logSplit, mSettings.mCascadeSplitLambda);
+	}
+	mCascadeSplits[cascadeCount - 1] = farDepth;
+}
+
+void Renderer::reduceDepthBounds()
+{
+	DepthBoundsReadback& readback = mDepthBoundsReadbacks[mFrameIndex % kGpuTimerLatency];
+
+	// the reduction of kGpuTimerLatency frames ago, dropped when it's still not done
+	if (readback.mFence)
+	{
+		const GLenum status = glClientWaitSync(readback.mFence, 0, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+		{
+			glGetNamedBufferSubData(readback.mSSBO, 0, sizeof(DepthBoundsComp), &mDepthBounds);
+			mDepthBoundsCascadeCount	= readback.mCascadeCount;
+			mDepthBoundsSunPos			= readback.mSunPos;
+		}
+		glDeleteSync(readback.mFence);
+		readback.mFence = nullptr;
+	}
+
+	const DepthBoundsComp initial{};
+	glNamedBufferSubData(readback.mSSBO, 0, sizeof(DepthBoundsComp), &initial);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, readback.mSSBO);
+	GLState::BindTextureUnit(0, mDepthTex);
+
+	const glm::mat4 invProjection = glm::inverse(mCamera.mProjection);
+	const glm::mat4 viewToLight = getSunRotation() * glm::inverse(mCamera.mView);
+
+	GLState::UseProgram(mDepthBoundsShader.mID);
+	glUniformMatrix4fv(glGetUniformLocation(mDepthBoundsShader.mID, "uInvProjection"), 1, GL_FALSE, &invProjection[0][0]);
+	// 16x16 work groups, see DepthBounds.comp
+	glDispatchCompute((mRenderWidth + 15) / 16, (mRenderHeight + 15) / 16, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	GLState::UseProgram(mCascadeBoundsShader.mID);
+	glUniformMatrix4fv(glGetUniformLocation(mCascadeBoundsShader.mID, "uInvProjection"), 1, GL_FALSE, &invProjection[0][0]);
+	glUniformMatrix4fv(glGetUniformLocation(mCascadeBoundsShader.mID, "uViewToLight"), 1, GL_FALSE, &viewToLight[0][0]);
+	glUniform1ui(glGetUniformLocation(mCascadeBoundsShader.mID, "uCascadeCount"), mSettings.mCascadeCount);
+	glUniform1f(glGetUniformLocation(mCascadeBoundsShader.mID, "uSplitLambda"), mSettings.mCascadeSplitLambda);
+	// 16x16 work groups, see CascadeBounds.comp
+	glDispatchCompute((mRenderWidth + 15) / 16, (mRenderHeight + 15) / 16, 1);
+	// glGetNamedBufferSubData() reads the result
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	readback.mFence			= glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	readback.mCascadeCount	= mSettings.mCascadeCount;
+	readback.mSunPos		= gSunPos;
+}
+
+void Renderer::createHiZTarget()
+{
+	GLState::DeleteTextures(1, &mHiZTex);
+
+	// the largest power of two within the window, so every level halves the last
+	mHiZWidth		= 1u << (u32)std::floor(std::log2((f32)std::max(mWidth, 1u)));
+	mHiZHeight		= 1u << (u32)std::floor(std::log2((f32)std::max(mHeight, 1u)));
+	mHiZLevelCount	= (u32)std::floor(std::log2((f32)std::max(mHiZWidth, mHiZHeight))) + 1;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &mHiZTex);
+	GL_LABEL(GL_TEXTURE, mHiZTex, "Hi-Z");
+	// a filtered depth wouldn't be conservative
+	glTextureParameteri(mHiZTex, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(mHiZTex, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(mHiZTex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(mHiZTex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureStorage2D(mHiZTex, mHiZLevelCount, GL_R32F, mHiZWidth, mHiZHeight);
+}
+
+void Renderer::updateCullObjects()
+{
+	ZoneScopedN("Update Cull Objects");
+
+	const usize lastCount = mCullObjects.size();
+	mCullMeshes.clear();
+	mCullObjects.clear();
+
+	auto addMeshes = [this](const std::vector<const Geom::Mesh*>& inMeshes) {
+		for (const Geom::Mesh* mesh : inMeshes)
+		{
+			// like renderMeshes()
+			if (mesh->mOpacityTexture || (mesh->mDiffuseTexture && mesh->mDiffuseTexture->mHasTransparency))
+			{
+				mTransparentMeshes.push_back(mesh);
+				continue;
+			}
+
+			mCullMeshes.push_back(mesh);
+			for (u32 i = 0; i < mesh->mInstanceTransforms.size(); i++)
+			{
+				glm::vec3 boundsMin;
+				glm::vec3 boundsMax;
+				mesh->GetInstanceBounds(i, &boundsMin, &boundsMax);
+
+				mCullObjects.push_back({
+					.mBoundsMin		= glm::vec4(boundsMin, 0.0f),
+					.mBoundsMax		= glm::vec4(boundsMax, 0.0f),
+					.mIndexCount	= (u32)mesh->mIndices.size(),
+					.mInstance		= i,
+				});
+			}
+		}
+	};
+	addMeshes(mMeshes);
+	addMeshes(mDynamicMeshes);
+
+	const u32 count = (u32)mCullObjects.size();
+	const bool grow = count > mCullCapacity;
+	if (grow)
+	{
+		glDeleteBuffers(1, &mCullObjectSSBO);
+		glDeleteBuffers(2, mCullCommandBuffers);
+		glDeleteBuffers(1, &mCullVisibilitySSBO);
+
+		mCullCapacity = std::max(count, mCullCapacity * 2);
+
+		glCreateBuffers(1, &mCullObjectSSBO);
+		GL_LABEL(GL_BUFFER, mCullObjectSSBO, "Cull Objects");
+		glNamedBufferStorage(mCullObjectSSBO, mCullCapacity * sizeof(CullObject), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+		// DrawElementsIndirectCommand
+		glCreateBuffers(2, mCullCommandBuffers);
+		for (u32 i = 0; i < 2; i++)
+		{
+			GL_LABEL(GL_BUFFER, mCullCommandBuffers[i], i == 0 ? "Cull Commands (Phase 1)" : "Cull Commands (Phase 2)");
+			glNamedBufferStorage(mCullCommandBuffers[i], mCullCapacity * 5 * sizeof(u32), nullptr, 0);
+		}
+
+		glCreateBuffers(1, &mCullVisibilitySSBO);
+		GL_LABEL(GL_BUFFER, mCullVisibilitySSBO, "Cull Visibility");
+		glNamedBufferStorage(mCullVisibilitySSBO, mCullCapacity * sizeof(u32), nullptr, 0);
+	}
+
+	// the visibility is per index, a new list starts with nothing visible and phase 2 draws it
+	if (grow || count != lastCount)
+		glClearNamedBufferData(mCullVisibilitySSBO, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+	if (count > 0)
+		glNamedBufferSubData(mCullObjectSSBO, 0, count * sizeof(CullObject), mCullObjects.data());
+}
+
+void Renderer::dispatchOcclusionCull(u32 inPhase)
+{
+	ZoneScopedN("Dispatch Occlusion Cull");
+
+	CullStatsReadback& readback = mCullStatsReadbacks[mFrameIndex % kGpuTimerLatency];
+	if (inPhase == 1)
+	{
+		// the statistics of kGpuTimerLatency frames ago, dropped when they're still not done
+		if (readback.mFence)
+		{
+			const GLenum status = glClientWaitSync(readback.mFence, 0, 0);
+			if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+				glGetNamedBufferSubData(readback.mSSBO, 0, sizeof(CullStats), &mCullStats);
+			glDeleteSync(readback.mFence);
+			readback.mFence = nullptr;
+		}
+
+		const CullStats initial{};
+		glNamedBufferSubData(readback.mSSBO, 0, sizeof(CullStats), &initial);
+	}
+
+	const u32 count = (u32)mCullObjects.size();
+	if (count == 0)
+		return;
+
+	const glm::mat4 viewProjection = mCamera.mProjection * mCamera.mView;
+
+	glm::vec4 planes[6];
+	getFrustumPlanes(planes, viewProjection);
+
+	GLState::UseProgram(mOcclusionCullShader.mID);
+	glUniform1ui(glGetUniformLocation(mOcclusionCullShader.mID, "uObjectCount"), count);
+	glUniform1ui(glGetUniformLocation(mOcclusionCullShader.mID, "uPhase"), inPhase);
+	glUniformMatrix4fv(glGetUniformLocation(mOcclusionCullShader.mID, "uViewProjection"), 1, GL_FALSE, &viewProjection[0][0]);
+	glUniform4fv(glGetUniformLocation(mOcclusionCullShader.mID, "uFrustumPlanes"), 6, &planes[0][0]);
+
+	GLState::BindTextureUnit(0, mHiZTex);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mCullObjectSSBO);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mCullCommandBuffers[inPhase - 1]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mCullVisibilitySSBO);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, readback.mSSBO);
+
+	// 64 wide work groups, see OcclusionCull.comp
+	glDispatchCompute((count + 63) / 64, 1, 1);
+	// the draws read the commands, the next phase the visibility
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	if (inPhase == 2)
+		readback.mFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void Renderer::buildHiZ()
+{
+	GL_ZONE("Build Hi-Z");
+	ZoneScopedN("Build Hi-Z");
+
+	GLState::UseProgram(mHiZShader.mID);
+	GLState::BindTextureUnit(0, mDepthTex);
+
+	u32 width = mHiZWidth;
+	u32 height = mHiZHeight;
+	for (u32 level = 0; level < mHiZLevelCount; level++)
+	{
+		glUniform1ui(glGetUniformLocation(mHiZShader.mID, "uLevel"), level);
+		if (level > 0)
+			glBindImageTexture(0, mHiZTex, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, mHiZTex, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		// 8x8 work groups, see HiZ.comp
+		glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		width	= std::max(width / 2, 1u);
+		height	= std::max(height / 2, 1u);
+	}
+
+	// the cull reads the pyramid through a sampler
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	GL_ZONE_END();
+}
+
+void Renderer::renderCulledMeshes(u32 inPhase, bool inDepthOnly)
+{
+	GL_ZONE(inPhase == 1 ? "Render Visible Meshes" : "Render Disoccluded Meshes");
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCullCommandBuffers[inPhase - 1]);
+	// the commands of the instances of a mesh follow each other
+	u32 command = 0;
+	for (const Geom::Mesh* mesh : mCullMeshes)
+	{
+		const u32 instanceCount = (u32)mesh->mInstanceTransforms.size();
+		// DrawElementsIndirectCommand is 5 uints
+		if (inDepthOnly)
+			mesh->DrawDepthIndirect((usize)command * 5 * sizeof(u32), instanceCount);
 		else
-			ioMats[i] = getLightSpaceMatrix(gShadowCascadeLevels[i - 1], kFarPlane);
+			mesh->DrawIndirect((usize)command * 5 * sizeof(u32), instanceCount);
+		command += instanceCount;
 	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	GL_ZONE_END();
+}
+
+glm::mat4 getSunRotation()
+{
+	// the origin of light space stays at the world origin, so the texel grid doesn't move with the camera
+	return glm::lookAt(
+		glm::vec3(0.0f),
+		-glm::normalize(gSunPos),
+		glm::vec3(0.0f, 1.0f, 0.0f)
+	);
+}
+
+f32 orderedToFloat(u32 inValue)
+{
+	const u32 bits = (inValue & 0x80000000u) != 0 ? inValue & 0x7FFFFFFFu : ~inValue;
+	f32 value;
+	memcpy(&value, &bits, sizeof(f32));
+	return value;
+}
+
+void getFrustumPlanes(glm::vec4 outPlanes[6], const glm::mat4& inViewProj)
+{
+	// Gribb and Hartmann, the rows of the view projection added to and subtracted from the w row
+	const glm::vec4 rowW(inViewProj[0][3], inViewProj[1][3], inViewProj[2][3], inViewProj[3][3]);
+	for (u32 i = 0; i < 3; i++)
+	{
+		const glm::vec4 row(inViewProj[0][i], inViewProj[1][i], inViewProj[2][i], inViewProj[3][i]);
+		outPlanes[i * 2 + 0] = rowW + row;
+		outPlanes[i * 2 + 1] = rowW - row;
+	}
+}
+
+bool isInFrustum(const glm::vec4 inPlanes[6], const glm::vec3& inBoundsMin, const glm::vec3& inBoundsMax)
+{
+	for (u32 i = 0; i < 6; i++)
+	{
+		const glm::vec4& plane = inPlanes[i];
+		// the corner farthest along the plane normal, like InFrustum() of OcclusionCull.comp
+		const glm::vec3 corner(
+			plane.x > 0.0f ? inBoundsMax.x : inBoundsMin.x,
+			plane.y > 0.0f ? inBoundsMax.y : inBoundsMin.y,
+			plane.z > 0.0f ? inBoundsMax.z : inBoundsMin.z
+		);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+f32 bitsToFloat(u32 inBits)
+{
+	f32 value;
+	memcpy(&value, &inBits, sizeof(f32));
+	return value;
 }
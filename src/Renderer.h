@@ -4,18 +4,32 @@
 #include "Geom.h"
 #include "Environment.h"
 #include "Compute.h"
+#include "FrameGraph.h"
+#include "SoftOcclusion.h"
+#include "GpuProfiler.h"
+#include <glad/glad.h>
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #ifndef ZR_DISTRIBUTION
-	#define GL_ZONE(inName) glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, inName)
-	#define GL_ZONE_END() glPopDebugGroup()
+	// a debug group and a GPU profiler zone, see GpuProfiler
+	#define GL_ZONE(inName) \
+		do { \
+			glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, inName); \
+			GpuProfiler::BeginZone(inName, __FILE__, __LINE__); \
+		} while (0)
+	#define GL_ZONE_END() \
+		do { \
+			GpuProfiler::EndZone(); \
+			glPopDebugGroup(); \
+		} while (0)
 	#define GL_LABEL(inTarget, inID, inName) glObjectLabel(inTarget, inID, -1, inName)
 #else
-	#define GL_ZONE(inName)
-	#define GL_ZONE_END()
+	// the zones time the dynamic resolution and the stats, only the debug groups are dropped
+	#define GL_ZONE(inName) GpuProfiler::BeginZone(inName, __FILE__, __LINE__)
+	#define GL_ZONE_END() GpuProfiler::EndZone()
 	#define GL_LABEL(inTarget, inID, inName)
 #endif
 
@@ -25,14 +39,152 @@
  */
 struct LumaExposureComp
 {
-	u32 mTotalLuma = 0.0f;
-	f32 mDesiredExposure = 0.0f;
-	f32 mExposure = 0.0f;
+	u32 mHistogram[256] = {};
+	f32 mAverageLogLuma = 0.0f;
+	f32 mExposure = 1.0f;
+};
+
+/// @brief The data structure of the `RenderScale` uniform block in `Utils.glsl`, std140.
+struct RenderScaleUniforms
+{
+	glm::vec2	mScale;
+	glm::ivec2	mSize;
+};
+
+/// @brief The data structure of the `FrameLights` uniform block in `Lights.glsl`, std140.
+struct FrameLightsUniforms
+{
+	struct PointLight
+	{
+		glm::vec3	mPosition;
+		f32			mLinear;
+		glm::vec3	mColor;
+		f32			mQuadratic;
+	};
+
+	/// @brief MAX_POINT_LIGHTS in the shaders.
+	sconst u32		kMaxPointLights = 42;
+
+	PointLight		mPointLights[kMaxPointLights];
+	glm::vec3		mDirLightDirection;
+	f32				mPad0;
+	glm::vec3		mDirLightColor;
+	f32				mPad1;
+	/// @brief Renderer::kCascadeCount of them.
+	glm::mat4		mCascadeMatrices[4];
+	glm::vec4		mCascadeLevels;
+	u32				mNumPointLights;
+	i32				mCascadeCount;
+	u32				mPad2[2];
+};
+
+/**
+ * @brief The data structure of the SSBO used inside `DepthBounds.comp` and `CascadeBounds.comp`.
+ * The bounds are floats encoded as uints which sort like them.
+ */
+struct DepthBoundsComp
+{
+	/// @brief The bits of the positive view space depths.
+	u32 mMinDepth = UINT32_MAX;
+	u32 mMaxDepth = 0;
+	/// @brief The light space min xyz then max xyz of every cascade, MAX_CASCADES in the shaders.
+	u32 mBounds[4][6] = {
+		{ UINT32_MAX, UINT32_MAX, UINT32_MAX, 0, 0, 0 },
+		{ UINT32_MAX, UINT32_MAX, UINT32_MAX, 0, 0, 0 },
+		{ UINT32_MAX, UINT32_MAX, UINT32_MAX, 0, 0, 0 },
+		{ UINT32_MAX, UINT32_MAX, UINT32_MAX, 0, 0, 0 },
+	};
+};
+
+/// @brief A depth bounds reduction in flight, read back once its fence signals.
+struct DepthBoundsReadback
+{
+	u32			mSSBO = 0;
+	GLsync		mFence = nullptr;
+	/// @brief The cascade count and sun position the bounds were reduced with.
+	u32			mCascadeCount = 0;
+	glm::vec3	mSunPos = glm::vec3(0.0f);
+};
+
+/// @brief A mesh of the occlusion culling, the `CullObject` of `OcclusionCull.comp`, std430.
+struct CullObject
+{
+	/// @brief World space, w is unused.
+	glm::vec4	mBoundsMin;
+	glm::vec4	mBoundsMax;
+	u32			mIndexCount;
+	/// @brief The instance of its mesh, the base instance of its command.
+	u32			mInstance;
+	u32			mPad[2];
+};
+
+/// @brief The data structure of the `Stats` SSBO in `OcclusionCull.comp`.
+struct CullStats
+{
+	u32 mObjectCount = 0;
+	u32 mFrustumCulled = 0;
+	u32 mOcclusionCulled = 0;
+	/// @brief The meshes visible last frame, drawn before the depth pyramid is built.
+	u32 mPhase1Drawn = 0;
+	/// @brief The meshes which turned visible, drawn after the depth pyramid is built.
+	u32 mPhase2Drawn = 0;
+};
+
+/// @brief The command of glMultiDrawElementsIndirect().
+struct DrawCommand
+{
+	u32	mCount			= 0;
+	u32	mInstanceCount	= 0;
+	u32	mFirstIndex		= 0;
+	u32	mBaseVertex		= 0;
+	/// @brief Selects the transform of the first instance.
+	u32	mBaseInstance	= 0;
+};
+
+/**
+ * @brief Meshes drawn with a command per run of consecutive instances which passed the culling,
+ * the CPU side counterpart of the commands `OcclusionCull.comp` writes.
+ */
+struct IndirectDraws
+{
+	struct MeshDraw
+	{
+		const Geom::Mesh*	mMesh			= nullptr;
+		u32					mFirstCommand	= 0;
+		u32					mCommandCount	= 0;
+	};
+
+	/// @brief The commands of a mesh follow each other.
+	std::vector<MeshDraw>		mDraws;
+	std::vector<DrawCommand>	mCommands;
+	u32							mBuffer		= 0;
+	u32							mCapacity	= 0;
+};
+
+/// @brief An occlusion culling statistics buffer in flight, read back once its fence signals.
+struct CullStatsReadback
+{
+	u32			mSSBO = 0;
+	GLsync		mFence = nullptr;
+};
+
+/// @brief A shadow cascade as it was last rendered.
+struct CachedCascade
+{
+	glm::mat4	mMatrix = glm::mat4(1.0f);
+	/// @brief The texel snapped center in the light space rotation, see Renderer::updateCascadeCache().
+	glm::vec3	mCenter = glm::vec3(0.0f);
+	f32			mRadius = 0.0f;
+	bool		mValid = false;
+	/// @brief The frames which rendered the layer.
+	u32			mUpdateCount = 0;
 };
 
 struct BloomMip
 {
 	glm::vec2	mSize;
+	/// @brief The part of the mip rendered at the current render scale.
+	glm::vec2	mRenderSize;
 	u32			mID;
 };
 
@@ -42,6 +194,9 @@ constexpr f32 kFarPlane = 1000.0f;
 constexpr f32 kMinCameraFOV = 5.0f;
 constexpr f32 kMaxCameraFOV = 75.0f;
 
+/// @brief The frames between a timestamp query and reading it, so the CPU never waits on the GPU.
+constexpr u32 kGpuTimerLatency = 4;
+
 struct Camera
 {
 	void		UpdateProjection(u32 inWidth, u32 inHeight)
@@ -63,12 +218,42 @@ struct Camera
 	f32			mFOV		= kMaxCameraFOV; /// @brief In degrees.
 };
 
+enum class EAmbientOcclusion : u32
+{
+	/// @brief Hemisphere samples in a fragment shader, blurred and upsampled.
+	Hemisphere,
+	/// @brief GTAO horizon search in a compute shader, accumulated over frames.
+	Horizon,
+};
+
+enum class EAntiAliasing : u32
+{
+	None,
+	/// @brief Edge detection and blending on the LDR frame.
+	FXAA,
+	/// @brief A jittered projection resolved against the reprojected history, before the post FX.
+	Temporal,
+};
+
+enum class ETransparency : u32
+{
+	/// @brief The instances of the transparent meshes sorted back to front and alpha blended.
+	Sorted,
+	/// @brief Weighted blended order independent transparency, a single unsorted pass which approximates the order.
+	WeightedBlended,
+	/// @brief A linked list of the fragments of every pixel, the nearest 16 are sorted and composited exactly by a resolve pass.
+	LinkedList,
+};
+
+constexpr u32 kTransparencyModeCount = 3;
+
 class Renderer final
 {
 public:
 											Renderer() = default;
 											~Renderer() = default;
 
+	/// @param ioWindow Null renders without ImGui, its backends need a window.
 	bool									StartUp(u32 inWidth, u32 inHeight, GLFWwindow* ioWindow);
 	void									ShutDown();
 
@@ -83,77 +268,448 @@ public:
 	/// @brief ImGui commands must go between BeginUI() and Render().
 	void									BeginUI();
 	void									Render(f32 inDeltaTime, f32 inCurrentTime);
+
+	/**
+	 * @brief Render kTransparencyBenchmarkFrames frames with every transparency mode, then print
+	 * the GPU time of their transparent pass and their error against the sorted mode. The
+	 * camera should stay still until it's done.
+	 */
+	void									BenchmarkTransparency();
+
 	struct
 	{
-		bool								mEnableFXAA = true;
+		EAntiAliasing						mAntiAliasing = EAntiAliasing::FXAA;
+		/// @brief The weight of the current frame in the temporal anti-aliasing.
+		f32									mTaaBlend = 0.1f;
 		bool								mEnableSSAO = true;
+		EAmbientOcclusion					mAmbientOcclusion = EAmbientOcclusion::Hemisphere;
+		/// @brief Horizon occlusion screen space directions per pixel.
+		u32									mGtaoSliceCount = 2;
+		/// @brief Horizon occlusion taps per side of every slice.
+		u32									mGtaoStepCount = 4;
+		/// @brief SSAO is computed at the resolution divided by this (1, 2 or 4) and upsampled.
+		u32									mSsaoResolutionDivisor = 2;
+		/// @brief At most kMaxSsaoSamples.
+		u32									mSsaoSampleCount = 32;
+		/// @brief In view space units, used by both occlusion passes.
+		f32									mSsaoRadius = 3.1f;
 		bool								mEnableCLUT = false;
+		/// @brief At most kMaxBloomMips, the first mip is half the resolution.
+		u32									mBloomMipCount = 5;
+		/// @brief The upsample tent filter radius in UV units.
+		f32									mBloomFilterRadius = 0.005f;
 		bool								mEnableAutoExposure = true;
+		/// @brief The darkest and brightest fractions of the histogram which the exposure ignores.
+		f32									mExposureLowPercentile = 0.5f;
+		f32									mExposureHighPercentile = 0.95f;
+		/// @brief In 1 / seconds.
+		f32									mExposureAdaptationSpeed = 2.5f;
+		/// @brief Color the scene by the shadow cascade it samples.
+		bool								mCsmDebug = false;
+		/**
+		 * @brief 12 bytes per pixel instead of 44: RGBA8 sRGB albedo with specular in alpha,
+		 * RG16 octahedral normals and the view space position reconstructed from depth.
+		 */
+		bool								mPackedGBuffer = true;
+		/**
+		 * @brief Render at a scale of the window size which follows the GPU time of the scaled
+		 * passes, then upscale and sharpen the frame to the window.
+		 */
+		bool								mDynamicResolution = false;
+		/// @brief The GPU time the scaled passes should take, in milliseconds.
+		f32									mTargetGpuTimeMs = 12.0f;
+		/// @brief The lowest render scale of each axis.
+		f32									mMinRenderScale = 0.5f;
+		/// @brief 0 to 1, the sharpening of the upscale.
+		f32									mSharpness = 0.5f;
+		/**
+		 * @brief Render the far shadow cascades again only when the camera moved out of their
+		 * margin or the sun moved. The meshes in mDynamicMeshes are redrawn over a cached copy of
+		 * the static meshes on a staggered schedule.
+		 */
+		bool								mCachedCascades = true;
+		/// @brief The cascades used out of the kCascadeCount layers of the cascade array.
+		u32									mCascadeCount = kCascadeCount;
+		/// @brief 0 splits the shadowed depth range evenly, 1 logarithmically.
+		f32									mCascadeSplitLambda = 0.75f;
+		/**
+		 * @brief Fit the cascade splits and projections to the depth range and light space bounds
+		 * of the visible pixels, reduced from the depth buffer a few frames earlier. The cached
+		 * cascades are bypassed, the bounds move every frame.
+		 */
+		bool								mSampleDistribution = false;
+		/**
+		 * @brief Draw the opaque meshes of the G-buffer with indirect draws whose instance count
+		 * is written by a two phase test against a depth pyramid. The shadow pass isn't culled.
+		 */
+		bool								mOcclusionCulling = true;
+		/**
+		 * @brief When mOcclusionCulling is off, rasterize mOccluderMeshes on the CPU and skip the
+		 * G-buffer meshes hidden behind them. The shadow pass isn't culled.
+		 */
+		bool								mSoftwareOcclusion = false;
+		/**
+		 * @brief Lay down the depth of the G-buffer meshes with a position only pass first, then shade
+		 * them with a GL_EQUAL depth test and no depth writes, so every pixel is shaded once.
+		 */
+		bool								mDepthPrepass = false;
+		/// @brief How the transparent meshes are composited over the lit scene.
+		ETransparency						mTransparency = ETransparency::Sorted;
 	} mSettings;
 
 	u32										mWidth = 0;
 	u32										mHeight = 0;
 
 	std::vector<const Geom::Mesh*>			mMeshes;
+	/// @brief Meshes which move, drawn with mMeshes but not cached in the shadow cascades, see Headless `--dynamic-model`.
+	std::vector<const Geom::Mesh*>			mDynamicMeshes;
 	std::vector<const Geom::PointLight*>	mPointLights;
 	Camera									mCamera;
 	Geom::Texture*							mLensDirtTexture = nullptr;
 	Shader									mDeferredShader;
+	Shader									mDepthPrepassShader;
 	Shader									mPostFxShader;
 	Shader									mFxaaShader;
 	Shader									mLightingShader;
 	Shader									mSsaoShader;
 	Shader									mSsaoBlurShader;
+	Shader									mSsaoDownsampleShader;
+	Shader									mSsaoUpsampleShader;
 	Shader									mBloomUpsampleShader;
-	Shader									mBloomDownsampleShader;
 	Shader									mShadowMapShader;
 	Shader									mTransparentShader;
+	Shader									mOitResolveShader;
 	Shader									mFullScreenShader;
+	Shader									mUpscaleShader;
 	ComputeShader							mLumaShader;
 	ComputeShader							mExposureShader;
+	ComputeShader							mGtaoShader;
+	ComputeShader							mBloomDownsampleShader;
+	ComputeShader							mTaaShader;
+	ComputeShader							mDepthBoundsShader;
+	ComputeShader							mCascadeBoundsShader;
+	ComputeShader							mHiZShader;
+	ComputeShader							mOcclusionCullShader;
 	Skybox									mSkybox;
 	u32										mFullScreenQuadVAO = 0;
 	u32										mFullScreenQuadVBO = 0;
 
+	/**
+	 * @brief The passes of a frame, built again when frameGraphKey() changes. The G-buffer
+	 * color, SSAO, bloom and post FX targets are its transients, the IDs of those targets
+	 * below are views owned by the graph which are set at every build.
+	 */
+	FrameGraph								mFrameGraph;
+	u64										mFrameGraphKey = 0;
+	f32										mDeltaTime = 0.0f;
+
+	/**
+	 * @brief The internal targets are allocated at the window size and the scaled passes render
+	 * to their bottom left mRenderWidth x mRenderHeight pixels, so a new scale needs no new targets.
+	 */
+	f32										mRenderScale = 1.0f;
+	u32										mRenderWidth = 0;
+	u32										mRenderHeight = 0;
+	/// @brief The render size over the window size, uRenderScale in the shaders.
+	glm::vec2								mRenderUVScale = glm::vec2(1.0f);
+	u32										mSsaoRenderWidth = 0;
+	u32										mSsaoRenderHeight = 0;
+	u32										mRenderScaleUBO = 0;
+	/// @brief The render scale of the frames in flight, by GpuProfiler::GetFrame().
+	f32										mGpuTimerScales[kGpuTimerLatency] = {};
+	/// @brief The last GPU time of the scaled passes, from the G-buffer zone to the post FX zone, in milliseconds.
+	f32										mGpuTimeMs = 0.0f;
+	/// @brief The fragment shader invocations of the G-buffer shading, a query per culling phase, by GpuProfiler::GetFrame().
+	u32										mGBufferFragmentQueries[2 * kGpuTimerLatency] = {};
+	/// @brief The phases every pair of fragment queries was used for.
+	u32										mGBufferFragmentQueryCounts[kGpuTimerLatency] = {};
+	struct
+	{
+		f32									mGBufferMs = 0.0f;
+		u64									mFragments = 0;
+		/// @brief mFragments over the rendered pixels, 1 when every covered pixel is shaded once.
+		f32									mOverdraw = 0.0f;
+	} mOverdrawStats;
+
 	u32										mAlbedoTex = 0;
 	u32										mSpecularTex = 0;
 	u32										mNormalTex = 0;
 	u32										mPositionTex = 0;
-	u32										mDepthRBO = 0;
+	u32										mDepthTex = 0;
+	/// @brief RG16F screen UV motion, only a target of the G-buffer with temporal anti-aliasing.
+	u32										mVelocityTex = 0;
 	u32										mDeferredFBO = 0;
 	u32										mLightingFBO = 0;
 	u32										mLightingTex = 0;
-	u32										mHdrFBO = 0;
+	/**
+	 * @brief The LDR post FX output. With the packed G-buffer the frame graph places it in
+	 * the memory of the albedo target, which is no longer read once the lighting pass ran.
+	 */
 	u32										mHdrTex = 0;
+	/// @brief The FXAA output at the render size, which the upscale reads with dynamic resolution.
+	u32										mAntiAliasFBO = 0;
+	u32										mAntiAliasTex = 0;
 	u32										mSsaoFBO = 0;
 	u32										mSsaoTex = 0;
 	u32										mSsaoBlurFBO = 0;
 	u32										mSsaoBlurTex = 0;
 	u32										mSsaoNoiseTex = 0;
-	u32										mFxaaFBO = 0;
-	u32										mFxaaTex = 0;
+	/// @brief The G-buffer view space normal (xyz) and z (w) at the SSAO resolution.
+	u32										mSsaoDepthNormalFBO = 0;
+	u32										mSsaoDepthNormalTex = 0;
+	u32										mSsaoUpsampleFBO = 0;
+	u32										mSsaoUpsampleTex = 0;
+	/// @brief The divisor the frame graph was built with.
+	u32										mSsaoDivisor = 0;
+	u32										mSsaoWidth = 0;
+	u32										mSsaoHeight = 0;
+	std::vector<glm::vec3>					mSsaoKernel;
+	/**
+	 * @brief The horizon occlusion ping-pongs between two targets, the one written last frame is
+	 * the history of the next. RGBA16F visibility and bent normal, R32F view space z.
+	 */
+	u32										mGtaoTex[2] = {};
+	u32										mGtaoViewZTex[2] = {};
+	/// @brief The target written by the last frame.
+	u32										mGtaoCurrent = 0;
+	/// @brief False when the last frame didn't compute horizon occlusion.
+	bool									mGtaoHistoryValid = false;
+	glm::mat4								mGtaoPrevView = glm::mat4(1.0f);
+	/// @brief mRenderUVScale of the frame which wrote the history.
+	glm::vec2								mGtaoPrevRenderScale = glm::vec2(1.0f);
+	/// @brief The resolved lighting ping-pongs like the horizon occlusion, RGBA16F.
+	u32										mTaaTex[2] = {};
+	/// @brief The target written by the last frame.
+	u32										mTaaCurrent = 0;
+	/// @brief False when the last frame didn't resolve the temporal anti-aliasing.
+	bool									mTaaHistoryValid = false;
+	glm::vec2								mTaaPrevRenderScale = glm::vec2(1.0f);
+	/// @brief mCamera.mProjection offset by the subpixel jitter of this frame.
+	glm::mat4								mJitteredProjection = glm::mat4(1.0f);
+	/// @brief The unjittered view projection of the last frame.
+	glm::mat4								mPrevViewProjection = glm::mat4(1.0f);
+	u32										mFrameIndex = 0;
 	u32										mBloomFBO = 0;
 	u32										mShadowMapFBO = 0;
 	u32										mCascadeTexArray = 0;
+	/// @brief The static meshes of the cached cascades, only created once there are dynamic meshes.
+	u32										mStaticCascadeTexArray = 0;
+	u32										mStaticShadowMapFBO = 0;
+	/// @brief The sun position the cached cascades were rendered with.
+	glm::vec3								mCascadeSunPos = glm::vec3(0.0f);
+	/// @brief A reduction per frame of the last kGpuTimerLatency frames, so the CPU never waits on the GPU.
+	DepthBoundsReadback						mDepthBoundsReadbacks[kGpuTimerLatency];
+	/// @brief The last bounds read back, mCascadeCount of 0 until there is one.
+	DepthBoundsComp							mDepthBounds;
+	u32										mDepthBoundsCascadeCount = 0;
+	glm::vec3								mDepthBoundsSunPos = glm::vec3(0.0f);
 	u32										mClutTex = 0;
 	std::vector<BloomMip>					mBloomMipChain;
+	/// @brief The ticket and per level done counters of BloomDownsample.comp.
+	u32										mBloomCounterSSBO = 0;
 
 	std::vector<const Geom::Mesh*>			mTransparentMeshes;
+	/// @brief The lights and cascades of the frame, the `FrameLights` block of `Lights.glsl`.
+	u32										mFrameLightsUBO = 0;
+	/// @brief The weighted blended targets, depth tested against the G-buffer depth.
+	u32										mOitFBO = 0;
+	/// @brief RGBA16F weighted premultiplied color and opacity.
+	u32										mOitAccumulationTex = 0;
+	/// @brief R16F transmittance.
+	u32										mOitRevealageTex = 0;
+	/// @brief R32UI first node of the linked list of every pixel, 0xFFFFFFFF ends a list.
+	u32										mOitHeadsTex = 0;
+	/// @brief The node counter and the linked list nodes, allocated the first time they're used.
+	u32										mOitNodeSSBO = 0;
+	u32										mOitNodeCapacity = 0;
+	/// @brief The node counter of every frame in flight, copied before the end timestamp of the pass.
+	u32										mOitNodeCountBuffer = 0;
+	/// @brief The transparency mode of the frames in flight, by GpuProfiler::GetFrame().
+	ETransparency							mTransparentTimerModes[kGpuTimerLatency] = {};
+	struct
+	{
+		/// @brief The last GPU time of the transparent pass in every mode, in milliseconds.
+		f32									mMs[kTransparencyModeCount] = {};
+		/// @brief The linked list nodes of the last frame read back, they overflowed above the capacity.
+		u32									mNodes = 0;
+	} mTransparencyStats;
+	struct
+	{
+		bool								mActive = false;
+		/// @brief The mode being measured and its frames so far.
+		u32									mMode = 0;
+		u32									mFrame = 0;
+		f64									mMsSum = 0.0;
+		u32									mSamples = 0;
+		/// @brief The mode to restore once it's done.
+		ETransparency						mPrevMode = ETransparency::Sorted;
+		/// @brief The lighting of the sorted mode, which the others are compared to.
+		std::vector<glm::vec4>				mReference;
+		glm::uvec2							mReferenceSize = glm::uvec2(0);
+		/// @brief The lighting of the mode being measured, read back after its frames.
+		std::vector<glm::vec4>				mImage;
+		glm::uvec2							mImageSize = glm::uvec2(0);
+		f32									mMs[kTransparencyModeCount] = {};
+		/// @brief The root mean square error of the RGB against the sorted mode.
+		f32									mError[kTransparencyModeCount] = {};
+		bool								mDone = false;
+	} mTransparencyBenchmark;
+	/// @brief The instances of the opaque meshes the G-buffer draws when the GPU culling is off.
+	IndirectDraws							mVisibleDraws;
+	/// @brief An instance per command, sorted back to front in the Sorted mode.
+	IndirectDraws							mTransparentDraws;
+
+	/// @brief The opaque meshes of mMeshes and mDynamicMeshes, in the order of the cull buffers.
+	std::vector<const Geom::Mesh*>			mCullMeshes;
+	/// @brief An object and command per instance of mCullMeshes, the instances of a mesh are contiguous.
+	std::vector<CullObject>					mCullObjects;
+	u32										mCullObjectSSBO = 0;
+	/// @brief The indirect draws of phase 1 and phase 2, one per mesh.
+	u32										mCullCommandBuffers[2] = {};
+	/// @brief A uint per mesh, whether it was visible at the end of the last frame.
+	u32										mCullVisibilitySSBO = 0;
+	/// @brief The meshes the cull buffers are allocated for.
+	u32										mCullCapacity = 0;
+	CullStatsReadback						mCullStatsReadbacks[kGpuTimerLatency];
+	/// @brief The last statistics read back.
+	CullStats								mCullStats;
+	/// @brief R32F farthest depth pyramid, level 0 is the largest power of two within the window.
+	u32										mHiZTex = 0;
+	u32										mHiZWidth = 0;
+	u32										mHiZHeight = 0;
+	u32										mHiZLevelCount = 0;
+
+	/// @brief The meshes rasterized by mSoftOcclusion, see SoftOcclusion::IsOccluderCandidate().
+	std::vector<const Geom::Mesh*>			mOccluderMeshes;
+	SoftOcclusion							mSoftOcclusion;
+	/// @brief Runs the software occlusion jobs, it's owned by the physics.
+	JPH::JobSystem*							mJobSystem = nullptr;
 
 	u32										mLumaSSBO = 0;
 
+	/// @brief The layout the frame graph was built with.
+	bool									mGBufferPacked = false;
+	usize									mDepthSizeBytes = 0;
+
 
 	glm::vec4								mClearColor = glm::vec4(0.1f, 0.14f, 0.21f, 1.0f);
 
 	/// ****************** CONSTANTS ****************** ///
 	sconst u32								kShadowQuality = 1024 * 4;
-	sconst u32								kFrustumCount = 3;
-	sconst u32								kCascadeCount = kFrustumCount + 1;
-	sconst glm::vec3						kSunDirection = glm::vec3(-0.2f, -1.0f, -0.2f);
+	/// @brief The layers of the cascade array, MAX_CASCADES in the shaders.
+	sconst u32								kCascadeCount = 4;
+	sconst glm::vec3						kSunColor = glm::vec3(0.38f);
+	sconst u32								kMaxSsaoSamples = 64;
+	/// @brief MAX_MIPS in BloomDownsample.comp, every mip takes an image unit.
+	sconst u32								kMaxBloomMips = 8;
+	/// @brief The log2 luminance range of the exposure histogram.
+	sconst f32								kExposureMinLogLuma = -10.0f;
+	sconst f32								kExposureLogLumaRange = 16.0f;
+	sconst u32								kExposureMaxInputWidth = 512;
+	/// @brief The binding of the `RenderScale` uniform block.
+	sconst u32								kRenderScaleBinding = 0;
+	/// @brief The part of the way to the render scale of the measured GPU time taken every frame.
+	sconst f32								kRenderScaleRate = 0.1f;
+	/// @brief The length of the Halton (2, 3) jitter sequence.
+	sconst u32								kTaaJitterCount = 8;
+	/// @brief The part of its radius a cached cascade is grown by, which the camera can move before it is rendered again.
+	sconst f32								kCascadeCacheMargin = 0.2f;
+	/// @brief The window size is divided by it for the software occlusion depth buffer.
+	sconst u32								kSoftOcclusionDivisor = 4;
+	/// @brief The binding of the `FrameLights` uniform block.
+	sconst u32								kFrameLightsBinding = 1;
+	/// @brief The linked list nodes are allocated for this many fragments per pixel on average.
+	sconst u32								kOitNodesPerPixel = 4;
+	/// @brief The size of a linked list node, see `Transparent.frag`.
+	sconst u32								kOitNodeSize = 16;
+	/// @brief The frames measured per mode by BenchmarkTransparency().
+	sconst u32								kTransparencyBenchmarkFrames = 64;
+
+	CachedCascade							mCascades[kCascadeCount];
+	/// @brief The far view space depth of every cascade, uShadowCascadeLevels in the shaders.
+	f32										mCascadeSplits[kCascadeCount] = {};
+
+	/**
+	 * @brief The framebuffer the last passes write, 0 is the window. It needs a 24 bit depth
+	 * attachment which the debug draw depth is copied to.
+	 */
+	u32										mOutputFBO = 0;
+	/// @brief Whether there is a window ImGui is drawn to.
+	bool									mEnableUI = true;
 
 private:
 	glm::mat4								getLightSpaceMatrix(f32 inNear, f32 inFar) const;
 	void									getLightSpaceMatrices(glm::mat4 ioMats[kCascadeCount]) const;
-	void									renderMeshes(Shader inShader);
-	void									bloomSetup();
+	/// @return Whether the last depth bounds read back match the current cascade count and sun.
+	bool									hasDepthBounds() const;
+	/// @brief Split the shadowed depth range into mSettings.mCascadeCount cascades, like CascadeBounds.comp.
+	void									updateCascadeSplits();
+	/// @brief Read the oldest depth bounds reduction back if it's done and start the one of this frame.
+	void									reduceDepthBounds();
+	/// @brief (Re)create the depth pyramid for the current size.
+	void									createHiZTarget();
+	/**
+	 * @brief Sort mMeshes and mDynamicMeshes into mCullMeshes and mTransparentMeshes, upload
+	 * their world space bounds and grow the cull buffers when needed.
+	 */
+	void									updateCullObjects();
+	/// @brief Write the indirect draws of a phase, see `OcclusionCull.comp`.
+	void									dispatchOcclusionCull(u32 inPhase);
+	/// @brief Build the depth pyramid from the depth buffer.
+	void									buildHiZ();
+	/// @brief Draw mCullMeshes with the indirect draws of a phase, with the bound program.
+	void									renderCulledMeshes(u32 inPhase, bool inDepthOnly = false);
+	/**
+	 * @brief Draw every instance of the opaque meshes with the bound program.
+	 * @param outTransparentMeshes Collects the transparent meshes, which are skipped.
+	 * @param inDepthOnly Draw only the positions, see Geom::Mesh::DrawDepth().
+	 */
+	void									renderMeshes(
+												const std::vector<const Geom::Mesh*>& inMeshes,
+												std::vector<const Geom::Mesh*>* outTransparentMeshes = nullptr,
+												bool inDepthOnly = false
+											);
+	/**
+	 * @brief Append the instances of the opaque meshes of inMeshes in the frustum to mVisibleDraws and
+	 * the transparent meshes to mTransparentMeshes. The instances ioOcclusion doesn't see are skipped when it's set.
+	 */
+	void									collectVisibleMeshes(const std::vector<const Geom::Mesh*>& inMeshes, const glm::vec4 inFrustumPlanes[6], SoftOcclusion* ioOcclusion);
+	/// @brief One command per instance of mTransparentMeshes in the frustum, sorted back to front if inSort.
+	void									collectTransparentDraws(bool inSort);
+	/// @brief Upload the commands to the buffer of ioDraws, which is grown to fit.
+	void									uploadIndirectDraws(IndirectDraws* ioDraws, const char* inLabel);
+	/// @brief Draw the commands of the uploaded inDraws with the bound program.
+	void									renderIndirectDraws(const IndirectDraws& inDraws, bool inDepthOnly = false);
+	/// @brief Read the G-buffer zone and queries of the frame GpuProfiler read last into mOverdrawStats.
+	void									readOverdrawStats();
+	/// @brief Upload the point lights, the sun and the cascades of the frame to mFrameLightsUBO.
+	void									updateFrameLights(const glm::mat4 inCascadeMatrices[kCascadeCount], u32 inCascadeCount);
+	/// @brief Read the transparent pass zone of the frame GpuProfiler read last into mTransparencyStats.
+	void									readTransparencyStats();
+	/// @brief Step BenchmarkTransparency() before the frame, which may switch the mode.
+	void									updateTransparencyBenchmark();
+	/// @brief Grow the linked list nodes to kOitNodesPerPixel per pixel of the window.
+	void									createOitNodes();
+	/**
+	 * @brief Fit the far cascades to spheres around their frustum slices, snapped to shadow map
+	 * texels, and move the cached ones which the camera left. The near cascade is left as is.
+	 * @return The mask of the cascades whose static meshes must be rendered again.
+	 */
+	u32										updateCascadeCache(glm::mat4 ioMats[kCascadeCount]);
+	/// @brief (Re)create the depth target shared by the deferred and lighting FBOs at the current size.
+	bool									createDepthTarget();
+	/// @brief A hash of the size and the settings which change the passes or their targets.
+	u64										frameGraphKey() const;
+	/// @brief Declare the passes of mSettings, compile the graph and attach its targets to the FBOs.
+	bool									buildFrameGraph();
+	/// @brief (Re)create the horizon occlusion targets at the current size, which drops the history.
+	void									createGtaoTargets();
+	/// @brief (Re)create the temporal anti-aliasing history at the current size, which drops it.
+	void									createTaaTargets();
+	/// @brief Generate mSettings.mSsaoSampleCount hemisphere samples.
+	void									updateSsaoKernel();
+	/// @brief Select the shader permutations which match mSettings.
+	void									selectPermutations();
+	/// @brief Read the oldest GPU timer, move the render scale toward the target time and upload it.
+	void									updateRenderScale();
 };
@@ -1,229 +1,678 @@
 #include "ResourceManager.h"
 
+#include "HotReload.h"
 #include "Memory.h"
 #include "Utils.h"
 #include <unordered_map>
 #include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <memory>
 #include <new>
 
-// i hate this file
+/**
+ * Every resource type has its own table with a dense slot array. A path is hashed
+ * when it's requested and mapped to a slot once, after that getting and releasing
+ * a resource is an index into the slot array using the handle. Every file has its
+ * own slot, files with identical textures share the GL texture, not the slot.
+ * A hash hit is only trusted after the stored path or size matches, so a collision
+ * loads its own resource instead of returning another one.
+ */
 
 using namespace ResMgr;
 namespace fs = std::filesystem;
 
-struct Resource
+/// @brief A path that maps to a slot, kept to tell a hit from a hash collision.
+struct SlotPath
 {
-	void*	mPtr		= nullptr;
+	u64			mHash;
+	std::string	mPath;
+};
+
+template <typename T>
+struct ResourceSlot
+{
+	T*					mPtr		= nullptr;
+	u32					mRefCount	= 0;
+	u32					mGeneration	= 1;
+	u32					mNextFree	= UINT32_MAX;
+	/// @brief Every path that maps to this slot (i.e. the absolute and the requested path).
+	std::vector<SlotPath>	mPaths;
+	/// @brief 0 if the resource type isn't deduplicated by content.
+	u64					mContentHash	= 0;
+};
+
+template <typename T>
+struct ResourceTable
+{
+	std::vector<ResourceSlot<T>>	mSlots;
+	std::unordered_map<u64, u32>	mPathToSlot;
+	u32								mFreeHead = UINT32_MAX;
+};
+
+/// @brief A GL texture shared by every texture file with identical pixels.
+struct TextureContent
+{
+	Geom::Texture		mTexture;
+	u32					mRefCount		= 0;
+	i32					mWidth			= 0;
+	i32					mHeight			= 0;
+	i32					mChannelCount	= 0;
+	Geom::ETextureType	mType			= Geom::ETextureType::Unknown;
+};
+
+/// @brief GPU buffers shared by every mesh with identical vertex and index data.
+struct MeshBuffers
+{
+	u32		mVBO		= UINT32_MAX;
+	u32		mEBO		= UINT32_MAX;
+	usize	mSizeBytes	= 0;
 	u32		mRefCount	= 0;
 };
 
 static struct
 {
-	std::unordered_map<std::string, Resource>	mResourceMap;
-	std::unordered_map<uptr, std::string>		mResourcePtrMap;
+	ResourceTable<Geom::Model>				mModels;
+	ResourceTable<Geom::Texture>			mTextures;
+	std::unordered_map<u64, TextureContent>	mTextureContents;
+	std::unordered_map<u64, MeshBuffers>	mMeshBuffers;
+	void									(*mOnModelReload)(const Geom::Model*) = nullptr;
 } gState;
 
-bool ResMgr::StartUp()
+/// @brief A texture being decoded on the hot reload thread.
+struct TextureReloadJob
 {
-	return true;
+	~TextureReloadJob() { Geom::Texture::FreeData(&mData); }
+
+	Handle<Geom::Texture>	mHandle;
+	Geom::ETextureType		mType = Geom::ETextureType::Unknown;
+	std::string				mPath;
+	Geom::TextureData		mData;
+	bool					mDecoded = false;
+};
+
+template <typename T>
+static ResourceSlot<T>* resolve(ResourceTable<T>& ioTable, Handle<T> inHandle)
+{
+	if (inHandle.mIndex >= ioTable.mSlots.size())
+		return nullptr;
+
+	ResourceSlot<T>& slot = ioTable.mSlots[inHandle.mIndex];
+	if (slot.mGeneration != inHandle.mGeneration || slot.mRefCount == 0)
+		return nullptr;
+
+	return &slot;
 }
 
-void ResMgr::ShutDown()
+/// @return false if the hash belongs to another path of the slot or isn't mapped to it.
+template <typename T>
+static bool slotHasPath(const ResourceSlot<T>& inSlot, u64 inHash, const char* inPath)
 {
-	for (const auto& p : gState.mResourceMap)
+	for (const SlotPath& path : inSlot.mPaths)
 	{
-		if (p.second.mRefCount != 0)
-		{
-			printf("WARN: ResMgr was shut down while object (0x%p) has a reference count above 0.\n", p.second.mPtr);
-			SBREAK();
-		}
+		if (path.mHash == inHash)
+			return path.mPath == inPath;
 	}
+
+	return false;
 }
 
-Geom::Model* ResMgr::GetModel(const char* inFilePath)
+/// @brief Map the path to the slot, unless another path with the same hash is mapped already.
+template <typename T>
+static void mapPath(ResourceTable<T>& ioTable, u32 inSlot, u64 inHash, const std::string& inPath)
 {
-	std::string filePath = fs::absolute(inFilePath).string();
+	if (!ioTable.mPathToSlot.emplace(inHash, inSlot).second)
+	{
+		printf("WARN: ResMgr path \"%s\" has the hash of another path, it won't be shared.\n", inPath.c_str());
+		return;
+	}
+
+	ioTable.mSlots[inSlot].mPaths.push_back({ inHash, inPath });
+}
+
+/**
+ * @brief Find the slot of a path. The hash of the path as requested is tried first so
+ * requesting the same path again doesn't touch the filesystem.
+ * @param outAbsolutePath Only written if the requested path was not found.
+ * @return UINT32_MAX if the path doesn't have a slot.
+ */
+template <typename T>
+static u32 findSlot(ResourceTable<T>& ioTable, const char* inFilePath, u64 inRequestHash, std::string* outAbsolutePath)
+{
+	auto it = ioTable.mPathToSlot.find(inRequestHash);
+	if (it != ioTable.mPathToSlot.end() && slotHasPath(ioTable.mSlots[it->second], inRequestHash, inFilePath))
+		return it->second;
 
-	if (gState.mResourceMap.find(filePath) != gState.mResourceMap.end())
+	std::string absolutePath = Utils::NormalizePath(inFilePath);
+	const u64 absoluteHash = Utils::HashString(absolutePath.c_str());
+
+	it = ioTable.mPathToSlot.find(absoluteHash);
+	if (it != ioTable.mPathToSlot.end() && slotHasPath(ioTable.mSlots[it->second], absoluteHash, absolutePath.c_str()))
 	{
-		Geom::Model* model = (Geom::Model*)gState.mResourceMap[filePath].mPtr;
-		gState.mResourceMap[filePath].mRefCount++;
-		return model;
+		// remember the requested path so the next request for it hits the first lookup
+		if (inRequestHash != absoluteHash)
+			mapPath(ioTable, it->second, inRequestHash, inFilePath);
+		return it->second;
+	}
+
+	if (outAbsolutePath)
+		*outAbsolutePath = std::move(absolutePath);
+
+	return UINT32_MAX;
+}
+
+/// @brief Map both the absolute and the requested path to the slot.
+template <typename T>
+static void addPaths(ResourceTable<T>& ioTable, u32 inSlot, const std::string& inAbsolutePath, const char* inFilePath, u64 inRequestHash)
+{
+	const u64 absoluteHash = Utils::HashString(inAbsolutePath.c_str());
+	mapPath(ioTable, inSlot, absoluteHash, inAbsolutePath);
+	if (inRequestHash != absoluteHash)
+		mapPath(ioTable, inSlot, inRequestHash, inFilePath);
+}
+
+/// @brief Put a loaded resource in a free slot with a reference count of 1.
+template <typename T>
+static Handle<T> insert(ResourceTable<T>& ioTable, T* inResource, const std::string& inAbsolutePath, const char* inFilePath, u64 inRequestHash)
+{
+	u32 idx = UINT32_MAX;
+	if (ioTable.mFreeHead != UINT32_MAX)
+	{
+		idx = ioTable.mFreeHead;
+		ioTable.mFreeHead = ioTable.mSlots[idx].mNextFree;
 	} else
 	{
-		gState.mResourceMap[filePath].mRefCount = 1;
-		gState.mResourceMap[filePath].mPtr = Mem::AllocT<Geom::Model>(EMemSource::ModelRAM);
-		Geom::Model* model = (Geom::Model*)gState.mResourceMap[filePath].mPtr;
-		if (!model)
-			return nullptr;
+		idx = (u32)ioTable.mSlots.size();
+		ioTable.mSlots.emplace_back();
+	}
 
-		gState.mResourcePtrMap[(uptr)model] = inFilePath;
+	ResourceSlot<T>& slot = ioTable.mSlots[idx];
+	slot.mPtr		= inResource;
+	slot.mRefCount	= 1;
+	slot.mNextFree	= UINT32_MAX;
+	addPaths(ioTable, idx, inAbsolutePath, inFilePath, inRequestHash);
 
-		if (!model->Load(filePath.c_str()))
-		{
-			Mem::FreeT<Geom::Model>(model, EMemSource::ModelRAM);
+	inResource->mHandle = { idx, slot.mGeneration };
+	return inResource->mHandle;
+}
 
-			gState.mResourceMap.erase(filePath);
-			gState.mResourcePtrMap.erase((uptr)model);
+template <typename T, typename LoadFn>
+static Handle<T> acquire(ResourceTable<T>& ioTable, const char* inFilePath, EMemSource inSource, LoadFn inLoad)
+{
+	const u64 requestHash = Utils::HashString(inFilePath);
 
-			return nullptr;
-		}
+	std::string absolutePath;
+	u32 idx = findSlot(ioTable, inFilePath, requestHash, &absolutePath);
+	if (idx != UINT32_MAX)
+	{
+		ResourceSlot<T>& slot = ioTable.mSlots[idx];
+		slot.mRefCount++;
+		return { idx, slot.mGeneration };
+	}
 
-		return model;
+	T* resource = Mem::AllocT<T>(inSource);
+	if (!resource)
+		return {};
+
+	if (!inLoad(resource, absolutePath.c_str()))
+	{
+		Mem::FreeT<T>(resource, inSource);
+		return {};
 	}
+
+	return insert(ioTable, resource, absolutePath, inFilePath, requestHash);
 }
 
-void ResMgr::ReleaseModel(const char* inFilePath)
+template <typename T, typename UnloadFn>
+static void release(ResourceTable<T>& ioTable, Handle<T> inHandle, EMemSource inSource, UnloadFn inUnload)
 {
-	std::string filePath = fs::absolute(inFilePath).string();
+	ResourceSlot<T>* slot = resolve(ioTable, inHandle);
+	if (!slot)
+	{
+		ZR_ASSERT(false, "Attempted to release a resource by a stale or invalid handle.");
+		return;
+	}
 
-	if (gState.mResourceMap.find(filePath) != gState.mResourceMap.end())
+	slot->mRefCount--;
+	if (slot->mRefCount != 0)
+		return;
+
+	inUnload(*slot);
+	Mem::FreeT<T>(slot->mPtr, inSource);
+	slot->mPtr = nullptr;
+
+	for (const SlotPath& path : slot->mPaths)
+		ioTable.mPathToSlot.erase(path.mHash);
+	slot->mPaths.clear();
+
+	// invalidate every handle to this slot. skip 0 because it marks invalid handles
+	slot->mGeneration++;
+	if (slot->mGeneration == 0)
+		slot->mGeneration = 1;
+
+	slot->mNextFree = ioTable.mFreeHead;
+	ioTable.mFreeHead = inHandle.mIndex;
+}
+
+template <typename T>
+static Handle<T> handleOfPath(ResourceTable<T>& ioTable, const char* inFilePath)
+{
+	u32 idx = findSlot(ioTable, inFilePath, Utils::HashString(inFilePath), nullptr);
+	if (idx == UINT32_MAX)
+		return {};
+
+	return { idx, ioTable.mSlots[idx].mGeneration };
+}
+
+bool ResMgr::StartUp()
+{
+	return true;
+}
+
+void ResMgr::ShutDown()
+{
+	for (const ResourceSlot<Geom::Model>& slot : gState.mModels.mSlots)
 	{
-		if (gState.mResourceMap[filePath].mRefCount == 0)
+		if (slot.mRefCount != 0)
 		{
-			ZR_ASSERT(false, "Attempted to release model which has a ref-count of 0.");
-			return;
+			printf("WARN: ResMgr was shut down while model (0x%p) has a reference count above 0.\n", (void*)slot.mPtr);
+			SBREAK();
 		}
-		
-		gState.mResourceMap[filePath].mRefCount--;
+	}
 
-		if (gState.mResourceMap[filePath].mRefCount == 0)
+	for (const ResourceSlot<Geom::Texture>& slot : gState.mTextures.mSlots)
+	{
+		if (slot.mRefCount != 0)
 		{
-			Geom::Model* model = (Geom::Model*)gState.mResourceMap[filePath].mPtr;
+			printf("WARN: ResMgr was shut down while texture (0x%p) has a reference count above 0.\n", (void*)slot.mPtr);
+			SBREAK();
+		}
+	}
 
-			model->Unload();
-			Mem::FreeT<Geom::Model>(model, EMemSource::ModelRAM);
+	if (!gState.mMeshBuffers.empty())
+	{
+		printf("WARN: ResMgr was shut down while %zu mesh buffers are still referenced.\n", gState.mMeshBuffers.size());
+		SBREAK();
+	}
+}
 
-			gState.mResourceMap.erase(filePath);
-			gState.mResourcePtrMap.erase((uptr)model);
-		}
-	} else
+Handle<Geom::Model> ResMgr::AcquireModel(const char* inFilePath)
+{
+	return acquire(gState.mModels, inFilePath, EMemSource::ModelRAM, [](Geom::Model* ioModel, const char* inAbsolutePath) {
+		return ioModel->Load(inAbsolutePath);
+	});
+}
+
+Geom::Model* ResMgr::GetModel(Handle<Geom::Model> inHandle)
+{
+	ResourceSlot<Geom::Model>* slot = resolve(gState.mModels, inHandle);
+	return slot ? slot->mPtr : nullptr;
+}
+
+void ResMgr::ReleaseModel(Handle<Geom::Model> inHandle)
+{
+	release(gState.mModels, inHandle, EMemSource::ModelRAM, [](ResourceSlot<Geom::Model>& ioSlot) {
+		ioSlot.mPtr->Unload();
+	});
+}
+
+Geom::Model* ResMgr::GetModel(const char* inFilePath)
+{
+	return GetModel(AcquireModel(inFilePath));
+}
+
+void ResMgr::ReleaseModel(const char* inFilePath)
+{
+	Handle<Geom::Model> handle = handleOfPath(gState.mModels, inFilePath);
+	if (!handle.IsValid())
 	{
 		ZR_ASSERT(false, "Attempted to release model which doesn't exist.");
+		return;
 	}
+
+	ReleaseModel(handle);
 }
 
 void ResMgr::ReleaseModel(const Geom::Model* inModel)
 {
-	if (gState.mResourcePtrMap.find((uptr)inModel) == gState.mResourcePtrMap.end())
+	ReleaseModel(inModel->mHandle);
+}
+
+/**
+ * @brief Point ioTexture at the GL texture of the data's content, uploading it if no other file
+ * has the same pixels (e.g. a texture copied next to every model). Its handle is kept.
+ * @param outContentHash The key of the content, the data's hash unless it collided with another texture.
+ */
+static bool acquireTextureContent(const Geom::TextureData& inData, Geom::ETextureType inType, Geom::Texture* ioTexture, u64* outContentHash)
+{
+	const Handle<Geom::Texture> handle = ioTexture->mHandle;
+
+	// a hash shared by a texture of another size or type is a collision, try the next one
+	u64 contentHash = inData.mContentHash;
+	auto it = gState.mTextureContents.find(contentHash);
+	while (it != gState.mTextureContents.end() && (
+		it->second.mWidth != inData.mWidth || it->second.mHeight != inData.mHeight ||
+		it->second.mChannelCount != inData.mChannelCount || it->second.mType != inType))
 	{
-		ZR_ASSERT(false, "Attempted to release model by reference which doesn't exist.");
-		return;
+		it = gState.mTextureContents.find(++contentHash);
 	}
 
-	const std::string& modelPath = gState.mResourcePtrMap[(uptr)inModel];
-	std::string filePath = fs::absolute(modelPath).string();
+	*outContentHash = contentHash;
+	if (it != gState.mTextureContents.end())
+	{
+		TextureContent& content = it->second;
+		content.mRefCount++;
+		Mem::ReportDedup(content.mTexture.mSizeBytes, EMemSource::TextureVRAM);
+
+		*ioTexture = content.mTexture;
+		ioTexture->mHandle = handle;
+		return true;
+	}
 
-	if (gState.mResourceMap[filePath].mRefCount == 0)
+	Geom::Texture fresh;
+	if (!fresh.Upload(inData, inType))
+		return false;
+
+	TextureContent& content = gState.mTextureContents[contentHash];
+	content.mTexture		= fresh;
+	content.mRefCount		= 1;
+	content.mWidth			= inData.mWidth;
+	content.mHeight			= inData.mHeight;
+	content.mChannelCount	= inData.mChannelCount;
+	content.mType			= inType;
+
+	*ioTexture = fresh;
+	ioTexture->mHandle = handle;
+	return true;
+}
+
+/// @brief The GL texture is deleted with the last file that references it.
+static void releaseTextureContent(u64 inContentHash)
+{
+	auto it = gState.mTextureContents.find(inContentHash);
+	if (it == gState.mTextureContents.end())
+	{
+		ZR_ASSERT(false, "Attempted to release a texture content which doesn't exist.");
+		return;
+	}
+
+	TextureContent& content = it->second;
+	content.mRefCount--;
+	if (content.mRefCount != 0)
 	{
-		ZR_ASSERT(false, "Attempted to release model which has a ref-count of 0.");
+		Mem::ReportDedupFree(content.mTexture.mSizeBytes, EMemSource::TextureVRAM);
 		return;
 	}
 
-	gState.mResourceMap[filePath].mRefCount--;
+	content.mTexture.Unload();
+	gState.mTextureContents.erase(it);
+}
+
+Handle<Geom::Texture> ResMgr::AcquireTexture(const char* inFilePath, Geom::ETextureType inType)
+{
+	ResourceTable<Geom::Texture>& table = gState.mTextures;
+	const u64 requestHash = Utils::HashString(inFilePath);
 
-	if (gState.mResourceMap[filePath].mRefCount == 0)
+	std::string absolutePath;
+	u32 idx = findSlot(table, inFilePath, requestHash, &absolutePath);
+	if (idx != UINT32_MAX)
 	{
-		Geom::Model* model = (Geom::Model*)gState.mResourceMap[filePath].mPtr;
+		ResourceSlot<Geom::Texture>& slot = table.mSlots[idx];
+		slot.mRefCount++;
+		return { idx, slot.mGeneration };
+	}
+
+	Geom::TextureData data;
+	if (!Geom::Texture::Decode(absolutePath.c_str(), inType, &data))
+		return {};
 
-		model->Unload();
-		Mem::FreeT<Geom::Model>(model, EMemSource::ModelRAM);
+	Geom::Texture* texture = Mem::AllocT<Geom::Texture>(EMemSource::TextureRAM);
+	if (!texture)
+	{
+		Geom::Texture::FreeData(&data);
+		return {};
+	}
 
-		gState.mResourceMap.erase(filePath);
-		gState.mResourcePtrMap.erase((uptr)model);
+	u64 contentHash = 0;
+	const bool uploaded = acquireTextureContent(data, inType, texture, &contentHash);
+	Geom::Texture::FreeData(&data);
+	if (!uploaded)
+	{
+		Mem::FreeT<Geom::Texture>(texture, EMemSource::TextureRAM);
+		return {};
 	}
+
+	Handle<Geom::Texture> handle = insert(table, texture, absolutePath, inFilePath, requestHash);
+	table.mSlots[handle.mIndex].mContentHash = contentHash;
+	return handle;
+}
+
+Geom::Texture* ResMgr::GetTexture(Handle<Geom::Texture> inHandle)
+{
+	ResourceSlot<Geom::Texture>* slot = resolve(gState.mTextures, inHandle);
+	return slot ? slot->mPtr : nullptr;
+}
+
+void ResMgr::ReleaseTexture(Handle<Geom::Texture> inHandle)
+{
+	release(gState.mTextures, inHandle, EMemSource::TextureRAM, [](ResourceSlot<Geom::Texture>& ioSlot) {
+		releaseTextureContent(ioSlot.mContentHash);
+		ioSlot.mContentHash = 0;
+	});
 }
 
 Geom::Texture* ResMgr::GetTexture(const char* inFilePath, Geom::ETextureType inType)
 {
-	std::string filePath = fs::absolute(inFilePath).string();
+	return GetTexture(AcquireTexture(inFilePath, inType));
+}
 
-	if (gState.mResourceMap.find(filePath) != gState.mResourceMap.end())
-	{
-		Geom::Texture* texture = (Geom::Texture*)gState.mResourceMap[filePath].mPtr;
-		gState.mResourceMap[filePath].mRefCount++;
-		return texture;
-	} else
+void ResMgr::ReleaseTexture(const char* inFilePath)
+{
+	Handle<Geom::Texture> handle = handleOfPath(gState.mTextures, inFilePath);
+	if (!handle.IsValid())
 	{
-		gState.mResourceMap[filePath].mRefCount = 1;
-		gState.mResourceMap[filePath].mPtr = Mem::AllocT<Geom::Texture>(EMemSource::TextureRAM);
-		Geom::Texture* texture = (Geom::Texture*)gState.mResourceMap[filePath].mPtr;
-		if (!texture)
-			return nullptr;
+		ZR_ASSERT(false, "Attempted to release texture which doesn't exist.");
+		return;
+	}
 
-		gState.mResourcePtrMap[(uptr)texture] = inFilePath;
+	ReleaseTexture(handle);
+}
 
-		if (!texture->Load(filePath.c_str(), inType))
-		{
-			Mem::FreeT<Geom::Texture>(texture, EMemSource::TextureRAM);
+void ResMgr::ReleaseTexture(const Geom::Texture* inTexture)
+{
+	ReleaseTexture(inTexture->mHandle);
+}
+
+bool ResMgr::AcquireMeshBuffers(u64* ioContentHash, usize inSizeBytes, u32* outVBO, u32* outEBO)
+{
+	// a hash shared by data of another size is a collision, try the next one
+	auto it = gState.mMeshBuffers.find(*ioContentHash);
+	while (it != gState.mMeshBuffers.end() && it->second.mSizeBytes != inSizeBytes)
+		it = gState.mMeshBuffers.find(++*ioContentHash);
 
-			gState.mResourceMap.erase(filePath);
-			gState.mResourcePtrMap.erase((uptr)texture);
+	if (it == gState.mMeshBuffers.end())
+		return false;
 
-			return nullptr;
-		}
+	MeshBuffers& buffers = it->second;
+	buffers.mRefCount++;
+	Mem::ReportDedup(buffers.mSizeBytes, EMemSource::ModelVRAM);
 
-		return texture;
-	}
+	*outVBO = buffers.mVBO;
+	*outEBO = buffers.mEBO;
+	return true;
 }
 
-void ResMgr::ReleaseTexture(const char* inFilePath)
+void ResMgr::AddMeshBuffers(u64 inContentHash, u32 inVBO, u32 inEBO, usize inSizeBytes)
 {
-	std::string filePath = fs::absolute(inFilePath).string();
+	ZR_ASSERT(gState.mMeshBuffers.find(inContentHash) == gState.mMeshBuffers.end(), "Mesh buffers were added twice for the same content.");
+
+	MeshBuffers& buffers = gState.mMeshBuffers[inContentHash];
+	buffers.mVBO		= inVBO;
+	buffers.mEBO		= inEBO;
+	buffers.mSizeBytes	= inSizeBytes;
+	buffers.mRefCount	= 1;
+	Mem::ReportAlloc(inSizeBytes, EMemSource::ModelVRAM);
+}
 
-	if (gState.mResourceMap.find(filePath) != gState.mResourceMap.end())
+bool ResMgr::ReleaseMeshBuffers(u64 inContentHash)
+{
+	auto it = gState.mMeshBuffers.find(inContentHash);
+	if (it == gState.mMeshBuffers.end())
 	{
-		if (gState.mResourceMap[filePath].mRefCount == 0)
-		{
-			ZR_ASSERT(false, "Attempted to release texture which has a ref-count of 0.");
-			return;
-		}
+		ZR_ASSERT(false, "Attempted to release mesh buffers which don't exist.");
+		return false;
+	}
 
-		gState.mResourceMap[filePath].mRefCount--;
+	MeshBuffers& buffers = it->second;
+	buffers.mRefCount--;
+	if (buffers.mRefCount != 0)
+	{
+		Mem::ReportDedupFree(buffers.mSizeBytes, EMemSource::ModelVRAM);
+		return false;
+	}
 
-		if (gState.mResourceMap[filePath].mRefCount == 0)
-		{
-			Geom::Texture* texture = (Geom::Texture*)gState.mResourceMap[filePath].mPtr;
+	Mem::ReportFree(buffers.mSizeBytes, EMemSource::ModelVRAM);
+	gState.mMeshBuffers.erase(it);
+	return true;
+}
 
-			texture->Unload();
-			Mem::FreeT<Geom::Texture>(texture, EMemSource::TextureRAM);
+static void finishTextureReload(const TextureReloadJob& inJob)
+{
+	ResourceTable<Geom::Texture>& table = gState.mTextures;
 
-			gState.mResourceMap.erase(filePath);
-			gState.mResourcePtrMap.erase((uptr)texture);
-		}
-	} else
+	// the texture may have been released while it was decoded
+	ResourceSlot<Geom::Texture>* slot = resolve(table, inJob.mHandle);
+	if (!slot)
+		return;
+
+	if (!inJob.mDecoded)
 	{
-		ZR_ASSERT(false, "Attempted to release texture which doesn't exist.");
+		printf("ERROR(ResMgr): Failed to reload texture \"%s\", keeping the last good version.\n", inJob.mPath.c_str());
+		return;
 	}
-}
 
-void ResMgr::ReleaseTexture(const Geom::Texture* inTexture)
-{
-	if (gState.mResourcePtrMap.find((uptr)inTexture) == gState.mResourcePtrMap.end())
+	// saving a file without changing it
+	if (inJob.mData.mContentHash == slot->mContentHash)
+		return;
+
+	// only the edited file moves to the new content, files with the old pixels keep the old texture
+	const u64 oldContentHash = slot->mContentHash;
+	u64 contentHash = 0;
+	if (!acquireTextureContent(inJob.mData, inJob.mType, slot->mPtr, &contentHash))
 	{
-		ZR_ASSERT(false, "Attempted to release texture by reference which doesn't exist.");
+		printf("ERROR(ResMgr): Failed to reload texture \"%s\", keeping the last good version.\n", inJob.mPath.c_str());
 		return;
 	}
 
-	const std::string& texturePath = gState.mResourcePtrMap[(uptr)inTexture];
-	std::string filePath = fs::absolute(texturePath).string();
+	slot->mContentHash = contentHash;
+	releaseTextureContent(oldContentHash);
+
+	printf("Reloaded texture \"%s\".\n", inJob.mPath.c_str());
+}
 
-	if (gState.mResourceMap[filePath].mRefCount == 0)
+static void reloadTexture(u32 inSlot, const std::string& inPath)
+{
+	ResourceSlot<Geom::Texture>& slot = gState.mTextures.mSlots[inSlot];
+
+	std::shared_ptr<TextureReloadJob> job = std::make_shared<TextureReloadJob>();
+	job->mHandle	= { inSlot, slot.mGeneration };
+	job->mType		= slot.mPtr->mType;
+	job->mPath		= inPath;
+
+	HotReload::Async(
+		[job]() {
+			job->mDecoded = Geom::Texture::Decode(job->mPath.c_str(), job->mType, &job->mData);
+		},
+		[job]() {
+			finishTextureReload(*job);
+		}
+	);
+}
+
+/**
+ * @brief Models are reloaded on the main thread because loading uploads the meshes.
+ * The new model is loaded before the old one is unloaded so shared textures and mesh
+ * buffers are not uploaded again.
+ */
+static void reloadModel(u32 inSlot, const std::string& inPath)
+{
+	Geom::Model fresh;
+	if (!fresh.Load(inPath.c_str()))
 	{
-		ZR_ASSERT(false, "Attempted to release texture which has a ref-count of 0.");
+		printf("ERROR(ResMgr): Failed to reload model \"%s\", keeping the last good version.\n", inPath.c_str());
 		return;
 	}
 
-	gState.mResourceMap[filePath].mRefCount--;
+	Geom::Model* model = gState.mModels.mSlots[inSlot].mPtr;
+	model->Unload();
+	fresh.mHandle = model->mHandle;
+	*model = std::move(fresh);
+
+	printf("Reloaded model \"%s\".\n", inPath.c_str());
 
-	if (gState.mResourceMap[filePath].mRefCount == 0)
+	if (gState.mOnModelReload)
+		gState.mOnModelReload(model);
+}
+
+void ResMgr::OnFilesChanged(const std::vector<std::string>& inPaths)
+{
+	for (const std::string& path : inPaths)
 	{
-		Geom::Texture* texture = (Geom::Texture*)gState.mResourceMap[filePath].mPtr;
+		const u64 hash = Utils::HashString(path.c_str());
 
-		texture->Unload();
-		Mem::FreeT<Geom::Texture>(texture, EMemSource::TextureRAM);
+		auto textureIt = gState.mTextures.mPathToSlot.find(hash);
+		if (textureIt != gState.mTextures.mPathToSlot.end() && slotHasPath(gState.mTextures.mSlots[textureIt->second], hash, path.c_str()))
+			reloadTexture(textureIt->second, path);
+
+		auto modelIt = gState.mModels.mPathToSlot.find(hash);
+		if (modelIt != gState.mModels.mPathToSlot.end() && slotHasPath(gState.mModels.mSlots[modelIt->second], hash, path.c_str()))
+			reloadModel(modelIt->second, path);
+	}
+}
+
+void ResMgr::SetModelReloadCallback(void (*inFn)(const Geom::Model* inModel))
+{
+	gState.mOnModelReload = inFn;
+}
+
+void ResMgr::Benchmark()
+{
+	constexpr u32 kIterations = 100000;
+	static const char* kPath = "res/textures/lens_dirt.jpg";
 
-		gState.mResourceMap.erase(filePath);
-		gState.mResourcePtrMap.erase((uptr)texture);
+	// hold a reference so the texture stays loaded between the pairs
+	const Handle<Geom::Texture> handle = AcquireTexture(kPath);
+	if (!handle.IsValid())
+	{
+		printf("ERROR(ResMgr): Failed to load \"%s\" for the benchmark.\n", kPath);
+		return;
 	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (u32 i = 0; i < kIterations; i++)
+		ReleaseTexture(GetTexture(kPath));
+	const f32 pathMs = std::chrono::duration<f32, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	for (u32 i = 0; i < kIterations; i++)
+		ReleaseTexture(AcquireTexture(kPath));
+	const f32 handleMs = std::chrono::duration<f32, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// volatile keeps the loop from being optimized away
+	Geom::Texture* volatile texture = nullptr;
+	start = std::chrono::high_resolution_clock::now();
+	for (u32 i = 0; i < kIterations; i++)
+		texture = GetTexture(handle);
+	const f32 getMs = std::chrono::duration<f32, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	ReleaseTexture(handle);
+
+	printf(
+		"Resource handle benchmark (%u get/release pairs of \"%s\"):\n"
+		"\tPath get + pointer release: %.3f ms\n"
+		"\tAcquire + handle release: %.3f ms\n"
+		"\tHandle get only: %.3f ms\n",
+		kIterations, kPath, pathMs, handleMs, getMs
+	);
 }
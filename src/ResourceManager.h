@@ -1,18 +1,59 @@
 #pragma once
 
 #include "Geom.h"
+#include "Handle.h"
 #include "defines.h"
+#include <string>
+#include <vector>
 
 namespace ResMgr
 {
-	bool			StartUp();
-	void			ShutDown();
+	bool					StartUp();
+	void					ShutDown();
 
-	Geom::Model*	GetModel(const char* inFilePath);
-	void			ReleaseModel(const char* inFilePath);
-	void			ReleaseModel(const Geom::Model* inModel);
+	/**
+	 * @brief Acquire functions increase the reference count of the resource at
+	 * the path (loading it if needed) and return an invalid handle on failure.
+	 * Every acquire must be matched with a release.
+	 */
+	Handle<Geom::Model>		AcquireModel(const char* inFilePath);
+	/// @return nullptr if the handle is stale or invalid.
+	Geom::Model*			GetModel(Handle<Geom::Model> inHandle);
+	void					ReleaseModel(Handle<Geom::Model> inHandle);
 
-	Geom::Texture*	GetTexture(const char* inFilePath, Geom::ETextureType inType = Geom::ETextureType::Unknown);
-	void			ReleaseTexture(const char* inFilePath);
-	void			ReleaseTexture(const Geom::Texture* inTexture);
+	Geom::Model*			GetModel(const char* inFilePath);
+	void					ReleaseModel(const char* inFilePath);
+	void					ReleaseModel(const Geom::Model* inModel);
+
+	Handle<Geom::Texture>	AcquireTexture(const char* inFilePath, Geom::ETextureType inType = Geom::ETextureType::Unknown);
+	/// @return nullptr if the handle is stale or invalid.
+	Geom::Texture*			GetTexture(Handle<Geom::Texture> inHandle);
+	void					ReleaseTexture(Handle<Geom::Texture> inHandle);
+
+	Geom::Texture*			GetTexture(const char* inFilePath, Geom::ETextureType inType = Geom::ETextureType::Unknown);
+	void					ReleaseTexture(const char* inFilePath);
+	void					ReleaseTexture(const Geom::Texture* inTexture);
+
+	/**
+	 * @brief Meshes with identical vertex and index data share one pair of GPU buffers.
+	 * @param ioContentHash Moved past hashes of data with another size, keep it for the release.
+	 * @return false if there are no buffers for the content hash yet, the caller
+	 * must then create them and call AddMeshBuffers().
+	 */
+	bool					AcquireMeshBuffers(u64* ioContentHash, usize inSizeBytes, u32* outVBO, u32* outEBO);
+	void					AddMeshBuffers(u64 inContentHash, u32 inVBO, u32 inEBO, usize inSizeBytes);
+	/// @return true if this was the last reference and the buffers must be deleted.
+	bool					ReleaseMeshBuffers(u64 inContentHash);
+
+	/**
+	 * @brief Subscribed to HotReload. Changed textures are decoded on the hot reload
+	 * thread and swapped in place, so Texture pointers stay valid. Changed models are
+	 * loaded again and replace the meshes of the old model.
+	 */
+	void					OnFilesChanged(const std::vector<std::string>& inPaths);
+	/// @brief Called after a model was reloaded. Pointers to its meshes and lights are invalidated.
+	void					SetModelReloadCallback(void (*inFn)(const Geom::Model* inModel));
+
+	/// @brief Time 100k get/release pairs of an already loaded texture and print the timings.
+	void					Benchmark();
 }
@@ -1,243 +1,961 @@
 #include "Shader.h"
 
+#include "GLState.h"
+#include "HotReload.h"
 #include "Utils.h"
 #define STB_INCLUDE_IMPLEMENTATION
 #define STB_INCLUDE_LINE_GLSL
 #include <stb_include.h>
 #include <glad/glad.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <thread>
+
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+	#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+	#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+using MaxShaderCompilerThreadsFn = void (APIENTRY*)(GLuint inCount);
+using ProcLoaderFn = void* (*)(const char* inName);
+
+sconst char* kIncludeDir = "res/shaders";
+sconst char* kBinaryCacheDir = "cache/shaders";
+/// @brief Above this the least recently used binaries are deleted when the first program is built.
+sconst u64 kBinaryCacheMaxBytes = 64ull * 1024 * 1024;
+sconst u32 kBinaryMagic = 0x4250525A; // "ZRPB"
+
+/// @brief The header of a program binary file in the cache directory.
+struct ProgramBinaryHeader
+{
+	u32	mMagic		= kBinaryMagic;
+	u32	mFormat		= 0;
+	u32	mSize		= 0;
+	u32	mPadding	= 0;
+	u64	mKey		= 0;
+};
+
+/// @brief A program whose compilation was started but not checked yet.
+struct PendingProgram
+{
+	u32*						mID = nullptr;
+	u32							mProgram = UINT32_MAX;
+	std::vector<ShaderStage>	mStages;
+	std::vector<u32>			mShaders;
+	/// @brief Hash of the expanded sources and the driver.
+	u64							mCacheKey = 0;
+	bool						mFromCache = false;
+	Clock::time_point			mStart;
+	std::function<void()>		mOnFailed;
+};
+
+/// @brief A program that is rebuilt when one of the files it was built from changes.
+struct ReloadEntry
+{
+	u32*						mID = nullptr;
+	std::vector<ShaderStage>	mStages;
+	std::vector<u64>			mDependencyHashes;
+	std::function<void()>		mOnReload;
+	/// @brief The binary cache key of the program, its binary is deleted when a reload replaces it.
+	u64							mCacheKey = 0;
+};
+
+/// @brief The sources of a reload, preprocessed on the hot reload thread.
+struct ReloadJob
+{
+	std::vector<ShaderStage>	mStages;
+	std::vector<std::string>	mSources;
+	std::vector<std::string>	mDependencies;
+	bool						mSucceeded = false;
+};
 
-bool Shader::Load(const char* inVertexPath, const char* inFragmentPath, const char* inGeometryPath)
+static struct
 {
-	ZR_ASSERT(mID == UINT32_MAX, "");
+	std::vector<ReloadEntry>	mEntries;
+
+	bool						mDriverQueried = false;
+	/// @brief Hash of the vendor, renderer and version strings so a driver update invalidates the binaries.
+	u64							mDriverHash = 0;
+	bool						mParallelCompile = false;
+	/// @brief The GLSL version of the context, e.g. 450 for a 4.5 context.
+	u32							mGlslVersion = 460;
+	ProcLoaderFn				mProcLoader = (ProcLoaderFn)glfwGetProcAddress;
+
+	bool						mInBatch = false;
+	Clock::time_point			mBatchStart;
+	std::vector<PendingProgram>	mPending;
+} gState;
+
+static f64 millisecondsSince(Clock::time_point inStart)
+{
+	return std::chrono::duration<f64, std::milli>(Clock::now() - inStart).count();
+}
 
-	i32		success;
-	char	infoLog[512];
-	u32		fragShader = UINT32_MAX;
-	u32		vertShader = UINT32_MAX;
-	u32		geomShader = UINT32_MAX;
+static const char* stageName(u32 inType)
+{
+	switch (inType)
+	{
+	case GL_VERTEX_SHADER:		return "Vertex";
+	case GL_FRAGMENT_SHADER:	return "Fragment";
+	case GL_GEOMETRY_SHADER:	return "Geometry";
+	case GL_COMPUTE_SHADER:		return "Compute";
+	default:					return "Unknown";
+	}
+}
 
-	// vertex shader
+static bool readFile(const char* inPath, std::string* outContents)
+{
+	FILE* fd = fopen(inPath, "rb");
+	if (!fd)
 	{
-		FILE* vertFd = fopen(inVertexPath, "rb");
-		if (!vertFd)
-		{
-			printf("ERROR: Failed to open shader \"%s\".", inVertexPath);
-			FATAL();
-			return false;
-		}
+		printf("ERROR(Shader): Failed to open shader \"%s\".\n", inPath);
+		return false;
+	}
 
-		fseek(vertFd, 0, SEEK_END);
-		u32 vertSize = (u32)ftell(vertFd);
-		fseek(vertFd, 0, SEEK_SET);
+	fseek(fd, 0, SEEK_END);
+	const usize size = (usize)ftell(fd);
+	fseek(fd, 0, SEEK_SET);
 
-		char* vertSrc = (char*)malloc(vertSize + 1);
-		if (!vertSrc)
-		{
-			printf("ERROR: Failed to allocate %u bytes for shader source.\n", vertSize);
-			FATAL();
-			return false;
-		}
+	outContents->resize(size);
+	const usize bytesRead = fread(outContents->data(), 1, size, fd);
+	fclose(fd);
 
-		vertSrc[vertSize] = '\0';
-		usize bytesRead = fread(vertSrc, 1, vertSize, vertFd);
-		if (bytesRead != vertSize)
-		{
-			puts("ERROR: Failed to read full bytes of vertex shader.\n");
-			FATAL();
-			return false;
-		}
+	if (bytesRead != size)
+	{
+		printf("ERROR(Shader): Failed to read full bytes of shader \"%s\".\n", inPath);
+		return false;
+	}
 
-		char* included = stb_include_string(vertSrc, nullptr, "res/shaders", "", nullptr);
-		if (!included)
+	return true;
+}
+
+/// @brief Append every file included by the source, the same way stb_include resolves them.
+static void collectIncludes(const std::string& inSource, std::vector<std::string>* ioDependencies)
+{
+	usize lineStart = 0;
+	while (lineStart < inSource.size())
+	{
+		usize lineEnd = inSource.find('\n', lineStart);
+		if (lineEnd == std::string::npos)
+			lineEnd = inSource.size();
+
+		usize i = inSource.find_first_not_of(" \t", lineStart);
+		if (i != std::string::npos && i < lineEnd && inSource.compare(i, 8, "#include") == 0)
 		{
-			puts("ERROR: Failed to allocate memory for included shader source.");
-			FATAL();
-			return false;
+			usize nameStart = inSource.find('"', i);
+			usize nameEnd = nameStart == std::string::npos ? nameStart : inSource.find('"', nameStart + 1);
+			if (nameEnd != std::string::npos && nameEnd < lineEnd)
+			{
+				std::string includePath = std::string(kIncludeDir) + '/' + inSource.substr(nameStart + 1, nameEnd - nameStart - 1);
+				std::string normalized = Utils::NormalizePath(includePath.c_str());
+
+				if (std::find(ioDependencies->begin(), ioDependencies->end(), normalized) == ioDependencies->end())
+				{
+					ioDependencies->push_back(normalized);
+
+					std::string included;
+					if (readFile(includePath.c_str(), &included))
+						collectIncludes(included, ioDependencies);
+				}
+			}
 		}
 
-		free(vertSrc);
+		lineStart = lineEnd + 1;
+	}
+}
 
-		vertShader = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertShader, 1, &included, NULL);
-		glCompileShader(vertShader);
-		glGetShaderiv(vertShader, GL_COMPILE_STATUS, &success);
-		if (!success)
+static std::string binaryCachePath(u64 inKey)
+{
+	char name[32] = {'\0'};
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)inKey);
+	return std::string(kBinaryCacheDir) + '/' + name;
+}
+
+/// @brief Delete the least recently used binaries until the cache fits in kBinaryCacheMaxBytes.
+static void pruneBinaryCache()
+{
+	struct CacheFile
+	{
+		fs::path			mPath;
+		u64					mSize;
+		fs::file_time_type	mLastUsed;
+	};
+
+	std::error_code ec;
+	std::vector<CacheFile> files;
+	u64 totalSize = 0;
+	for (const fs::directory_entry& entry : fs::directory_iterator(kBinaryCacheDir, ec))
+	{
+		if (!entry.is_regular_file(ec) || entry.path().extension() != ".bin")
+			continue;
+
+		CacheFile file;
+		file.mPath		= entry.path();
+		file.mSize		= entry.file_size(ec);
+		file.mLastUsed	= entry.last_write_time(ec);
+		totalSize += file.mSize;
+		files.push_back(std::move(file));
+	}
+
+	if (totalSize <= kBinaryCacheMaxBytes)
+		return;
+
+	std::sort(files.begin(), files.end(), [](const CacheFile& inA, const CacheFile& inB) {
+		return inA.mLastUsed < inB.mLastUsed;
+	});
+
+	u32 removed = 0;
+	for (const CacheFile& file : files)
+	{
+		if (totalSize <= kBinaryCacheMaxBytes)
+			break;
+		if (fs::remove(file.mPath, ec))
 		{
-			glGetShaderInfoLog(vertShader, 512, NULL, infoLog);
-			glDeleteShader(vertShader);
-			fprintf(stderr, "Error: Vertex shader compilation failed,\n%s\n", infoLog);
-			SBREAK();
-			free(included);
-			fclose(vertFd);
-			return false;
+			totalSize -= file.mSize;
+			removed++;
 		}
+	}
+	printf("Removed %u unused shader binaries from \"%s\".\n", removed, kBinaryCacheDir);
+}
 
-		free(included);
-		fclose(vertFd);
+/// @brief Delete the binary of a program which was rebuilt, unless another program still uses it.
+static void removeBinary(u64 inKey)
+{
+	for (const ReloadEntry& entry : gState.mEntries)
+	{
+		if (entry.mCacheKey == inKey)
+			return;
 	}
 
-	// fragment shader
+	std::error_code ec;
+	fs::remove(binaryCachePath(inKey), ec);
+}
+
+static void queryDriver()
+{
+	if (gState.mDriverQueried)
+		return;
+	gState.mDriverQueried = true;
+
+	std::string driver;
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+	{
+		const char* str = (const char*)glGetString(name);
+		if (str)
+			driver += str;
+		driver += '\n';
+	}
+	gState.mDriverHash = Utils::HashString(driver.c_str());
+	pruneBinaryCache();
+
+	i32 major = 0;
+	i32 minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	gState.mGlslVersion = (u32)(major * 100 + minor * 10);
+
+	i32 extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (i32 i = 0; i < extensionCount; i++)
 	{
-		FILE* fragFd = fopen(inFragmentPath, "rb");
-		if (!fragFd)
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (!extension)
+			continue;
+
+		MaxShaderCompilerThreadsFn maxThreads = nullptr;
+		if (strcmp(extension, "GL_KHR_parallel_shader_compile") == 0)
+			maxThreads = (MaxShaderCompilerThreadsFn)gState.mProcLoader("glMaxShaderCompilerThreadsKHR");
+		else if (strcmp(extension, "GL_ARB_parallel_shader_compile") == 0)
+			maxThreads = (MaxShaderCompilerThreadsFn)gState.mProcLoader("glMaxShaderCompilerThreadsARB");
+
+		if (maxThreads)
 		{
-			printf("ERROR: Failed to open shader \"%s\".", inVertexPath);
-			FATAL();
-			return false;
+			// let the driver pick the thread count
+			maxThreads(0xFFFFFFFF);
+			gState.mParallelCompile = true;
+			break;
 		}
+	}
+}
+
+static bool loadBinary(u32 inProgram, u64 inKey)
+{
+	const std::string path = binaryCachePath(inKey);
+	FILE* fd = fopen(path.c_str(), "rb");
+	if (!fd)
+		return false;
+
+	ProgramBinaryHeader header;
+	if (fread(&header, sizeof(header), 1, fd) != 1 || header.mMagic != kBinaryMagic || header.mKey != inKey)
+	{
+		fclose(fd);
+		return false;
+	}
+
+	std::vector<u8> binary(header.mSize);
+	const usize bytesRead = fread(binary.data(), 1, binary.size(), fd);
+	fclose(fd);
+	if (bytesRead != binary.size())
+		return false;
+
+	glProgramBinary(inProgram, header.mFormat, binary.data(), (GLsizei)binary.size());
 
-		fseek(fragFd, 0, SEEK_END);
-		u32 fragSize = (u32)ftell(fragFd);
-		fseek(fragFd, 0, SEEK_SET);
+	// the driver may reject binaries from another version even if the strings match
+	i32 success;
+	glGetProgramiv(inProgram, GL_LINK_STATUS, &success);
 
-		char* fragSrc = (char*)malloc(fragSize + 1);
-		if (!fragSrc)
+	// the write time orders the binaries by their last use for pruneBinaryCache()
+	if (success)
+	{
+		std::error_code ec;
+		fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+	}
+	return success;
+}
+
+static void saveBinary(u32 inProgram, u64 inKey)
+{
+	i32 length = 0;
+	glGetProgramiv(inProgram, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<u8> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(inProgram, length, nullptr, &format, binary.data());
+
+	std::error_code ec;
+	fs::create_directories(kBinaryCacheDir, ec);
+
+	FILE* fd = fopen(binaryCachePath(inKey).c_str(), "wb");
+	if (!fd)
+	{
+		printf("ERROR(Shader): Failed to write the program binary cache in \"%s\".\n", kBinaryCacheDir);
+		return;
+	}
+
+	ProgramBinaryHeader header;
+	header.mFormat	= format;
+	header.mSize	= (u32)length;
+	header.mKey		= inKey;
+	fwrite(&header, sizeof(header), 1, fd);
+	fwrite(binary.data(), 1, binary.size(), fd);
+	fclose(fd);
+}
+
+/**
+ * @brief The shaders are written against `#version 460`, software GL (e.g. llvmpipe) may only
+ * have a 4.5 context. Nothing they use is new in 4.6, so the version is lowered to the context's.
+ */
+static std::string matchContextVersion(const std::string& inSource)
+{
+	std::string source = inSource;
+	const usize version = source.find("#version 460");
+	if (version != std::string::npos && gState.mGlslVersion < 460)
+		source.replace(version + 9, 3, std::to_string(gState.mGlslVersion));
+	return source;
+}
+
+/**
+ * @brief Start building a program from the binary cache or from source. Compiling
+ * and linking are not waited on, so with GL_KHR_parallel_shader_compile many
+ * programs compile at the same time until they are checked in finishBuild().
+ */
+static PendingProgram beginBuild(const std::vector<ShaderStage>& inStages, const std::vector<std::string>& inSources)
+{
+	ZR_ASSERT(inStages.size() == inSources.size(), "Every shader stage must have a source.");
+	queryDriver();
+
+	PendingProgram pending;
+	pending.mStart		= Clock::now();
+	pending.mStages		= inStages;
+	pending.mCacheKey	= gState.mDriverHash;
+	for (usize i = 0; i < inStages.size(); i++)
+	{
+		pending.mCacheKey = Utils::Hash64(&inStages[i].mType, sizeof(u32), pending.mCacheKey);
+		pending.mCacheKey = Utils::Hash64(inSources[i].data(), inSources[i].size(), pending.mCacheKey);
+	}
+
+	pending.mProgram = glCreateProgram();
+	if (loadBinary(pending.mProgram, pending.mCacheKey))
+	{
+		pending.mFromCache = true;
+		return pending;
+	}
+
+	// a rejected binary leaves the program in a failed state
+	GLState::DeleteProgram(pending.mProgram);
+	pending.mProgram = glCreateProgram();
+
+	for (usize i = 0; i < inStages.size(); i++)
+	{
+		const std::string matched = matchContextVersion(inSources[i]);
+		const char* source = matched.c_str();
+
+		u32 shader = glCreateShader(inStages[i].mType);
+		glShaderSource(shader, 1, &source, nullptr);
+		glCompileShader(shader);
+		glAttachShader(pending.mProgram, shader);
+		pending.mShaders.push_back(shader);
+	}
+
+	glProgramParameteri(pending.mProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(pending.mProgram);
+
+	return pending;
+}
+
+static bool isBuildComplete(const PendingProgram& inPending)
+{
+	if (inPending.mFromCache || !gState.mParallelCompile)
+		return true;
+
+	i32 complete = GL_TRUE;
+	glGetProgramiv(inPending.mProgram, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete;
+}
+
+/// @brief Wait for the program and check it. The program is deleted on failure.
+static bool finishBuild(PendingProgram* ioPending)
+{
+	i32 success;
+	glGetProgramiv(ioPending->mProgram, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		bool compiled = true;
+		for (usize i = 0; i < ioPending->mShaders.size(); i++)
 		{
-			printf("ERROR: Failed to allocate %u bytes for shader source.\n", fragSize);
-			FATAL();
-			return false;
+			glGetShaderiv(ioPending->mShaders[i], GL_COMPILE_STATUS, &success);
+			if (success)
+				continue;
+
+			char infoLog[1024];
+			glGetShaderInfoLog(ioPending->mShaders[i], sizeof(infoLog), nullptr, infoLog);
+			fprintf(stderr, "Error: %s shader compilation failed (\"%s\"),\n%s\n", stageName(ioPending->mStages[i].mType), ioPending->mStages[i].mPath.c_str(), infoLog);
+			compiled = false;
 		}
 
-		fragSrc[fragSize] = '\0';
-		usize bytesRead = fread(fragSrc, 1, fragSize, fragFd);
-		if (bytesRead != fragSize)
+		if (compiled)
 		{
-			puts("ERROR: Failed to read full bytes of fragment shader.\n");
-			FATAL();
-			return false;
+			char infoLog[1024];
+			glGetProgramInfoLog(ioPending->mProgram, sizeof(infoLog), nullptr, infoLog);
+			fprintf(stderr, "Error: Shader program linking failed (\"%s\"),\n%s\n", ioPending->mStages.back().mPath.c_str(), infoLog);
 		}
+	}
 
-		char* included = stb_include_string(fragSrc, nullptr, "res/shaders", "", nullptr);
-		if (!included)
-		{
-			puts("ERROR: Failed to allocate memory for included shader source.");
-			FATAL();
+	for (u32 shader : ioPending->mShaders)
+		glDeleteShader(shader);
+	ioPending->mShaders.clear();
+
+	if (!success)
+	{
+		GLState::DeleteProgram(ioPending->mProgram);
+		ioPending->mProgram = UINT32_MAX;
+		return false;
+	}
+
+	if (!ioPending->mFromCache)
+		saveBinary(ioPending->mProgram, ioPending->mCacheKey);
+
+	return true;
+}
+
+static void reportBuildTime(const PendingProgram& inPending, f64 inMilliseconds)
+{
+	printf("Shader \"%s\": %.2fms (%s)\n", inPending.mStages.back().mPath.c_str(), inMilliseconds,
+		inPending.mFromCache ? "binary cache" : "compiled");
+}
+
+/// @brief The defines go right after `#version`, which must stay the first statement.
+static void insertDefines(const std::vector<std::string>& inDefines, std::string* ioSource)
+{
+	usize versionStart = ioSource->find("#version");
+	usize insertAt = versionStart == std::string::npos ? 0 : ioSource->find('\n', versionStart);
+	insertAt = insertAt == std::string::npos ? ioSource->size() : insertAt + 1;
+
+	std::string defines;
+	for (const std::string& define : inDefines)
+		defines += "#define " + define + " 1\n";
+
+	// keep the line numbers of compile errors pointing into the file
+	if (versionStart != std::string::npos)
+		defines += "#line 2\n";
+
+	ioSource->insert(insertAt, defines);
+}
+
+bool ShaderProgram::Preprocess(const std::vector<ShaderStage>& inStages, std::vector<std::string>* outSources, std::vector<std::string>* outDependencies)
+{
+	outSources->clear();
+	outDependencies->clear();
+
+	for (const ShaderStage& stage : inStages)
+	{
+		std::string source;
+		if (!readFile(stage.mPath.c_str(), &source))
 			return false;
-		}
 
-		free(fragSrc);
+		outDependencies->push_back(Utils::NormalizePath(stage.mPath.c_str()));
+		collectIncludes(source, outDependencies);
 
-		fragShader = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragShader, 1, &included, NULL);
-		glCompileShader(fragShader);
-		glGetShaderiv(fragShader, GL_COMPILE_STATUS, &success);
-		if (!success)
+		if (!stage.mDefines.empty())
+			insertDefines(stage.mDefines, &source);
+
+		char error[256] = {'\0'};
+		char* included = stb_include_string(source.data(), nullptr, (char*)kIncludeDir, (char*)"", error);
+		if (!included)
 		{
-			glGetShaderInfoLog(fragShader, 512, NULL, infoLog);
-			glDeleteShader(vertShader);
-			glDeleteShader(fragShader);
-			fprintf(stderr, "Error: Fragment shader compilation failed,\n%s\n", infoLog);
-			SBREAK();
-			free(included);
-			fclose(fragFd);
+			printf("ERROR(Shader): Failed to expand the includes of \"%s\". %s\n", stage.mPath.c_str(), error);
 			return false;
 		}
 
+		outSources->push_back(included);
 		free(included);
-		fclose(fragFd);
 	}
 
-	// geom shader
-	if (inGeometryPath)
+	return true;
+}
+
+u32 ShaderProgram::Build(const std::vector<ShaderStage>& inStages, const std::vector<std::string>& inSources)
+{
+	PendingProgram pending = beginBuild(inStages, inSources);
+	finishBuild(&pending);
+	return pending.mProgram;
+}
+
+static std::vector<u64> hashPaths(const std::vector<std::string>& inPaths)
+{
+	std::vector<u64> hashes;
+	hashes.reserve(inPaths.size());
+	for (const std::string& path : inPaths)
+		hashes.push_back(Utils::HashString(path.c_str()));
+	return hashes;
+}
+
+static ReloadEntry* findEntry(const u32* inID)
+{
+	for (ReloadEntry& entry : gState.mEntries)
 	{
-		FILE* geomFd = fopen(inGeometryPath, "rb");
-		if (!geomFd)
-		{
-			printf("ERROR: Failed to open shader \"%s\".", inVertexPath);
-			FATAL();
-			return false;
-		}
+		if (entry.mID == inID)
+			return &entry;
+	}
 
-		fseek(geomFd, 0, SEEK_END);
-		u32 geomSize = (u32)ftell(geomFd);
-		fseek(geomFd, 0, SEEK_SET);
+	return nullptr;
+}
 
-		char* geomSrc = (char*)malloc(geomSize + 1);
-		if (!geomSrc)
-		{
-			printf("ERROR: Failed to allocate %u bytes for shader source.\n", geomSize);
-			FATAL();
-			return false;
-		}
+void ShaderProgram::Register(u32* ioID, const std::vector<ShaderStage>& inStages, const std::vector<std::string>& inDependencies, std::function<void()> inOnReload)
+{
+	ReloadEntry* entry = findEntry(ioID);
+	if (!entry)
+		entry = &gState.mEntries.emplace_back();
+
+	entry->mID					= ioID;
+	entry->mStages				= inStages;
+	entry->mDependencyHashes	= hashPaths(inDependencies);
+	entry->mOnReload			= std::move(inOnReload);
+}
+
+void ShaderProgram::Unregister(const u32* inID)
+{
+	auto it = std::find_if(gState.mEntries.begin(), gState.mEntries.end(), [inID](const ReloadEntry& inEntry) {
+		return inEntry.mID == inID;
+	});
+
+	if (it != gState.mEntries.end())
+		gState.mEntries.erase(it);
+}
+
+static void finishReload(u32* ioID, const ReloadJob& inJob)
+{
+	// the shader may have been unloaded while its sources were read
+	ReloadEntry* entry = findEntry(ioID);
+	if (!entry)
+		return;
+
+	const char* name = inJob.mStages.back().mPath.c_str();
+	if (!inJob.mSucceeded)
+	{
+		printf("ERROR(Shader): Failed to reload \"%s\", keeping the last good version.\n", name);
+		return;
+	}
+
+	PendingProgram pending = beginBuild(inJob.mStages, inJob.mSources);
+	if (!finishBuild(&pending))
+	{
+		printf("ERROR(Shader): Failed to reload \"%s\", keeping the last good version.\n", name);
+		return;
+	}
+
+	GLState::DeleteProgram(*ioID);
+	*ioID = pending.mProgram;
+
+	// every edit has a new key, only the binary of the current sources is kept
+	const u64 previousKey = entry->mCacheKey;
+	entry->mCacheKey = pending.mCacheKey;
+	if (previousKey != pending.mCacheKey)
+		removeBinary(previousKey);
+
+	// an include may have been added or removed
+	entry->mDependencyHashes = hashPaths(inJob.mDependencies);
+	if (entry->mOnReload)
+		entry->mOnReload();
 
-		geomSrc[geomSize] = '\0';
-		usize bytesRead = fread(geomSrc, 1, geomSize, geomFd);
-		if (bytesRead != geomSize)
+	printf("Reloaded shader \"%s\".\n", name);
+}
+
+void ShaderProgram::OnFilesChanged(const std::vector<std::string>& inPaths)
+{
+	const std::vector<u64> changed = hashPaths(inPaths);
+
+	for (const ReloadEntry& entry : gState.mEntries)
+	{
+		bool isAffected = false;
+		for (u64 hash : entry.mDependencyHashes)
 		{
-			puts("ERROR: Failed to read full bytes of geometry shader.\n");
-			FATAL();
-			return false;
+			if (std::find(changed.begin(), changed.end(), hash) != changed.end())
+			{
+				isAffected = true;
+				break;
+			}
 		}
 
-		char* included = stb_include_string(geomSrc, nullptr, "res/shaders", "", nullptr);
-		if (!included)
+		if (!isAffected)
+			continue;
+
+		std::shared_ptr<ReloadJob> job = std::make_shared<ReloadJob>();
+		job->mStages = entry.mStages;
+
+		u32* id = entry.mID;
+		HotReload::Async(
+			[job]() {
+				job->mSucceeded = ShaderProgram::Preprocess(job->mStages, &job->mSources, &job->mDependencies);
+			},
+			[id, job]() {
+				finishReload(id, *job);
+			}
+		);
+	}
+}
+
+bool ShaderProgram::Load(u32* outID, const std::vector<ShaderStage>& inStages, std::function<void()> inOnReload, std::function<void()> inOnFailed)
+{
+	const Clock::time_point start = Clock::now();
+
+	std::vector<std::string> sources;
+	std::vector<std::string> dependencies;
+	if (!Preprocess(inStages, &sources, &dependencies))
+		return false;
+
+	PendingProgram pending = beginBuild(inStages, sources);
+	pending.mID		= outID;
+	pending.mStart	= start;
+
+	*outID = pending.mProgram;
+	Register(outID, inStages, dependencies, std::move(inOnReload));
+	findEntry(outID)->mCacheKey = pending.mCacheKey;
+
+	if (gState.mInBatch)
+	{
+		pending.mOnFailed = std::move(inOnFailed);
+		gState.mPending.push_back(std::move(pending));
+		return true;
+	}
+
+	const bool success = finishBuild(&pending);
+	reportBuildTime(pending, millisecondsSince(start));
+	if (!success)
+	{
+		Unregister(outID);
+		*outID = UINT32_MAX;
+	}
+
+	return success;
+}
+
+void ShaderProgram::SetProcLoader(void* (*inLoader)(const char* inName))
+{
+	gState.mProcLoader = inLoader;
+}
+
+void ShaderProgram::BeginBatch()
+{
+	ZR_ASSERT(!gState.mInBatch, "Shader batches can't be nested.");
+	gState.mInBatch = true;
+	gState.mBatchStart = Clock::now();
+}
+
+bool ShaderProgram::EndBatch()
+{
+	ZR_ASSERT(gState.mInBatch, "EndBatch() was called without BeginBatch().");
+	gState.mInBatch = false;
+
+	std::vector<PendingProgram> pending;
+	pending.swap(gState.mPending);
+
+	// poll instead of blocking on the first program so every program's time is when it actually finished
+	std::vector<f64> buildTimes(pending.size(), -1.0);
+	usize remaining = pending.size();
+	while (remaining != 0)
+	{
+		for (usize i = 0; i < pending.size(); i++)
 		{
-			puts("ERROR: Failed to allocate memory for included shader source.");
-			FATAL();
-			return false;
+			if (buildTimes[i] >= 0.0 || !isBuildComplete(pending[i]))
+				continue;
+
+			buildTimes[i] = millisecondsSince(pending[i].mStart);
+			remaining--;
 		}
 
-		free(geomSrc);
+		if (remaining != 0)
+			std::this_thread::yield();
+	}
+
+	u32 cacheHits = 0;
+	u32 failures = 0;
+	for (usize i = 0; i < pending.size(); i++)
+	{
+		PendingProgram& program = pending[i];
+		const bool success = finishBuild(&program);
+		reportBuildTime(program, gState.mParallelCompile ? buildTimes[i] : millisecondsSince(program.mStart));
 
-		geomShader = glCreateShader(GL_GEOMETRY_SHADER);
-		glShaderSource(geomShader, 1, &included, NULL);
-		glCompileShader(geomShader);
-		glGetShaderiv(geomShader, GL_COMPILE_STATUS, &success);
 		if (!success)
 		{
-			glGetShaderInfoLog(geomShader, 512, NULL, infoLog);
-			glDeleteShader(vertShader);
-			glDeleteShader(fragShader);
-			glDeleteShader(geomShader);
-			fprintf(stderr, "Error: Geometry shader compilation failed,\n%s\n", infoLog);
-			SBREAK();
-			free(included);
-			fclose(geomFd);
-			return false;
+			Unregister(program.mID);
+			*program.mID = UINT32_MAX;
+			failures++;
+
+			// the owner may free the ID, it's not touched after
+			if (program.mOnFailed)
+				program.mOnFailed();
+			continue;
 		}
 
-		free(included);
-		fclose(geomFd);
+		cacheHits += program.mFromCache;
+
+		// uniform setups were deferred until the program is linked
+		ReloadEntry* entry = findEntry(program.mID);
+		if (entry && entry->mOnReload)
+			entry->mOnReload();
 	}
 
-	mID = glCreateProgram();
-	glAttachShader(mID, vertShader);
-	glAttachShader(mID, fragShader);
-	if (inGeometryPath)
-		glAttachShader(mID, geomShader);
-	
-	glLinkProgram(mID);
+	printf("Built %zu shader programs in %.2fms (%u from the binary cache, parallel compile %s).\n",
+		pending.size(), millisecondsSince(gState.mBatchStart), cacheHits, gState.mParallelCompile ? "on" : "off");
 
-	glDeleteShader(vertShader);
-	glDeleteShader(fragShader);
+	if (failures != 0)
+		printf("ERROR(Shader): %u shader programs of the batch failed to build.\n", failures);
+
+	return failures == 0;
+}
+
+bool ShaderProgram::IsPending(const u32* inID)
+{
+	for (const PendingProgram& pending : gState.mPending)
+	{
+		if (pending.mID == inID)
+			return true;
+	}
+
+	return false;
+}
+
+bool Shader::Load(const char* inVertexPath, const char* inFragmentPath, const char* inGeometryPath, const std::vector<std::string>& inDefines)
+{
+	ZR_ASSERT(mID == UINT32_MAX, "");
+	ZR_ASSERT(inDefines.size() <= 32, "A permutation mask has 32 bits.");
+
+	mStages = {
+		{ GL_VERTEX_SHADER,		inVertexPath	},
+		{ GL_FRAGMENT_SHADER,	inFragmentPath	},
+	};
 	if (inGeometryPath)
-		glDeleteShader(geomShader);
+		mStages.push_back({ GL_GEOMETRY_SHADER, inGeometryPath });
+
+	mDefines		= inDefines;
+	mPermutation	= 0;
+
+	const bool success = loadPermutation(0);
+	if (!success)
+		SBREAK();
+
+	return success;
+}
+
+bool Shader::LoadCompute(const char* inComputePath, const std::vector<std::string>& inDefines)
+{
+	ZR_ASSERT(mID == UINT32_MAX, "");
+	ZR_ASSERT(inDefines.size() <= 32, "A permutation mask has 32 bits.");
+
+	mStages			= { { GL_COMPUTE_SHADER, inComputePath } };
+	mDefines		= inDefines;
+	mPermutation	= 0;
 
-	glGetProgramiv(mID, GL_LINK_STATUS, &success);
+	const bool success = loadPermutation(0);
 	if (!success)
+		SBREAK();
+
+	return success;
+}
+
+void Shader::Unload()
+{
+	ZR_ASSERT(mID != UINT32_MAX, "");
+
+	for (auto& [mask, program] : mPermutations)
 	{
-		glGetProgramInfoLog(mID, 512, NULL, infoLog);
-		fprintf(stderr, "Error: Shader program linking failed,\n%s\n", infoLog);
-		mID = UINT32_MAX;
+		ShaderProgram::Unregister(&program);
+		GLState::DeleteProgram(program);
+	}
+
+	mPermutations.clear();
+	mFailedPermutations.clear();
+	mID = UINT32_MAX;
+}
+
+bool Shader::loadPermutation(u32 inMask)
+{
+	std::vector<ShaderStage> stages = mStages;
+	for (ShaderStage& stage : stages)
+	{
+		for (u32 i = 0; i < mDefines.size(); i++)
+		{
+			if (inMask & (1u << i))
+				stage.mDefines.push_back(mDefines[i]);
+		}
+	}
+
+	u32* program = &mPermutations[inMask];
+	*program = UINT32_MAX;
+
+	const bool success = ShaderProgram::Load(program, stages,
+		[this, inMask]() {
+			onPermutationBuilt(inMask);
+		},
+		[this, inMask]() {
+			onPermutationFailed(inMask);
+		}
+	);
+
+	if (!success)
+	{
+		mPermutations.erase(inMask);
+		mFailedPermutations.push_back(inMask);
 		return false;
 	}
 
+	if (inMask == mPermutation)
+		mID = *program;
+
 	return true;
 }
 
-void Shader::Unload()
+void Shader::onPermutationBuilt(u32 inMask)
 {
-	ZR_ASSERT(mID != UINT32_MAX, "");
-	glDeleteProgram(mID);
-	mID = UINT32_MAX;
+	// a hot reload replaces the program
+	const u32 program = mPermutations[inMask];
+	if (inMask == mPermutation)
+		mID = program;
+
+	if (!mUniformSetup)
+		return;
+
+	// the setup uses mID, point it at the permutation that was built for the call
+	const u32 selected = mID;
+	mID = program;
+	mUniformSetup(*this);
+	mID = selected;
+}
+
+void Shader::onPermutationFailed(u32 inMask)
+{
+	// Load() already copied the name of the failed program
+	mPermutations.erase(inMask);
+	mFailedPermutations.push_back(inMask);
+	if (inMask != mPermutation)
+		return;
+
+	// permutation 0 failing fails the batch, there is nothing to fall back to
+	auto base = mPermutations.find(0);
+	if (inMask == 0 || base == mPermutations.end())
+	{
+		mID = UINT32_MAX;
+		return;
+	}
+
+	printf("ERROR(Shader): Failed to build a permutation of \"%s\", using permutation 0.\n", mStages.back().mPath.c_str());
+	mPermutation	= 0;
+	mID				= base->second;
+}
+
+void Shader::SetPermutation(u32 inMask)
+{
+	ZR_ASSERT(inMask < (1ull << mDefines.size()), "The permutation uses a define the shader doesn't have.");
+
+	// the permutations are selected every frame, a failed one isn't rebuilt every time
+	if (std::find(mFailedPermutations.begin(), mFailedPermutations.end(), inMask) != mFailedPermutations.end())
+		inMask = 0;
+
+	if (inMask == mPermutation)
+		return;
+
+	auto it = mPermutations.find(inMask);
+	if (it == mPermutations.end())
+	{
+		mPermutation = inMask;
+		if (!loadPermutation(inMask))
+		{
+			printf("ERROR(Shader): Failed to build a permutation of \"%s\", using permutation 0.\n", mStages.back().mPath.c_str());
+			SetPermutation(0);
+			return;
+		}
+
+		// ShaderProgram::Load() only calls back for batched programs and reloads
+		if (mUniformSetup && !ShaderProgram::IsPending(&mPermutations[inMask]))
+			mUniformSetup(*this);
+		return;
+	}
+
+	mPermutation = inMask;
+	mID = it->second;
+
+	// uniforms set while another permutation was selected didn't reach this one
+	if (mUniformSetup && !ShaderProgram::IsPending(&it->second))
+		mUniformSetup(*this);
+}
+
+void Shader::SetUniformSetup(std::function<void(const Shader&)> inSetup)
+{
+	mUniformSetup = std::move(inSetup);
+	if (!mUniformSetup)
+		return;
+
+	// a batched permutation runs the setup once it's linked
+	const u32 selected = mID;
+	for (auto& [mask, program] : mPermutations)
+	{
+		if (ShaderProgram::IsPending(&program))
+			continue;
+
+		mID = program;
+		mUniformSetup(*this);
+	}
+	mID = selected;
 }
 
 void Shader::Use() const
 {
 	ZR_ASSERT(mID != UINT32_MAX, "");
-	glUseProgram(mID);
+	GLState::UseProgram(mID);
 }
 
 void Shader::SetMat4(const std::string& inUniformName, const glm::mat4& inMat4) const
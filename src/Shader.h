@@ -2,8 +2,76 @@
 
 #include "defines.h"
 #include <glm/glm.hpp>
+#include <functional>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+struct ShaderStage
+{
+	u32							mType = 0; ///< GL_VERTEX_SHADER, GL_FRAGMENT_SHADER etc.
+	std::string					mPath;
+	/// @brief Every name is inserted as `#define NAME 1` after the `#version` line.
+	std::vector<std::string>	mDefines;
+};
+
+/**
+ * @brief Building programs from source files, shared by Shader and ComputeShader.
+ * Registered programs are rebuilt when any file they were built from changes.
+ */
+namespace ShaderProgram
+{
+	/**
+	 * @brief Read every stage and expand its includes. Does not touch GL so it can run on any thread.
+	 * @param outDependencies The normalized path of every file the sources were built from.
+	 */
+	bool	Preprocess(const std::vector<ShaderStage>& inStages, std::vector<std::string>* outSources, std::vector<std::string>* outDependencies);
+	/**
+	 * @brief Compiled programs are cached as program binaries keyed by the expanded
+	 * sources and the driver, so unchanged programs skip compilation on the next launch.
+	 * @return UINT32_MAX if a stage failed to compile or the program failed to link.
+	 */
+	u32		Build(const std::vector<ShaderStage>& inStages, const std::vector<std::string>& inSources);
+
+	/**
+	 * @brief Preprocess, build and register a program for hot reload.
+	 * @param inOnFailed Called when a batched program fails at EndBatch(), after its ID was set to UINT32_MAX.
+	 */
+	bool	Load(u32* outID, const std::vector<ShaderStage>& inStages, std::function<void()> inOnReload, std::function<void()> inOnFailed = nullptr);
+
+	/**
+	 * @brief Programs loaded between BeginBatch() and EndBatch() are checked at EndBatch(),
+	 * so with GL_KHR_parallel_shader_compile they compile at the same time. Their ID is
+	 * valid right away but must not be used before EndBatch().
+	 * @return false if any program of the batch failed to build.
+	 */
+	void	BeginBatch();
+	bool	EndBatch();
+	bool	IsPending(const u32* inID);
+
+	/**
+	 * @brief Rebuild the program in ioID when one of its dependencies changes. The last
+	 * good program is kept if the new one fails to build.
+	 * @param inOnReload Called after a new program was swapped in or a batched program was linked.
+	 */
+	void	Register(u32* ioID, const std::vector<ShaderStage>& inStages, const std::vector<std::string>& inDependencies, std::function<void()> inOnReload);
+	void	Unregister(const u32* inID);
+
+	/**
+	 * @brief The loader glad was loaded with, glfwGetProcAddress by default. The extensions
+	 * which glad wasn't generated with are loaded with it.
+	 */
+	void	SetProcLoader(void* (*inLoader)(const char* inName));
+
+	/// @brief Subscribed to HotReload.
+	void	OnFilesChanged(const std::vector<std::string>& inPaths);
+}
+
+/**
+ * @brief A shader can have permutations, which are its program compiled with a subset of
+ * its feature defines. Bit i of a permutation mask enables the i-th define passed to Load().
+ * Permutation 0 (no defines) is built by Load(), the others when they are first selected.
+ */
 class Shader final
 {
 public:
@@ -11,9 +79,25 @@ public:
 			~Shader() = default;
 
 	/// @brief The Geometry shader is not enabled if `inGeometryPath` is nullptr.
-	bool	Load(const char* inVertexPath, const char* inFragmentPath, const char* inGeometryPath = nullptr);
+	bool	Load(const char* inVertexPath, const char* inFragmentPath, const char* inGeometryPath = nullptr, const std::vector<std::string>& inDefines = {});
+	/// @brief A compute program with permutations and uniform setters, ComputeShader has neither.
+	bool	LoadCompute(const char* inComputePath, const std::vector<std::string>& inDefines = {});
 	void	Unload();
 
+	/**
+	 * @brief Select the program used by Use() and the uniform setters, building it if needed.
+	 * Uniforms are per program, so they must be set after the permutation is selected. The
+	 * uniform setup runs again when the selection changes. A permutation which failed to
+	 * build selects permutation 0 instead and isn't built again.
+	 */
+	void	SetPermutation(u32 inMask);
+
+	/**
+	 * @brief Set the uniforms which are not updated every frame. The function is called
+	 * immediately and again every time a permutation is built or hot reloaded.
+	 */
+	void	SetUniformSetup(std::function<void(const Shader&)> inSetup);
+
 	void	Use() const;
 	void	SetMat4(const std::string& inUniformName, const glm::mat4& inMat4) const;
 	void	SetVec3(const std::string& inUniformName, const glm::vec3& inVec3) const;
@@ -22,5 +106,21 @@ public:
 	void	SetUint(const std::string& inUniformName, u32 inUint) const;
 	void	SetFloat(const std::string& inUniformName, f32 inFloat) const;
 
-	u32		mID = UINT32_MAX;
+	/// @brief The program of the selected permutation.
+	u32									mID = UINT32_MAX;
+	std::function<void(const Shader&)>	mUniformSetup;
+
+private:
+	bool								loadPermutation(u32 inMask);
+	void								onPermutationBuilt(u32 inMask);
+	void								onPermutationFailed(u32 inMask);
+
+	std::vector<ShaderStage>			mStages;
+	std::vector<std::string>			mDefines;
+	/// @brief The program of every permutation that was built, by mask. The map nodes are
+	/// stable, so their IDs are registered for hot reload directly.
+	std::unordered_map<u32, u32>		mPermutations;
+	/// @brief The masks which failed to build, selecting them selects permutation 0.
+	std::vector<u32>					mFailedPermutations;
+	u32									mPermutation = 0;
 };
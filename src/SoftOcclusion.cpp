@@ -0,0 +1,544 @@
+#include "SoftOcclusion.h"
+
+#include "Memory.h"
+#include "Utils.h"
+#include <Jolt/Jolt.h>
+#include <Jolt/Core/JobSystem.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <tracy/Tracy.hpp>
+#include <emmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cstdio>
+
+/// @brief The second largest world space extent of an occluder, so thin or small meshes are skipped.
+sconst f32 kMinOccluderExtent = 1.0f;
+/// @brief Vertices closer to the camera plane are not projected, their triangles are dropped.
+sconst f32 kMinClipW = 0.001f;
+
+void SoftOcclusion::Resize(u32 inWidth, u32 inHeight)
+{
+	if (inWidth == mWidth && inHeight == mHeight && mDepth)
+		return;
+
+	ShutDown();
+
+	mWidth	= inWidth;
+	mHeight	= inHeight;
+	mTilesX	= (inWidth + kTileWidth - 1) / kTileWidth;
+	mTilesY	= (inHeight + kTileHeight - 1) / kTileHeight;
+
+	const usize size = (usize)mTilesX * mTilesY * kTileWidth * kTileHeight * sizeof(f32);
+	mDepth = (f32*)Mem::AlignedAlloc(size, 16, EMemSource::RendererRAM);
+	std::fill(mDepth, mDepth + size / sizeof(f32), 1.0f);
+	mTileMaxDepth.assign(mTilesX * mTilesY, 1.0f);
+}
+
+void SoftOcclusion::ShutDown()
+{
+	if (mDepth)
+		Mem::AlignedFree(mDepth, EMemSource::RendererRAM);
+	mDepth = nullptr;
+	mTileMaxDepth.clear();
+	mBinJobs.clear();
+	mWidth	= 0;
+	mHeight	= 0;
+}
+
+void SoftOcclusion::Rasterize(const std::vector<const Geom::Mesh*>& inOccluders, const glm::mat4& inViewProjection, JPH::JobSystem* ioJobSystem)
+{
+	ZoneScopedN("Software Occlusion Rasterize");
+	ZR_ASSERT(mDepth != nullptr, "SoftOcclusion::Resize() must be called before rasterizing.");
+
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	mViewProjection = inViewProjection;
+
+	// the proxies are built here so the jobs only read the map
+	mFrameProxies.clear();
+	mFrameTransforms.clear();
+	for (const Geom::Mesh* mesh : inOccluders)
+	{
+		const Proxy& proxy = getProxy(*mesh);
+		for (const glm::mat4& transform : mesh->mInstanceTransforms)
+		{
+			mFrameProxies.push_back(&proxy);
+			mFrameTransforms.push_back(transform);
+		}
+	}
+
+	const u32 occluderCount = (u32)mFrameProxies.size();
+	u32 jobCount = ioJobSystem ? (u32)std::max(ioJobSystem->GetMaxConcurrency(), 1) : 1;
+	jobCount = std::max(std::min(jobCount, occluderCount), 1u);
+
+	const u32 tileCount = mTilesX * mTilesY;
+	mBinJobs.resize(jobCount);
+	for (BinJob& job : mBinJobs)
+	{
+		job.mTriangles.clear();
+		job.mBins.resize(tileCount);
+		for (std::vector<u32>& bin : job.mBins)
+			bin.clear();
+		job.mOccluderTriangles = 0;
+	}
+
+	runJobs(ioJobSystem, jobCount, [this, occluderCount, jobCount](u32 inJob) {
+		const u32 first	= (u32)((u64)occluderCount * inJob / jobCount);
+		const u32 last	= (u32)((u64)occluderCount * (inJob + 1) / jobCount);
+		binOccluders(mBinJobs[inJob], first, last, mViewProjection);
+	});
+
+	runJobs(ioJobSystem, mTilesY, [this](u32 inRow) {
+		for (u32 x = 0; x < mTilesX; x++)
+			rasterizeTile(inRow * mTilesX + x);
+	});
+
+	mStats.mOccluderTriangles	= 0;
+	mStats.mRasterizedTriangles	= 0;
+	for (const BinJob& job : mBinJobs)
+	{
+		mStats.mOccluderTriangles	+= job.mOccluderTriangles;
+		mStats.mRasterizedTriangles	+= (u32)job.mTriangles.size();
+	}
+	mStats.mTestedBoxes	= 0;
+	mStats.mCulledBoxes	= 0;
+	mStats.mRasterizeMs	= std::chrono::duration<f32, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool SoftOcclusion::IsVisible(const glm::vec3& inBoundsMin, const glm::vec3& inBoundsMax)
+{
+	mStats.mTestedBoxes++;
+
+	glm::vec2 screenMin(FLT_MAX);
+	glm::vec2 screenMax(-FLT_MAX);
+	f32 nearestDepth = FLT_MAX;
+	for (u32 i = 0; i < 8; i++)
+	{
+		const glm::vec4 clip = mViewProjection * glm::vec4(
+			(i & 1) ? inBoundsMax.x : inBoundsMin.x,
+			(i & 2) ? inBoundsMax.y : inBoundsMin.y,
+			(i & 4) ? inBoundsMax.z : inBoundsMin.z,
+			1.0f
+		);
+		// the box crosses the camera plane
+		if (clip.w < kMinClipW)
+			return true;
+
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		screenMin = glm::min(screenMin, glm::vec2(ndc.x, ndc.y));
+		screenMax = glm::max(screenMax, glm::vec2(ndc.x, ndc.y));
+		nearestDepth = std::min(nearestDepth, ndc.z * 0.5f + 0.5f);
+	}
+
+	// out of the screen is for the frustum culling to decide
+	if (screenMax.x < -1.0f || screenMax.y < -1.0f || screenMin.x > 1.0f || screenMin.y > 1.0f || nearestDepth <= 0.0f)
+		return true;
+
+	const i32 minX = std::max((i32)std::floor((screenMin.x * 0.5f + 0.5f) * (f32)mWidth), 0);
+	const i32 minY = std::max((i32)std::floor((screenMin.y * 0.5f + 0.5f) * (f32)mHeight), 0);
+	const i32 maxX = std::min((i32)std::floor((screenMax.x * 0.5f + 0.5f) * (f32)mWidth), (i32)mWidth - 1);
+	const i32 maxY = std::min((i32)std::floor((screenMax.y * 0.5f + 0.5f) * (f32)mHeight), (i32)mHeight - 1);
+
+	const __m128 nearest = _mm_set1_ps(nearestDepth);
+	for (i32 ty = minY / (i32)kTileHeight; ty <= maxY / (i32)kTileHeight; ty++)
+	{
+		for (i32 tx = minX / (i32)kTileWidth; tx <= maxX / (i32)kTileWidth; tx++)
+		{
+			const u32 tile = ty * mTilesX + tx;
+			// every pixel of the tile is in front of the box
+			if (mTileMaxDepth[tile] < nearestDepth)
+				continue;
+
+			const i32 originX	= tx * kTileWidth;
+			const i32 originY	= ty * kTileHeight;
+			const i32 x0		= std::max(minX, originX);
+			const i32 x1		= std::min(maxX, originX + (i32)kTileWidth - 1);
+			const i32 y0		= std::max(minY, originY);
+			const i32 y1		= std::min(maxY, originY + (i32)kTileHeight - 1);
+			const f32* depth	= mDepth + (usize)tile * kTileWidth * kTileHeight;
+
+			for (i32 y = y0; y <= y1; y++)
+			{
+				const f32* row = depth + (y - originY) * kTileWidth;
+				for (i32 x = originX + ((x0 - originX) & ~3); x <= x1; x += 4)
+				{
+					// the lanes inside [x0, x1]
+					u32 lanes = 0xF;
+					if (x < x0)
+						lanes &= 0xFu << (x0 - x);
+					if (x + 3 > x1)
+						lanes &= 0xFu >> (x + 3 - x1);
+
+					const __m128 farther = _mm_cmpge_ps(_mm_load_ps(row + (x - originX)), nearest);
+					if ((u32)_mm_movemask_ps(farther) & lanes)
+						return true;
+				}
+			}
+		}
+	}
+
+	mStats.mCulledBoxes++;
+	return false;
+}
+
+bool SoftOcclusion::IsOccluderCandidate(const Geom::Mesh& inMesh)
+{
+	if (inMesh.mOpacityTexture || (inMesh.mDiffuseTexture && inMesh.mDiffuseTexture->mHasTransparency))
+		return false;
+
+	// the instances share the size, but not the box around all of them
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	inMesh.GetInstanceBounds(0, &boundsMin, &boundsMax);
+
+	glm::vec3 extent = boundsMax - boundsMin;
+	std::sort(&extent.x, &extent.x + 3);
+	return extent[1] >= kMinOccluderExtent;
+}
+
+const SoftOcclusion::Proxy& SoftOcclusion::getProxy(const Geom::Mesh& inMesh)
+{
+	auto it = mProxies.find(inMesh.mContentHash);
+	if (it != mProxies.end())
+		return it->second;
+
+	ZoneScopedN("Build Occluder Proxy");
+	Proxy& proxy = mProxies[inMesh.mContentHash];
+
+	// the largest triangles of the mesh. A simplification which moves vertices (e.g. vertex
+	// clustering) can close the gaps between columns or under arches, and a proxy which covers
+	// more than its mesh culls what is seen through them. A subset of the triangles only occludes less.
+	std::vector<std::pair<f32, u32>> triangles;
+	triangles.reserve(inMesh.mIndices.size() / 3);
+	for (u32 i = 0; i + 2 < inMesh.mIndices.size(); i += 3)
+	{
+		const glm::vec3& a = inMesh.mVertices[inMesh.mIndices[i + 0]].mPosition;
+		const glm::vec3& b = inMesh.mVertices[inMesh.mIndices[i + 1]].mPosition;
+		const glm::vec3& c = inMesh.mVertices[inMesh.mIndices[i + 2]].mPosition;
+		const f32 area = glm::length(glm::cross(b - a, c - a));
+		if (area > 0.0f)
+			triangles.push_back({ area, i });
+	}
+
+	if (triangles.size() > kMaxProxyTriangles)
+	{
+		std::nth_element(triangles.begin(), triangles.begin() + kMaxProxyTriangles, triangles.end(),
+			[](const std::pair<f32, u32>& inA, const std::pair<f32, u32>& inB) {
+				return inA.first > inB.first;
+			});
+		triangles.resize(kMaxProxyTriangles);
+	}
+
+	// only the vertices of the kept triangles
+	std::vector<u32> remap(inMesh.mVertices.size(), UINT32_MAX);
+	for (const auto& [area, first] : triangles)
+	{
+		for (u32 i = first; i < first + 3; i++)
+		{
+			const u32 vertex = inMesh.mIndices[i];
+			if (remap[vertex] == UINT32_MAX)
+			{
+				remap[vertex] = (u32)proxy.mVertices.size();
+				proxy.mVertices.push_back(inMesh.mVertices[vertex].mPosition);
+			}
+			proxy.mIndices.push_back(remap[vertex]);
+		}
+	}
+
+	return proxy;
+}
+
+void SoftOcclusion::binOccluders(BinJob& ioJob, u32 inFirst, u32 inLast, const glm::mat4& inViewProjection)
+{
+	ZoneScopedN("Bin Occluders");
+
+	std::vector<glm::vec4> clip;
+	for (u32 o = inFirst; o < inLast; o++)
+	{
+		const Proxy& proxy = *mFrameProxies[o];
+		const glm::mat4 transform = inViewProjection * mFrameTransforms[o];
+
+		clip.resize(proxy.mVertices.size());
+		for (u32 i = 0; i < proxy.mVertices.size(); i++)
+			clip[i] = transform * glm::vec4(proxy.mVertices[i], 1.0f);
+
+		ioJob.mOccluderTriangles += (u32)proxy.mIndices.size() / 3;
+		for (u32 i = 0; i < proxy.mIndices.size(); i += 3)
+		{
+			const glm::vec4& c0 = clip[proxy.mIndices[i + 0]];
+			const glm::vec4& c1 = clip[proxy.mIndices[i + 1]];
+			const glm::vec4& c2 = clip[proxy.mIndices[i + 2]];
+			// there is no clipping, a dropped occluder triangle only occludes less
+			if (c0.w < kMinClipW || c1.w < kMinClipW || c2.w < kMinClipW)
+				continue;
+
+			// pixels with y up, and [0,1] depth
+			glm::vec3 v[3];
+			const glm::vec4* c[3] = { &c0, &c1, &c2 };
+			for (u32 j = 0; j < 3; j++)
+			{
+				const glm::vec3 ndc = glm::vec3(*c[j]) / c[j]->w;
+				v[j] = glm::vec3((ndc.x * 0.5f + 0.5f) * (f32)mWidth, (ndc.y * 0.5f + 0.5f) * (f32)mHeight, ndc.z * 0.5f + 0.5f);
+			}
+
+			// back facing or degenerate
+			const f32 area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+			if (area <= 0.0f)
+				continue;
+			if (v[0].z > 1.0f && v[1].z > 1.0f && v[2].z > 1.0f)
+				continue;
+
+			Triangle triangle;
+			triangle.mMinX = std::max((i32)std::floor(std::min(std::min(v[0].x, v[1].x), v[2].x)), 0);
+			triangle.mMinY = std::max((i32)std::floor(std::min(std::min(v[0].y, v[1].y), v[2].y)), 0);
+			triangle.mMaxX = std::min((i32)std::floor(std::max(std::max(v[0].x, v[1].x), v[2].x)), (i32)mWidth - 1);
+			triangle.mMaxY = std::min((i32)std::floor(std::max(std::max(v[0].y, v[1].y), v[2].y)), (i32)mHeight - 1);
+			if (triangle.mMinX > triangle.mMaxX || triangle.mMinY > triangle.mMaxY)
+				continue;
+
+			// counter clockwise, so the inside is left of every edge
+			for (u32 j = 0; j < 3; j++)
+			{
+				const glm::vec3& from	= v[j];
+				const glm::vec3& to		= v[(j + 1) % 3];
+				triangle.mEdgeA[j] = from.y - to.y;
+				triangle.mEdgeB[j] = to.x - from.x;
+				triangle.mEdgeC[j] = -(triangle.mEdgeA[j] * from.x + triangle.mEdgeB[j] * from.y);
+			}
+
+			const f32 invArea = 1.0f / area;
+			triangle.mDepthA = ((v[1].z - v[0].z) * (v[2].y - v[0].y) - (v[2].z - v[0].z) * (v[1].y - v[0].y)) * invArea;
+			triangle.mDepthB = ((v[2].z - v[0].z) * (v[1].x - v[0].x) - (v[1].z - v[0].z) * (v[2].x - v[0].x)) * invArea;
+			triangle.mDepthC = v[0].z - triangle.mDepthA * v[0].x - triangle.mDepthB * v[0].y;
+
+			const u32 index = (u32)ioJob.mTriangles.size();
+			ioJob.mTriangles.push_back(triangle);
+			for (i32 ty = triangle.mMinY / (i32)kTileHeight; ty <= triangle.mMaxY / (i32)kTileHeight; ty++)
+			{
+				for (i32 tx = triangle.mMinX / (i32)kTileWidth; tx <= triangle.mMaxX / (i32)kTileWidth; tx++)
+					ioJob.mBins[ty * mTilesX + tx].push_back(index);
+			}
+		}
+	}
+}
+
+void SoftOcclusion::rasterizeTile(u32 inTile)
+{
+	const i32 originX	= (i32)(inTile % mTilesX) * kTileWidth;
+	const i32 originY	= (i32)(inTile / mTilesX) * kTileHeight;
+	f32* depth			= mDepth + (usize)inTile * kTileWidth * kTileHeight;
+
+	const __m128 cleared = _mm_set1_ps(1.0f);
+	for (u32 i = 0; i < kTileWidth * kTileHeight; i += 4)
+		_mm_store_ps(depth + i, cleared);
+
+	// the pixel centers of four pixels
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (const BinJob& job : mBinJobs)
+	{
+		for (const u32 index : job.mBins[inTile])
+		{
+			const Triangle& triangle = job.mTriangles[index];
+
+			const i32 x0 = std::max(triangle.mMinX, originX);
+			const i32 x1 = std::min(triangle.mMaxX, originX + (i32)kTileWidth - 1);
+			const i32 y0 = std::max(triangle.mMinY, originY);
+			const i32 y1 = std::min(triangle.mMaxY, originY + (i32)kTileHeight - 1);
+
+			__m128 edgeA[3];
+			__m128 edgeB[3];
+			__m128 edgeC[3];
+			for (u32 j = 0; j < 3; j++)
+			{
+				edgeA[j] = _mm_set1_ps(triangle.mEdgeA[j]);
+				edgeB[j] = _mm_set1_ps(triangle.mEdgeB[j]);
+				edgeC[j] = _mm_set1_ps(triangle.mEdgeC[j]);
+			}
+			const __m128 depthA = _mm_set1_ps(triangle.mDepthA);
+			const __m128 depthB = _mm_set1_ps(triangle.mDepthB);
+			const __m128 depthC = _mm_set1_ps(triangle.mDepthC);
+
+			for (i32 y = y0; y <= y1; y++)
+			{
+				const __m128 py = _mm_set1_ps((f32)y + 0.5f);
+				f32* row = depth + (y - originY) * kTileWidth;
+
+				// whole groups of four, the edges reject the pixels out of the bounds
+				for (i32 x = originX + ((x0 - originX) & ~3); x <= x1; x += 4)
+				{
+					const __m128 px = _mm_add_ps(_mm_set1_ps((f32)x), laneOffsets);
+
+					__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+					for (u32 j = 0; j < 3; j++)
+					{
+						const __m128 edge = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeA[j], px), _mm_mul_ps(edgeB[j], py)), edgeC[j]);
+						inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+					}
+					if (_mm_movemask_ps(inside) == 0)
+						continue;
+
+					const __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(depthA, px), _mm_mul_ps(depthB, py)), depthC);
+					const __m128 old = _mm_load_ps(row + (x - originX));
+					const __m128 nearer = _mm_min_ps(old, z);
+					_mm_store_ps(row + (x - originX), _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+				}
+			}
+		}
+	}
+
+	__m128 maxDepth = _mm_load_ps(depth);
+	for (u32 i = 4; i < kTileWidth * kTileHeight; i += 4)
+		maxDepth = _mm_max_ps(maxDepth, _mm_load_ps(depth + i));
+	alignas(16) f32 lanes[4];
+	_mm_store_ps(lanes, maxDepth);
+	mTileMaxDepth[inTile] = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+}
+
+void SoftOcclusion::runJobs(JPH::JobSystem* ioJobSystem, u32 inCount, const std::function<void(u32)>& inJob)
+{
+	if (!ioJobSystem || inCount <= 1)
+	{
+		for (u32 i = 0; i < inCount; i++)
+			inJob(i);
+		return;
+	}
+
+	JPH::JobSystem::Barrier* barrier = ioJobSystem->CreateBarrier();
+	for (u32 i = 0; i < inCount; i++)
+	{
+		const JPH::JobSystem::JobHandle handle = ioJobSystem->CreateJob("Software Occlusion", JPH::Color::sGreen, [&inJob, i]() {
+			inJob(i);
+		});
+		barrier->AddJob(handle);
+	}
+	ioJobSystem->WaitForJobs(barrier);
+	ioJobSystem->DestroyBarrier(barrier);
+}
+
+void SoftOcclusion::Benchmark(JPH::JobSystem* ioJobSystem)
+{
+	constexpr u32 kWidth		= 1920;
+	constexpr u32 kHeight		= 1080;
+	constexpr u32 kBoxCount		= 1000;
+	constexpr u32 kIterations	= 100;
+
+	// a unit box, counter clockwise from the outside
+	Geom::Mesh box;
+	const u32 indices[] = {
+		0, 2, 1,	1, 2, 3,	// -z
+		4, 5, 6,	5, 7, 6,	// +z
+		0, 4, 2,	2, 4, 6,	// -x
+		1, 3, 5,	3, 7, 5,	// +x
+		0, 1, 4,	1, 5, 4,	// -y
+		2, 6, 3,	3, 6, 7,	// +y
+	};
+	box.mIndices.assign(indices, indices + 36);
+	box.mVertices.resize(8);
+	for (u32 i = 0; i < 8; i++)
+		box.mVertices[i].mPosition = glm::vec3((f32)(i & 1), (f32)((i >> 1) & 1), (f32)((i >> 2) & 1));
+	box.mBoundsMin		= glm::vec3(0.0f);
+	box.mBoundsMax		= glm::vec3(1.0f);
+	box.mContentHash	= Utils::Hash64(indices, sizeof(indices));
+
+	// a 40x25 wall of slab instances in front of the camera, with gaps between them
+	for (u32 i = 0; i < kBoxCount; i++)
+	{
+		const glm::vec3 position(-40.0f + (f32)(i % 40) * 2.0f, -25.0f + (f32)(i / 40) * 2.0f, -30.0f - (f32)(i % 7));
+		box.mInstanceTransforms.push_back(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(1.9f, 1.9f, 0.5f)));
+	}
+	const std::vector<const Geom::Mesh*> occluders = { &box };
+
+	const glm::mat4 viewProjection =
+		glm::perspective(glm::radians(60.0f), (f32)kWidth / (f32)kHeight, 0.1f, 1000.0f) *
+		glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	SoftOcclusion occlusion;
+	occlusion.Resize(kWidth, kHeight);
+
+	f32 rasterizeMs = 0.0f;
+	f32 testMs = 0.0f;
+	u32 culled = 0;
+	for (u32 iteration = 0; iteration < kIterations; iteration++)
+	{
+		occlusion.Rasterize(occluders, viewProjection, ioJobSystem);
+		rasterizeMs += occlusion.mStats.mRasterizeMs;
+
+		// boxes behind the wall, some of them behind its gaps
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (u32 i = 0; i < kBoxCount; i++)
+		{
+			const glm::vec3 boundsMin(-40.0f + (f32)(i % 40) * 2.0f + 1.85f * (f32)(i % 3 == 0), -25.0f + (f32)(i / 40) * 2.0f, -60.0f);
+			occlusion.IsVisible(boundsMin, boundsMin + glm::vec3(0.5f));
+		}
+		testMs += std::chrono::duration<f32, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		culled = occlusion.mStats.mCulledBoxes;
+	}
+
+	printf(
+		"Software occlusion benchmark (%ux%u, %u occluders, %u triangles):\n"
+		"\tRasterize: %.3f ms\n"
+		"\tTest %u boxes: %.3f ms, %u culled\n",
+		kWidth, kHeight, kBoxCount, occlusion.mStats.mOccluderTriangles,
+		rasterizeMs / (f32)kIterations,
+		kBoxCount, testMs / (f32)kIterations, culled
+	);
+
+	// a wall with a doorway narrower than the cells of a vertex clustering over its bounds,
+	// a clustered proxy moves the vertices around the doorway into it and closes it
+	Geom::Mesh wall;
+	std::vector<f32> columns;
+	for (u32 x = 0; x <= 16; x++)
+		columns.push_back((f32)x);
+	columns.push_back(16.5f);
+	columns.push_back(17.5f);
+	for (u32 x = 18; x <= 32; x++)
+		columns.push_back((f32)x);
+
+	constexpr u32 kRows = 8;
+	constexpr f32 kDoorLeft = 16.5f;
+	constexpr f32 kDoorHeight = 6.0f;
+	for (f32 x : columns)
+	{
+		for (u32 y = 0; y <= kRows; y++)
+		{
+			Geom::Vertex vertex{};
+			vertex.mPosition = glm::vec3(x, (f32)y, 0.0f);
+			wall.mVertices.push_back(vertex);
+		}
+	}
+	for (u32 column = 0; column + 1 < columns.size(); column++)
+	{
+		for (u32 y = 0; y < kRows; y++)
+		{
+			if (columns[column] == kDoorLeft && (f32)y < kDoorHeight)
+				continue;
+
+			// counter clockwise from +z
+			const u32 a = column * (kRows + 1) + y;
+			const u32 b = a + kRows + 1;
+			const u32 quad[] = { a, b, a + 1,	b, b + 1, a + 1 };
+			wall.mIndices.insert(wall.mIndices.end(), quad, quad + 6);
+		}
+	}
+	wall.mBoundsMin		= glm::vec3(0.0f);
+	wall.mBoundsMax		= glm::vec3(32.0f, (f32)kRows, 0.0f);
+	wall.mContentHash	= Utils::Hash64(wall.mIndices.data(), wall.mIndices.size() * sizeof(u32));
+	wall.mInstanceTransforms.push_back(glm::mat4(1.0f));
+	const std::vector<const Geom::Mesh*> walls = { &wall };
+
+	const glm::mat4 wallViewProjection =
+		glm::perspective(glm::radians(60.0f), (f32)kWidth / (f32)kHeight, 0.1f, 1000.0f) *
+		glm::lookAt(glm::vec3(17.0f, 3.0f, 10.0f), glm::vec3(17.0f, 3.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	occlusion.Rasterize(walls, wallViewProjection, ioJobSystem);
+
+	const bool behindWall	= occlusion.IsVisible(glm::vec3(12.85f, 2.85f, -2.3f), glm::vec3(13.15f, 3.15f, -2.0f));
+	const bool throughDoor	= occlusion.IsVisible(glm::vec3(16.85f, 2.85f, -2.3f), glm::vec3(17.15f, 3.15f, -2.0f));
+	printf("\tWall: box behind it %s, box behind its doorway %s\n", behindWall ? "visible" : "culled", throughDoor ? "visible" : "culled");
+	ZR_ASSERT(!behindWall, "The box behind the wall wasn't culled.");
+	ZR_ASSERT(throughDoor, "The box seen through the doorway was culled, the proxy covers more than its mesh.");
+
+	occlusion.ShutDown();
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "defines.h"
+#include "Geom.h"
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <glm/glm.hpp>
+
+namespace JPH
+{
+	class JobSystem;
+}
+
+/**
+ * @brief A CPU depth rasterizer for occlusion culling where the GPU culling isn't available.
+ * Proxies of the occluder meshes, their largest triangles, are rasterized into a small depth
+ * buffer of kTileWidth x kTileHeight tiles, four pixels at a time with SSE, and the bounding
+ * boxes of the meshes are tested against it before they are drawn. A proxy is a subset of
+ * its mesh, so it never hides what the mesh doesn't.
+ *
+ * The occluders are transformed and binned to the tiles by a job per group of occluders and
+ * every tile row is rasterized by its own job, so no two jobs write the same pixels.
+ * Nothing here touches GL, so it also runs without a context.
+ */
+class SoftOcclusion final
+{
+public:
+								SoftOcclusion() = default;
+								~SoftOcclusion() = default;
+
+	/// @brief Allocate the depth buffer, the size is rounded up to whole tiles.
+	void						Resize(u32 inWidth, u32 inHeight);
+	void						ShutDown();
+
+	/**
+	 * @brief Clear the depth buffer and rasterize the proxies of inOccluders. The proxy of a mesh
+	 * is built the first time its content is seen.
+	 * @param ioJobSystem Runs the jobs, they run on the calling thread when it's null.
+	 */
+	void						Rasterize(
+									const std::vector<const Geom::Mesh*>& inOccluders,
+									const glm::mat4& inViewProjection,
+									JPH::JobSystem* ioJobSystem
+								);
+
+	/// @brief Whether any pixel of a world space box is in front of the rasterized depth.
+	bool						IsVisible(const glm::vec3& inBoundsMin, const glm::vec3& inBoundsMax);
+
+	/// @brief Whether a mesh is opaque and large enough to be worth rasterizing as an occluder.
+	static bool					IsOccluderCandidate(const Geom::Mesh& inMesh);
+
+	/**
+	 * @brief Rasterize 1k box occluders into a 1920x1080 buffer, test 1k boxes and print the timings.
+	 * Then check that a wall culls the box behind it, but not the box seen through its doorway.
+	 */
+	static void					Benchmark(JPH::JobSystem* ioJobSystem);
+
+	struct
+	{
+		u32						mOccluderTriangles = 0;
+		/// @brief The occluder triangles which weren't clipped or back facing.
+		u32						mRasterizedTriangles = 0;
+		u32						mTestedBoxes = 0;
+		u32						mCulledBoxes = 0;
+		f32						mRasterizeMs = 0.0f;
+	} mStats;
+
+	/// ****************** CONSTANTS ****************** ///
+	/// @brief A multiple of 4, the SSE width.
+	sconst u32					kTileWidth = 32;
+	sconst u32					kTileHeight = 16;
+	/// @brief The largest triangles of a mesh which its proxy keeps.
+	sconst u32					kMaxProxyTriangles = 1024;
+
+private:
+	/// @brief The largest triangles of a mesh, before its transform.
+	struct Proxy
+	{
+		std::vector<glm::vec3>	mVertices;
+		std::vector<u32>		mIndices;
+	};
+
+	/// @brief A screen space triangle set up for the rasterizer, edges are >= 0 inside.
+	struct Triangle
+	{
+		f32						mEdgeA[3];
+		f32						mEdgeB[3];
+		f32						mEdgeC[3];
+		/// @brief The depth plane, depth = A * x + B * y + C.
+		f32						mDepthA;
+		f32						mDepthB;
+		f32						mDepthC;
+		/// @brief The pixel bounds, inclusive.
+		i32						mMinX;
+		i32						mMinY;
+		i32						mMaxX;
+		i32						mMaxY;
+	};
+
+	/// @brief The triangles a bin job set up and their indices per tile.
+	struct BinJob
+	{
+		std::vector<Triangle>			mTriangles;
+		std::vector<std::vector<u32>>	mBins;
+		u32								mOccluderTriangles = 0;
+	};
+
+	const Proxy&				getProxy(const Geom::Mesh& inMesh);
+	void						binOccluders(BinJob& ioJob, u32 inFirst, u32 inLast, const glm::mat4& inViewProjection);
+	void						rasterizeTile(u32 inTile);
+	/// @brief Run inCount jobs and wait for them.
+	static void					runJobs(JPH::JobSystem* ioJobSystem, u32 inCount, const std::function<void(u32)>& inJob);
+
+	/// @brief Keyed by Geom::Mesh::mContentHash, meshes with the same data share a proxy.
+	std::unordered_map<u64, Proxy>	mProxies;
+	/// @brief The proxy and transform of every occluder instance of the current Rasterize().
+	std::vector<const Proxy*>		mFrameProxies;
+	std::vector<glm::mat4>			mFrameTransforms;
+	std::vector<BinJob>				mBinJobs;
+	/// @brief Of the last Rasterize(), the boxes are tested with it.
+	glm::mat4						mViewProjection = glm::mat4(1.0f);
+
+	/// @brief Tile major, kTileWidth x kTileHeight [0,1] depths per tile, 16 byte aligned.
+	f32*						mDepth = nullptr;
+	/// @brief The farthest depth of every tile, which the tests skip whole tiles with.
+	std::vector<f32>			mTileMaxDepth;
+	u32							mWidth = 0;
+	u32							mHeight = 0;
+	u32							mTilesX = 0;
+	u32							mTilesY = 0;
+};
@@ -1,5 +1,6 @@
 ﻿#include "UI.h"
 
+#include "GLState.h"
 #include "Memory.h"
 #include "Renderer.h"
 #include "Unicode.h"
@@ -81,10 +82,10 @@ bool ArabicCache::CreateAndRender(const std::string& inText)
 		return false;
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, mFBO);
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Enable(GL_BLEND);
+	GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	g.mShader.Use();
 	g.mShader.SetVec3("uTint", glm::vec3(1.0f));
@@ -176,8 +177,8 @@ bool ArabicCache::CreateAndRender(const std::string& inText)
 			{ pos.x + size.x,	pos.y + size.y,	1.0f, 0.0f },
 		};
 
-		glBindTextureUnit(0, c.mTextureID);
-		glBindVertexArray(g.mVAO);
+		GLState::BindTextureUnit(0, c.mTextureID);
+		GLState::BindVertexArray(g.mVAO);
 		glNamedBufferSubData(g.mVBO, 0, sizeof(verts), verts);
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 
@@ -187,15 +188,15 @@ bool ArabicCache::CreateAndRender(const std::string& inText)
 	hb_font_destroy(hbFont);
 	hb_buffer_destroy(hbBuffer);
 
-	glDisable(GL_BLEND);
+	GLState::Disable(GL_BLEND);
 
 	return true;
 }
 
 void ArabicCache::Destroy()
 {
-	glDeleteTextures(1, &mTextureID);
-	glDeleteFramebuffers(1, &mFBO);
+	GLState::DeleteTextures(1, &mTextureID);
+	GLState::DeleteFramebuffers(1, &mFBO);
 }
 
 void UI::RenderArabic(const std::string& inText, glm::vec2 inPos, f32 inScale, const glm::vec3& inColor) const
@@ -205,10 +206,10 @@ void UI::RenderArabic(const std::string& inText, glm::vec2 inPos, f32 inScale, c
 	g.mShader.Use();
 	g.mShader.SetVec3("uTint", inColor);
 
-	glBindVertexArray(g.mVAO);
+	GLState::BindVertexArray(g.mVAO);
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Enable(GL_BLEND);
+	GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	hb_font_t* hbFont;
 	hb_buffer_t* hbBuffer;
@@ -334,7 +335,7 @@ void UI::RenderArabic(const std::string& inText, glm::vec2 inPos, f32 inScale, c
 					{ pos.x + size.x,	pos.y + size.y,	1.0f, 0.0f },
 				};
 
-				glBindTextureUnit(0, c.mTextureID);
+				GLState::BindTextureUnit(0, c.mTextureID);
 				glNamedBufferSubData(g.mVBO, 0, sizeof(verts), verts);
 				glDrawArrays(GL_TRIANGLES, 0, 6);
 			}
@@ -343,7 +344,7 @@ void UI::RenderArabic(const std::string& inText, glm::vec2 inPos, f32 inScale, c
 		}
 	}
 
-	glDisable(GL_BLEND);
+	GLState::Disable(GL_BLEND);
 }
 
 void UI::RenderArabicCached(const ArabicCache& inCache, glm::vec2 inPos, f32 inScale, const glm::vec3& inColor) const
@@ -374,19 +375,19 @@ void UI::RenderArabicCached(const ArabicCache& inCache, glm::vec2 inPos, f32 inS
 		verts[i][1] += inPos.y - f32(inCache.mHeight / 2);
 	}
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Enable(GL_BLEND);
+	GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	glBindTextureUnit(0, inCache.mTextureID);
+	GLState::BindTextureUnit(0, inCache.mTextureID);
 
 	{
 		ZoneScopedN("Upload Quad & Draw");
-		glBindVertexArray(g.mVAO);
+		GLState::BindVertexArray(g.mVAO);
 		glNamedBufferSubData(g.mVBO, 0, sizeof(verts), verts);
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 	}
 
-	glDisable(GL_BLEND);
+	GLState::Disable(GL_BLEND);
 }
 
 bool UI::StartUp()
@@ -398,7 +399,9 @@ bool UI::StartUp()
 	}
 
 	g.mShader.Use();
-	g.mShader.SetInt("uComponent", 0);
+	g.mShader.SetUniformSetup([](const Shader& inShader) {
+		inShader.SetInt("uComponent", 0);
+	});
 
 	FT_Face englishFace = {};
 
@@ -509,14 +512,14 @@ void UI::ShutDown()
 {
 	for (u32 c = 0; c < kNumAsciiChars; c++)
 	{
-		glDeleteTextures(1, &mEnglishCharMap[c].mTextureID);
+		GLState::DeleteTextures(1, &mEnglishCharMap[c].mTextureID);
 	}
 
 	Mem::Free(mEnglishCharMap, EMemSource::UiRAM);
 
 	g.mShader.Unload();
 	glDeleteBuffers(1, &g.mVBO);
-	glDeleteVertexArrays(1, &g.mVAO);
+	GLState::DeleteVertexArrays(1, &g.mVAO);
 	FT_Done_Face(g.mArabicFace);
 	FT_Done_FreeType(g.mFT);
 }
@@ -532,10 +535,10 @@ void UI::RenderEnglish(const char* inText, glm::vec2 inPos, f32 inScale, const g
 	g.mShader.Use();
 	g.mShader.SetVec3("uTint", inColor);
 
-	glBindVertexArray(g.mVAO);
+	GLState::BindVertexArray(g.mVAO);
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::Enable(GL_BLEND);
+	GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	usize len = strlen(inText);
 	for (usize i = 0; i < len; i++)
@@ -562,11 +565,11 @@ void UI::RenderEnglish(const char* inText, glm::vec2 inPos, f32 inScale, const g
 			{ pos.x + size.x,	pos.y + size.y,	1.0f, 0.0f },
 		};
 
-		glBindTextureUnit(0, c.mTextureID);
+		GLState::BindTextureUnit(0, c.mTextureID);
 		glNamedBufferSubData(g.mVBO, 0, sizeof(verts), verts);
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 		inPos.x += (c.mAdvance >> 6) * inScale;
 	}
 
-	glDisable(GL_BLEND);
+	GLState::Disable(GL_BLEND);
 }
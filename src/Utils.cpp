@@ -1,14 +1,21 @@
 #include "Utils.h"
 
-#define NOMINMAX
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+#ifdef _WIN32
+	#define NOMINMAX
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#endif
 #include <cmath>
+#include <cstdio>
 #include <ctime>
 #include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
 
 using namespace Utils;
 
+#ifdef _WIN32
 static void sehHandler(u32 inCode, _EXCEPTION_POINTERS* inEP)
 {
 	if (inCode == EXCEPTION_FLT_DIVIDE_BY_ZERO);
@@ -17,10 +24,28 @@ static void sehHandler(u32 inCode, _EXCEPTION_POINTERS* inEP)
 		SBREAK();
 	}
 }
+#endif
 
 bool Utils::IsDebuggerAttached()
 {
+#ifdef _WIN32
 	return IsDebuggerPresent();
+#else
+	// a traced process has the PID of its tracer in its status
+	FILE* status = fopen("/proc/self/status", "r");
+	if (!status)
+		return false;
+
+	char line[256];
+	i32 tracerPid = 0;
+	while (fgets(line, sizeof(line), status))
+	{
+		if (sscanf(line, "TracerPid: %d", &tracerPid) == 1)
+			break;
+	}
+	fclose(status);
+	return tracerPid != 0;
+#endif
 }
 
 void Utils::EnableFpeExcept()
@@ -45,3 +70,142 @@ f32 Utils::RandomBetween(f32 inMin, f32 inMax)
 {
 	return ((inMax - inMin) * ((f32)rand() / RAND_MAX)) + inMin;
 }
+
+f32 Utils::Halton(u32 inIndex, u32 inBase)
+{
+	// the digits of the index in the base, mirrored around the radix point
+	f32 result = 0.0f;
+	f32 fraction = 1.0f;
+	while (inIndex > 0)
+	{
+		fraction /= (f32)inBase;
+		result += fraction * (f32)(inIndex % inBase);
+		inIndex /= inBase;
+	}
+
+	return result;
+}
+
+u64 Utils::HashString(const char* inStr)
+{
+	u64 hash = 0xcbf29ce484222325ull;
+	for (const char* c = inStr; *c; c++)
+	{
+		hash ^= (u8)*c;
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+// https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+static constexpr u64 kXxhPrime1 = 0x9E3779B185EBCA87ull;
+static constexpr u64 kXxhPrime2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr u64 kXxhPrime3 = 0x165667B19E3779F9ull;
+static constexpr u64 kXxhPrime4 = 0x85EBCA77C2B2AE63ull;
+static constexpr u64 kXxhPrime5 = 0x27D4EB2F165667C5ull;
+
+sinline u64 rotl64(u64 inX, u32 inBits)
+{
+	return (inX << inBits) | (inX >> (64 - inBits));
+}
+
+sinline u64 read64(const u8* inPtr)
+{
+	u64 val;
+	memcpy(&val, inPtr, sizeof(val));
+	return val;
+}
+
+sinline u32 read32(const u8* inPtr)
+{
+	u32 val;
+	memcpy(&val, inPtr, sizeof(val));
+	return val;
+}
+
+sinline u64 xxhRound(u64 inAcc, u64 inLane)
+{
+	inAcc += inLane * kXxhPrime2;
+	inAcc = rotl64(inAcc, 31);
+	return inAcc * kXxhPrime1;
+}
+
+sinline u64 xxhMergeRound(u64 inAcc, u64 inLane)
+{
+	inAcc ^= xxhRound(0, inLane);
+	return inAcc * kXxhPrime1 + kXxhPrime4;
+}
+
+u64 Utils::Hash64(const void* inData, usize inSize, u64 inSeed)
+{
+	const u8* p = (const u8*)inData;
+	const u8* end = p + inSize;
+	u64 hash;
+
+	if (inSize >= 32)
+	{
+		// 4 independent lanes so the loop isnt bound by one multiply chain
+		u64 v1 = inSeed + kXxhPrime1 + kXxhPrime2;
+		u64 v2 = inSeed + kXxhPrime2;
+		u64 v3 = inSeed;
+		u64 v4 = inSeed - kXxhPrime1;
+
+		const u8* limit = end - 32;
+		do
+		{
+			v1 = xxhRound(v1, read64(p));		p += 8;
+			v2 = xxhRound(v2, read64(p));		p += 8;
+			v3 = xxhRound(v3, read64(p));		p += 8;
+			v4 = xxhRound(v4, read64(p));		p += 8;
+		} while (p <= limit);
+
+		hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		hash = xxhMergeRound(hash, v1);
+		hash = xxhMergeRound(hash, v2);
+		hash = xxhMergeRound(hash, v3);
+		hash = xxhMergeRound(hash, v4);
+	} else
+	{
+		hash = inSeed + kXxhPrime5;
+	}
+
+	hash += (u64)inSize;
+
+	while (p + 8 <= end)
+	{
+		hash ^= xxhRound(0, read64(p));
+		hash = rotl64(hash, 27) * kXxhPrime1 + kXxhPrime4;
+		p += 8;
+	}
+
+	if (p + 4 <= end)
+	{
+		hash ^= (u64)read32(p) * kXxhPrime1;
+		hash = rotl64(hash, 23) * kXxhPrime2 + kXxhPrime3;
+		p += 4;
+	}
+
+	while (p < end)
+	{
+		hash ^= (*p) * kXxhPrime5;
+		hash = rotl64(hash, 11) * kXxhPrime1;
+		p++;
+	}
+
+	// avalanche
+	hash ^= hash >> 33;
+	hash *= kXxhPrime2;
+	hash ^= hash >> 29;
+	hash *= kXxhPrime3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+std::string Utils::NormalizePath(const char* inPath)
+{
+	std::error_code ec;
+	std::string path = std::filesystem::absolute(inPath, ec).lexically_normal().string();
+	std::replace(path.begin(), path.end(), '\\', '/');
+	return path;
+}
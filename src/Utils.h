@@ -5,6 +5,7 @@
 #include <Jolt/Math/Vec3.h>
 #include <glm/glm.hpp>
 #include <glm/vec3.hpp>
+#include <string>
 
 inline JPH::Vec3 GlmToJph(const glm::vec3& inFrom)
 {
@@ -23,12 +24,22 @@ namespace Utils
 
 	f32		InvertRange(f32 inVal, f32 inRangeStart, f32 inRangeEnd);
 	f32		RandomBetween(f32 inMin, f32 inMax);
+	/// @brief Element inIndex of the Halton low discrepancy sequence of base inBase, in [0, 1).
+	f32		Halton(u32 inIndex, u32 inBase);
+
+	/// @brief 64-bit FNV-1a hash of a null terminated string.
+	u64		HashString(const char* inStr);
+	/// @brief XXH64 of a block of memory. Use it for large blocks (e.g. pixels or vertices).
+	u64		Hash64(const void* inData, usize inSize, u64 inSeed = 0);
+
+	/// @brief The absolute and lexically normal form of a path with '/' separators.
+	std::string	NormalizePath(const char* inPath);
 }
 
 /// @brief Safe Debug Break. Break into the debugger if a debugger is attached.
 #define SBREAK() \
 	do { \
-		if (Utils::IsDebuggerAttached()) __debugbreak(); \
+		if (Utils::IsDebuggerAttached()) ZR_DEBUGBREAK(); \
 	} while (0)
 
 /// @brief Conditional Debug Break. Call SBREAK() if the expression inExpr is true.
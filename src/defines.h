@@ -6,12 +6,22 @@
 #define ZR_B_RED "\033[1;31m"
 /// @brief ANSI text formatting reset.
 #define ZR_ANSI_RESET "\033[0m"
+// a breakpoint a debugger can continue from, __builtin_trap() is SIGILL and always ends the process
+#ifdef _WIN32
+	#define ZR_DEBUGBREAK() __debugbreak()
+#elif defined(__clang__)
+	#define ZR_DEBUGBREAK() __builtin_debugtrap()
+#else
+	#include <csignal>
+	#define ZR_DEBUGBREAK() raise(SIGTRAP)
+#endif
+
 // TODO: disable asserts in release
 #define ZR_ASSERT(inExpression, inMessage, ...) \
 	do { \
 		if (!(inExpression)) { \
 			fprintf(stderr, "%sZR_ASSERT: (%s:%d): " inMessage "%s\n", ZR_B_RED, __FILE__, __LINE__, __VA_ARGS__, ZR_ANSI_RESET); \
-			__debugbreak(); \
+			ZR_DEBUGBREAK(); \
 			abort(); } \
 	} while (0)
 
@@ -19,7 +29,12 @@
 
 #define OFFSETOF __builtin_offsetof
 
-#define REQUEST_DEDICATED_GPU() extern "C" __declspec(dllexport) unsigned long NvOptimusEnablement = 0x00000001
+#ifdef _WIN32
+	#define REQUEST_DEDICATED_GPU() extern "C" __declspec(dllexport) unsigned long NvOptimusEnablement = 0x00000001
+#else
+	// the driver picks the GPU (e.g. DRI_PRIME on Mesa)
+	#define REQUEST_DEDICATED_GPU() static_assert(true, "")
+#endif
 
 #define sinline static inline
 #define sconst static inline const
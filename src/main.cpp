@@ -9,9 +9,15 @@
 #include "UI.h"
 #include "DebugDraw.h"
 #include "Memory.h"
+#include "HotReload.h"
+#include "GpuProfiler.h"
+#include "GLState.h"
+#include "Headless.h"
+#include "Benchmark.h"
 #include "defines.h"
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <csignal>
 #include <cfenv>
@@ -28,7 +34,6 @@ REQUEST_DEDICATED_GPU();
 /**
  * TODO
  * - fix every TODO in the task list
- * - use compute shader for post process https://juandiegomontoya.github.io/modern_opengl.html
  * - custom model file format
  */
 
@@ -54,6 +59,9 @@ bool gFreeCam			= false;
 f32 gDeltaTime = 0.0f;
 f32 gLastTime = 0.0f;
 
+/// @brief The movement given to the character this frame, recorded into benchmark tracks.
+glm::vec3 gMovementInput = glm::vec3(0.0f);
+
 static void framebufferSizeCb(GLFWwindow* ioWindow, i32 inWidth, i32 inHeight);
 static void mouseMoveCb(GLFWwindow* inWindow, f64 inX, f64 inY);
 static void keyCb(GLFWwindow* inWindow, i32 inKey, i32 inScancode, i32 inAction, i32 inMods);
@@ -61,8 +69,9 @@ static void scrollCb(GLFWwindow* inWindow, f64 inX, f64 inY);
 static void processInput();
 
 static void update();
+static void onModelReloaded(const Geom::Model* inModel);
 
-i32 main(void)
+i32 main(i32 argc, char** argv)
 {
 	Utils::EnableFpeExcept();
 
@@ -71,6 +80,20 @@ i32 main(void)
 
 	srand(time(NULL));
 
+	// the frame graph compiler is checked without a window or a GL context
+	for (i32 i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--test-frame-graph") == 0)
+			return FrameGraph::SelfTest() ? 0 : 1;
+	}
+
+	Headless::Options headlessOptions;
+	if (Headless::ParseArgs(argc, argv, &headlessOptions))
+	{
+		tracy::SetThreadName("Main Thread");
+		return Headless::Run(headlessOptions);
+	}
+
 	// the physics class must be instanced after jolt default allocators
 	// are registered
 	Physics::Ready();
@@ -126,13 +149,14 @@ i32 main(void)
 	gDebugDraw.StartUp();
 	Geom::StartUp();
 	gPhysics->StartUp();
+	gRenderer->mJobSystem = gPhysics->mJobSystem;
 
 	if (!gUiMgr.StartUp())
 		return 1;
 
 	gModel = ResMgr::GetModel("res/models/sponza2/sponza2.gltf");
 	//gModel = ResMgr::GetModel("res/models/city/city.gltf");
-	ZR_ASSERT(gModel->mPointLights.size() <= 42,
+	ZR_ASSERT(gModel->mPointLights.size() <= FrameLightsUniforms::kMaxPointLights,
 		"The lighting shader currently only supports 42 point lights,"
 		"the loaded model has %zu.", gModel->mPointLights.size()
 	);
@@ -147,10 +171,17 @@ i32 main(void)
 	ArabicCache cache;
 	cache.CreateAndRender(u8"السلام عليكم");
 
-	for (u32 i = 0; i < gModel->mMeshes.size(); i++)
-		gRenderer->mMeshes.push_back(&gModel->mMeshes[i]);
-	for (u32 i = 0; i < gModel->mPointLights.size(); i++)
-		gRenderer->mPointLights.push_back(&gModel->mPointLights[i]);
+	onModelReloaded(gModel);
+
+#ifndef ZR_DISTRIBUTION
+	if (HotReload::StartUp())
+	{
+		HotReload::WatchDirectory("res");
+		HotReload::Subscribe(ShaderProgram::OnFilesChanged);
+		HotReload::Subscribe(ResMgr::OnFilesChanged);
+		ResMgr::SetModelReloadCallback(onModelReloaded);
+	}
+#endif
 
 	while (gAppIsRunning)
 	{
@@ -161,6 +192,9 @@ i32 main(void)
 			break;
 		}
 
+		// resources are only swapped between frames
+		HotReload::Update();
+
 		f32 currentFrame = static_cast<f32>(glfwGetTime());
 		gDeltaTime = currentFrame - gLastTime;
 		gDeltaTime = (gDeltaTime > 0.2f) ? 0.2f : gDeltaTime;
@@ -172,13 +206,14 @@ i32 main(void)
 		update();
 
 		gRenderer->SetCamera(gCamera);
+		Benchmark::RecordFrame(gDeltaTime, gCamera, gMovementInput);
 
 		gRenderer->Render(gDeltaTime, currentFrame);
 
 		{
 			ZoneScopedN("Text Rendering");
 			GL_ZONE("Draw Text");
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
 			//glClear(GL_COLOR_BUFFER_BIT);
 			gUiMgr.UpdateProjection(gWindowWidth, gWindowHeight);
 			//gUiMgr.RenderEnglish("Hello, world!", glm::vec2(100.0f, 300.0f), 1.0f, glm::vec3(1.0f));
@@ -191,10 +226,16 @@ i32 main(void)
 			ZoneScopedN("Swap Buffers");
 			glfwSwapBuffers(gWindow);
 		}
+		// the GPU zones are collected once the frame is submitted
+		GpuProfiler::NewFrame();
+		GLState::NewFrame();
 
 		FrameMark;
 	}
 
+	HotReload::ShutDown();
+	Benchmark::EndRecording();
+
 	cache.Destroy();
 
 	gUiMgr.ShutDown();
@@ -227,6 +268,24 @@ void framebufferSizeCb(GLFWwindow* ioWindow, i32 inWidth, i32 inHeight)
 	gRenderer->OnResize(inWidth, inHeight);
 }
 
+void onModelReloaded(const Geom::Model* inModel)
+{
+	if (inModel != gModel)
+		return;
+
+	gRenderer->mMeshes.clear();
+	gRenderer->mOccluderMeshes.clear();
+	gRenderer->mPointLights.clear();
+	for (u32 i = 0; i < gModel->mMeshes.size(); i++)
+	{
+		gRenderer->mMeshes.push_back(&gModel->mMeshes[i]);
+		if (SoftOcclusion::IsOccluderCandidate(gModel->mMeshes[i]))
+			gRenderer->mOccluderMeshes.push_back(&gModel->mMeshes[i]);
+	}
+	for (u32 i = 0; i < gModel->mPointLights.size(); i++)
+		gRenderer->mPointLights.push_back(&gModel->mPointLights[i]);
+}
+
 void mouseMoveCb(GLFWwindow* inWindow, f64 inX, f64 inY)
 {
 	if (!gCaptureMouse)
@@ -319,7 +378,8 @@ void keyCb(GLFWwindow* inWindow, i32 inKey, i32 inScancode, i32 inAction, i32 in
 		}
 
 		case GLFW_KEY_1:
-			gRenderer->mSettings.mEnableFXAA = !gRenderer->mSettings.mEnableFXAA;
+			// cycle through the anti-aliasing modes
+			gRenderer->mSettings.mAntiAliasing = (EAntiAliasing)(((u32)gRenderer->mSettings.mAntiAliasing + 1) % 3);
 			break;
 
 		case GLFW_KEY_2:
@@ -419,6 +479,7 @@ void processInput()
 	}
 
 	gPhysics->UpdateCharacter(gDeltaTime, movementDir);
+	gMovementInput = movementDir;
 
 	if (glfwGetMouseButton(gWindow, GLFW_MOUSE_BUTTON_LEFT))
 	{
@@ -450,10 +511,92 @@ void update()
 	ImGui::Begin("Debug Menu");
 	{
 		// ImGui::SliderFloat("Exposure", &gExposure, 0.0f, 10.0f);
-		ImGui::Checkbox("FXAA", &gRenderer->mSettings.mEnableFXAA);
+		{
+			static const char* kAntiAliasingModes[] = { "None", "FXAA", "TAA" };
+			i32 mode = (i32)gRenderer->mSettings.mAntiAliasing;
+			if (ImGui::Combo("Anti-Aliasing", &mode, kAntiAliasingModes, IM_ARRAYSIZE(kAntiAliasingModes)))
+				gRenderer->mSettings.mAntiAliasing = (EAntiAliasing)mode;
+
+			ImGui::SliderFloat("TAA Blend", &gRenderer->mSettings.mTaaBlend, 0.02f, 0.5f);
+		}
 		ImGui::Checkbox("SSAO", &gRenderer->mSettings.mEnableSSAO);
+		{
+			static const char* kAoTechniques[] = { "Hemisphere (SSAO)", "Horizon (GTAO)" };
+			i32 technique = (i32)gRenderer->mSettings.mAmbientOcclusion;
+			if (ImGui::Combo("AO Technique", &technique, kAoTechniques, IM_ARRAYSIZE(kAoTechniques)))
+				gRenderer->mSettings.mAmbientOcclusion = (EAmbientOcclusion)technique;
+
+			static const char* kSsaoResolutions[] = { "Full", "Half", "Quarter" };
+			i32 resolution = gRenderer->mSettings.mSsaoResolutionDivisor == 4 ? 2 : gRenderer->mSettings.mSsaoResolutionDivisor - 1;
+			if (ImGui::Combo("SSAO Resolution", &resolution, kSsaoResolutions, IM_ARRAYSIZE(kSsaoResolutions)))
+				gRenderer->mSettings.mSsaoResolutionDivisor = 1u << resolution;
+
+			i32 sampleCount = (i32)gRenderer->mSettings.mSsaoSampleCount;
+			if (ImGui::SliderInt("SSAO Samples", &sampleCount, 4, (i32)Renderer::kMaxSsaoSamples))
+				gRenderer->mSettings.mSsaoSampleCount = (u32)sampleCount;
+
+			ImGui::SliderFloat("SSAO Radius", &gRenderer->mSettings.mSsaoRadius, 0.1f, 10.0f);
+
+			i32 sliceCount = (i32)gRenderer->mSettings.mGtaoSliceCount;
+			if (ImGui::SliderInt("GTAO Slices", &sliceCount, 1, 8))
+				gRenderer->mSettings.mGtaoSliceCount = (u32)sliceCount;
+
+			i32 stepCount = (i32)gRenderer->mSettings.mGtaoStepCount;
+			if (ImGui::SliderInt("GTAO Steps", &stepCount, 1, 16))
+				gRenderer->mSettings.mGtaoStepCount = (u32)stepCount;
+		}
 		ImGui::Checkbox("Physics", &gEnablePhysics);
 		ImGui::Checkbox("CLUT", &gRenderer->mSettings.mEnableCLUT);
+		ImGui::Checkbox("Auto Exposure", &gRenderer->mSettings.mEnableAutoExposure);
+		ImGui::SliderFloat("Exposure Low Percentile", &gRenderer->mSettings.mExposureLowPercentile, 0.0f, 1.0f);
+		ImGui::SliderFloat("Exposure High Percentile", &gRenderer->mSettings.mExposureHighPercentile, 0.0f, 1.0f);
+		ImGui::SliderFloat("Exposure Adaptation", &gRenderer->mSettings.mExposureAdaptationSpeed, 0.1f, 10.0f);
+		{
+			i32 mipCount = (i32)gRenderer->mSettings.mBloomMipCount;
+			if (ImGui::SliderInt("Bloom Mips", &mipCount, 1, (i32)Renderer::kMaxBloomMips))
+				gRenderer->mSettings.mBloomMipCount = (u32)mipCount;
+
+			ImGui::SliderFloat("Bloom Radius", &gRenderer->mSettings.mBloomFilterRadius, 0.001f, 0.02f);
+		}
+		ImGui::Checkbox("CSM Debug", &gRenderer->mSettings.mCsmDebug);
+		ImGui::Checkbox("Cached Cascades", &gRenderer->mSettings.mCachedCascades);
+		{
+			i32 cascadeCount = (i32)gRenderer->mSettings.mCascadeCount;
+			if (ImGui::SliderInt("Cascades", &cascadeCount, 1, (i32)Renderer::kCascadeCount))
+				gRenderer->mSettings.mCascadeCount = (u32)cascadeCount;
+		}
+		ImGui::SliderFloat("Cascade Split Lambda", &gRenderer->mSettings.mCascadeSplitLambda, 0.0f, 1.0f);
+		ImGui::Checkbox("Sample Distribution Shadows", &gRenderer->mSettings.mSampleDistribution);
+		ImGui::Checkbox("Packed G-Buffer", &gRenderer->mSettings.mPackedGBuffer);
+		ImGui::Checkbox("Occlusion Culling", &gRenderer->mSettings.mOcclusionCulling);
+		ImGui::Checkbox("Software Occlusion", &gRenderer->mSettings.mSoftwareOcclusion);
+		ImGui::Checkbox("Depth Prepass", &gRenderer->mSettings.mDepthPrepass);
+		if (ImGui::Button("Benchmark Software Occlusion"))
+			SoftOcclusion::Benchmark(gRenderer->mJobSystem);
+		if (ImGui::Button("Benchmark Resource Handles"))
+			ResMgr::Benchmark();
+		{
+			static const char* kTransparencyModes[] = { "Sorted", "Weighted Blended OIT", "Linked List OIT" };
+			i32 mode = (i32)gRenderer->mSettings.mTransparency;
+			if (ImGui::Combo("Transparency", &mode, kTransparencyModes, IM_ARRAYSIZE(kTransparencyModes)))
+				gRenderer->mSettings.mTransparency = (ETransparency)mode;
+
+			if (ImGui::Button("Benchmark Transparency"))
+				gRenderer->BenchmarkTransparency();
+		}
+		// replay it with `--benchmark` and a manifest which names the track
+		if (!Benchmark::IsRecording() && ImGui::Button("Record Benchmark Track"))
+			Benchmark::BeginRecording("benchmarks/recorded.track");
+		else if (Benchmark::IsRecording() && ImGui::Button("Stop Recording"))
+			Benchmark::EndRecording();
+		ImGui::Checkbox("Dynamic Resolution", &gRenderer->mSettings.mDynamicResolution);
+		ImGui::SliderFloat("Target GPU Time (ms)", &gRenderer->mSettings.mTargetGpuTimeMs, 2.0f, 33.0f);
+		ImGui::SliderFloat("Min Render Scale", &gRenderer->mSettings.mMinRenderScale, 0.25f, 1.0f);
+		ImGui::SliderFloat("Sharpness", &gRenderer->mSettings.mSharpness, 0.0f, 1.0f);
+		ImGui::Text(
+			"Render Scale: %.2f (%ux%u)\nGPU Time: %.3fms",
+			gRenderer->mRenderScale, gRenderer->mRenderWidth, gRenderer->mRenderHeight, gRenderer->mGpuTimeMs
+		);
 		ImGui::Text("Delta Time: %.3fms\nFPS: %.2f", gDeltaTime, 1.0f / gDeltaTime);
 	}
 	ImGui::End();